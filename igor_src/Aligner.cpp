@@ -25,10 +25,45 @@
  */
 
 #include "Aligner.h"
+#include "Seqstreamreader.h"
+#include "Binaryalignments.h"
+#include "Stripedsw.h"
+#include "Alignmentwriter.h"
+#include "Alignmentcache.h"
+#include <sys/stat.h>
+#include <limits>
+#include <atomic>
+#include <map>
+#include <sstream>
 
 using namespace std;
 
-Aligner::Aligner() {
+/*
+ * Buffers used by Aligner::sw_align, one instance per thread reused across alignments
+ * Buffers only grow such that a thread only allocates memory when it meets a larger SW matrix than before
+ */
+struct Sw_workspace{
+	Unchecked_matrix<double> score_matrix;
+	Unchecked_matrix<int> col_memory_matrix;
+	Unchecked_matrix<int> row_memory_matrix;
+	Unchecked_matrix<int> alignment_numb_tracker;
+	vector<int> max_row_coord;
+	vector<int> max_col_coord;
+	vector<int> max_score;
+	Int_Str flipped_data_sequence;
+	Int_Str flipped_genomic_sequence;
+};
+
+static Sw_workspace& get_thread_sw_workspace(){
+	static thread_local Sw_workspace workspace;
+	return workspace;
+}
+
+//Number of SW alignments performed and number of DP matrices allocations they required (over all threads)
+static atomic<size_t> sw_align_count(0);
+static atomic<size_t> sw_matrix_allocation_count(0);
+
+Aligner::Aligner(): output_format(CSV_align_f) , output_order(Arrival_order) , max_abs_substitution_score(0) , seed_length(0) {
 	// TODO Auto-generated constructor stub
 
 }
@@ -38,7 +73,12 @@ Aligner::Aligner() {
  * @gap_pen : sets the gap penalty (the gap penalty is linear)
  * @gene : Gene class of the gene aligned. V gene allows for deletions on the 3' side of the genomic template, J gene on the 5' , D gene and undefined allow deletion on both sides
  */
-Aligner::Aligner(Matrix<double> sub_mat , int gap_pen , Gene_class gene): substitution_matrix(sub_mat) , gap_penalty(gap_pen), gene(gene){
+Aligner::Aligner(Matrix<double> sub_mat , int gap_pen , Gene_class gene): substitution_matrix(sub_mat) , gap_penalty(gap_pen), gene(gene) , output_format(CSV_align_f) , output_order(Arrival_order) , max_abs_substitution_score(0) , seed_length(0){
+	for(int i = 0 ; i != substitution_matrix.get_n_rows() ; ++i){
+		for(int j = 0 ; j != substitution_matrix.get_n_cols() ; ++j){
+			max_abs_substitution_score = max(max_abs_substitution_score , fabs(substitution_matrix(i,j)));
+		}
+	}
 	switch(gene){
 	case V_gene:
 		//Perform best alignment using all the right part of the genomic sequence
@@ -71,46 +111,11 @@ Aligner::~Aligner() {
 	// TODO Auto-generated destructor stub
 }
 /*
- * This method reads sequences in a fasta file and return a vector of indexed sequences
+ * This method reads sequences in a (possibly gzipped) fasta file and return a vector of indexed sequences
  */
 vector<pair<const int, const string>> read_fasta(string filename){
-	//TODO Check for \r,\n\s stuff
-	ifstream infile(filename);
-	if(!infile){
-		throw runtime_error("File not found: "+filename);
-	}
-	string seq_str;
-	string temp_str;
-	int seq_count = -1;
-	vector<pair<const int, const std::string>> sequence_vect;
-
-	while (getline(infile,temp_str)){
-		if(temp_str[temp_str.size()-1] == '\r'){
-			temp_str.erase(temp_str.size()-1);
-		}
-		if(temp_str[0] == '>'){
-
-			if(seq_count>(-1)){
-				//Read sequences in upper case
-				transform(seq_str.begin(),seq_str.end(),seq_str.begin(),::toupper);
-				sequence_vect.push_back(pair<const int , const string> (seq_count , seq_str));
-			}
-
-			seq_str = string();
-			seq_count++;
-		}
-		else{
-			seq_str+=temp_str;
-		}
-
-	}
-	if(seq_count>(-1)){
-		//Read sequences in upper case
-		transform(seq_str.begin(),seq_str.end(),seq_str.begin(),::toupper);
-		sequence_vect.push_back(pair<const int , const string> (seq_count , seq_str));
-	}
-
-	return sequence_vect;
+	Seq_stream_reader fasta_reader(filename,FASTA_f);
+	return fasta_reader.read_all();
 }
 
 /*
@@ -128,7 +133,7 @@ vector<pair<string,string>> read_genomic_fasta(string filename){
 		vector<pair<string,std::string>> sequence_vect;
 
 		while (getline(infile,temp_str)){
-			if(temp_str[temp_str.size()-1] == '\r'){
+			if( (not temp_str.empty()) and (temp_str[temp_str.size()-1] == '\r')){
 				temp_str.erase(temp_str.size()-1);
 			}
 			if(temp_str[0] == '>'){
@@ -186,29 +191,19 @@ vector<pair<string,string>> read_genomic_fasta(string filename){
 	}
 
 /*
- * This method reads a file with one sequence per line and returns a vector of indexed sequences
+ * This method reads a (possibly gzipped) file with one sequence per line and returns a vector of indexed sequences
  */
 vector<pair<const int , const string>> read_txt(string filename){
-	ifstream infile(filename);
-	if(!infile){
-		throw runtime_error("File not found: "+filename);
-	}
-	int seq_count = 0;
-	vector<pair<const int, const std::string>> sequence_vect;
-	string seq_str;
-
-	while(getline(infile,seq_str)){
-		if(seq_str[seq_str.size()-1] == '\r'){
-			seq_str.erase(seq_str.size()-1);
-		}
-		if(!seq_str.empty()){
-			transform(seq_str.begin(),seq_str.end(),seq_str.begin(),::toupper);
-			sequence_vect.push_back(pair<const int , const string >(seq_count , seq_str));
-			seq_count++;
-		}
-	}
+	Seq_stream_reader txt_reader(filename,TXT_f);
+	return txt_reader.read_all();
+}
 
-	return sequence_vect;
+/*
+ * This method reads sequences in a (possibly gzipped) fastq file and returns a vector of indexed sequences
+ */
+vector<pair<const int , const string>> read_fastq(string filename){
+	Seq_stream_reader fastq_reader(filename,FASTQ_f);
+	return fastq_reader.read_all();
 }
 /*
  * This methods reads a file containing at each line the index of the sequence a semicolon and the actual sequence
@@ -280,11 +275,8 @@ forward_list<Alignment_data> Aligner::align_seq(string nt_seq , double score_thr
 }
 
 forward_list<Alignment_data> Aligner::align_seq(string nt_seq , double score_threshold , bool best_align_only, bool best_gene_only , unordered_map<string,pair<int,int>> genomic_offset_bounds , bool rev_offset_frame/*=false*/){
-	set<string> all_genomic_names;
-	for(pair<string,string> genomic_template: this->nt_genomic_sequences){
-		all_genomic_names.emplace(genomic_template.first);
-	}
-	return align_seq(nt_seq , score_threshold , best_align_only, best_gene_only , genomic_offset_bounds, all_genomic_names, rev_offset_frame/*=false*/);
+	//Align all genomic templates
+	return this->align_int_seq(nt2int(nt_seq) , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , NULL , rev_offset_frame , NULL);
 }
 
 
@@ -307,15 +299,219 @@ forward_list<Alignment_data> Aligner::align_seq(string nt_seq , double score_thr
  *
  */
 forward_list<Alignment_data> Aligner::align_seq(string nt_seq , double score_threshold , bool best_align_only, bool best_gene_only , unordered_map<string,pair<int,int>> genomic_offset_bounds, set<string> restricted_genomic_list, bool rev_offset_frame/*=false*/){
-	int min_offset;
-	int max_offset;
-	Int_Str int_seq = nt2int(nt_seq);
+	return this->align_int_seq(nt2int(nt_seq) , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , &restricted_genomic_list , rev_offset_frame , NULL);
+}
+
+/**
+ * \brief A function performing alignment of all genomic templates against a batch of sequences
+ *
+ * \param [in] nt_seqs the nucleotide sequences to study
+ * \param [in] score_threshold The SW alignment score threshold to record an alignment
+ * \param [in] best_align_only Only retain the best alignment for each genomic template.
+ * \param [in] best_gene_only Only retain the best gene/allele candidate (or best candidates if several have the same highest score).
+ * \param [in] genomic_offset_bounds A hash map containing offsets lower and upper bounds for each genomic template. Keys of the map are the genomic templates names.
+ * \param [in] rev_offset_frame Are offsets bounds given reversed? (offset defined based on the last sequence nt instead of the first). Default is false.
+ *
+ * Returns the same alignments as align_seq() for each sequence (in the same order as nt_seqs).
+ * Sequences are processed by groups of get_interseq_batch_size() sequences: the score upper bounds of a group against each genomic template are
+ * computed at once by the inter sequence SIMD kernel (one sequence per lane) instead of running the striped kernel for each sequence.
+ */
+vector<forward_list<Alignment_data>> Aligner::align_seq_batch(const vector<string>& nt_seqs , double score_threshold , bool best_align_only , bool best_gene_only , const unordered_map<string,pair<int,int>>& genomic_offset_bounds , bool rev_offset_frame/*=false*/){
+	vector<Int_Str> int_seqs;
+	int_seqs.reserve(nt_seqs.size());
+	for(vector<string>::const_iterator iter = nt_seqs.begin() ; iter != nt_seqs.end() ; ++iter){
+		int_seqs.push_back(nt2int(*iter));
+	}
+	vector<Int_Str> flipped_seqs;
+	if(flip_seqs){
+		flipped_seqs = int_seqs;
+		for(vector<Int_Str>::iterator iter = flipped_seqs.begin() ; iter != flipped_seqs.end() ; ++iter){
+			reverse((*iter).begin(),(*iter).end());
+		}
+	}
+	const vector<Int_Str>& profiled_seqs = flip_seqs ? flipped_seqs : int_seqs;
+
+	vector<forward_list<Alignment_data>> batch_alignments;
+	batch_alignments.reserve(int_seqs.size());
+	size_t batch_size = get_interseq_batch_size();
+	vector<int> seqs_bounds;
+	for(size_t first_seq = 0 ; first_seq < int_seqs.size() ; first_seq += batch_size){
+		size_t last_seq = min(first_seq + batch_size , int_seqs.size());
+		vector<const Int_Str*> lanes_seqs;
+		for(size_t i = first_seq ; i != last_seq ; ++i){
+			lanes_seqs.push_back(&profiled_seqs[i]);
+		}
+		Interseq_sw_batch sw_batch(lanes_seqs , substitution_matrix , gap_penalty , local_align);
+		if(not sw_batch.is_enabled()){
+			//Fall back on the single sequence score pass
+			for(size_t i = first_seq ; i != last_seq ; ++i){
+				batch_alignments.push_back(this->align_int_seq(int_seqs[i] , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , NULL , rev_offset_frame , NULL));
+			}
+			continue;
+		}
+
+		//Score bounds of each sequence indexed by genomic template
+		vector<vector<int>> templates_score_bounds(last_seq - first_seq , vector<int>(profiled_genomic_sequences.size()));
+		for(size_t genomic_index = 0 ; genomic_index != profiled_genomic_sequences.size() ; ++genomic_index){
+			sw_batch.max_scores(profiled_genomic_sequences[genomic_index] , seqs_bounds);
+			for(size_t k = 0 ; k != seqs_bounds.size() ; ++k){
+				templates_score_bounds[k][genomic_index] = seqs_bounds[k];
+			}
+		}
+		for(size_t i = first_seq ; i != last_seq ; ++i){
+			batch_alignments.push_back(this->align_int_seq(int_seqs[i] , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , NULL , rev_offset_frame , &templates_score_bounds[i-first_seq]));
+		}
+	}
+	return batch_alignments;
+}
+
+/*
+ * Same as align_seq_batch() but alignments of sequences present in the cache are reused and each distinct sequence is aligned once.
+ * Newly aligned sequences are added to the cache if they belong to cached_seqs (all of them if NULL).
+ */
+vector<Shared_seq_alignments> Aligner::align_seq_batch_cached(const vector<string>& nt_seqs , double score_threshold , bool best_align_only , bool best_gene_only , const unordered_map<string,pair<int,int>>& genomic_offset_bounds , bool rev_offset_frame , Alignment_cache& alignment_cache , const unordered_set<string>* cached_seqs_p){
+	vector<Shared_seq_alignments> batch_alignments(nt_seqs.size());
+	vector<string> missing_seqs;
+	vector<size_t> missing_seqs_indices(nt_seqs.size());
+	unordered_map<string,size_t> missing_seqs_map;
+	for(size_t i = 0 ; i != nt_seqs.size() ; ++i){
+		batch_alignments[i] = alignment_cache.find(nt_seqs[i]);
+		if(not batch_alignments[i]){
+			pair<unordered_map<string,size_t>::iterator,bool> emplace_result = missing_seqs_map.emplace(nt_seqs[i] , missing_seqs.size());
+			if(emplace_result.second){
+				missing_seqs.push_back(nt_seqs[i]);
+			}
+			missing_seqs_indices[i] = (*emplace_result.first).second;
+		}
+	}
+	if(missing_seqs.empty()){
+		return batch_alignments;
+	}
+
+	vector<forward_list<Alignment_data>> missing_alignments = this->align_seq_batch(missing_seqs , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , rev_offset_frame);
+	vector<Shared_seq_alignments> shared_missing_alignments(missing_seqs.size());
+	for(size_t k = 0 ; k != missing_seqs.size() ; ++k){
+		shared_missing_alignments[k] = make_shared<const forward_list<Alignment_data>>(move(missing_alignments[k]));
+		if( (cached_seqs_p == NULL) or (cached_seqs_p->count(missing_seqs[k])>0) ){
+			alignment_cache.insert(missing_seqs[k] , shared_missing_alignments[k]);
+		}
+	}
+	for(size_t i = 0 ; i != nt_seqs.size() ; ++i){
+		if(not batch_alignments[i]){
+			batch_alignments[i] = shared_missing_alignments[missing_seqs_indices[i]];
+		}
+	}
+	return batch_alignments;
+}
+
+/*
+ * Creates the alignment cache used by align_seqs()
+ * Without persistent cache only sequences appearing several times in sequence_list are cached (they are returned in repeated_seqs),
+ * otherwise all sequences are cached and the cache previously saved for the same parameters is loaded.
+ */
+shared_ptr<Alignment_cache> Aligner::create_alignment_cache(const vector<pair<const int , const string>>& sequence_list , double score_threshold , bool best_align_only , bool best_gene_only , const unordered_map<string,pair<int,int>>& genomic_offset_bounds , bool rev_offset_frame , unordered_set<string>& repeated_seqs){
+	shared_ptr<Alignment_cache> alignment_cache_p = make_shared<Alignment_cache>(this->get_alignment_parameters_key(score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , rev_offset_frame));
+	if(alignment_cache_dir.empty()){
+		repeated_seqs = find_repeated_sequences(sequence_list);
+	}
+	else{
+		alignment_cache_p->load(this->get_alignment_cache_prefix(*alignment_cache_p));
+	}
+	return alignment_cache_p;
+}
+
+/*
+ * Returns a text describing everything the alignments depend on: gene class, alignment parameters, genomic templates and their offset bounds
+ * Alignments obtained with the same key are identical
+ */
+string Aligner::get_alignment_parameters_key(double score_threshold , bool best_align_only , bool best_gene_only , const unordered_map<string,pair<int,int>>& genomic_offset_bounds , bool rev_offset_frame) const{
+	ostringstream key_stream;
+	key_stream.precision(17);
+	key_stream<<"gene="<<this->gene<<endl;
+	key_stream<<"score_threshold="<<score_threshold<<endl;
+	key_stream<<"best_align_only="<<best_align_only<<endl;
+	key_stream<<"best_gene_only="<<best_gene_only<<endl;
+	key_stream<<"reversed_offsets="<<rev_offset_frame<<endl;
+	key_stream<<"gap_penalty="<<this->gap_penalty<<endl;
+	key_stream<<"seed_length="<<this->seed_length<<endl;
+	key_stream<<"substitution_matrix="<<substitution_matrix.get_n_rows()<<"x"<<substitution_matrix.get_n_cols();
+	for(int i = 0 ; i != substitution_matrix.get_n_rows() ; ++i){
+		for(int j = 0 ; j != substitution_matrix.get_n_cols() ; ++j){
+			key_stream<<","<<substitution_matrix(i,j);
+		}
+	}
+	key_stream<<endl;
+	//Sort templates by name such that the key does not depend on their order
+	map<string,string> sorted_templates(nt_genomic_sequences.begin() , nt_genomic_sequences.end());
+	for(map<string,string>::const_iterator iter = sorted_templates.begin() ; iter != sorted_templates.end() ; ++iter){
+		key_stream<<"template="<<(*iter).first<<";"<<(*iter).second;
+		unordered_map<string,pair<int,int>>::const_iterator bounds_iter = genomic_offset_bounds.find((*iter).first);
+		if(bounds_iter != genomic_offset_bounds.end()){
+			key_stream<<";"<<(*bounds_iter).second.first<<";"<<(*bounds_iter).second.second;
+		}
+		key_stream<<endl;
+	}
+	return key_stream.str();
+}
+
+/*
+ * Returns the path prefix of the persistent cache files for the parameters of the cache
+ */
+string Aligner::get_alignment_cache_prefix(const Alignment_cache& alignment_cache) const{
+	ostringstream prefix_stream;
+	prefix_stream<<alignment_cache_dir;
+	if(alignment_cache_dir.back() != '/'){
+		prefix_stream<<"/";
+	}
+	prefix_stream<<this->gene<<"_"<<hex<<fnv1a_hash(alignment_cache.get_parameters_key());
+	return prefix_stream.str();
+}
+
+/*
+ * Returns the genomic templates names (in the order of int_genomic_sequences)
+ */
+vector<string> Aligner::get_template_names() const{
+	vector<string> template_names;
+	for(forward_list<pair<string,Int_Str>>::const_iterator iter = this->int_genomic_sequences.begin() ; iter != this->int_genomic_sequences.end() ; ++iter){
+		template_names.push_back(iter->first);
+	}
+	return template_names;
+}
+
+/*
+ * Aligns the genomic templates contained in restricted_genomic_list (all templates if NULL) against an int encoded sequence.
+ * If templates_score_bounds is NULL the score upper bounds of the templates are computed with the striped kernel, otherwise
+ * they are read from it (indexed in the order of int_genomic_sequences).
+ */
+forward_list<Alignment_data> Aligner::align_int_seq(const Int_Str& int_seq , double score_threshold , bool best_align_only, bool best_gene_only , const unordered_map<string,pair<int,int>>& genomic_offset_bounds, const set<string>* restricted_genomic_list, bool rev_offset_frame , const vector<int>* templates_score_bounds_p){
 	size_t seqlen=int_seq.size();
 	forward_list<Alignment_data> alignment_list;// = *(new forward_list<Alignment_data>());
 
-	for(forward_list<pair<string,Int_Str>>::const_iterator iter = int_genomic_sequences.begin() ; iter != int_genomic_sequences.end() ; iter++){
+	//The striped SIMD kernel gives an upper bound of the alignment scores of each template at a fraction of the cost of sw_align
+	shared_ptr<Striped_sw_profile> sw_profile_p;
+	if(templates_score_bounds_p == NULL){
+		Int_Str profiled_seq = int_seq;
+		if(flip_seqs){
+			reverse(profiled_seq.begin(),profiled_seq.end());
+		}
+		sw_profile_p = make_shared<Striped_sw_profile>(profiled_seq , substitution_matrix , gap_penalty , local_align);
+	}
+
+	//Diagonals of the k-mers shared with each genomic template if the seed prefilter is used
+	vector<vector<int>> templates_seed_diagonals;
+	if(seed_length>0){
+		templates_seed_diagonals = this->find_seed_diagonals(int_seq);
+	}
+
+	vector<forward_list<pair<string,Int_Str>>::const_iterator> aligned_templates;
+	vector<pair<int,int>> templates_offsets;
+	vector<int> templates_score_bounds;
+	size_t genomic_index = 0;
+	for(forward_list<pair<string,Int_Str>>::const_iterator iter = int_genomic_sequences.begin() ; iter != int_genomic_sequences.end() ; iter++ , ++genomic_index){
 		//If the gene must be aligned
-		if(restricted_genomic_list.count((*iter).first)>0){
+		if( (restricted_genomic_list == NULL) or (restricted_genomic_list->count((*iter).first)>0) ){
+			int min_offset;
+			int max_offset;
 			// Extract min and max offset information from the offset bounds map
 			try{
 				min_offset=genomic_offset_bounds.at((*iter).first).first;
@@ -330,22 +526,71 @@ forward_list<Alignment_data> Aligner::align_seq(string nt_seq , double score_thr
 			min_offset+=(rev_offset_frame)? seqlen-1:0;//seqlen-1 correspond to the index of the last nt of the sequence
 			max_offset+=(rev_offset_frame)? seqlen-1:0;
 
-			list<pair<int,Alignment_data>> alignments;
-			try{
-				alignments = this->sw_align(int_seq , (*iter).second , score_threshold , best_align_only , min_offset , max_offset);
-			}
-			catch(exception& e){
-				cerr<<endl;
-				cerr<<"Exception caught calling sw_align() on genomic template:"<<(*iter).first<<endl;
-				throw e;
+			int score_bound = INT16_MAX;
+			if(seed_length>0){
+				//The template is not aligned if it shares no k-mer with the sequence on a diagonal within the offset bounds
+				const vector<int>& seed_diagonals = templates_seed_diagonals[genomic_index];
+				vector<int>::const_iterator diag_iter = lower_bound(seed_diagonals.begin(),seed_diagonals.end(),min_offset);
+				if( (diag_iter == seed_diagonals.end()) or ((*diag_iter)>max_offset) ){
+					score_bound = numeric_limits<int>::min();
+				}
 			}
-			//TODO quick and dirty fix for D genes alignments
-			//alignment.second.gene_name = (*iter).first;
-			//alignment_list.push_front(alignment.second);
-			for(list<pair<int,Alignment_data>>::iterator jiter = alignments.begin() ; jiter != alignments.end() ; jiter++){
-				(*jiter).second.gene_name = (*iter).first;
-				alignment_list.push_front((*jiter).second);
+			if(score_bound != numeric_limits<int>::min()){
+				if(templates_score_bounds_p != NULL){
+					score_bound = (*templates_score_bounds_p)[genomic_index];
+				}
+				else if(sw_profile_p->is_enabled()){
+					score_bound = sw_profile_p->max_score(profiled_genomic_sequences[genomic_index]);
+				}
 			}
+
+			aligned_templates.push_back(iter);
+			templates_offsets.emplace_back(min_offset,max_offset);
+			templates_score_bounds.push_back(score_bound);
+		}
+	}
+
+	//When only the best gene is kept, align templates by decreasing score bound such that templates that cannot compete with the best alignment found so far are skipped
+	vector<size_t> alignment_order(aligned_templates.size());
+	for(size_t i = 0 ; i != alignment_order.size() ; ++i){
+		alignment_order[i] = i;
+	}
+	if(best_gene_only){
+		stable_sort(alignment_order.begin(),alignment_order.end(),[&templates_score_bounds](const size_t& i , const size_t& j){return templates_score_bounds[i]>templates_score_bounds[j];});
+	}
+
+	vector<list<pair<int,Alignment_data>>> templates_alignments(aligned_templates.size());
+	double best_gene_score = 0;
+	for(vector<size_t>::const_iterator order_iter = alignment_order.begin() ; order_iter != alignment_order.end() ; ++order_iter){
+		size_t template_index = *order_iter;
+		if( (templates_score_bounds[template_index] < score_threshold) or (best_gene_only and (templates_score_bounds[template_index] < best_gene_score)) ){
+			//No alignment of this template can be kept
+			continue;
+		}
+
+		forward_list<pair<string,Int_Str>>::const_iterator iter = aligned_templates[template_index];
+		list<pair<int,Alignment_data>>& alignments = templates_alignments[template_index];
+		try{
+			alignments = this->sw_align(int_seq , (*iter).second , score_threshold , best_align_only , templates_offsets[template_index].first , templates_offsets[template_index].second);
+		}
+		catch(exception& e){
+			cerr<<endl;
+			cerr<<"Exception caught calling sw_align() on genomic template:"<<(*iter).first<<endl;
+			throw e;
+		}
+		for(list<pair<int,Alignment_data>>::const_iterator jiter = alignments.begin() ; jiter != alignments.end() ; jiter++){
+			best_gene_score = max(best_gene_score,(*jiter).second.score);
+		}
+	}
+
+	//Gather the alignments in the genomic templates order
+	for(size_t template_index = 0 ; template_index != aligned_templates.size() ; ++template_index){
+		//TODO quick and dirty fix for D genes alignments
+		//alignment.second.gene_name = (*iter).first;
+		//alignment_list.push_front(alignment.second);
+		for(list<pair<int,Alignment_data>>::iterator jiter = templates_alignments[template_index].begin() ; jiter != templates_alignments[template_index].end() ; jiter++){
+			(*jiter).second.gene_name = (*aligned_templates[template_index]).first;
+			alignment_list.push_front((*jiter).second);
 		}
 	}
 
@@ -402,32 +647,53 @@ unordered_map<int,forward_list<Alignment_data>> Aligner::align_seqs(vector<pair<
 	int processed_seq_number = 0;
 	double total_number_seqs = sequence_list.size(); //Use a double for float division afterwards
 
+	//Identical sequences are only aligned once
+	unordered_set<string> repeated_seqs;
+	shared_ptr<Alignment_cache> alignment_cache_p = this->create_alignment_cache(sequence_list , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , rev_offset_frame , repeated_seqs);
+	const unordered_set<string>* cached_seqs_p = alignment_cache_dir.empty() ? &repeated_seqs : NULL;
+
 /*
  * Declaring parellel loop using OpenMP 4.0 standards
 	#pragma omp declare reduction (merge:unordered_map<int,forward_list<Alignment_data>>:omp_out.insert(omp_in.begin(),omp_in.end()))
 	#pragma omp parallel for schedule(dynamic) reduction(merge:alignment_map) shared(processed_seq_number)
 */
 
+	//Sequences are aligned by batches sharing the same inter sequence SIMD score pass
+	size_t batch_size = get_interseq_batch_size();
+	int n_batches = (sequence_list.size() + batch_size - 1)/batch_size;
+
 	//Declare parallel loop using OpenMP 3.1 standards
 	#pragma omp parallel for schedule(dynamic) shared(processed_seq_number , alignment_map) //num_threads(1)
-	for(vector<pair<const int , const string>>::const_iterator seq_it = sequence_list.begin() ; seq_it < sequence_list.end() ; seq_it++){
-		forward_list<Alignment_data> seq_alignments = align_seq((*seq_it).second , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , rev_offset_frame);
-		#pragma omp critical(emplace_seq_alignments)
-		{
-			alignment_map.emplace((*seq_it).first , seq_alignments);
-			//cout<<"Seq "<<processed_seq_number<<" processed"<<endl;
-			++processed_seq_number;
+	for(int batch_index = 0 ; batch_index < n_batches ; ++batch_index){
+		vector<pair<const int , const string>>::const_iterator batch_begin = sequence_list.begin() + batch_index*batch_size;
+		vector<pair<const int , const string>>::const_iterator batch_end = sequence_list.begin() + min((batch_index+1)*batch_size , sequence_list.size());
+		vector<string> batch_seqs;
+		for(vector<pair<const int , const string>>::const_iterator seq_it = batch_begin ; seq_it != batch_end ; ++seq_it){
+			batch_seqs.push_back((*seq_it).second);
 		}
+		vector<Shared_seq_alignments> batch_alignments = align_seq_batch_cached(batch_seqs , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , rev_offset_frame , *alignment_cache_p , cached_seqs_p);
 
-		if(processed_seq_number%50 == 0){
-			//Output current progress to cerr
-			#pragma omp critical(show_progress_align)
+		for(vector<pair<const int , const string>>::const_iterator seq_it = batch_begin ; seq_it != batch_end ; ++seq_it){
+			#pragma omp critical(emplace_seq_alignments)
 			{
-				show_progress_bar(cerr,processed_seq_number/total_number_seqs, to_string(this->gene)+" alignments",50);
+				alignment_map.emplace((*seq_it).first , *batch_alignments[seq_it - batch_begin]);
+				//cout<<"Seq "<<processed_seq_number<<" processed"<<endl;
+				++processed_seq_number;
+			}
+
+			if(processed_seq_number%50 == 0){
+				//Output current progress to cerr
+				#pragma omp critical(show_progress_align)
+				{
+					show_progress_bar(cerr,processed_seq_number/total_number_seqs, to_string(this->gene)+" alignments",50);
+				}
 			}
 		}
 	}
 	close_progress_bar(cerr, to_string(this->gene)+" alignments",50);
+	if(not alignment_cache_dir.empty()){
+		alignment_cache_p->save(this->get_alignment_cache_prefix(*alignment_cache_p) , this->get_template_names());
+	}
 	return alignment_map;
 }
 /**
@@ -476,8 +742,6 @@ void Aligner::align_seqs( string filename , vector<pair<const int , const string
  */
 void Aligner::align_seqs( string filename , vector<pair<const int , const string>> sequence_list , double score_threshold , bool best_align_only, bool best_gene_only , unordered_map<string,pair<int,int>> genomic_offset_bounds,bool rev_offset_frame/*=false*/){
 
-	unordered_map<int,forward_list<Alignment_data>> alignment_map; //= *(new unordered_map<int,forward_list<Alignment_data>>);
-
 	string folder_path = filename.substr(0,filename.rfind("/")+1); //Get the file path
 	ofstream align_infos_file(folder_path + "aligns_info.out",fstream::out | fstream::app); //Opens the file in append mode
 
@@ -502,58 +766,89 @@ void Aligner::align_seqs( string filename , vector<pair<const int , const string
 	align_infos_file<<"Gap penalty = "<<this->gap_penalty<<endl;
 	align_infos_file<<"Substitution matrix:"<<endl;
 	align_infos_file<<this->substitution_matrix<<endl;
-	align_infos_file<<sequence_list.size()<<" sequences processed in ";
 
-	ofstream outfile(filename);
-	outfile<<"seq_index"<<";"<<"gene_name"<<";"<<"score"<<";"<<"offset"<<";"<<"insertions"<<";"<<"deletions"<<";"<<"mismatches"<<";"<<"length"<<";5_p_align_offset;3_p_align_offset"<<endl;
+	bool write_csv = (this->output_format == CSV_align_f) or (this->output_format == CSV_BIN_align_f);
+	bool write_binary = (this->output_format == BIN_align_f) or (this->output_format == CSV_BIN_align_f);
 
-	int processed_seq_number = 0;
-	double total_number_seqs = sequence_list.size(); //Use a double for float division afterwards
+	ofstream outfile;
+	if(write_csv){
+		outfile.open(filename);
+		outfile<<"seq_index"<<";"<<"gene_name"<<";"<<"score"<<";"<<"offset"<<";"<<"insertions"<<";"<<"deletions"<<";"<<"mismatches"<<";"<<"length"<<";5_p_align_offset;3_p_align_offset"<<endl;
+	}
 
+	shared_ptr<Binary_alignment_writer> binary_writer_p;
+	if(write_binary){
+		binary_writer_p = make_shared<Binary_alignment_writer>(get_binary_alignment_filename(filename) , this->get_template_names());
+		align_infos_file<<"Binary alignments in file: "<<get_binary_alignment_filename(filename)<<endl;
+	}
 
-/*
- * Declaring parallel loop using OpenMP 4.0 standards
-	#pragma omp declare reduction (merge:unordered_map<int,forward_list<Alignment_data>>:omp_out.insert(omp_in.begin(),omp_in.end()))
-	#pragma omp parallel for schedule(dynamic) reduction(merge:alignment_map) shared(processed_seq_number)
-*/
+	align_infos_file<<"Sequences written in input order = "<<(this->output_order == Input_order)<<endl;
+
+	//Identical sequences are only aligned once
+	unordered_set<string> repeated_seqs;
+	shared_ptr<Alignment_cache> alignment_cache_p = this->create_alignment_cache(sequence_list , score_threshold , best_align_only , best_gene_only , genomic_offset_bounds , rev_offset_frame , repeated_seqs);
+	const unordered_set<string>* cached_seqs_p = alignment_cache_dir.empty() ? &repeated_seqs : NULL;
+	if(not alignment_cache_dir.empty()){
+		align_infos_file<<"Persistent alignment cache: "<<this->get_alignment_cache_prefix(*alignment_cache_p)<<" ("<<alignment_cache_p->size()<<" sequences loaded)"<<endl;
+	}
+	align_infos_file<<sequence_list.size()<<" sequences processed in ";
+
+	size_t begin_sw_align_count = sw_align_count;
+	size_t begin_sw_matrix_allocation_count = sw_matrix_allocation_count;
+
+	//Alignments are buffered by each thread and written by a single writer thread
+	Alignment_output_writer output_writer(write_csv ? &outfile : NULL , binary_writer_p , this->output_order , sequence_list.size() , to_string(this->gene)+" alignments");
+
+	//Sequences are aligned by batches sharing the same inter sequence SIMD score pass
+	size_t batch_size = get_interseq_batch_size();
+	int n_batches = (sequence_list.size() + batch_size - 1)/batch_size;
+	//Give contiguous batches to each thread such that its output buffer holds a range of sequences (as long as there is enough work for all threads)
+	int batch_chunk = max(1 , min(1024/((int) batch_size) , n_batches/(8*omp_get_max_threads())));
 
 	//Declare parallel loop using OpenMP 3.1 standards
-	#pragma omp parallel for schedule(dynamic) shared(processed_seq_number , alignment_map) //num_threads(1)
-	for(vector<pair<const int , const string>>::const_iterator seq_it = sequence_list.begin() ; seq_it < sequence_list.end() ; seq_it++){
-		try{
-			forward_list<Alignment_data> seq_alignments = align_seq((*seq_it).second , score_threshold , best_align_only, best_gene_only , genomic_offset_bounds, rev_offset_frame);
+	#pragma omp parallel shared(output_writer)
+	{
+		#pragma omp for schedule(dynamic,batch_chunk) nowait
+		for(int batch_index = 0 ; batch_index < n_batches ; ++batch_index){
+			vector<pair<const int , const string>>::const_iterator batch_begin = sequence_list.begin() + batch_index*batch_size;
+			vector<pair<const int , const string>>::const_iterator batch_end = sequence_list.begin() + min((batch_index+1)*batch_size , sequence_list.size());
+			try{
+				vector<string> batch_seqs;
+				for(vector<pair<const int , const string>>::const_iterator seq_it = batch_begin ; seq_it != batch_end ; ++seq_it){
+					batch_seqs.push_back((*seq_it).second);
+				}
+				vector<Shared_seq_alignments> batch_alignments = align_seq_batch_cached(batch_seqs , score_threshold , best_align_only, best_gene_only , genomic_offset_bounds, rev_offset_frame , *alignment_cache_p , cached_seqs_p);
 
-			#pragma omp critical(emplace_seq_alignments)
-			{
-				write_single_seq_alignment(outfile , (*seq_it).first , seq_alignments );
-				//cout<<"Seq "<<processed_seq_number<<" processed"<<endl;
-				++processed_seq_number;
+				for(vector<pair<const int , const string>>::const_iterator seq_it = batch_begin ; seq_it != batch_end ; ++seq_it){
+					output_writer.append_seq_alignments(seq_it - sequence_list.begin() , (*seq_it).first , *batch_alignments[seq_it - batch_begin]);
+				}
 			}
-
-			//Output current progress to cerr
-			if(processed_seq_number%50 == 0){
-				#pragma omp critical(show_progress_align)
-				{
-					show_progress_bar(cerr,processed_seq_number/total_number_seqs,to_string(this->gene)+" alignments",50);
+			catch(exception& except){
+				cerr<<endl;
+				cerr<<"Exception caught calling align_seq_batch() on sequences:"<<endl;
+				for(vector<pair<const int , const string>>::const_iterator seq_it = batch_begin ; seq_it != batch_end ; ++seq_it){
+					cerr<<(*seq_it).first<<";"<<(*seq_it).second<<endl;
 				}
+				cerr<<endl;
+				cerr<<"Throwing exception now..."<<endl<<endl;
+				cerr<<except.what()<<endl;
+				throw except;
 			}
 		}
-		catch(exception& except){
-			cerr<<endl;
-			cerr<<"Exception caught calling align_seq() on sequence:"<<endl;
-			cerr<<(*seq_it).first<<";"<<(*seq_it).second<<endl;
-			cerr<<endl;
-			cerr<<"Throwing exception now..."<<endl<<endl;
-			cerr<<except.what()<<endl;
-			throw except;
-		}
-
-
+		output_writer.flush_thread_buffer();
 	}
+	output_writer.close();
 	close_progress_bar(cerr, to_string(this->gene)+" alignments",50);
 
 	chrono::duration<double> elapsed_time = chrono::system_clock::now() - begin_time;
 	align_infos_file<<elapsed_time.count()<<" seconds"<<endl;
+	size_t n_sw_aligns = sw_align_count - begin_sw_align_count;
+	align_infos_file<<"SW alignments performed = "<<n_sw_aligns<<endl;
+	align_infos_file<<"DP matrices allocations = "<<(sw_matrix_allocation_count - begin_sw_matrix_allocation_count)<<" (would be "<<4*n_sw_aligns<<" without workspace reuse)"<<endl;
+	align_infos_file<<"Sequences alignments reused from cache = "<<alignment_cache_p->get_n_hits()<<endl;
+	if(not alignment_cache_dir.empty()){
+		alignment_cache_p->save(this->get_alignment_cache_prefix(*alignment_cache_p) , this->get_template_names());
+	}
 
 }
 
@@ -591,9 +886,17 @@ std::unordered_map<std::string,std::pair<int,int>> Aligner::build_genomic_bounds
 void write_indexed_seq_csv(string filename , vector<pair<const int,const string>> indexed_seq_list){
 	ofstream outfile(filename);
 	outfile<<"seq_index"<<";"<<"sequence"<<endl;
+	append_indexed_seq_csv(outfile,indexed_seq_list);
+}
+
+/*
+ * Appends a chunk of indexed sequences to an already opened indexed sequences file (header excluded)
+ */
+void append_indexed_seq_csv(ofstream& outfile , const vector<pair<const int,const string>>& indexed_seq_list){
 	for(vector<pair<const int,const string>>::const_iterator iter = indexed_seq_list.begin() ; iter!=indexed_seq_list.end() ; iter++){
-		outfile << (*iter).first<<";"<<(*iter).second<<endl;
+		outfile << (*iter).first<<";"<<(*iter).second<<"\n";
 	}
+	outfile.flush();
 }
 /*
  * Writes the alignment in a semicolon separated files with 5 fields:
@@ -615,7 +918,7 @@ void Aligner::write_alignments_seq_csv(string filename , unordered_map<int,forwa
 /*
  * This method writes the alignments for one sequence in the given stream
  */
-void write_single_seq_alignment(ofstream& outfile , int seq_index , forward_list<Alignment_data> seq_alignments){
+void write_single_seq_alignment(ostream& outfile , int seq_index , const forward_list<Alignment_data>& seq_alignments){
 	for(forward_list<Alignment_data>::const_iterator jiter = seq_alignments.begin() ; jiter != seq_alignments.end() ; ++jiter){
 		outfile<<seq_index<<";"<<(*jiter).gene_name<<";"<<(*jiter).score<<";"<<(*jiter).offset<<";{";
 		for(forward_list<int>::const_iterator kiter = (*jiter).insertions.begin() ; kiter!=(*jiter).insertions.end() ; ++kiter){
@@ -665,6 +968,11 @@ forward_list<pair<const int , const string>> read_indexed_seq_csv(string filenam
  * The structure of the file is assumed to be the same as the one created by the Aligner::write_alignments_seq_csv method
  */
 unordered_map<int,vector<Alignment_data>> read_alignments_seq_csv(string filename , double score_threshold , bool allow_in_dels ){
+	//The file may be a binary alignment file (see resolve_alignment_filename())
+	if(is_binary_alignment_file(filename)){
+		return read_alignments_seq_bin(filename , score_threshold , allow_in_dels);
+	}
+
 	ifstream infile(filename);
 	if(!infile){
 		throw runtime_error("File not found: "+filename);
@@ -781,11 +1089,20 @@ unordered_map<int,vector<Alignment_data>> read_alignments_seq_csv(string filenam
 						}
 					}
 
-					//FIXME read alignment length
-
 			}
 
-		indexed_alignments[index].push_back( Alignment_data(gene_name , offset , INT16_MIN , insertions , deletions , mismatches , score));
+		//Alignment length and 5'/3' offsets (not written by older versions)
+		size_t length_sep = (mism_sep==string::npos) ? string::npos : line_str.find(';',mism_sep+1);
+		size_t five_p_sep = (length_sep==string::npos) ? string::npos : line_str.find(';',length_sep+1);
+		if(five_p_sep!=string::npos){
+			size_t align_length = stoul(line_str.substr( (mism_sep+1) , (length_sep - mism_sep -1) ));
+			size_t five_p_offset = stoul(line_str.substr( (length_sep+1) , (five_p_sep - length_sep -1) ));
+			size_t three_p_offset = stoul(line_str.substr(five_p_sep+1));
+			indexed_alignments[index].push_back( Alignment_data(gene_name , offset , five_p_offset , three_p_offset , align_length , insertions , deletions , mismatches , score));
+		}
+		else{
+			indexed_alignments[index].push_back( Alignment_data(gene_name , offset , INT16_MIN , insertions , deletions , mismatches , score));
+		}
 
 	}
 	return indexed_alignments;
@@ -817,20 +1134,27 @@ unordered_map<int,pair<string,unordered_map<Gene_class,vector<Alignment_data>>>>
 	unordered_map<int,vector<Alignment_data>> alignments = read_alignments_seq_csv(filename , 0 , allow_in_dels);
 	for(vector<pair<const int , const string>>::const_iterator seq_it = indexed_sequences.begin() ; seq_it != indexed_sequences.end() ; ++seq_it){
 			vector<Alignment_data>& seq_alignments = alignments[(*seq_it).first];
-			double max_score = -1;
-			for(vector<Alignment_data>::const_iterator align_it = seq_alignments.begin() ; align_it != seq_alignments.end() ; ++align_it){
-				if((*align_it).score>max_score){max_score=(*align_it).score;}
-			}
-			for(vector<Alignment_data>::iterator align_it = (seq_alignments.end()-1) ; align_it != (seq_alignments.begin() -1);--align_it){
-				if((*align_it).score<(max_score-score_range)){seq_alignments.erase(align_it);}
-			}
-			sort(seq_alignments.begin() , seq_alignments.end() , align_compare);
+			select_alignments_score_range(seq_alignments , score_range);
 			sorted_alignments[(*seq_it).first].second[aligned_gene] = alignments[(*seq_it).first];
 			sorted_alignments[(*seq_it).first].first = (*seq_it).second;
 	}
 	return sorted_alignments;
 }
 
+/*
+ * Only keeps alignments whose score is within score_range of the best alignment score and sorts them by decreasing score
+ */
+void select_alignments_score_range(vector<Alignment_data>& seq_alignments , double score_range){
+	double max_score = -1;
+	for(vector<Alignment_data>::const_iterator align_it = seq_alignments.begin() ; align_it != seq_alignments.end() ; ++align_it){
+		if((*align_it).score>max_score){max_score=(*align_it).score;}
+	}
+	for(size_t i = seq_alignments.size() ; i != 0 ; --i){
+		if(seq_alignments[i-1].score<(max_score-score_range)){seq_alignments.erase(seq_alignments.begin()+(i-1));}
+	}
+	sort(seq_alignments.begin() , seq_alignments.end() , align_compare);
+}
+
 vector<tuple<int,string,unordered_map<Gene_class,vector<Alignment_data>>>> map2vect(unordered_map<int,pair<string,unordered_map<Gene_class,vector<Alignment_data>>>> alignments_map){
 	vector<tuple<int,string,unordered_map<Gene_class,vector<Alignment_data>>>> alignmets_vect;
 	for(unordered_map<int,pair<string,unordered_map<Gene_class,vector<Alignment_data>>>>::const_iterator seq_it = alignments_map.begin() ; seq_it != alignments_map.end() ; ++seq_it){
@@ -846,6 +1170,91 @@ void Aligner::set_genomic_sequences(vector< pair <string,string> > nt_genomic_se
 		nt_genomic_sequences.emplace_front((*iter).first,(*iter).second);
 		int_genomic_sequences.emplace_front((*iter).first , nt2int((*iter).second));
 	}
+	this->profiled_genomic_sequences.clear();
+	for(forward_list<pair<string,Int_Str>>::const_iterator iter = int_genomic_sequences.begin() ; iter != int_genomic_sequences.end() ; ++iter){
+		profiled_genomic_sequences.push_back((*iter).second);
+		if(flip_seqs){
+			reverse(profiled_genomic_sequences.back().begin(),profiled_genomic_sequences.back().end());
+		}
+	}
+	this->build_seed_index();
+}
+
+/*
+ * Sets the length of the k-mers used to prefilter the genomic templates before the SW alignment
+ * Only templates sharing at least one k-mer with the sequence on a diagonal allowed by their offset bounds are aligned.
+ * Alignments with few/short exact matches can thus be missed, a null length disables the filter (exact mode, default).
+ */
+void Aligner::set_seed_filter(size_t kmer_length){
+	//k-mers are encoded on 2 bits per nucleotide in 32 bits integers
+	if(kmer_length>16){
+		throw invalid_argument("Seed length for genomic templates prefiltering cannot exceed 16 nucleotides, received: " + to_string(kmer_length));
+	}
+	this->seed_length = kmer_length;
+	this->build_seed_index();
+}
+
+/*
+ * Indexes the positions of all k-mers of the genomic templates
+ * k-mers containing ambiguous nucleotides are not indexed
+ */
+void Aligner::build_seed_index(){
+	seed_index.clear();
+	if(seed_length==0){
+		return;
+	}
+	const uint32_t kmer_mask = (seed_length==16) ? UINT32_MAX : ((1u<<(2*seed_length)) - 1);
+	size_t genomic_index = 0;
+	for(forward_list<pair<string,Int_Str>>::const_iterator iter = int_genomic_sequences.begin() ; iter != int_genomic_sequences.end() ; ++iter , ++genomic_index){
+		uint32_t kmer_code = 0;
+		size_t n_valid_nt = 0;
+		for(size_t pos = 0 ; pos != (*iter).second.size() ; ++pos){
+			int nt = (*iter).second[pos];
+			if(nt>int_T){
+				n_valid_nt = 0;
+				continue;
+			}
+			kmer_code = ((kmer_code<<2) | nt) & kmer_mask;
+			++n_valid_nt;
+			if(n_valid_nt>=seed_length){
+				seed_index[kmer_code].emplace_back(genomic_index , pos + 1 - seed_length);
+			}
+		}
+	}
+}
+
+/*
+ * Returns for each genomic template (in the int_genomic_sequences order) the sorted diagonals (sequence position - template position)
+ * on which a k-mer is shared with the sequence
+ */
+vector<vector<int>> Aligner::find_seed_diagonals(const Int_Str& int_seq) const{
+	vector<vector<int>> templates_diagonals(distance(int_genomic_sequences.begin(),int_genomic_sequences.end()));
+	const uint32_t kmer_mask = (seed_length==16) ? UINT32_MAX : ((1u<<(2*seed_length)) - 1);
+	uint32_t kmer_code = 0;
+	size_t n_valid_nt = 0;
+	for(size_t pos = 0 ; pos != int_seq.size() ; ++pos){
+		int nt = int_seq[pos];
+		if(nt>int_T){
+			n_valid_nt = 0;
+			continue;
+		}
+		kmer_code = ((kmer_code<<2) | nt) & kmer_mask;
+		++n_valid_nt;
+		if(n_valid_nt>=seed_length){
+			unordered_map<uint32_t,vector<pair<size_t,int>>>::const_iterator hits = seed_index.find(kmer_code);
+			if(hits != seed_index.end()){
+				int seq_pos = pos + 1 - seed_length;
+				for(vector<pair<size_t,int>>::const_iterator hit_iter = (*hits).second.begin() ; hit_iter != (*hits).second.end() ; ++hit_iter){
+					templates_diagonals[(*hit_iter).first].push_back(seq_pos - (*hit_iter).second);
+				}
+			}
+		}
+	}
+	for(vector<vector<int>>::iterator diag_iter = templates_diagonals.begin() ; diag_iter != templates_diagonals.end() ; ++diag_iter){
+		sort((*diag_iter).begin(),(*diag_iter).end());
+		(*diag_iter).erase(unique((*diag_iter).begin(),(*diag_iter).end()),(*diag_iter).end());
+	}
+	return templates_diagonals;
 }
 
 /*
@@ -1089,10 +1498,10 @@ vector<pair<const int , const string>> sample_indexed_seq(vector<pair<const int
 
 }
 
-void Aligner::sw_align_common(const Int_Str& int_data_sequence, const Int_Str& int_genomic_sequence ,const int i ,const int j , Matrix<double>& score_matrix , Matrix<int>& row_memory_matrix , Matrix<int>& col_memory_matrix , Matrix<int>& alignment_numb_tracker ,vector<int>& max_score, vector<int>& max_row_coord , vector<int>& max_col_coord){
+void Aligner::sw_align_common(const Int_Str& int_data_sequence, const Int_Str& int_genomic_sequence ,const int i ,const int j , Unchecked_matrix<double>& score_matrix , Unchecked_matrix<int>& row_memory_matrix , Unchecked_matrix<int>& col_memory_matrix , Unchecked_matrix<int>& alignment_numb_tracker ,vector<int>& max_score, vector<int>& max_row_coord , vector<int>& max_col_coord){
 	int genomic_gap_score = score_matrix(i,j-1) - gap_penalty;
 	int data_gap_score = score_matrix(i-1,j) - gap_penalty;
-	int subs_score = score_matrix(i-1,j-1) + substitution_matrix(int_data_sequence.at(i) , int_genomic_sequence.at(j));
+	int subs_score = score_matrix(i-1,j-1) + substitution_matrix(int_data_sequence[i] , int_genomic_sequence[j]);
 
 	if ( (subs_score>= data_gap_score) & (subs_score>=genomic_gap_score) & ( (subs_score>0) | (!local_align) ) ){
 		score_matrix(i,j) = subs_score;
@@ -1154,16 +1563,17 @@ void Aligner::sw_align_common(const Int_Str& int_data_sequence, const Int_Str& i
  */
 list<pair<int,Alignment_data>> Aligner::sw_align(const Int_Str& int_data_sequence ,const Int_Str& int_genomic_sequence , double score_threshold , bool best_only , int min_offset , int max_offset){
 
+	//All DP buffers are borrowed from the thread workspace
+	Sw_workspace& workspace = get_thread_sw_workspace();
 
-
-	Int_Str int_data_sequence_copy = int_data_sequence;
-	Int_Str int_genomic_sequence_copy = int_genomic_sequence;
 	int offset_change = 0;
 
 	if(flip_seqs){
-		reverse(int_data_sequence_copy.begin(),int_data_sequence_copy.end());
-		reverse(int_genomic_sequence_copy.begin(),int_genomic_sequence_copy.end());
+		workspace.flipped_data_sequence.assign(int_data_sequence.rbegin(),int_data_sequence.rend());
+		workspace.flipped_genomic_sequence.assign(int_genomic_sequence.rbegin(),int_genomic_sequence.rend());
 	}
+	const Int_Str& int_data_sequence_copy = flip_seqs ? workspace.flipped_data_sequence : int_data_sequence;
+	const Int_Str& int_genomic_sequence_copy = flip_seqs ? workspace.flipped_genomic_sequence : int_genomic_sequence;
 
 	/*if(min_offset<0){
 		//Remove nucleotides that cannot be in the alignment
@@ -1188,10 +1598,16 @@ list<pair<int,Alignment_data>> Aligner::sw_align(const Int_Str& int_data_sequenc
 
 
 
-	Matrix<double> score_matrix(n_rows,n_cols);
-	Matrix<int> col_memory_matrix(n_rows,n_cols);
-	Matrix<int> row_memory_matrix(n_rows,n_cols);
-	Matrix<int> alignment_numb_tracker(n_rows,n_cols);
+	Unchecked_matrix<double>& score_matrix = workspace.score_matrix;
+	Unchecked_matrix<int>& col_memory_matrix = workspace.col_memory_matrix;
+	Unchecked_matrix<int>& row_memory_matrix = workspace.row_memory_matrix;
+	Unchecked_matrix<int>& alignment_numb_tracker = workspace.alignment_numb_tracker;
+	size_t n_allocations = score_matrix.reshape(n_rows,n_cols) + col_memory_matrix.reshape(n_rows,n_cols)
+			+ row_memory_matrix.reshape(n_rows,n_cols) + alignment_numb_tracker.reshape(n_rows,n_cols);
+	++sw_align_count;
+	if(n_allocations>0){
+		sw_matrix_allocation_count += n_allocations;
+	}
 
 	for(int i = 0 ; i!=n_rows ; ++i){
 		score_matrix(i,0) = 0;
@@ -1211,9 +1627,44 @@ list<pair<int,Alignment_data>> Aligner::sw_align(const Int_Str& int_data_sequenc
 	int max_col_coord;
 	int max_score = 0;*/
 
-	vector<int> max_row_coord;
-	vector<int> max_col_coord;
-	vector<int> max_score;
+	vector<int>& max_row_coord = workspace.max_row_coord;
+	vector<int>& max_col_coord = workspace.max_col_coord;
+	vector<int>& max_score = workspace.max_score;
+	max_row_coord.clear();
+	max_col_coord.clear();
+	max_score.clear();
+
+	//Restrict the DP to the band of diagonals (i-j) that can lead to an alignment within the offset bounds
+	//The margin around the allowed diagonals is chosen such that any path leaving the band scores below a gapless path,
+	//cells within the band are thus filled exactly as for the full matrix and the same alignments are found
+	int64_t band_min_diag;
+	int64_t band_max_diag;
+	if(flip_seqs){
+		int flip_offset = int_data_sequence.size() - int_genomic_sequence.size();
+		band_min_diag = (int64_t) flip_offset - max_offset;
+		band_max_diag = (int64_t) flip_offset - min_offset;
+	}
+	else{
+		band_min_diag = (int64_t) min_offset - offset_change;
+		band_max_diag = (int64_t) max_offset - offset_change;
+	}
+	bool banded = false;
+	if(gap_penalty>0){
+		int64_t band_margin = ceil(4*max_abs_substitution_score*min(n_rows,n_cols)/gap_penalty) + 2;
+		band_min_diag -= band_margin;
+		band_max_diag += band_margin;
+		banded = (band_min_diag > -(n_cols-1)) or (band_max_diag < (n_rows-1));
+	}
+	//Cells outside the band are given a score such that they are never chosen as predecessors
+	const double out_of_band_score = INT32_MIN/2;
+	auto fill_cell = [&](const int i , const int j){
+		if(banded and ( ((i-j)<band_min_diag) or ((i-j)>band_max_diag) )){
+			score_matrix(i,j) = out_of_band_score;
+		}
+		else{
+			sw_align_common(int_data_sequence_copy , int_genomic_sequence_copy , i , j , score_matrix , row_memory_matrix , col_memory_matrix , alignment_numb_tracker , max_score , max_row_coord , max_col_coord);
+		}
+	};
 
 	bool matrix_complete = false;
 
@@ -1241,7 +1692,7 @@ list<pair<int,Alignment_data>> Aligner::sw_align(const Int_Str& int_data_sequenc
 			//If all the rows have been explored
 			for (int i=1 ; i!=n_rows ; ++i){
 				//Explore next missing column
-				sw_align_common(int_data_sequence_copy , int_genomic_sequence_copy , i , explored_col_coord-1  , score_matrix , row_memory_matrix , col_memory_matrix , alignment_numb_tracker , max_score , max_row_coord , max_col_coord);
+				fill_cell(i , explored_col_coord-1);
 			}
 
 		}
@@ -1249,7 +1700,7 @@ list<pair<int,Alignment_data>> Aligner::sw_align(const Int_Str& int_data_sequenc
 			//If all colmuns have been explored
 			for (int j=1 ; j!=n_cols ; ++j){
 				//Explore next missing row
-				sw_align_common(int_data_sequence_copy , int_genomic_sequence_copy , explored_row_coord-1 , j  , score_matrix , row_memory_matrix , col_memory_matrix , alignment_numb_tracker , max_score , max_row_coord , max_col_coord);
+				fill_cell(explored_row_coord-1 , j);
 			}
 			if(!last_column_explored){last_column_explored = true;}//By construction
 		}
@@ -1258,13 +1709,13 @@ list<pair<int,Alignment_data>> Aligner::sw_align(const Int_Str& int_data_sequenc
 			int j=1;
 
 			while( (i!=explored_row_coord) & (j!=explored_col_coord) ){
-				sw_align_common(int_data_sequence_copy , int_genomic_sequence_copy , i , explored_col_coord  , score_matrix , row_memory_matrix , col_memory_matrix , alignment_numb_tracker , max_score , max_row_coord , max_col_coord);
+				fill_cell(i , explored_col_coord);
 				++i;
-				sw_align_common(int_data_sequence_copy , int_genomic_sequence_copy , explored_row_coord , j  , score_matrix , row_memory_matrix , col_memory_matrix , alignment_numb_tracker , max_score , max_row_coord , max_col_coord);
+				fill_cell(explored_row_coord , j);
 				++j;
 			}
 			//Fill last angle of the square
-			sw_align_common(int_data_sequence_copy , int_genomic_sequence_copy , explored_row_coord , explored_col_coord  , score_matrix , row_memory_matrix , col_memory_matrix , alignment_numb_tracker , max_score , max_row_coord , max_col_coord);
+			fill_cell(explored_row_coord , explored_col_coord);
 		}
 
 
@@ -1657,3 +2108,31 @@ forward_list<Alignment_data> extract_best_gene_alignments(const forward_list<Ali
 	}
 	return best_gene_aligns;
 }
+
+/*
+ * Returns the name of the binary alignment file corresponding to a CSV alignment file name
+ */
+string get_binary_alignment_filename(string csv_filename){
+	size_t extension_index = csv_filename.rfind(".csv");
+	if( (extension_index != string::npos) and (extension_index == csv_filename.size()-4) ){
+		return csv_filename.substr(0,extension_index) + ".bin";
+	}
+	return csv_filename + ".bin";
+}
+
+/*
+ * Given a CSV alignment file name, returns the name of the binary alignment file instead if binary alignments are asked for (prefer_binary)
+ * and the binary file exists, or if only the binary file exists (alignments written with -align --format bin).
+ * The modification times are not compared: a binary file left over from a previous alignment must not silently replace a newer CSV file.
+ */
+string resolve_alignment_filename(string csv_filename , bool prefer_binary){
+	string bin_filename = get_binary_alignment_filename(csv_filename);
+	struct stat file_stat;
+	if(stat(bin_filename.c_str() , &file_stat) != 0){
+		return csv_filename;
+	}
+	if( prefer_binary or (stat(csv_filename.c_str() , &file_stat) != 0) ){
+		return bin_filename;
+	}
+	return csv_filename;
+}
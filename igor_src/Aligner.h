@@ -30,6 +30,8 @@
 #include <list>
 #include <unordered_map>
 #include <set>
+#include <unordered_set>
+#include <memory>
 #include <utility>
 #include <fstream>
 #include <algorithm>
@@ -39,6 +41,7 @@
 #include <stdexcept>
 #include <random>
 #include <chrono>
+#include <cstdint>
 
 #include "IntStr.h"
 
@@ -70,11 +73,12 @@ struct Alignment_data {
 	size_t align_length;
 	mutable std::vector<int> mismatches;
 	double score;
+	mutable int realization_index; //Index of the gene in the Gene_choice realizations, -1 if not resolved (see Gene_choice::resolve_realization_indices())
 
-	Alignment_data(std::string gene , int off): gene_name(gene) , offset(off) , insertions(*(new std::forward_list<int>)) , deletions(*(new std::forward_list<int>)) , score(0) {}
-	Alignment_data(int off, size_t five_p_off , size_t three_p_off , size_t align_len , std::forward_list<int> ins , std::forward_list<int> del , std::vector<int> mis , double alignment_score): gene_name(std::string()) , offset(off) , five_p_offset(five_p_off) , three_p_offset(three_p_off) , insertions(ins) , deletions(del) , align_length(align_len) , mismatches(mis) , score(alignment_score) {}
-	Alignment_data(std::string gene , int off , size_t align_len , std::forward_list<int> ins , std::forward_list<int> del , std::vector<int> mis , double alignment_score): gene_name(gene) , offset(off) , insertions(ins) , deletions(del) , align_length(align_len) , mismatches(mis) , score(alignment_score) {}
-	Alignment_data(std::string gene , int off, size_t five_p_off , size_t three_p_off , size_t align_len , std::forward_list<int> ins , std::forward_list<int> del , std::vector<int> mis , double alignment_score): gene_name(gene) , offset(off) , five_p_offset(five_p_off) , three_p_offset(three_p_off) , insertions(ins) , deletions(del) , align_length(align_len) , mismatches(mis) , score(alignment_score) {}
+	Alignment_data(std::string gene , int off): gene_name(gene) , offset(off) , insertions(*(new std::forward_list<int>)) , deletions(*(new std::forward_list<int>)) , score(0) , realization_index(-1) {}
+	Alignment_data(int off, size_t five_p_off , size_t three_p_off , size_t align_len , std::forward_list<int> ins , std::forward_list<int> del , std::vector<int> mis , double alignment_score): gene_name(std::string()) , offset(off) , five_p_offset(five_p_off) , three_p_offset(three_p_off) , insertions(ins) , deletions(del) , align_length(align_len) , mismatches(mis) , score(alignment_score) , realization_index(-1) {}
+	Alignment_data(std::string gene , int off , size_t align_len , std::forward_list<int> ins , std::forward_list<int> del , std::vector<int> mis , double alignment_score): gene_name(gene) , offset(off) , insertions(ins) , deletions(del) , align_length(align_len) , mismatches(mis) , score(alignment_score) , realization_index(-1) {}
+	Alignment_data(std::string gene , int off, size_t five_p_off , size_t three_p_off , size_t align_len , std::forward_list<int> ins , std::forward_list<int> del , std::vector<int> mis , double alignment_score): gene_name(gene) , offset(off) , five_p_offset(five_p_off) , three_p_offset(three_p_off) , insertions(ins) , deletions(del) , align_length(align_len) , mismatches(mis) , score(alignment_score) , realization_index(-1) {}
 
 /*	bool operator<(const Alignment_data& align){
 		//Hardcode to get the alignments in descending order using sort()
@@ -83,6 +87,26 @@ struct Alignment_data {
 
 };
 
+//Alignments of one sequence, shared between identical sequences
+typedef std::shared_ptr<const std::forward_list<Alignment_data>> Shared_seq_alignments;
+
+class Alignment_cache;
+
+/**
+ * Output formats for alignments written on disk
+ * - CSV_align_f: human readable semicolon separated file (default)
+ * - BIN_align_f: compact binary container (see Binary_alignment_writer)
+ * - CSV_BIN_align_f: both
+ */
+enum Alignment_fileformat{CSV_align_f , BIN_align_f , CSV_BIN_align_f};
+
+/**
+ * Order of the sequences in alignment files written on disk
+ * - Arrival_order: sequences are written as soon as they are aligned (default)
+ * - Input_order: sequences are written in the same order as the input sequences
+ */
+enum Alignment_output_order{Arrival_order , Input_order};
+
 /**
  * \class Aligner Aligner.h
  * \brief A modified Smith-Waterman alignment class
@@ -109,6 +133,7 @@ public:
 	std::forward_list<Alignment_data> align_seq(std::string , double , bool , std::unordered_map<std::string,std::pair<int,int>>, std::set<std::string> , bool=false);
 	std::forward_list<Alignment_data> align_seq(std::string , double , bool , bool , std::unordered_map<std::string,std::pair<int,int>>, bool=false);
 	std::forward_list<Alignment_data> align_seq(std::string , double , bool , bool , std::unordered_map<std::string,std::pair<int,int>> , std::set<std::string> , bool=false);
+	std::vector<std::forward_list<Alignment_data>> align_seq_batch(const std::vector<std::string>& , double , bool , bool , const std::unordered_map<std::string,std::pair<int,int>>& , bool=false);
 
 	// Multiple sequences alignments methods
 	std::unordered_map<int,std::forward_list<Alignment_data>> align_seqs(std::vector<std::pair<const int , const std::string>> , double , bool);
@@ -129,6 +154,11 @@ public:
 	std::unordered_map<int,std::forward_list<Alignment_data>> read_alignments_seq_csv(std::string , double , bool);
 
 	void set_genomic_sequences(std::vector< std::pair<std::string,std::string> >);
+	void set_output_format(Alignment_fileformat format){this->output_format = format;}
+	void set_output_order(Alignment_output_order order){this->output_order = order;}
+	void set_alignment_cache_dir(std::string cache_dir){this->alignment_cache_dir = cache_dir;}
+	std::string get_alignment_parameters_key(double , bool , bool , const std::unordered_map<std::string,std::pair<int,int>>& , bool) const;
+	void set_seed_filter(size_t);
 	int incorporate_in_dels( std::string& , std::string& , const std::forward_list<int> , const std::forward_list<int> , int );
 
 
@@ -138,9 +168,23 @@ private:
 	Matrix<double> substitution_matrix;
 	int gap_penalty;
 	Gene_class gene;
+	Alignment_fileformat output_format;
+	Alignment_output_order output_order;
+	std::string alignment_cache_dir; //directory of the persistent alignment cache, no persistent cache if empty
 	bool local_align;
 	bool flip_seqs;
-	void sw_align_common(const Int_Str& ,const Int_Str& ,const int,const int , Matrix<double>& , Matrix<int>& , Matrix<int>& , Matrix<int>& , std::vector<int>& ,  std::vector<int>& , std::vector<int>&);
+	double max_abs_substitution_score;
+	std::vector<Int_Str> profiled_genomic_sequences; //genomic templates in the orientation used by the SIMD score kernels (same order as int_genomic_sequences)
+	size_t seed_length;
+	std::unordered_map<uint32_t,std::vector<std::pair<size_t,int>>> seed_index; //k-mer code -> (genomic template index, position)
+	void build_seed_index();
+	std::vector<std::vector<int>> find_seed_diagonals(const Int_Str&) const;
+	std::vector<Shared_seq_alignments> align_seq_batch_cached(const std::vector<std::string>& , double , bool , bool , const std::unordered_map<std::string,std::pair<int,int>>& , bool , Alignment_cache& , const std::unordered_set<std::string>*);
+	std::shared_ptr<Alignment_cache> create_alignment_cache(const std::vector<std::pair<const int , const std::string>>& , double , bool , bool , const std::unordered_map<std::string,std::pair<int,int>>& , bool , std::unordered_set<std::string>&);
+	std::string get_alignment_cache_prefix(const Alignment_cache&) const;
+	std::vector<std::string> get_template_names() const;
+	std::forward_list<Alignment_data> align_int_seq(const Int_Str& , double , bool , bool , const std::unordered_map<std::string,std::pair<int,int>>& , const std::set<std::string>* , bool , const std::vector<int>*);
+	void sw_align_common(const Int_Str& ,const Int_Str& ,const int,const int , Unchecked_matrix<double>& , Unchecked_matrix<int>& , Unchecked_matrix<int>& , Unchecked_matrix<int>& , std::vector<int>& ,  std::vector<int>& , std::vector<int>&);
 	std::list<std::pair<int,Alignment_data>> sw_align(const Int_Str& ,const Int_Str& , double , bool , int , int);
 	std::unordered_map<std::string,std::pair<int,int>> build_genomic_bounds_map(int,int) const;
 
@@ -151,25 +195,30 @@ std::unordered_map<int,std::pair<std::string,std::unordered_map<Gene_class,std::
 std::unordered_map<int,std::pair<std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>> read_alignments_seq_csv(std::string , Gene_class , double , bool , std::vector<std::pair<const int,const std::string>>, std::unordered_map<int,std::pair<std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>>);
 std::unordered_map<int,std::pair<std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>> read_alignments_seq_csv_score_range(std::string , Gene_class , double , bool , std::vector<std::pair<const int,const std::string>>);
 std::unordered_map<int,std::pair<std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>> read_alignments_seq_csv_score_range(std::string , Gene_class , double , bool , std::vector<std::pair<const int,const std::string>>, std::unordered_map<int,std::pair<std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>>);
+void select_alignments_score_range(std::vector<Alignment_data>& , double);
 std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>> map2vect (std::unordered_map<int,std::pair<std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>>);
 std::forward_list<std::pair<const int,const std::string>> read_indexed_seq_csv(std::string);
 std::vector<std::pair<const int , const std::string>> read_indexed_csv(std::string);
 std::vector<std::pair<const int,const std::string>> read_fasta(std::string);
 std::vector<std::pair<std::string,std::string>> read_genomic_fasta(std::string);
 std::vector<std::pair<const int,const std::string>> read_txt(std::string);
+std::vector<std::pair<const int,const std::string>> read_fastq(std::string);
 std::unordered_map<std::string,size_t> read_gene_anchors_csv(std::string,std::string separator= ";");
 std::unordered_map<std::string,std::pair<int,int>> read_template_specific_offset_csv(std::string,std::string separator= ";");
 void write_indexed_seq_csv(std::string , std::vector<std::pair<const int,const std::string>>);
+void append_indexed_seq_csv(std::ofstream& , const std::vector<std::pair<const int,const std::string>>&);
 Int_Str nt2int(std::string);
 bool comp_nt_int(const int& , const int&);
 std::list<Int_nt> get_ambiguous_nt_list(const Int_nt&);
-inline void write_single_seq_alignment( std::ofstream& , int , std::forward_list<Alignment_data> );
+void write_single_seq_alignment( std::ostream& , int , const std::forward_list<Alignment_data>& );
 //Compare alignments (sort by score)
 bool align_compare(Alignment_data , Alignment_data );
 std::vector<std::pair<const int , const std::string>> sample_indexed_seq( std::vector<std::pair<const int , const std::string>>,const size_t);
 Matrix<double> read_substitution_matrix(const std::string& , std::string sep=",");
 std::tuple<bool,int,int> extract_min_max_genomic_templates_offsets(const std::unordered_map<std::string,std::pair<int,int>>& genomic_offset_bounds);
 std::forward_list<Alignment_data> extract_best_gene_alignments(const std::forward_list<Alignment_data>&);
+std::string get_binary_alignment_filename(std::string);
+std::string resolve_alignment_filename(std::string , bool);
 
 /*
 	namespace substitution_matrices{
@@ -0,0 +1,159 @@
+/*
+ * Alignmentcache.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Alignmentcache.h"
+#include "Binaryalignments.h"
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <cstdio>
+
+using namespace std;
+
+static const size_t n_cache_shards = 64;
+
+Alignment_cache::Alignment_cache(string key): parameters_key(key) , n_hits(0) {
+	for(size_t i = 0 ; i != n_cache_shards ; ++i){
+		shards.emplace_back(new Cache_shard);
+	}
+}
+
+Alignment_cache::~Alignment_cache() {
+	// TODO Auto-generated destructor stub
+}
+
+Alignment_cache::Cache_shard& Alignment_cache::get_shard(const string& nt_seq){
+	return *shards[hash<string>()(nt_seq) % n_cache_shards];
+}
+
+/*
+ * Returns the cached alignments of the sequence, or a null pointer if the sequence is not in the cache
+ */
+Shared_seq_alignments Alignment_cache::find(const string& nt_seq){
+	Cache_shard& shard = get_shard(nt_seq);
+	lock_guard<mutex> lock(shard.shard_mutex);
+	unordered_map<string,Shared_seq_alignments>::const_iterator iter = shard.seqs_alignments.find(nt_seq);
+	if(iter == shard.seqs_alignments.end()){
+		return Shared_seq_alignments();
+	}
+	++n_hits;
+	return (*iter).second;
+}
+
+/*
+ * Stores the alignments of a sequence (an already cached sequence is left untouched)
+ */
+void Alignment_cache::insert(const string& nt_seq , Shared_seq_alignments shared_alignments){
+	Cache_shard& shard = get_shard(nt_seq);
+	lock_guard<mutex> lock(shard.shard_mutex);
+	shard.seqs_alignments.emplace(nt_seq , shared_alignments);
+}
+
+size_t Alignment_cache::size() const{
+	size_t n_seqs = 0;
+	for(vector<unique_ptr<Cache_shard>>::const_iterator iter = shards.begin() ; iter != shards.end() ; ++iter){
+		lock_guard<mutex> lock((*iter)->shard_mutex);
+		n_seqs += (*iter)->seqs_alignments.size();
+	}
+	return n_seqs;
+}
+
+/*
+ * Loads a cache previously saved with the same parameters key
+ * Returns false if no cache file exists or if it has been created with different parameters
+ */
+bool Alignment_cache::load(string cache_prefix){
+	ifstream parameters_file(cache_prefix + "_parameters.txt");
+	if(!parameters_file){
+		return false;
+	}
+	string saved_key((istreambuf_iterator<char>(parameters_file)) , istreambuf_iterator<char>());
+	if(saved_key != parameters_key){
+		return false;
+	}
+
+	vector<pair<const int,const string>> cached_seqs = read_indexed_csv(cache_prefix + "_sequences.csv");
+	unordered_map<int,vector<Alignment_data>> cached_alignments = read_alignments_seq_bin(cache_prefix + "_alignments.bin" , -numeric_limits<double>::infinity() , true);
+	for(vector<pair<const int,const string>>::const_iterator iter = cached_seqs.begin() ; iter != cached_seqs.end() ; ++iter){
+		forward_list<Alignment_data> seq_alignments;
+		unordered_map<int,vector<Alignment_data>>::iterator align_iter = cached_alignments.find((*iter).first);
+		if(align_iter != cached_alignments.end()){
+			for(vector<Alignment_data>::reverse_iterator jiter = (*align_iter).second.rbegin() ; jiter != (*align_iter).second.rend() ; ++jiter){
+				//The binary reader pushes in/dels in front, restore the order they had when aligned
+				(*jiter).insertions.reverse();
+				(*jiter).deletions.reverse();
+				seq_alignments.push_front(*jiter);
+			}
+		}
+		this->insert((*iter).second , make_shared<const forward_list<Alignment_data>>(seq_alignments));
+	}
+	return true;
+}
+
+/*
+ * Saves the cache content on disk
+ */
+void Alignment_cache::save(string cache_prefix , const vector<string>& template_names) const{
+	//The parameters file is removed first and written last such that an interrupted save is never loaded
+	remove((cache_prefix + "_parameters.txt").c_str());
+	vector<pair<const int,const string>> cached_seqs;
+	{
+		Binary_alignment_writer binary_writer(cache_prefix + "_alignments.bin" , template_names);
+		int seq_index = 0;
+		for(vector<unique_ptr<Cache_shard>>::const_iterator iter = shards.begin() ; iter != shards.end() ; ++iter){
+			lock_guard<mutex> lock((*iter)->shard_mutex);
+			for(unordered_map<string,Shared_seq_alignments>::const_iterator jiter = (*iter)->seqs_alignments.begin() ; jiter != (*iter)->seqs_alignments.end() ; ++jiter){
+				cached_seqs.emplace_back(seq_index , (*jiter).first);
+				binary_writer.write_seq_alignments(seq_index , *(*jiter).second);
+				++seq_index;
+			}
+		}
+	}
+	write_indexed_seq_csv(cache_prefix + "_sequences.csv" , cached_seqs);
+	ofstream parameters_file(cache_prefix + "_parameters.txt");
+	parameters_file<<parameters_key;
+}
+
+/*
+ * Returns the sequences appearing more than once in the list
+ */
+unordered_set<string> find_repeated_sequences(const vector<pair<const int,const string>>& sequence_list){
+	unordered_set<string> seen_seqs;
+	unordered_set<string> repeated_seqs;
+	for(vector<pair<const int,const string>>::const_iterator iter = sequence_list.begin() ; iter != sequence_list.end() ; ++iter){
+		if(not seen_seqs.insert((*iter).second).second){
+			repeated_seqs.insert((*iter).second);
+		}
+	}
+	return repeated_seqs;
+}
+
+/*
+ * 64 bits FNV-1a hash, stable across platforms and compilers (used to name cache files)
+ */
+uint64_t fnv1a_hash(const string& str){
+	uint64_t hash_value = 14695981039346656037ULL;
+	for(string::const_iterator iter = str.begin() ; iter != str.end() ; ++iter){
+		hash_value ^= static_cast<unsigned char>(*iter);
+		hash_value *= 1099511628211ULL;
+	}
+	return hash_value;
+}
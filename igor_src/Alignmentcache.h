@@ -0,0 +1,83 @@
+/*
+ * Alignmentcache.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_ALIGNMENTCACHE_H_
+#define IGOR_SRC_ALIGNMENTCACHE_H_
+
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "Aligner.h"
+
+
+/**
+ * \class Alignment_cache Alignmentcache.h
+ * \brief Thread safe cache of the alignments of nucleotide sequences for one set of alignment parameters.
+ * \version 1.0
+ *
+ * Identical reads are frequent in immune repertoires (clonal expansion), the cache allows to align each distinct sequence once.
+ * The cache is split in shards protected by their own mutex such that concurrent lookups from different threads rarely collide.
+ * The cache content is only valid for the genomic templates and alignment parameters it has been filled with, these are
+ * described by the parameters key given upon construction (see Aligner::get_alignment_parameters_key()).
+ *
+ * The cache can be saved on disk and loaded back using three files sharing a prefix: the parameters key (_parameters.txt),
+ * the indexed sequences (_sequences.csv) and their alignments (_alignments.bin, IGoR's binary alignment format).
+ */
+class Alignment_cache {
+public:
+	Alignment_cache(std::string);
+	virtual ~Alignment_cache();
+
+	Shared_seq_alignments find(const std::string&);
+	void insert(const std::string& , Shared_seq_alignments);
+	size_t size() const;
+	size_t get_n_hits() const {return n_hits;}
+	const std::string& get_parameters_key() const {return parameters_key;}
+
+	bool load(std::string);
+	void save(std::string , const std::vector<std::string>&) const;
+
+private:
+	//Forbid copies since shards own their mutex
+	Alignment_cache(const Alignment_cache&);
+	Alignment_cache& operator=(const Alignment_cache&);
+
+	struct Cache_shard{
+		std::unordered_map<std::string,Shared_seq_alignments> seqs_alignments;
+		mutable std::mutex shard_mutex;
+	};
+	Cache_shard& get_shard(const std::string&);
+
+	std::string parameters_key;
+	std::vector<std::unique_ptr<Cache_shard>> shards;
+	std::atomic<size_t> n_hits;
+};
+
+std::unordered_set<std::string> find_repeated_sequences(const std::vector<std::pair<const int,const std::string>>&);
+uint64_t fnv1a_hash(const std::string&);
+
+#endif /* IGOR_SRC_ALIGNMENTCACHE_H_ */
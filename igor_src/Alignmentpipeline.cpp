@@ -0,0 +1,180 @@
+/*
+ * Alignmentpipeline.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Alignmentpipeline.h"
+
+using namespace std;
+
+Aligned_seq_queue::Aligned_seq_queue(size_t max_batches): max_n_batches(max_batches) , closed(false) , n_pushed_seqs(0) {
+	if(max_n_batches == 0){
+		throw invalid_argument("Aligned_seq_queue capacity must be at least one batch");
+	}
+}
+
+Aligned_seq_queue::~Aligned_seq_queue() {
+	// TODO Auto-generated destructor stub
+}
+
+/*
+ * Moves the batch at the end of the queue, waits while the queue is full
+ */
+void Aligned_seq_queue::push(Aligned_seq_batch& seq_batch){
+	unique_lock<mutex> lock(queue_mutex);
+	while( (batches.size() >= max_n_batches) and (not closed) ){
+		not_full.wait(lock);
+	}
+	if(closed){
+		throw runtime_error("Trying to push a batch in a closed Aligned_seq_queue");
+	}
+	n_pushed_seqs += seq_batch.size();
+	batches.emplace_back();
+	batches.back().swap(seq_batch);
+	seq_batch.clear();
+	not_empty.notify_one();
+}
+
+/*
+ * Moves the first batch of the queue in seq_batch, waits while the queue is empty
+ * Returns false once the queue is closed and no batch is left
+ */
+bool Aligned_seq_queue::pop(Aligned_seq_batch& seq_batch){
+	unique_lock<mutex> lock(queue_mutex);
+	while(batches.empty() and (not closed)){
+		not_empty.wait(lock);
+	}
+	if(batches.empty()){
+		return false;
+	}
+	seq_batch.swap(batches.front());
+	batches.pop_front();
+	not_full.notify_one();
+	return true;
+}
+
+/*
+ * Signals that no more batches will be pushed
+ */
+void Aligned_seq_queue::close(){
+	lock_guard<mutex> lock(queue_mutex);
+	closed = true;
+	not_empty.notify_all();
+	not_full.notify_all();
+}
+
+/*
+ * Closes the queue and stores the exception thrown by the producer
+ */
+void Aligned_seq_queue::close(exception_ptr exception){
+	{
+		lock_guard<mutex> lock(queue_mutex);
+		producer_exception = exception;
+	}
+	this->close();
+}
+
+/*
+ * Rethrows the exception caught on the producer side if any
+ */
+void Aligned_seq_queue::rethrow_producer_exception(){
+	lock_guard<mutex> lock(queue_mutex);
+	if(producer_exception){
+		rethrow_exception(producer_exception);
+	}
+}
+
+size_t Aligned_seq_queue::get_n_pushed_seqs(){
+	lock_guard<mutex> lock(queue_mutex);
+	return n_pushed_seqs;
+}
+
+/*
+ * Adds the general offset bounds for genomic templates without template specific offset bounds
+ */
+unordered_map<string,pair<int,int>> complete_offset_bounds(unordered_map<string,pair<int,int>> template_bounds_map , const vector<pair<string,string>>& genomic_templates , int min_offset , int max_offset){
+	for(vector<pair<string,string>>::const_iterator iter = genomic_templates.begin() ; iter != genomic_templates.end() ; ++iter){
+		if(template_bounds_map.count((*iter).first)==0){
+			template_bounds_map.emplace((*iter).first , make_pair(min_offset,max_offset));
+		}
+	}
+	return template_bounds_map;
+}
+
+/*
+ * Aligns a chunk of sequences for all genes in parallel on n_threads threads and sorts the alignments the same way as read_alignments_seq_csv_score_range
+ * The order of the batch is the order of the chunk
+ */
+Aligned_seq_batch align_seq_batch(const vector<pair<const int,const string>>& seq_chunk , const list<Pipeline_align_parms>& align_parms_list , int n_threads){
+	Aligned_seq_batch seq_batch(seq_chunk.size());
+
+	//Sequences are aligned by groups sharing the same inter sequence SIMD score pass
+	size_t group_size = get_interseq_batch_size();
+	int n_groups = (seq_chunk.size() + group_size - 1)/group_size;
+
+	//Declare parallel loop using OpenMP 3.1 standards
+	#pragma omp parallel for schedule(dynamic) shared(seq_batch) num_threads(n_threads)
+	for(int group_index = 0 ; group_index < n_groups ; ++group_index){
+		size_t first_seq = group_index*group_size;
+		size_t last_seq = min(first_seq + group_size , seq_chunk.size());
+		vector<string> group_seqs;
+		for(size_t i = first_seq ; i != last_seq ; ++i){
+			group_seqs.push_back(seq_chunk[i].second);
+		}
+		vector<unordered_map<Gene_class,vector<Alignment_data>>> seqs_alignments(last_seq - first_seq);
+		for(list<Pipeline_align_parms>::const_iterator parms_it = align_parms_list.begin() ; parms_it != align_parms_list.end() ; ++parms_it){
+			vector<forward_list<Alignment_data>> group_alignments = (*parms_it).aligner_p->align_seq_batch(group_seqs , (*parms_it).score_threshold , (*parms_it).best_align_only , (*parms_it).best_gene_only , (*parms_it).offset_bounds , (*parms_it).reversed_offsets);
+			for(size_t k = 0 ; k != group_alignments.size() ; ++k){
+				vector<Alignment_data>& gene_alignments_vect = seqs_alignments[k][(*parms_it).gene];
+				for(forward_list<Alignment_data>::const_iterator align_it = group_alignments[k].begin() ; align_it != group_alignments[k].end() ; ++align_it){
+					//Same selection as when reading the alignments from file
+					if( ((*align_it).score >= 0) and (*align_it).insertions.empty() and (*align_it).deletions.empty() ){
+						gene_alignments_vect.push_back(*align_it);
+					}
+				}
+				select_alignments_score_range(gene_alignments_vect , (*parms_it).score_range);
+			}
+		}
+		for(size_t i = first_seq ; i != last_seq ; ++i){
+			seq_batch[i] = make_tuple(seq_chunk[i].first , seq_chunk[i].second , seqs_alignments[i-first_seq]);
+		}
+	}
+	return seq_batch;
+}
+
+/*
+ * Reads, aligns and pushes batches of sequences in the queue until the reader is exhausted
+ * Batches are aligned on n_threads threads, running alongside the threads evaluating the sequences
+ * The queue is closed upon return, exceptions are forwarded to the consumer through the queue
+ */
+void produce_aligned_seq_batches(Seq_chunk_reader read_chunk , const list<Pipeline_align_parms>& align_parms_list , size_t batch_size , int n_threads , Aligned_seq_queue& seq_queue){
+	try{
+		vector<pair<const int,const string>> seq_chunk;
+		seq_chunk.reserve(batch_size);
+		while(read_chunk(seq_chunk,batch_size)>0){
+			Aligned_seq_batch seq_batch = align_seq_batch(seq_chunk , align_parms_list , n_threads);
+			seq_queue.push(seq_batch);
+			seq_chunk.clear();
+		}
+		seq_queue.close();
+	}
+	catch(exception& e){
+		seq_queue.close(current_exception());
+	}
+}
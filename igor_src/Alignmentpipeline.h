@@ -0,0 +1,110 @@
+/*
+ * Alignmentpipeline.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_ALIGNMENTPIPELINE_H_
+#define IGOR_SRC_ALIGNMENTPIPELINE_H_
+
+#include <string>
+#include <vector>
+#include <list>
+#include <deque>
+#include <tuple>
+#include <utility>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include "Aligner.h"
+#include "Stripedsw.h"
+#include "Utils.h"
+
+//Batch of sequences with their sorted alignments, as consumed by GenModel
+typedef std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class,std::vector<Alignment_data>>>> Aligned_seq_batch;
+
+//Function appending at most N indexed sequences to the vector and returning the number of sequences appended
+typedef std::function<size_t(std::vector<std::pair<const int,const std::string>>& , size_t)> Seq_chunk_reader;
+
+
+/**
+ * \class Aligned_seq_queue Alignmentpipeline.h
+ * \brief Bounded thread safe queue of aligned sequence batches.
+ * \version 1.0
+ *
+ * Links the alignment producer to the sequence evaluation in the fused align/evaluate pipeline.
+ * The producer blocks when the queue is full such that memory usage stays bounded by the queue capacity times the batch size.
+ * Consumers block until a batch is available, pop() returns false once the queue has been closed and drained.
+ * An exception thrown on the producer side is stored and can be rethrown on the consumer side after the queue has been drained.
+ */
+class Aligned_seq_queue {
+public:
+	Aligned_seq_queue(size_t);
+	virtual ~Aligned_seq_queue();
+
+	void push(Aligned_seq_batch&);
+	bool pop(Aligned_seq_batch&);
+	void close();
+	void close(std::exception_ptr);
+	void rethrow_producer_exception();
+
+	size_t get_n_pushed_seqs();
+
+private:
+	//Forbid copies since the queue owns the synchronization primitives
+	Aligned_seq_queue(const Aligned_seq_queue&);
+	Aligned_seq_queue& operator=(const Aligned_seq_queue&);
+
+	std::deque<Aligned_seq_batch> batches;
+	size_t max_n_batches;
+	bool closed;
+	size_t n_pushed_seqs;
+	std::exception_ptr producer_exception;
+	std::mutex queue_mutex;
+	std::condition_variable not_full;
+	std::condition_variable not_empty;
+};
+
+
+/**
+ * \struct Pipeline_align_parms Alignmentpipeline.h
+ * \brief Alignment parameters for one gene in the fused pipeline.
+ *
+ * Mirrors what is done by '-align' followed by the alignments reading prior to '-evaluate': alignments are performed
+ * with the alignment parameters, alignments with in/dels are discarded and only alignments within score_range of the best one are kept.
+ */
+struct Pipeline_align_parms{
+	Gene_class gene;
+	std::shared_ptr<Aligner> aligner_p;
+	double score_threshold;
+	bool best_align_only;
+	bool best_gene_only;
+	std::unordered_map<std::string,std::pair<int,int>> offset_bounds;
+	bool reversed_offsets;
+	double score_range;
+};
+
+std::unordered_map<std::string,std::pair<int,int>> complete_offset_bounds(std::unordered_map<std::string,std::pair<int,int>> , const std::vector<std::pair<std::string,std::string>>& , int , int);
+Aligned_seq_batch align_seq_batch(const std::vector<std::pair<const int,const std::string>>& , const std::list<Pipeline_align_parms>& , int);
+void produce_aligned_seq_batches(Seq_chunk_reader , const std::list<Pipeline_align_parms>& , size_t , int , Aligned_seq_queue&);
+
+#endif /* IGOR_SRC_ALIGNMENTPIPELINE_H_ */
@@ -0,0 +1,211 @@
+/*
+ * Alignmentwriter.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Alignmentwriter.h"
+
+using namespace std;
+
+//Number of sequences after which a thread buffer is handed over to the writer thread
+static const size_t block_n_seqs = 1024;
+//Number of blocks waiting to be written above which worker threads wait for the writer thread
+static const size_t max_queued_blocks = 64;
+
+Alignment_block_queue::Alignment_block_queue(): head(new Node) , tail(nullptr) {
+	tail = head.load();
+}
+
+Alignment_block_queue::~Alignment_block_queue() {
+	while(tail != nullptr){
+		Node* next = tail->next.load();
+		delete tail;
+		tail = next;
+	}
+}
+
+/*
+ * Moves the block at the end of the queue, never blocks
+ */
+void Alignment_block_queue::push(Alignment_output_block& block){
+	Node* node = new Node;
+	swap(node->block , block);
+	Node* previous = head.exchange(node , memory_order_acq_rel);
+	previous->next.store(node , memory_order_release);
+}
+
+/*
+ * Moves the first block of the queue in block, returns false if no block is available
+ * The tail node is a stub whose block has already been consumed
+ */
+bool Alignment_block_queue::try_pop(Alignment_output_block& block){
+	Node* next = tail->next.load(memory_order_acquire);
+	if(next == nullptr){
+		return false;
+	}
+	swap(block , next->block);
+	delete tail;
+	tail = next;
+	return true;
+}
+
+
+Alignment_output_writer::Alignment_output_writer(ofstream* csv_outfile , shared_ptr<Binary_alignment_writer> binary_writer , Alignment_output_order order , size_t total_n_seqs , string label):
+		csv_outfile_p(csv_outfile) , binary_writer_p(binary_writer) , output_order(order) , n_seqs(total_n_seqs) , progress_label(label) , n_written_seqs(0) ,
+		n_queued_blocks(0) , producers_done(false) , writer_failed(false) , closed(false) {
+	for(int i = 0 ; i != omp_get_max_threads() ; ++i){
+		thread_buffers.emplace_back(new Thread_buffer);
+	}
+	writer_thread = thread(&Alignment_output_writer::write_blocks , this);
+}
+
+Alignment_output_writer::~Alignment_output_writer() {
+	if(not closed){
+		//Make sure the writer thread is joined, errors can only be reported by close()
+		try{
+			this->close();
+		}
+		catch(exception& e){
+			cerr<<"Exception caught while closing Alignment_output_writer: "<<e.what()<<endl;
+		}
+	}
+}
+
+/*
+ * Appends the alignments of the sequence at position seq_position in the input list to the calling thread buffer
+ */
+void Alignment_output_writer::append_seq_alignments(size_t seq_position , int seq_index , const forward_list<Alignment_data>& seq_alignments){
+	Thread_buffer& buffer = *thread_buffers[omp_get_thread_num()];
+	Alignment_output_block& block = buffer.block;
+	size_t block_size = block.last_seq - block.first_seq;
+	if( (block_size >= block_n_seqs) or ( (block_size>0) and (output_order == Input_order) and (seq_position != block.last_seq) ) ){
+		this->push_buffer(buffer);
+	}
+	if(block.last_seq == block.first_seq){
+		block.first_seq = seq_position;
+		block.last_seq = seq_position;
+	}
+	++block.last_seq;
+	if(csv_outfile_p != NULL){
+		write_single_seq_alignment(buffer.csv_stream , seq_index , seq_alignments);
+	}
+	if(binary_writer_p){
+		block.seqs_alignments.emplace_back(seq_index , seq_alignments);
+	}
+}
+
+/*
+ * Hands the calling thread buffer over to the writer thread
+ */
+void Alignment_output_writer::flush_thread_buffer(){
+	this->push_buffer(*thread_buffers[omp_get_thread_num()]);
+}
+
+void Alignment_output_writer::push_buffer(Thread_buffer& buffer){
+	if(buffer.block.last_seq == buffer.block.first_seq){
+		return;
+	}
+	//Bound the memory used by blocks waiting to be written
+	while( (n_queued_blocks.load() >= max_queued_blocks) and (not writer_failed.load()) ){
+		this_thread::yield();
+	}
+	buffer.block.csv_text = buffer.csv_stream.str();
+	buffer.csv_stream.str(string());
+	++n_queued_blocks;
+	block_queue.push(buffer.block);
+	buffer.block = Alignment_output_block();
+	wake_writer.notify_one();
+}
+
+/*
+ * Flushes the remaining buffers and waits until everything has been written
+ * Must be called outside of the parallel region once all sequences have been appended
+ */
+void Alignment_output_writer::close(){
+	if(closed){
+		return;
+	}
+	closed = true;
+	for(vector<unique_ptr<Thread_buffer>>::iterator iter = thread_buffers.begin() ; iter != thread_buffers.end() ; ++iter){
+		this->push_buffer(**iter);
+	}
+	producers_done.store(true , memory_order_release);
+	wake_writer.notify_one();
+	writer_thread.join();
+	if(writer_exception){
+		rethrow_exception(writer_exception);
+	}
+}
+
+/*
+ * Writer thread loop
+ */
+void Alignment_output_writer::write_blocks(){
+	try{
+		map<size_t,Alignment_output_block> early_blocks;
+		size_t next_seq = 0;
+		Alignment_output_block block;
+		while(true){
+			//Read the flag before trying to pop such that no block pushed before it was set can be missed
+			bool done = producers_done.load(memory_order_acquire);
+			if(block_queue.try_pop(block)){
+				--n_queued_blocks;
+				if(output_order == Input_order){
+					size_t first_seq = block.first_seq;
+					swap(early_blocks[first_seq] , block);
+					while( (not early_blocks.empty()) and (early_blocks.begin()->first == next_seq) ){
+						this->write_block(early_blocks.begin()->second);
+						next_seq = early_blocks.begin()->second.last_seq;
+						early_blocks.erase(early_blocks.begin());
+					}
+				}
+				else{
+					this->write_block(block);
+				}
+				continue;
+			}
+			if(done){
+				break;
+			}
+			unique_lock<mutex> lock(wake_mutex);
+			//Notifications are sent without holding the lock, the timeout bounds the delay of a missed one
+			wake_writer.wait_for(lock , chrono::milliseconds(1));
+		}
+		if(not early_blocks.empty()){
+			throw runtime_error("Alignment_output_writer::write_blocks(): sequences " + to_string(next_seq) + " to " + to_string(early_blocks.begin()->first) + " were never appended");
+		}
+	}
+	catch(exception& e){
+		writer_exception = current_exception();
+		writer_failed.store(true);
+	}
+}
+
+void Alignment_output_writer::write_block(const Alignment_output_block& block){
+	if(csv_outfile_p != NULL){
+		csv_outfile_p->write(block.csv_text.data() , block.csv_text.size());
+	}
+	if(binary_writer_p){
+		for(vector<pair<int,forward_list<Alignment_data>>>::const_iterator iter = block.seqs_alignments.begin() ; iter != block.seqs_alignments.end() ; ++iter){
+			binary_writer_p->write_seq_alignments((*iter).first , (*iter).second);
+		}
+	}
+	n_written_seqs += block.last_seq - block.first_seq;
+	show_progress_bar(cerr , n_written_seqs/((double) n_seqs) , progress_label , 50);
+}
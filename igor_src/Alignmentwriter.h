@@ -0,0 +1,147 @@
+/*
+ * Alignmentwriter.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_ALIGNMENTWRITER_H_
+#define IGOR_SRC_ALIGNMENTWRITER_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <forward_list>
+#include <utility>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <omp.h>
+#include "Aligner.h"
+#include "Binaryalignments.h"
+#include "Utils.h"
+
+
+/**
+ * \struct Alignment_output_block Alignmentwriter.h
+ * \brief Alignments of a contiguous range of sequences of the input list, ready to be written on disk.
+ */
+struct Alignment_output_block{
+	size_t first_seq; //position of the first sequence of the block in the input sequence list
+	size_t last_seq; //position past the last sequence of the block
+	std::string csv_text;
+	std::vector<std::pair<int,std::forward_list<Alignment_data>>> seqs_alignments; //only filled for binary output
+
+	Alignment_output_block(): first_seq(0) , last_seq(0) {}
+};
+
+
+/**
+ * \class Alignment_block_queue Alignmentwriter.h
+ * \brief Lock free multiple producers single consumer queue of output blocks.
+ * \version 1.0
+ *
+ * Intrusive linked list with a stub node: producers only perform an atomic exchange on the head, the single consumer
+ * follows the links from the tail. push() can be called by any thread, try_pop() only by the consumer thread.
+ */
+class Alignment_block_queue {
+public:
+	Alignment_block_queue();
+	virtual ~Alignment_block_queue();
+
+	void push(Alignment_output_block&);
+	bool try_pop(Alignment_output_block&);
+
+private:
+	//Forbid copies since nodes are owned by the queue
+	Alignment_block_queue(const Alignment_block_queue&);
+	Alignment_block_queue& operator=(const Alignment_block_queue&);
+
+	struct Node{
+		std::atomic<Node*> next;
+		Alignment_output_block block;
+		Node(): next(nullptr) {}
+	};
+	std::atomic<Node*> head;
+	Node* tail;
+};
+
+
+/**
+ * \class Alignment_output_writer Alignmentwriter.h
+ * \brief Writes the alignments produced by several OpenMP threads through a single writer thread.
+ * \version 1.0
+ *
+ * Each OpenMP thread appends its alignments to its own buffer, buffers are handed over to the writer thread by large blocks
+ * through a lock free queue. Worker threads thus never wait for each other nor for the disk (unless too many blocks are pending).
+ * The writer thread also takes care of the progress bar.
+ *
+ * With Input_order blocks are written in the order of the input sequence list (the writer keeps blocks arriving early aside),
+ * a new block is started whenever a thread appends a sequence that does not directly follow the previous one it appended.
+ * With Arrival_order blocks are written as they come.
+ *
+ * close() must be called once all threads are done appending (outside the parallel region), it flushes the remaining buffers,
+ * waits for the writer thread and rethrows any exception that occurred while writing.
+ */
+class Alignment_output_writer {
+public:
+	Alignment_output_writer(std::ofstream* , std::shared_ptr<Binary_alignment_writer> , Alignment_output_order , size_t , std::string);
+	virtual ~Alignment_output_writer();
+
+	void append_seq_alignments(size_t , int , const std::forward_list<Alignment_data>&);
+	void flush_thread_buffer();
+	void close();
+
+private:
+	//Forbid copies since the writer owns a thread
+	Alignment_output_writer(const Alignment_output_writer&);
+	Alignment_output_writer& operator=(const Alignment_output_writer&);
+
+	struct Thread_buffer{
+		Alignment_output_block block;
+		std::ostringstream csv_stream;
+	};
+
+	void push_buffer(Thread_buffer&);
+	void write_blocks();
+	void write_block(const Alignment_output_block&);
+
+	std::ofstream* csv_outfile_p;
+	std::shared_ptr<Binary_alignment_writer> binary_writer_p;
+	Alignment_output_order output_order;
+	size_t n_seqs;
+	std::string progress_label;
+	size_t n_written_seqs;
+	std::vector<std::unique_ptr<Thread_buffer>> thread_buffers;
+	Alignment_block_queue block_queue;
+	std::atomic<size_t> n_queued_blocks;
+	std::atomic<bool> producers_done;
+	std::atomic<bool> writer_failed;
+	std::exception_ptr writer_exception;
+	std::mutex wake_mutex;
+	std::condition_variable wake_writer;
+	std::thread writer_thread;
+	bool closed;
+};
+
+#endif /* IGOR_SRC_ALIGNMENTWRITER_H_ */
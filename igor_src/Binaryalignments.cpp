@@ -0,0 +1,305 @@
+/*
+ * Binaryalignments.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Binaryalignments.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char binary_alignment_magic[8] = {'I','G','o','R','A','L','N','\0'};
+static const uint32_t binary_alignment_version = 1;
+static const uint32_t binary_alignment_byte_order_mark = 0x01020304;
+
+
+/*
+ * Varint encoding helpers
+ */
+static inline void append_varint(string& buffer , uint64_t value){
+	while(value >= 0x80){
+		buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<char>(value));
+}
+
+static inline void append_signed_varint(string& buffer , int64_t value){
+	//Zigzag encoding such that small negative values also use few bytes
+	append_varint(buffer , (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+static inline void append_raw(string& buffer , const void* data , size_t size){
+	buffer.append(static_cast<const char*>(data) , size);
+}
+
+static inline uint64_t read_varint(const unsigned char*& pos , const unsigned char* end){
+	uint64_t value = 0;
+	int shift = 0;
+	while(true){
+		if( (pos == end) or (shift>63) ){
+			throw runtime_error("Corrupted varint in binary alignment file");
+		}
+		unsigned char byte = *pos;
+		++pos;
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if( (byte & 0x80) == 0){
+			break;
+		}
+		shift += 7;
+	}
+	return value;
+}
+
+static inline int64_t read_signed_varint(const unsigned char*& pos , const unsigned char* end){
+	uint64_t zigzag = read_varint(pos,end);
+	return static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+}
+
+template<typename T>
+static inline void read_raw(const unsigned char*& pos , const unsigned char* end , T& value){
+	if( (size_t)(end - pos) < sizeof(T)){
+		throw runtime_error("Truncated binary alignment file");
+	}
+	memcpy(&value , pos , sizeof(T));
+	pos += sizeof(T);
+}
+
+/*
+ * Delta encoded list of positions
+ */
+template<typename Container>
+static inline void append_position_list(string& buffer , const Container& positions){
+	uint64_t n_positions = 0;
+	for(typename Container::const_iterator iter = positions.begin() ; iter != positions.end() ; ++iter){
+		++n_positions;
+	}
+	append_varint(buffer , n_positions);
+	int64_t previous = 0;
+	for(typename Container::const_iterator iter = positions.begin() ; iter != positions.end() ; ++iter){
+		append_signed_varint(buffer , (*iter) - previous);
+		previous = (*iter);
+	}
+}
+
+
+Binary_alignment_writer::Binary_alignment_writer(string filename , const vector<string>& template_names): outfile(filename , ios::out | ios::binary) {
+	if(!outfile){
+		throw runtime_error("Could not open binary alignment file for writing: " + filename);
+	}
+	string header;
+	append_raw(header , binary_alignment_magic , sizeof(binary_alignment_magic));
+	append_raw(header , &binary_alignment_version , sizeof(binary_alignment_version));
+	append_raw(header , &binary_alignment_byte_order_mark , sizeof(binary_alignment_byte_order_mark));
+	append_varint(header , template_names.size());
+	for(size_t i = 0 ; i != template_names.size() ; ++i){
+		append_varint(header , template_names[i].size());
+		header.append(template_names[i]);
+		template_indices.emplace(template_names[i] , i);
+	}
+	outfile.write(header.data() , header.size());
+}
+
+Binary_alignment_writer::~Binary_alignment_writer() {
+	this->flush();
+	outfile.close();
+}
+
+/*
+ * Writes the buffered records on disk
+ */
+void Binary_alignment_writer::flush(){
+	outfile.write(record_buffer.data() , record_buffer.size());
+	record_buffer.clear();
+	outfile.flush();
+}
+
+/*
+ * Writes the alignments of one sequence as length prefixed records
+ */
+void Binary_alignment_writer::write_seq_alignments(int seq_index , const forward_list<Alignment_data>& seq_alignments){
+	string record;
+	for(forward_list<Alignment_data>::const_iterator iter = seq_alignments.begin() ; iter != seq_alignments.end() ; ++iter){
+		record.clear();
+		append_signed_varint(record , seq_index);
+		append_varint(record , template_indices.at((*iter).gene_name));
+		append_signed_varint(record , (*iter).offset);
+		append_raw(record , &(*iter).score , sizeof(double));
+		append_varint(record , (*iter).align_length);
+		append_varint(record , (*iter).five_p_offset);
+		append_varint(record , (*iter).three_p_offset);
+		append_position_list(record , (*iter).insertions);
+		append_position_list(record , (*iter).deletions);
+		append_position_list(record , (*iter).mismatches);
+
+		append_varint(record_buffer , record.size());
+		record_buffer.append(record);
+	}
+	//Write by large blocks
+	if(record_buffer.size() > (1<<16)){
+		this->flush();
+	}
+}
+
+/*
+ * Checks whether the file starts with the binary alignment file magic string
+ */
+bool is_binary_alignment_file(string filename){
+	ifstream infile(filename , ios::in | ios::binary);
+	if(!infile){
+		return false;
+	}
+	char magic[sizeof(binary_alignment_magic)];
+	infile.read(magic , sizeof(magic));
+	return ( infile.gcount() == sizeof(magic) ) and ( memcmp(magic , binary_alignment_magic , sizeof(magic)) == 0 );
+}
+
+/*
+ * Reads a binary alignment file through a memory map
+ * Returns the same structure as read_alignments_seq_csv (alignments with a score below score_threshold
+ * or containing in/dels when not allowed are discarded)
+ */
+unordered_map<int,vector<Alignment_data>> read_alignments_seq_bin(string filename , double score_threshold , bool allow_in_dels){
+	int file_descriptor = open(filename.c_str() , O_RDONLY);
+	if(file_descriptor<0){
+		throw runtime_error("File not found: "+filename);
+	}
+	struct stat file_stat;
+	if(fstat(file_descriptor , &file_stat) != 0){
+		close(file_descriptor);
+		throw runtime_error("Could not stat binary alignment file: " + filename);
+	}
+	size_t file_size = file_stat.st_size;
+	if(file_size < sizeof(binary_alignment_magic)){
+		close(file_descriptor);
+		throw runtime_error("File " + filename + " is not an IGoR binary alignment file");
+	}
+	void* mapped_file = mmap(NULL , file_size , PROT_READ , MAP_PRIVATE , file_descriptor , 0);
+	close(file_descriptor);
+	if(mapped_file == MAP_FAILED){
+		throw runtime_error("Could not memory map binary alignment file: " + filename);
+	}
+	madvise(mapped_file , file_size , MADV_SEQUENTIAL);
+
+	unordered_map<int,vector<Alignment_data>> indexed_alignments;
+	try{
+		const unsigned char* pos = static_cast<const unsigned char*>(mapped_file);
+		const unsigned char* end = pos + file_size;
+
+		if(memcmp(pos , binary_alignment_magic , sizeof(binary_alignment_magic)) != 0){
+			throw runtime_error("File " + filename + " is not an IGoR binary alignment file");
+		}
+		pos += sizeof(binary_alignment_magic);
+		uint32_t version;
+		read_raw(pos , end , version);
+		if(version != binary_alignment_version){
+			throw runtime_error("Unsupported binary alignment file version " + to_string(version) + " in file " + filename);
+		}
+		uint32_t byte_order_mark;
+		read_raw(pos , end , byte_order_mark);
+		if(byte_order_mark != binary_alignment_byte_order_mark){
+			throw runtime_error("Binary alignment file " + filename + " has been written on a machine with a different byte order");
+		}
+
+		size_t n_templates = read_varint(pos , end);
+		vector<string> template_names;
+		template_names.reserve(n_templates);
+		for(size_t i = 0 ; i != n_templates ; ++i){
+			size_t name_length = read_varint(pos , end);
+			if( (size_t)(end-pos) < name_length){
+				throw runtime_error("Truncated binary alignment file: " + filename);
+			}
+			template_names.emplace_back(reinterpret_cast<const char*>(pos) , name_length);
+			pos += name_length;
+		}
+
+		forward_list<int> insertions;
+		forward_list<int> deletions;
+		vector<int> mismatches;
+		while(pos != end){
+			size_t record_length = read_varint(pos , end);
+			if( (size_t)(end-pos) < record_length){
+				throw runtime_error("Truncated binary alignment file: " + filename);
+			}
+			const unsigned char* record_end = pos + record_length;
+
+			int seq_index = read_signed_varint(pos , record_end);
+			size_t template_index = read_varint(pos , record_end);
+			int offset = read_signed_varint(pos , record_end);
+			double score;
+			read_raw(pos , record_end , score);
+
+			if(score<score_threshold){
+				pos = record_end;
+				continue;
+			}
+
+			size_t align_length = read_varint(pos , record_end);
+			size_t five_p_offset = read_varint(pos , record_end);
+			size_t three_p_offset = read_varint(pos , record_end);
+
+			//In/dels are pushed in front to mimic the CSV reader behavior
+			insertions.clear();
+			deletions.clear();
+			mismatches.clear();
+			size_t n_positions = read_varint(pos , record_end);
+			int position = 0;
+			for(size_t i = 0 ; i != n_positions ; ++i){
+				position += read_signed_varint(pos , record_end);
+				insertions.push_front(position);
+			}
+			n_positions = read_varint(pos , record_end);
+			position = 0;
+			for(size_t i = 0 ; i != n_positions ; ++i){
+				position += read_signed_varint(pos , record_end);
+				deletions.push_front(position);
+			}
+			if( (not allow_in_dels) and ( (not insertions.empty()) or (not deletions.empty()) ) ){
+				pos = record_end;
+				continue;
+			}
+			n_positions = read_varint(pos , record_end);
+			mismatches.reserve(n_positions);
+			position = 0;
+			for(size_t i = 0 ; i != n_positions ; ++i){
+				position += read_signed_varint(pos , record_end);
+				mismatches.push_back(position);
+			}
+			if(pos != record_end){
+				throw runtime_error("Corrupted record in binary alignment file: " + filename);
+			}
+			if(template_index >= template_names.size()){
+				throw runtime_error("Unknown genomic template index in binary alignment file: " + filename);
+			}
+
+			indexed_alignments[seq_index].push_back( Alignment_data(template_names[template_index] , offset , five_p_offset , three_p_offset , align_length , insertions , deletions , mismatches , score));
+		}
+	}
+	catch(exception& e){
+		munmap(mapped_file , file_size);
+		throw;
+	}
+	munmap(mapped_file , file_size);
+
+	return indexed_alignments;
+}
@@ -0,0 +1,72 @@
+/*
+ * Binaryalignments.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_BINARYALIGNMENTS_H_
+#define IGOR_SRC_BINARYALIGNMENTS_H_
+
+#include <string>
+#include <vector>
+#include <forward_list>
+#include <unordered_map>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include "Aligner.h"
+
+
+/**
+ * \class Binary_alignment_writer Binaryalignments.h
+ * \brief Writes alignments in IGoR's compact binary alignment container.
+ * \version 1.0
+ *
+ * The file starts with a header containing a magic string, the format version, a byte order mark and the table of
+ * genomic template names. It is followed by length-prefixed records, one per alignment, containing:
+ * - the sequence index and genomic template index
+ * - the offset, 5' and 3' alignment offsets and alignment length
+ * - the alignment score (raw IEEE double)
+ * - the insertions, deletions and mismatches positions lists (delta encoded)
+ *
+ * All integers are stored as LEB128 varints (zigzag encoded for signed values), such that a typical alignment
+ * fits in a few tens of bytes. Records are written in the same order as the CSV lines would be.
+ */
+class Binary_alignment_writer {
+public:
+	Binary_alignment_writer(std::string , const std::vector<std::string>&);
+	virtual ~Binary_alignment_writer();
+
+	void write_seq_alignments(int , const std::forward_list<Alignment_data>&);
+	void flush();
+
+private:
+	//Forbid copies since the writer owns the file stream
+	Binary_alignment_writer(const Binary_alignment_writer&);
+	Binary_alignment_writer& operator=(const Binary_alignment_writer&);
+
+	std::ofstream outfile;
+	std::unordered_map<std::string,uint32_t> template_indices;
+	std::string record_buffer;
+};
+
+std::unordered_map<int,std::vector<Alignment_data>> read_alignments_seq_bin(std::string , double , bool);
+bool is_binary_alignment_file(std::string);
+
+#endif /* IGOR_SRC_BINARYALIGNMENTS_H_ */
@@ -9,6 +9,8 @@
 #ifndef CDR3SEQDATA_H
 #define CDR3SEQDATA_H
 
+#include <string>
+
 class CDR3SeqData {
 public:
     CDR3SeqData();
@@ -0,0 +1,52 @@
+/*
+ * Canonicalgenerator.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Canonicalgenerator.h"
+
+using namespace std;
+
+/**
+ * Compile the generation kernel specialized for the topology of the model queue.
+ * Returns a null pointer if the model does not have a canonical topology, the generic generation should then be used.
+ */
+unique_ptr<Sequence_generator> compile_canonical_generator(const queue<shared_ptr<Rec_Event>>& model_queue , const Marginal_array_p& model_marginals_p ,
+		const unordered_map<Rec_Event_name,int>& index_map , const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map){
+
+	Canonical_topology topology = detect_canonical_topology(model_queue);
+
+	vector<shared_ptr<Rec_Event>> events;
+	queue<shared_ptr<Rec_Event>> model_queue_copy = model_queue;
+	while(not model_queue_copy.empty()){
+		events.push_back(model_queue_copy.front());
+		model_queue_copy.pop();
+	}
+
+	switch(topology){
+		case Tcr_beta_topology:
+			return unique_ptr<Sequence_generator>(new Canonical_sequence_generator<Tcr_beta_signature>(topology , events , model_marginals_p , index_map , offset_map));
+		case Bcr_heavy_topology:
+			return unique_ptr<Sequence_generator>(new Canonical_sequence_generator<Bcr_heavy_signature>(topology , events , model_marginals_p , index_map , offset_map));
+		case VJ_topology:
+			return unique_ptr<Sequence_generator>(new Canonical_sequence_generator<VJ_signature>(topology , events , model_marginals_p , index_map , offset_map));
+		default:
+			return unique_ptr<Sequence_generator>();
+	}
+}
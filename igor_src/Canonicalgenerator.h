@@ -0,0 +1,316 @@
+/*
+ * Canonicalgenerator.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_CANONICALGENERATOR_H_
+#define IGOR_SRC_CANONICALGENERATOR_H_
+
+#include <string>
+#include <vector>
+#include <array>
+#include <queue>
+#include <memory>
+#include <random>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include "Canonicaltopology.h"
+#include "Aligner.h"
+#include "Utils.h"
+
+/**
+ * \class Sequence_generator Canonicalgenerator.h
+ * \brief Interface of the compiled sequence generation kernels.
+ * \version 1.0
+ *
+ * A kernel draws the realizations of all events of a model and reconstructs the sequence without any per sequence allocation or string keyed lookup.
+ * For a given seed the generated sequences and realizations are identical to the ones of GenModel::generate_unique_sequence().
+ */
+class Sequence_generator{
+public:
+	virtual ~Sequence_generator(){};
+	virtual void generate(std::mt19937_64& , std::string&) = 0;
+	virtual void write_realizations(std::ostream&) const = 0;
+	virtual std::queue<std::queue<int>> get_realizations_queue() const = 0;
+	virtual Canonical_topology get_topology() const = 0;
+};
+
+/**
+ * \class Canonical_sequence_generator Canonicalgenerator.h
+ * \brief Sequence generation kernel specialized for a canonical topology.
+ * \version 1.0
+ *
+ * The kernel is compiled from the model queue, the marginals and the index and offset maps used by the generic generation:
+ * each event gets its realizations in the order used to sample them, its base index in the marginals array and the strides it applies
+ * to its children indices. The draws are then unrolled in queue order with the type and target sequence of each event known at compile time.
+ *
+ * The marginals array must outlive the kernel and the event internal probabilities (dinucleotide matrices) must be up to date when it is built.
+ */
+template<class Signature> class Canonical_sequence_generator: public Sequence_generator{
+public:
+	Canonical_sequence_generator(Canonical_topology topology , const std::vector<std::shared_ptr<Rec_Event>>& events , const Marginal_array_p& model_marginals_p ,
+			const std::unordered_map<Rec_Event_name,int>& index_map , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& offset_map):
+				topology(topology) , model_marginals(model_marginals_p.get()) , distribution(0.0,1.0){
+		if(events.size() != n_events){
+			throw std::invalid_argument("Number of events (" + std::to_string(events.size()) + ") does not match the topology in Canonical_sequence_generator::Canonical_sequence_generator()");
+		}
+		std::fill(nt_indices.begin() , nt_indices.end() , -1);
+		const std::string nt_chars = "ACGTURYKMSWBDHVN";
+		for(std::string::const_iterator iter = nt_chars.begin() ; iter != nt_chars.end() ; ++iter){
+			nt_indices[static_cast<unsigned char>(*iter)] = nt2int(std::string(1,*iter)).at(0);
+		}
+
+		for(size_t slot = 0 ; slot != n_events ; ++slot){
+			const Rec_Event& event = *events[slot];
+			Compiled_event& compiled_event = compiled_events[slot];
+			base_indices[slot] = index_map.at(event.get_name());
+
+			const std::unordered_map<std::string,Event_realization>& realizations_map = event.get_realizations_map();
+			for(std::unordered_map<std::string,Event_realization>::const_iterator iter = realizations_map.begin() ; iter != realizations_map.end() ; ++iter){
+				compiled_event.indices.push_back((*iter).second.index);
+				compiled_event.values.push_back((*iter).second.value_int);
+				compiled_event.strings.push_back((*iter).second.value_str);
+			}
+
+			if(offset_map.count(event.get_name()) != 0){
+				const std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>& children = offset_map.at(event.get_name());
+				for(std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>::const_iterator jiter = children.begin() ; jiter != children.end() ; ++jiter){
+					size_t child_slot = 0;
+					while(child_slot != n_events and events[child_slot]->get_name() != (*jiter).first->get_name()){++child_slot;}
+					if(child_slot == n_events){
+						throw std::runtime_error("Child event \"" + (*jiter).first->get_name() + "\" of \"" + event.get_name() + "\" is not in the model queue in Canonical_sequence_generator::Canonical_sequence_generator()");
+					}
+					compiled_event.offsets.push_back(std::make_pair(child_slot , (*jiter).second));
+				}
+			}
+
+			//Conditional dinucleotide probabilities for every (possibly ambiguous) previous nucleotide
+			const Dinucl_markov* dinucl_p = dynamic_cast<const Dinucl_markov*>(&event);
+			if(dinucl_p != nullptr){
+				const Matrix<double>& dinuc_proba_matrix = dinucl_p->get_dinuc_proba_matrix();
+				for(int previous_nt = 0 ; previous_nt != 15 ; ++previous_nt){
+					for(std::vector<int>::const_iterator iter = compiled_event.indices.begin() ; iter != compiled_event.indices.end() ; ++iter){
+						compiled_event.dinucl_probas.push_back(dinuc_proba_matrix(previous_nt , *iter));
+					}
+				}
+			}
+		}
+	}
+
+	void generate(std::mt19937_64& generator , std::string& sequence){
+		for(typename std::array<std::string,6>::iterator iter = constructed_sequences.begin() ; iter != constructed_sequences.end() ; ++iter){
+			(*iter).clear();
+		}
+		for(typename std::array<std::vector<int>,n_events>::iterator iter = realizations.begin() ; iter != realizations.end() ; ++iter){
+			(*iter).clear();
+		}
+		current_indices = base_indices;
+
+		Canonical_signature_steps<Signature>::type::run(*this , generator);
+
+		sequence.clear();
+		sequence += constructed_sequences[V_gene_seq];
+		sequence += constructed_sequences[VJ_ins_seq];
+		sequence += constructed_sequences[VD_ins_seq];
+		sequence += constructed_sequences[D_gene_seq];
+		sequence += constructed_sequences[DJ_ins_seq];
+		sequence += constructed_sequences[J_gene_seq];
+	}
+
+	void write_realizations(std::ostream& outfile) const{
+		for(typename std::array<std::vector<int>,n_events>::const_iterator iter = realizations.begin() ; iter != realizations.end() ; ++iter){
+			outfile<<";(";
+			for(std::vector<int>::const_iterator jiter = (*iter).begin() ; jiter != (*iter).end() ; ++jiter){
+				if(jiter != (*iter).begin()){
+					outfile<<",";
+				}
+				outfile<<(*jiter);
+			}
+			outfile<<")";
+		}
+	}
+
+	std::queue<std::queue<int>> get_realizations_queue() const{
+		std::queue<std::queue<int>> realizations_queue;
+		for(typename std::array<std::vector<int>,n_events>::const_iterator iter = realizations.begin() ; iter != realizations.end() ; ++iter){
+			std::queue<int> event_queue;
+			for(std::vector<int>::const_iterator jiter = (*iter).begin() ; jiter != (*iter).end() ; ++jiter){
+				event_queue.push(*jiter);
+			}
+			realizations_queue.push(event_queue);
+		}
+		return realizations_queue;
+	}
+
+	Canonical_topology get_topology() const{return topology;}
+
+	/**
+	 * Draw the realization of the event in queue position slot, called by Canonical_steps
+	 */
+	template<Canonical_event_role Role> void step(size_t slot , std::mt19937_64& generator){
+		typedef Canonical_role_traits<Role> Traits;
+		draw<Traits>(slot , generator , static_cast<const typename Traits::event_class*>(nullptr));
+	}
+
+private:
+	static const size_t n_events = Signature::n_events;
+
+	struct Compiled_event{
+		std::vector<int> indices; //Realizations indices in sampling order
+		std::vector<int> values;
+		std::vector<std::string> strings;
+		std::vector<std::pair<size_t,int>> offsets; //Queue position of the children and associated stride
+		std::vector<double> dinucl_probas; //For dinucleotide Markov models: [previous_nt*n_realizations + k]
+	};
+
+	/*
+	 * Walk the cumulative distribution of the event, accumulating in the same order and precision as the generic draw_random_realization
+	 * Returns the position of the drawn realization or -1 if the cumulated probability never reached rand
+	 */
+	int find_realization(size_t slot , double rand) const{
+		const Compiled_event& event = compiled_events[slot];
+		const long double* probas = model_marginals + current_indices[slot];
+		double prob_count = 0;
+		for(size_t k = 0 ; k != event.indices.size() ; ++k){
+			prob_count += probas[event.indices[k]];
+			if(prob_count>=rand){
+				return k;
+			}
+		}
+		return -1;
+	}
+
+	void record_realization(size_t slot , int k){
+		const Compiled_event& event = compiled_events[slot];
+		const int realization_index = event.indices[k];
+		realizations[slot].push_back(realization_index);
+		for(std::vector<std::pair<size_t,int>>::const_iterator iter = event.offsets.begin() ; iter != event.offsets.end() ; ++iter){
+			current_indices[(*iter).first] += realization_index*(*iter).second;
+		}
+	}
+
+	template<class Traits> void draw(size_t slot , std::mt19937_64& generator , const Gene_choice*){
+		int k = find_realization(slot , distribution(generator));
+		if(k>=0){
+			constructed_sequences[Traits::seq_type] = compiled_events[slot].strings[k];
+			record_realization(slot , k);
+		}
+	}
+
+	template<class Traits> void draw(size_t slot , std::mt19937_64& generator , const Deletion*){
+		int k = find_realization(slot , distribution(generator));
+		if(k>=0){
+			std::string& gene_seq = constructed_sequences[Traits::seq_type];
+			const int n_deleted = compiled_events[slot].values[k];
+			if(Traits::seq_side == Three_prime){
+				if(n_deleted>=0){
+					gene_seq.erase(gene_seq.size() - n_deleted);
+				}
+				else{
+					//Palindromic insertions
+					palindrome_str.assign(gene_seq , gene_seq.size() + n_deleted , std::string::npos);
+					std::reverse(palindrome_str.begin() , palindrome_str.end());
+					make_transversions(palindrome_str , false);
+					gene_seq += palindrome_str;
+				}
+			}
+			else{
+				if(n_deleted>=0){
+					gene_seq.erase(0 , n_deleted);
+				}
+				else{
+					palindrome_str.assign(gene_seq , 0 , -n_deleted);
+					std::reverse(palindrome_str.begin() , palindrome_str.end());
+					make_transversions(palindrome_str , false);
+					gene_seq.insert(0 , palindrome_str);
+				}
+			}
+			record_realization(slot , k);
+		}
+	}
+
+	template<class Traits> void draw(size_t slot , std::mt19937_64& generator , const Insertion*){
+		int k = find_realization(slot , distribution(generator));
+		if(k>=0){
+			constructed_sequences[Traits::seq_type].assign(compiled_events[slot].values[k] , 'I');
+			record_realization(slot , k);
+		}
+	}
+
+	template<class Traits> void draw(size_t slot , std::mt19937_64& generator , const Dinucl_markov*){
+		std::string& inserted_seq = constructed_sequences[Traits::seq_type];
+		if(not inserted_seq.empty()){
+			const Compiled_event& event = compiled_events[slot];
+			if(inserted_seq[0] == 'I'){
+				const std::string& previous_seq = constructed_sequences[Traits::previous_seq_type];
+				if(previous_seq.empty()){
+					throw std::out_of_range("Empty " + std::string(Traits::reversed ? "J" : "V") + " gene sequence preceding the inserted nucleotides in Canonical_sequence_generator::draw()");
+				}
+				draw_dinucl_nt(event , slot , Traits::reversed ? previous_seq.front() : previous_seq.back() , inserted_seq[0] , generator);
+			}
+			for(size_t i = 1 ; i != inserted_seq.size() ; ++i){
+				if(inserted_seq[i] == 'I'){
+					draw_dinucl_nt(event , slot , inserted_seq[i-1] , inserted_seq[i] , generator);
+				}
+			}
+			if(Traits::reversed){
+				std::reverse(inserted_seq.begin() , inserted_seq.end());
+			}
+		}
+	}
+
+	void draw_dinucl_nt(const Compiled_event& event , size_t slot , char previous_nt_char , char& inserted_nt , std::mt19937_64& generator){
+		int previous_nt = nt_indices[static_cast<unsigned char>(previous_nt_char)];
+		if(previous_nt<0){
+			//Unknown nucleotide, let nt2int report it
+			previous_nt = nt2int(std::string(1,previous_nt_char)).at(0);
+		}
+		double rand = distribution(generator);
+		double prob_count = 0;
+		const size_t n_realizations = event.indices.size();
+		const double* probas = event.dinucl_probas.data() + previous_nt*n_realizations;
+		for(size_t k = 0 ; k != n_realizations ; ++k){
+			prob_count += probas[k];
+			if(prob_count>=rand){
+				inserted_nt = event.strings[k][0];
+				realizations[slot].push_back(event.indices[k]);
+				break;
+			}
+		}
+	}
+
+	Canonical_topology topology;
+	const long double* model_marginals;
+	std::uniform_real_distribution<double> distribution;
+	std::array<Compiled_event,n_events> compiled_events;
+	std::array<int,n_events> base_indices;
+	std::array<int,n_events> current_indices;
+	std::array<std::vector<int>,n_events> realizations;
+	std::array<std::string,6> constructed_sequences; //Indexed by Seq_type
+	std::string palindrome_str;
+	std::array<int,256> nt_indices;
+};
+
+std::unique_ptr<Sequence_generator> compile_canonical_generator(const std::queue<std::shared_ptr<Rec_Event>>& , const Marginal_array_p& ,
+		const std::unordered_map<Rec_Event_name,int>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>&);
+
+
+#endif /* IGOR_SRC_CANONICALGENERATOR_H_ */
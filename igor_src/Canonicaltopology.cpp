@@ -0,0 +1,68 @@
+/*
+ * Canonicaltopology.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Canonicaltopology.h"
+
+using namespace std;
+
+namespace{
+	template<class Signature> bool matches_signature(const vector<const Rec_Event*>& events){
+		if(events.size() != Signature::n_events){
+			return false;
+		}
+		return Canonical_signature_steps<Signature>::type::matches(events.data());
+	}
+}
+
+/**
+ * Returns the canonical topology matching the model queue (events sorted by processing order), or Generic_topology if none does.
+ */
+Canonical_topology detect_canonical_topology(queue<shared_ptr<Rec_Event>> model_queue){
+	vector<const Rec_Event*> events;
+	while(not model_queue.empty()){
+		events.push_back(model_queue.front().get());
+		model_queue.pop();
+	}
+
+	if(matches_signature<Tcr_beta_signature>(events)){
+		return Tcr_beta_topology;
+	}
+	else if(matches_signature<Bcr_heavy_signature>(events)){
+		return Bcr_heavy_topology;
+	}
+	else if(matches_signature<VJ_signature>(events)){
+		return VJ_topology;
+	}
+	return Generic_topology;
+}
+
+string canonical_topology_str(Canonical_topology topology){
+	switch(topology){
+		case Tcr_beta_topology:
+			return "tcr_beta";
+		case Bcr_heavy_topology:
+			return "bcr_heavy";
+		case VJ_topology:
+			return "VJ";
+		default:
+			return "generic";
+	}
+}
@@ -0,0 +1,173 @@
+/*
+ * Canonicaltopology.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_CANONICALTOPOLOGY_H_
+#define IGOR_SRC_CANONICALTOPOLOGY_H_
+
+#include <string>
+#include <queue>
+#include <memory>
+#include "Rec_Event.h"
+#include "Genechoice.h"
+#include "Deletion.h"
+#include "Insertion.h"
+#include "Dinuclmarkov.h"
+#include "Utils.h"
+
+/*
+ * Canonical topologies are the event graphs of the models shipped with IGoR.
+ * A topology is described at compile time by the ordered list of the roles of its events in the model queue,
+ * such that kernels specialized for a topology know the concrete type and target sequence of each event.
+ * Any model whose queue does not exactly match one of these signatures is handled by the generic (dynamic) code.
+ */
+
+enum Canonical_event_role {V_choice_role , J_choice_role , D_choice_role , V_3_del_role , D_5_del_role , D_3_del_role , J_5_del_role ,
+	VD_ins_role , VD_dinucl_role , DJ_ins_role , DJ_dinucl_role , VJ_ins_role , VJ_dinucl_role};
+
+enum Canonical_topology {Generic_topology , Tcr_beta_topology , Bcr_heavy_topology , VJ_topology};
+
+/**
+ * \struct Canonical_role_traits Canonicaltopology.h
+ * \brief Compile time description of an event role: concrete class, identifiers and constructed sequence it acts on.
+ */
+template<Canonical_event_role Role> struct Canonical_role_traits;
+
+template<> struct Canonical_role_traits<V_choice_role>{
+	typedef Gene_choice event_class;
+	static const Event_type event_type = GeneChoice_t; static const Gene_class gene_class = V_gene; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = V_gene_seq;
+};
+template<> struct Canonical_role_traits<J_choice_role>{
+	typedef Gene_choice event_class;
+	static const Event_type event_type = GeneChoice_t; static const Gene_class gene_class = J_gene; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = J_gene_seq;
+};
+template<> struct Canonical_role_traits<D_choice_role>{
+	typedef Gene_choice event_class;
+	static const Event_type event_type = GeneChoice_t; static const Gene_class gene_class = D_gene; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = D_gene_seq;
+};
+template<> struct Canonical_role_traits<V_3_del_role>{
+	typedef Deletion event_class;
+	static const Event_type event_type = Deletion_t; static const Gene_class gene_class = V_gene; static const Seq_side seq_side = Three_prime;
+	static const Seq_type seq_type = V_gene_seq;
+};
+template<> struct Canonical_role_traits<D_5_del_role>{
+	typedef Deletion event_class;
+	static const Event_type event_type = Deletion_t; static const Gene_class gene_class = D_gene; static const Seq_side seq_side = Five_prime;
+	static const Seq_type seq_type = D_gene_seq;
+};
+template<> struct Canonical_role_traits<D_3_del_role>{
+	typedef Deletion event_class;
+	static const Event_type event_type = Deletion_t; static const Gene_class gene_class = D_gene; static const Seq_side seq_side = Three_prime;
+	static const Seq_type seq_type = D_gene_seq;
+};
+template<> struct Canonical_role_traits<J_5_del_role>{
+	typedef Deletion event_class;
+	static const Event_type event_type = Deletion_t; static const Gene_class gene_class = J_gene; static const Seq_side seq_side = Five_prime;
+	static const Seq_type seq_type = J_gene_seq;
+};
+template<> struct Canonical_role_traits<VD_ins_role>{
+	typedef Insertion event_class;
+	static const Event_type event_type = Insertion_t; static const Gene_class gene_class = VD_genes; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = VD_ins_seq;
+};
+template<> struct Canonical_role_traits<DJ_ins_role>{
+	typedef Insertion event_class;
+	static const Event_type event_type = Insertion_t; static const Gene_class gene_class = DJ_genes; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = DJ_ins_seq;
+};
+template<> struct Canonical_role_traits<VJ_ins_role>{
+	typedef Insertion event_class;
+	static const Event_type event_type = Insertion_t; static const Gene_class gene_class = VJ_genes; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = VJ_ins_seq;
+};
+//For dinucleotide Markov models previous_seq_type is the gene providing the first nucleotide the chain is conditioned on
+template<> struct Canonical_role_traits<VD_dinucl_role>{
+	typedef Dinucl_markov event_class;
+	static const Event_type event_type = Dinuclmarkov_t; static const Gene_class gene_class = VD_genes; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = VD_ins_seq; static const Seq_type previous_seq_type = V_gene_seq; static const bool reversed = false;
+};
+template<> struct Canonical_role_traits<DJ_dinucl_role>{
+	typedef Dinucl_markov event_class;
+	static const Event_type event_type = Dinuclmarkov_t; static const Gene_class gene_class = DJ_genes; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = DJ_ins_seq; static const Seq_type previous_seq_type = J_gene_seq; static const bool reversed = true;
+};
+template<> struct Canonical_role_traits<VJ_dinucl_role>{
+	typedef Dinucl_markov event_class;
+	static const Event_type event_type = Dinuclmarkov_t; static const Gene_class gene_class = VJ_genes; static const Seq_side seq_side = Undefined_side;
+	static const Seq_type seq_type = VJ_ins_seq; static const Seq_type previous_seq_type = V_gene_seq; static const bool reversed = false;
+};
+
+/**
+ * \struct Canonical_signature Canonicaltopology.h
+ * \brief Ordered list of event roles as they appear in the model queue.
+ */
+template<Canonical_event_role... Roles> struct Canonical_signature{
+	static const size_t n_events = sizeof...(Roles);
+};
+
+//human/mouse tcr_beta
+typedef Canonical_signature<V_choice_role , J_choice_role , D_choice_role , V_3_del_role , D_5_del_role , D_3_del_role , J_5_del_role ,
+		VD_ins_role , VD_dinucl_role , DJ_ins_role , DJ_dinucl_role> Tcr_beta_signature;
+//human bcr_heavy (D deletions have a higher priority than the V and J ones)
+typedef Canonical_signature<V_choice_role , J_choice_role , D_choice_role , D_5_del_role , D_3_del_role , V_3_del_role , J_5_del_role ,
+		VD_ins_role , VD_dinucl_role , DJ_ins_role , DJ_dinucl_role> Bcr_heavy_signature;
+//human tcr_alpha, IGK and IGL
+typedef Canonical_signature<V_choice_role , J_choice_role , V_3_del_role , J_5_del_role , VJ_ins_role , VJ_dinucl_role> VJ_signature;
+
+/**
+ * \struct Canonical_steps Canonicaltopology.h
+ * \brief Unrolls the roles of a signature at compile time, Slot being the position of Role in the model queue.
+ *
+ * Kernel::template step<Role>(Slot,args...) is invoked for each role in queue order.
+ */
+template<size_t Slot , Canonical_event_role... Roles> struct Canonical_steps;
+
+template<size_t Slot> struct Canonical_steps<Slot>{
+	static bool matches(const Rec_Event* const* ){return true;}
+	template<class Kernel , class... Args> static void run(Kernel& , Args&... ){}
+};
+
+template<size_t Slot , Canonical_event_role Role , Canonical_event_role... Others> struct Canonical_steps<Slot,Role,Others...>{
+	static bool matches(const Rec_Event* const* events){
+		typedef Canonical_role_traits<Role> Traits;
+		const Rec_Event* event_p = events[Slot];
+		return (event_p->get_type() == Traits::event_type) and (event_p->get_class() == Traits::gene_class)
+				and (event_p->get_side() == Traits::seq_side) and (dynamic_cast<const typename Traits::event_class*>(event_p) != nullptr)
+				and Canonical_steps<Slot+1,Others...>::matches(events);
+	}
+	template<class Kernel , class... Args> static void run(Kernel& kernel , Args&... args){
+		kernel.template step<Role>(Slot , args...);
+		Canonical_steps<Slot+1,Others...>::run(kernel , args...);
+	}
+};
+
+template<class Signature> struct Canonical_signature_steps;
+template<Canonical_event_role... Roles> struct Canonical_signature_steps<Canonical_signature<Roles...>>{
+	typedef Canonical_steps<0,Roles...> type;
+};
+
+Canonical_topology detect_canonical_topology(std::queue<std::shared_ptr<Rec_Event>>);
+std::string canonical_topology_str(Canonical_topology);
+
+
+#endif /* IGOR_SRC_CANONICALTOPOLOGY_H_ */
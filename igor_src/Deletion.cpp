@@ -24,6 +24,7 @@
  */
 
 #include "Deletion.h"
+#include "Scenarioengine.h"
 
 
 using namespace std;
@@ -31,7 +32,7 @@ using namespace std;
 /**
  * This function compares nucleotides and output a boolean if they do not necessarily imply an error (ambiguous nucleotides are thus treated in a loose sense).
  */
-bool inline comp_nt_int(const int& nt_1 , const int& nt_2){
+bool comp_nt_int(const int& nt_1 , const int& nt_2){
   if(nt_1 != nt_2){
     if( (nt_1<4) & (nt_2<4)){
       return false;
@@ -180,7 +181,8 @@ Deletion::Deletion(Gene_class gene , Seq_side side ):Rec_Event(gene,side), new_s
 		v_3_min_del(INT16_MAX) ,memory_layer_offset_check2(-1) , d_5_min_offset(INT16_MAX) , new_index(-1) , j_5_max_offset(INT16_MAX) , d_3_max_offset(INT16_MAX) , dj_check(true) ,j_5_offset(INT16_MAX) , end_reached(false) ,d_chosen(false) , memory_layer_safety_1(-1) ,
 		new_tmp_err_w_proba(-1) , d_5_max_del(INT16_MAX) , v_3_min_offset(INT16_MAX) ,j_chosen(false) , memory_layer_safety_2(-1) , err_rate_upper_bound(-1) , v_chosen(false),vd_check(true) , j_5_min_offset(INT16_MAX) , v_3_max_offset(INT16_MAX) , v_3_max_del(INT16_MAX),
 		d_3_min_offset(INT16_MAX) , d_5_max_offset(INT16_MAX) , j_5_min_del(INT16_MAX) , d_5_new_offset(INT16_MAX) , vj_check(true) , d_3_min_del(INT16_MAX) , base_index(INT16_MAX) , memory_layer_offset_check1(-1) , d_5_offset(INT16_MAX) , d_del_opposite_side_processed(false),
-		v_3_offset(INT16_MAX) , d_5_min_del(INT16_MAX) , previous_marginal_index(INT16_MAX) , deletion_value(INT16_MAX) , j_5_max_del(INT16_MAX) , d_3_offset(INT16_MAX) , proba_contribution(-1) , d_3_new_offset(INT16_MAX) , memory_layer_cs(-1) , j_5_new_offset(INT16_MAX){
+		v_3_offset(INT16_MAX) , d_5_min_del(INT16_MAX) , previous_marginal_index(INT16_MAX) , deletion_value(INT16_MAX) , j_5_max_del(INT16_MAX) , d_3_offset(INT16_MAX) , proba_contribution(-1) , d_3_new_offset(INT16_MAX) , memory_layer_cs(-1) , j_5_new_offset(INT16_MAX) ,
+		profile_cacheable(true){
 	this->type = Event_type::Deletion_t;
 	for(unordered_map<string,Event_realization>::const_iterator iter = this->event_realizations.begin() ; iter != this->event_realizations.end() ; ++iter){
 		if((*iter).second.value_int > (-this->len_min)){this->len_min = -(*iter).second.value_int;}
@@ -230,7 +232,18 @@ void Deletion::add_realization(int del_number){
  * -First check whether any of these number of deletions is possible given the current position and number of deletions on other genes
  * -Loop over # of deletions in decreasing order
  */
-void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_map& downstream_proba_map , const string& sequence , const Int_Str& int_sequence , Index_map& base_index_map , const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map , shared_ptr<Next_event_ptr>& next_event_ptr_arr , Marginal_array_p& updated_marginals_point , const Marginal_array_p& model_parameters_point ,const unordered_map<Gene_class , vector<Alignment_data>>& allowed_realizations , Seq_type_str_p_map& constructed_sequences , Seq_offsets_map& seq_offsets , shared_ptr<Error_rate>& error_rate_p , map<size_t,shared_ptr<Counter>>& counters_list , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , Safety_bool_map& safety_set , Mismatch_vectors_map& mismatches_lists , double& seq_max_prob_scenario , double& proba_threshold_factor){
+void Deletion::iterate(double& scenario_proba , Scenario_context& context){
+	Downstream_scenario_proba_bound_map& downstream_proba_map = context.downstream_proba_map;
+	const string& sequence = context.sequence;
+	const Int_Str& int_sequence = context.int_sequence;
+	Index_map& base_index_map = context.index_map;
+	const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map = context.offset_map;
+	const Marginal_array_p& model_parameters_point = context.model_parameters;
+	Seq_type_str_p_map& constructed_sequences = context.constructed_sequences;
+	Seq_offsets_map& seq_offsets = context.seq_offsets;
+	shared_ptr<Error_rate>& error_rate_p = context.error_rate_p;
+	Safety_bool_map& safety_set = context.safety_set;
+	Mismatch_vectors_map& mismatches_lists = context.mismatches_lists;
 
 	base_index = base_index_map.at(this->event_index);
 	//constructed_sequences_copy = constructed_sequences;
@@ -276,12 +289,13 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 			//Check J choice
 			if(j_chosen){
+				//Always needed for the VJ junction length, even when the VJ pair is already safe
+				j_5_offset = seq_offsets.at(J_gene_seq,Five_prime,memory_layer_offset_check2);
 
 					//if(safety_set.count(Event_safety::VJ_safe) == 0){
 				if(!safety_set.at(Event_safety::VJ_safe,memory_layer_safety_2-1)){
 					//j_5_offset = seq_offsets.at(pair<Seq_type,Seq_side>(J_gene_seq , Five_prime));
 					//j_5_offset = seq_offsets.at(j_5_pair);
-					j_5_offset = seq_offsets.at(J_gene_seq,Five_prime,memory_layer_offset_check2);
 
 					j_5_min_offset = j_5_offset - j_5_min_del;
 					j_5_max_offset = j_5_offset - j_5_max_del;
@@ -296,11 +310,13 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 			else{
 				vj_check = false;//No point of checking if J has not been picked because the offset is unknown
 			}
-			Int_Str& previous_str = (*constructed_sequences.at(V_gene_seq,memory_layer_cs-1));
+			const Int_Str_view previous_str = constructed_sequences.at(V_gene_seq,memory_layer_cs-1);
 			vector<int>& v_mismatch_list = *mismatches_lists.at(V_gene_seq , memory_layer_mismatches-1);
 
 
-			for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter){
+			prepare_deletion_profile(previous_str , v_mismatch_list , v_3_offset);
+			size_t profile_position = 0;
+			for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter , ++profile_position){
 				if((int)previous_str.size()>(*iter).value_int){ //Do not allow for deletion of the entire V
 					//TODO What about deletions going outside the read?
 					//unordered_set<Event_safety> safety_set_copy = safety_set;
@@ -358,90 +374,16 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 
 					//Positive or negative deletion (palindroms) mechanism
-					if((*iter).value_int >= 0){
-						//Delete the end of the V-gene (3' end)
-						new_str = previous_str.substr(0,previous_str.size()-(*iter).value_int);
-
-						//Update the mismatch list given the deletions
-						if(!v_mismatch_list.empty()){
-							mis_iter = v_mismatch_list.end();
-							//Get an iterator referring to an actual integer (end() is not dereferenceable)
-							mis_iter--;
-							end_reached = false;
-							while((*mis_iter)>v_3_new_offset ){
-								if( mis_iter == v_mismatch_list.begin()){
-									end_reached = true;
-									break;
-								}
-								else{
-									--mis_iter;
-								}
-							}
-
-							if( end_reached){
-								//Clear the vector but the capacity remains the same
-								mismatches_vector.clear();
-							}
-							else{
-								++mis_iter;
-								mismatches_vector.assign(v_mismatch_list.begin(),mis_iter);
-							}
-						}
-						else{
-							mismatches_vector.clear();
-						}
-					}
-					else //Negative deletions
-					{
-						if(v_3_new_offset < (int) sequence.size() ){
-							//Check that the palindrom cannot be longer than the sequence itself
-							if( (-(*iter).value_int) <= (int) previous_str.size()){
-								//Copy the last nucleotides
-								//cout<<"# p nucl: "<<(-(*iter).second.value_int)<<endl;
-								tmp_str = previous_str.substr(previous_str.size()  + (*iter).value_int , string::npos );
-								//cout<<"tmp_str: "<<tmp_str<<endl;
-								//Reverse them
-								//TODO revise this (perhaps not a good idea to perform these operations every time)
-								reverse(tmp_str.begin() , tmp_str.end());
-								make_transversions(tmp_str);
-								//cout<<"rev_tmp_str: "<<tmp_str<<endl;
-								//Merge strings
-								new_str = previous_str + tmp_str;
-								//cout<<"prev_str: "<<previous_str<<endl;
-								//cout<<"new str:  "<<new_str<<endl;
-								//Count mismatches and add them to the mismatches list
-								mismatches_vector = v_mismatch_list;
-							/*	cout<<"mismatch_vect : ";
-								for(vector<int>::const_iterator test = mismatches_vector.begin() ; test != mismatches_vector.end() ; test++){
-									cout<<(*test)<<";";
-								}
-								cout<<endl;
-*/
-								for(int i = 0 ; i != (-(*iter).value_int) ; ++i ){
-									if(not comp_nt_int(tmp_str[i] , int_sequence.at(v_3_offset+1+i))){
-										mismatches_vector.push_back(v_3_offset+1+i);
-									}
-								}
-/*								cout<<"prev_v_3_offset: "<<v_3_offset<<endl;
-								cout<<"seq: "<<int_sequence<<endl;
-								cout<<"new_mismatch_vect : ";
-								for(vector<int>::const_iterator test = mismatches_vector.begin() ; test != mismatches_vector.end() ; test++){
-									cout<<(*test)<<";";
-								}
-								cout<<endl;
-								cout<<"--------------------------------------------------------------"<<endl;*/
-							}
-							else{
-								continue;
-							}
-						}
-						else{
+					if((*iter).value_int < 0){
+						//Check that the palindrom cannot be longer than the sequence itself
+						if( (v_3_new_offset >= (int) sequence.size()) or ((-(*iter).value_int) > (int) previous_str.size()) ){
 							continue;
 						}
-
 					}
+					//Delete the end of the V-gene (3' end) or append the palindrom and update the mismatch list
+					deleted_str = apply_deletion_profile(profile_position , (*iter).value_int , v_3_new_offset , v_3_offset , previous_str , v_mismatch_list , int_sequence , false);
 
-					constructed_sequences.set_value( V_gene_seq , &new_str , memory_layer_cs);
+					constructed_sequences.set_value(V_gene_seq , deleted_str , memory_layer_cs);
 					//constructed_sequences_copy.at(V_gene_seq).erase(constructed_sequences.at(V_gene_seq).size() - (*iter).second.value_int);
 					//Get rid of scenarios that delete more J nucleotides than the ones on the read //TODO improve this part (for J also)
 					//if(constructed_sequences_copy.at(V_gene_seq).size()<1){continue;}//Already delt with upper
@@ -460,22 +402,25 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					//Update downstream proba map and compute the downstream proba bound for this event
 						scenario_upper_bound_proba = new_scenario_proba;
 
+						//Junction length proba bounds given the chosen parents of the downstream events
+						const map<int,double>& vd_length_proba_map = vd_length_proba_bounds.get_length_proba_map(vd_length_best_proba_map , model_parameters_point , base_index_map);
+						const map<int,double>& vj_length_proba_map = vj_length_proba_bounds.get_length_proba_map(vj_length_best_proba_map , model_parameters_point , base_index_map);
 						//Get VD or VJ junction upper bound proba
 						if(d_chosen){
-							if(vd_length_best_proba_map.count(d_5_offset - v_3_new_offset -1)<=0){
+							if(vd_length_proba_map.count(d_5_offset - v_3_new_offset -1)<=0){
 								continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 							}
 							downstream_proba_map.set_value(VD_ins_seq , 1.0 , memory_layer_proba_map_junction);
 						}
 						else if(j_chosen){
-							if(vj_length_best_proba_map.count(j_5_offset - v_3_new_offset -1)<=0){
+							if(vj_length_proba_map.count(j_5_offset - v_3_new_offset -1)<=0){
 								continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 							}
 							downstream_proba_map.set_value(VJ_ins_seq , 1.0, memory_layer_proba_map_junction);
 						}
 
 						//Update the mismatches penalty
-						downstream_proba_map.set_value(V_gene_seq , error_rate_p->get_err_rate_upper_bound(mismatches_vector.size(),new_str.size()-mismatches_vector.size()) , memory_layer_proba_map_seq);
+						downstream_proba_map.set_value(V_gene_seq , error_rate_p->get_err_rate_upper_bound(mismatches_vector.size(),deleted_str.size()-mismatches_vector.size()) , memory_layer_proba_map_seq);
 
 						//Multiply all downstream probas
 						downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
@@ -484,7 +429,7 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					//new_tmp_err_w_proba*=pow(err_rate_upper_bound,mismatches_vector.size());
 					//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
 
-					if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+					if(context.is_pruned(scenario_upper_bound_proba)){
 						//The order in which deletion are processed goes with decreasing number of deletion.
 						//If a high number of deletions contains too many errors to be processed (even without taking the proba contribution into account), fewer deletions can only contain more thus the loop is broken
 						break;
@@ -494,20 +439,20 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					scenario_upper_bound_proba = new_scenario_proba;
 					//Get VD or VJ junction upper bound proba
 					if(d_chosen){
-						downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(d_5_offset - v_3_new_offset -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(VD_ins_seq , vd_length_proba_map.at(d_5_offset - v_3_new_offset -1) , memory_layer_proba_map_junction);
 					}
 					else if(j_chosen){
-						downstream_proba_map.set_value(VJ_ins_seq , vj_length_best_proba_map.at(j_5_offset - v_3_new_offset -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(VJ_ins_seq , vj_length_proba_map.at(j_5_offset - v_3_new_offset -1) , memory_layer_proba_map_junction);
 					}
 					//Multiply all downstream probas
 					downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
 					//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-					if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+					if(context.is_pruned(scenario_upper_bound_proba)){
 						continue;
 					}
 
-					Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_point , model_parameters_point , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor );
+					Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 				}
 			}
 		}
@@ -549,11 +494,13 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					vd_check = false;
 				}
 
-				Int_Str& previous_str = (*constructed_sequences.at(D_gene_seq,memory_layer_cs-1));
+				const Int_Str_view previous_str = constructed_sequences.at(D_gene_seq,memory_layer_cs-1);
 				vector<int>& d_mismatch_list = *mismatches_lists.at(D_gene_seq , memory_layer_mismatches-1);
 
 
-				for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter){
+				prepare_deletion_profile(previous_str , d_mismatch_list , d_5_offset);
+				size_t profile_position = 0;
+				for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter , ++profile_position){
 					if( (int) previous_str.size()>=(*iter).value_int){
 
 						//unordered_set<Event_safety> safety_set_copy = safety_set;
@@ -598,83 +545,18 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 						//Positive or negative deletion (palindroms) mechanism
 						if((*iter).value_int >= 0){
-
-							///THIS IS A TEMPORARY FIX// //FIXME
-						//////////////////////////////////////////////////////////////////////////
 							if(d_del_opposite_side_processed){
 									if((*iter).value_int>previous_str.size()){
 											continue;
 									}
 							}
-
-						 //////////////////////////////////////////////////////////////////////////
-
-
-							//Delete the beginning of the D-gene (5' end)
-							new_str = previous_str.substr((*iter).value_int,string::npos);
-
-							//Update the mismatches given the number of deleted nucleotides
-							//Discard irrelevant mismatches (assuming the vector of mismatches is ordered) given the number of deletions
-							if(!d_mismatch_list.empty()){
-								mis_iter = d_mismatch_list.begin();
-
-								end_reached = false;
-								while( ( (*mis_iter)< d_5_new_offset ) ){
-									++mis_iter;
-									if(mis_iter==d_mismatch_list.end()){
-										end_reached = true;
-										break;
-									}
-								}
-								if(end_reached){
-									mismatches_vector.clear();
-								}
-								else{
-									mismatches_vector.assign(mis_iter,d_mismatch_list.end());
-								}
-							}
-							else{
-								mismatches_vector.clear();
-							}
-
-						}else //Negative deletion
-						{
-							if(d_5_new_offset>=0){
-								//Check that the palindrom cannot be longer than the sequence itself
-								if( (-(*iter).value_int) <= (int) previous_str.size()){
-
-									//Copy the first nucleotides
-									tmp_str = previous_str.substr(0 , -(*iter).value_int );
-
-									//Reverse them
-									reverse(tmp_str.begin() , tmp_str.end());
-									make_transversions(tmp_str);
-									//Merge strings
-									new_str =  tmp_str + previous_str ;
-
-									mismatches_vector = d_mismatch_list;
-
-									for(int i = 0 ; i != (-(*iter).value_int) ; ++i ){
-										//Check for errors in reverse order to keep the mismatch vector ordered
-										if(d_5_new_offset+i<int_sequence.size() and (not comp_nt_int(tmp_str[i] , int_sequence.at(d_5_new_offset+i)))){
-											mismatches_vector.push_back(d_5_new_offset+i);
-										}
-									}
-									sort(mismatches_vector.begin(),mismatches_vector.end());
-
-								}
-								else{
-									continue;
-								}
-							}
-							else{
-								continue;
-							}
-
 						}
+						else if( (d_5_new_offset < 0) or ((-(*iter).value_int) > (int) previous_str.size()) ){
+							continue;
+						}
+						deleted_str = apply_deletion_profile(profile_position , (*iter).value_int , d_5_new_offset , d_5_offset , previous_str , d_mismatch_list , int_sequence , true);
 
-
-						constructed_sequences.set_value(D_gene_seq , &new_str , memory_layer_cs);
+						constructed_sequences.set_value(D_gene_seq , deleted_str , memory_layer_cs);
 						//constructed_sequences_copy.at(D_gene_seq).erase(0 , (*iter).second.value_int);
 
 						//seq_offsets_copy.at(pair<Seq_type,Seq_side>(D_gene_seq,Five_prime)) = d_5_new_offset;
@@ -690,18 +572,20 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 						//Update downstream proba map and compute the downstream proba bound for this event
 							scenario_upper_bound_proba = new_scenario_proba;
 
+							//Junction length proba bounds given the chosen parents of the downstream events
+							const map<int,double>& vd_length_proba_map = vd_length_proba_bounds.get_length_proba_map(vd_length_best_proba_map , model_parameters_point , base_index_map);
 							//Get VD upper bound proba
 							if(v_chosen){
-								if(vd_length_best_proba_map.count(d_5_new_offset - v_3_offset -1)<=0){
+								if(vd_length_proba_map.count(d_5_new_offset - v_3_offset -1)<=0){
 									continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 								}
-								downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(d_5_new_offset - v_3_offset -1) , memory_layer_proba_map_junction);
+								downstream_proba_map.set_value(VD_ins_seq , vd_length_proba_map.at(d_5_new_offset - v_3_offset -1) , memory_layer_proba_map_junction);
 							}
 
 							//Update the mismatches penalty
 							if(d_del_opposite_side_processed){
 								endogeneous_mismatches = mismatches_vector.size();
-								downstream_proba_map.set_value(D_gene_seq , error_rate_p->get_err_rate_upper_bound(mismatches_vector.size(),new_str.size()-mismatches_vector.size()) , memory_layer_proba_map_seq);
+								downstream_proba_map.set_value(D_gene_seq , error_rate_p->get_err_rate_upper_bound(mismatches_vector.size(),deleted_str.size()-mismatches_vector.size()) , memory_layer_proba_map_seq);
 							}
 							else{
 								mis_iter = mismatches_vector.begin();
@@ -732,7 +616,7 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 						new_scenario_proba*=proba_contribution;
 						scenario_upper_bound_proba*=proba_contribution;
 						//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-						if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+						if(context.is_pruned(scenario_upper_bound_proba)){
 							continue;
 						}
 
@@ -740,7 +624,7 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 						/*if(d_del_opposite_side_processed){
 							new_tmp_err_w_proba*=pow(err_rate_upper_bound,mismatches_vector.size());
 							compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-							if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+							if(context.is_pruned(scenario_upper_bound_proba)){
 								//The order in which deletion are processed goes with decreasing number of deletion.
 								//If a high number of deletions contains too many errors to be processed (even without taking the proba contribution into account), fewer deletions can only contain more thus the loop is broken
 								break;
@@ -749,21 +633,21 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 							new_tmp_err_w_proba*=proba_contribution;
 							compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-							if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+							if(context.is_pruned(scenario_upper_bound_proba)){
 								continue;
 							}
 						}
 						else{
 							new_tmp_err_w_proba*=proba_contribution;
 							compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-							if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+							if(context.is_pruned(scenario_upper_bound_proba)){
 								continue;
 							}
 						}
 */
 
 
-						Rec_Event::iterate_wrap_up(new_scenario_proba ,downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_point  , model_parameters_point , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists ,seq_max_prob_scenario , proba_threshold_factor);
+						Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 
 					}
 				}
@@ -803,10 +687,12 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					dj_check = false;
 				}
 
-				Int_Str& previous_str = (*constructed_sequences.at(D_gene_seq,memory_layer_cs-1));
+				const Int_Str_view previous_str = constructed_sequences.at(D_gene_seq,memory_layer_cs-1);
 				vector<int>& d_mismatch_list = *mismatches_lists.at(D_gene_seq , memory_layer_mismatches-1);
 
-				for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter){
+				prepare_deletion_profile(previous_str , d_mismatch_list , d_3_offset);
+				size_t profile_position = 0;
+				for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter , ++profile_position){
 					if((int)previous_str.size()>=(*iter).value_int){
 
 						//unordered_set<Event_safety> safety_set_copy = safety_set;
@@ -842,100 +728,18 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 						//Positive or negative deletion (palindroms) mechanism
 						if((*iter).value_int >= 0){
-
-							///THIS IS A TEMPORARY FIX// //FIXME
-						//////////////////////////////////////////////////////////////////////////
 							if(d_del_opposite_side_processed){
 									if((*iter).value_int>previous_str.size()){
 											continue;
 									}
 							}
-						//////////////////////////////////////////////////////////////////////////
-
-
-							//Delete the end of the D-gene (3'end)
-							new_str = previous_str.substr(0,previous_str.size() - (*iter).value_int);
-
-							//Update mismatches list given the number of deletions
-							//Discard irrelevant mismatches (assuming the vector of mismatches is ordered) given the number of deletions
-							if(!d_mismatch_list.empty()){
-								mis_iter = d_mismatch_list.end();
-								//Get an iterator referring to an actual integer (end() is not dereferenceable)
-								mis_iter--;
-								end_reached = false;
-								while((*mis_iter)>d_3_new_offset ){
-									if( mis_iter == d_mismatch_list.begin()){
-										end_reached = true;
-										break;
-									}
-									else{
-										mis_iter--;
-									}
-								}
-
-								if( end_reached){
-									//Clear the vector but the capacity remains the same
-									mismatches_vector.clear();
-								}
-								else{
-									++mis_iter;
-									mismatches_vector.assign(d_mismatch_list.begin(),mis_iter);
-								}
-							}
-							else{
-								mismatches_vector.clear();
-							}
-
 						}
-						else //Negative deletion
-						{
-							if(d_3_new_offset < (int) sequence.size() ){
-								//Check that the palindrom cannot be longer than the sequence itself
-								if( (-(*iter).value_int) <= (int) previous_str.size()){
-									//Copy the last nucleotides
-
-									tmp_str = previous_str.substr(previous_str.size()  + (*iter).value_int , string::npos );
-
-									//Reverse them
-									reverse(tmp_str.begin() , tmp_str.end());
-									make_transversions(tmp_str);
-
-									//Merge strings
-									new_str = previous_str + tmp_str;
-
-									//Count mismatches and add them to the mismatches list
-									mismatches_vector = d_mismatch_list;
-
-									for(int i = 0 ; i != (-(*iter).value_int) ; ++i ){
-										/*if(d_3_offset+1+i<0){
-											cout<<"problem"<<endl;
-											cout<<d_3_offset<<endl;
-											cout<<i<<endl;
-
-											cout<<seq_offsets.at(V_gene_seq,Three_prime)<<endl;
-											cout<<seq_offsets.at(D_gene_seq,Five_prime)<<endl;
-											cout<<seq_offsets.at(D_gene_seq,Three_prime)<<endl;
-											cout<<seq_offsets.at(J_gene_seq,Five_prime)<<endl;
-
-										}*/
-
-										if(d_3_offset+1+i>=0 and (not comp_nt_int(tmp_str[i] , int_sequence.at(d_3_offset+1+i)))){
-											mismatches_vector.push_back(d_3_offset+1+i);
-										}
-									}
-								}
-								else{
-									continue;
-								}
-							}
-							else{
-								continue;
-							}
-
+						else if( (d_3_new_offset >= (int) sequence.size()) or ((-(*iter).value_int) > (int) previous_str.size()) ){
+							continue;
 						}
+						deleted_str = apply_deletion_profile(profile_position , (*iter).value_int , d_3_new_offset , d_3_offset , previous_str , d_mismatch_list , int_sequence , true);
 
-
-						constructed_sequences.set_value(D_gene_seq , &new_str,memory_layer_cs);
+						constructed_sequences.set_value(D_gene_seq , deleted_str , memory_layer_cs);
 						//constructed_sequences_copy.at(D_gene_seq).erase(constructed_sequences.at(D_gene_seq).size() - (*iter).second.value_int);
 
 						//seq_offsets_copy.at(pair<Seq_type,Seq_side>(D_gene_seq,Three_prime)) = d_3_new_offset;
@@ -952,18 +756,20 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 						//Update downstream proba map and compute the downstream proba bound for this event
 							scenario_upper_bound_proba = new_scenario_proba;
 
+							//Junction length proba bounds given the chosen parents of the downstream events
+							const map<int,double>& dj_length_proba_map = dj_length_proba_bounds.get_length_proba_map(dj_length_best_proba_map , model_parameters_point , base_index_map);
 							//Get VD upper bound proba
 							if(j_chosen){
-								if(dj_length_best_proba_map.count(j_5_offset - d_3_new_offset -1)<=0){
+								if(dj_length_proba_map.count(j_5_offset - d_3_new_offset -1)<=0){
 									continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 								}
-								downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(j_5_offset - d_3_new_offset -1) , memory_layer_proba_map_junction);
+								downstream_proba_map.set_value(DJ_ins_seq , dj_length_proba_map.at(j_5_offset - d_3_new_offset -1) , memory_layer_proba_map_junction);
 							}
 
 							//Update the mismatches penalty
 							if(d_del_opposite_side_processed){
 								endogeneous_mismatches = mismatches_vector.size();
-								downstream_proba_map.set_value(D_gene_seq , error_rate_p->get_err_rate_upper_bound(endogeneous_mismatches,new_str.size()-endogeneous_mismatches) , memory_layer_proba_map_seq);
+								downstream_proba_map.set_value(D_gene_seq , error_rate_p->get_err_rate_upper_bound(endogeneous_mismatches,deleted_str.size()-endogeneous_mismatches) , memory_layer_proba_map_seq);
 							}
 							else{
 								mis_iter = mismatches_vector.begin();
@@ -994,7 +800,7 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 						new_scenario_proba*=proba_contribution;
 						scenario_upper_bound_proba*=proba_contribution;
 						//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-						if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+						if(context.is_pruned(scenario_upper_bound_proba)){
 							continue;
 						}
 
@@ -1003,7 +809,7 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 						if(d_del_opposite_side_processed){
 							new_tmp_err_w_proba*=pow(err_rate_upper_bound,mismatches_vector.size());
 							compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-							if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+							if(context.is_pruned(scenario_upper_bound_proba)){
 								//The order in which deletion are processed goes with decreasing number of deletion.
 								//If a high number of deletions contains too many errors to be processed (even without taking the proba contribution into account), fewer deletions can only contain more thus the loop is broken
 								break;
@@ -1012,19 +818,19 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 							new_tmp_err_w_proba*=proba_contribution;
 							compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-							if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+							if(context.is_pruned(scenario_upper_bound_proba)){
 								continue;
 							}
 						}
 						else{
 							new_tmp_err_w_proba*=proba_contribution;
 							compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-							if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+							if(context.is_pruned(scenario_upper_bound_proba)){
 								continue;
 							}
 						}*/
 
-						Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_point  , model_parameters_point , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists ,seq_max_prob_scenario , proba_threshold_factor);
+						Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 
 					}
 
@@ -1096,9 +902,11 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 				vj_check = false;
 			}
 
-			Int_Str& previous_str = (*constructed_sequences.at(J_gene_seq,memory_layer_cs-1));
+			const Int_Str_view previous_str = constructed_sequences.at(J_gene_seq,memory_layer_cs-1);
 			vector<int>& j_mismatch_list = *mismatches_lists.at(J_gene_seq , memory_layer_mismatches-1);
-			for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter){
+			prepare_deletion_profile(previous_str , j_mismatch_list , j_5_offset);
+			size_t profile_position = 0;
+			for(forward_list<Event_realization>::const_iterator iter=(*this).int_value_and_index.begin() ; iter != (*this).int_value_and_index.end() ; ++iter , ++profile_position){
 				if( (int) previous_str.size()>(*iter).value_int){
 
 					//unordered_set<Event_safety> safety_set_copy = safety_set;
@@ -1147,83 +955,12 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					this->iterate_common( iter , base_index_map , offset_map , model_parameters_point);
 
 					//Positive or negative deletion (palindroms) mechanism
-					if((*iter).value_int >= 0){
-						//Delete the beginning of the J-gene (5' end)
-						new_str = previous_str.substr((*iter).value_int);
-
-						//Update mismatch list given the number of deletions
-						//Discard irrelevant mismatches (assuming the vector of mismatches is ordered) given the number of deletions
-						if(!j_mismatch_list.empty()){
-							mis_iter = j_mismatch_list.begin();
-							end_reached = false;
-							while( ( (*mis_iter)< j_5_new_offset ) ){
-								++mis_iter;
-								if(mis_iter==j_mismatch_list.end()){
-									end_reached = true;
-									break;
-								}
-							}
-							if(end_reached){
-								mismatches_vector.clear();
-							}
-							else{
-								mismatches_vector.assign(mis_iter,j_mismatch_list.end());
-							}
-						}
-						else{
-							mismatches_vector.clear();
-						}
-
-
-					}
-					else //Negative deletion
-					{
-						//Check that the palindrom cannot be longer than the sequence itself
-						if( (-(*iter).value_int) <= (int)previous_str.size()){
-
-							//Copy the first nucleotides
-							//cout<<"# p nucl: "<<(-(*iter).second.value_int)<<endl;
-							tmp_str = previous_str.substr(0 , -(*iter).value_int );
-							//cout<<"tmp_str: "<<tmp_str<<endl;
-							//Reverse them
-							reverse(tmp_str.begin() , tmp_str.end());
-							make_transversions(tmp_str);
-							//Merge strings
-							new_str =  tmp_str + previous_str ;
-
-							//cout<<"prev_str: "<<previous_str<<endl;
-							//cout<<"new str:  "<<new_str<<endl;
-							//Count mismatches and add them to the mismatches list
-							mismatches_vector = j_mismatch_list;
-/*							cout<<"mismatch_vect : ";
-							for(vector<int>::const_iterator test = mismatches_vector.begin() ; test != mismatches_vector.end() ; test++){
-								cout<<(*test)<<";";
-							}
-							cout<<endl;*/
-							for(int i = 0 ; i != (-(*iter).value_int) ; ++i ){
-								//Check for errors in reverse order to keep the mismatch vector ordered
-								if( not comp_nt_int(tmp_str[i] , int_sequence.at(j_5_new_offset+i))){
-									mismatches_vector.push_back(j_5_new_offset+i);
-								}
-							}
-							sort(mismatches_vector.begin(),mismatches_vector.end());
-/*							cout<<"prev_v_3_offset: "<<v_3_offset<<endl;
-							cout<<"seq: "<<int_sequence<<endl;
-							cout<<"new_mismatch_vect : ";
-							for(vector<int>::const_iterator test = mismatches_vector.begin() ; test != mismatches_vector.end() ; test++){
-								cout<<(*test)<<";";
-							}
-							cout<<endl;
-							cout<<endl;*/
-						}
-						else{
-							continue;
-						}
+					if( ((*iter).value_int < 0) and ((-(*iter).value_int) > (int)previous_str.size()) ){
+						continue;
 					}
+					deleted_str = apply_deletion_profile(profile_position , (*iter).value_int , j_5_new_offset , j_5_offset , previous_str , j_mismatch_list , int_sequence , false);
 
-
-
-					constructed_sequences.set_value(J_gene_seq , &new_str , memory_layer_cs);
+					constructed_sequences.set_value(J_gene_seq , deleted_str , memory_layer_cs);
 					//constructed_sequences_copy.at(J_gene_seq).erase(0 , (*iter).second.value_int);
 					//Get rid of scenarios that delete more J nucleotides than the ones on the read //TODO improve this part (for J also)
 					//if(constructed_sequences_copy.at(J_gene_seq).size()<1){continue;}
@@ -1242,22 +979,25 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					//Update downstream proba map and compute the downstream proba bound for this event
 						scenario_upper_bound_proba = new_scenario_proba;
 
+						//Junction length proba bounds given the chosen parents of the downstream events
+						const map<int,double>& dj_length_proba_map = dj_length_proba_bounds.get_length_proba_map(dj_length_best_proba_map , model_parameters_point , base_index_map);
+						const map<int,double>& vj_length_proba_map = vj_length_proba_bounds.get_length_proba_map(vj_length_best_proba_map , model_parameters_point , base_index_map);
 						//Get DJ or VJ junction upper bound proba
 						if(d_chosen){
-							if(dj_length_best_proba_map.count( j_5_new_offset - d_3_offset  -1)<=0){
+							if(dj_length_proba_map.count( j_5_new_offset - d_3_offset  -1)<=0){
 								continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 							}
 							downstream_proba_map.set_value(DJ_ins_seq , 1.0 , memory_layer_proba_map_junction);
 						}
 						else if(v_chosen){
-							if(vj_length_best_proba_map.count(j_5_new_offset - v_3_offset -1)<=0){
+							if(vj_length_proba_map.count(j_5_new_offset - v_3_offset -1)<=0){
 								continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 							}
 							downstream_proba_map.set_value(VJ_ins_seq , 1.0 , memory_layer_proba_map_junction);
 						}
 
 						//Count the number of mismatches that will not go away even with maximum number of deletions
-						downstream_proba_map.set_value(J_gene_seq , error_rate_p->get_err_rate_upper_bound(mismatches_vector.size(),new_str.size()-mismatches_vector.size()) , memory_layer_proba_map_seq);
+						downstream_proba_map.set_value(J_gene_seq , error_rate_p->get_err_rate_upper_bound(mismatches_vector.size(),deleted_str.size()-mismatches_vector.size()) , memory_layer_proba_map_seq);
 
 						//Multiply all downstream probas
 						downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
@@ -1267,7 +1007,7 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					//new_tmp_err_w_proba*=pow(err_rate_upper_bound,mismatches_vector.size());
 					//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
 
-					if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+					if(context.is_pruned(scenario_upper_bound_proba)){
 						//The order in which deletion are processed goes with decreasing number of deletion.
 						//If a high number of deletions contains too many errors to be processed (even without taking the proba contribution into account), fewer deletions can only contain more thus the loop is broken
 						break;
@@ -1277,20 +1017,20 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 					scenario_upper_bound_proba = new_scenario_proba;
 					//Get DJ or VJ junction upper bound proba
 					if(d_chosen){
-						downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(j_5_new_offset - d_3_offset  -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(DJ_ins_seq , dj_length_proba_map.at(j_5_new_offset - d_3_offset  -1) , memory_layer_proba_map_junction);
 					}
 					else if(v_chosen){
-						downstream_proba_map.set_value(VJ_ins_seq , vj_length_best_proba_map.at(j_5_new_offset - v_3_offset -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(VJ_ins_seq , vj_length_proba_map.at(j_5_new_offset - v_3_offset -1) , memory_layer_proba_map_junction);
 					}
 					//Multiply all downstream probas
 					downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
 					//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-					if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+					if(context.is_pruned(scenario_upper_bound_proba)){
 						continue;
 					}
 
-					Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_point  , model_parameters_point , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
+					Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 				}
 			}
 		}
@@ -1673,11 +1413,139 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 		j_5_min_del=0;
 		j_5_max_del=0;
 	}
+
+	//The upstream sequence of the second D deletion is built by the first one, its deletion profile cannot be reused across calls
+	profile_cacheable = true;
+	if(this->event_class == D_gene){
+		Seq_side other_side = (this->event_side == Five_prime) ? Three_prime : Five_prime;
+		if( (events_map.count(tuple<Event_type,Gene_class,Seq_side>(Deletion_t,D_gene,other_side)) != 0) and d_del_opposite_side_processed ){
+			profile_cacheable = false;
+		}
+	}
+	profile_key.invalidate();
+
 	this->Rec_Event::initialize_event(processed_events,events_map,offset_map,downstream_proba_map,constructed_sequences,safety_set,error_rate_p,mismatches_list,seq_offsets,index_map);
 
  }
 
 
+/**
+ * Select the deletion profile of the upstream sequence, reset it unless it is the cached profile of the same alignment and template
+ */
+void Deletion::prepare_deletion_profile(const Int_Str_view& previous_str , const vector<int>& mismatch_list , int offset){
+	if( profile_cacheable and profile_key.matches(previous_str , mismatch_list , offset) ){
+		return;
+	}
+	if(profile_cacheable){
+		profile_key.assign(previous_str , mismatch_list , offset);
+	}
+	else{
+		profile_key.invalidate();
+	}
+	profile_entries.assign(distance(int_value_and_index.begin() , int_value_and_index.end()) , Deletion_profile_entry());
+	profile_nucleotides.clear();
+	profile_mismatches.clear();
+}
+
+/**
+ * Set mismatches_vector and return the deleted (or palindrome extended) upstream sequence for the realization at the given position.
+ * new_offset is the offset of the deleted side after the deletion and offset the one before.
+ * If check_read_bounds palindromic nucleotides outside the read are not compared to it (D gene)
+ */
+Int_Str_view Deletion::apply_deletion_profile(size_t position , int deletion , int new_offset , int offset , const Int_Str_view& previous_str , const vector<int>& mismatch_list , const Int_Str& int_sequence , bool check_read_bounds){
+	Deletion_profile_entry& entry = profile_entries[position];
+	const bool three_prime = (this->event_side == Three_prime);
+
+	if(not entry.computed){
+		if(deletion >= 0){
+			//Discard irrelevant mismatches (assuming the vector of mismatches is ordered) given the number of deletions
+			if(!mismatch_list.empty()){
+				end_reached = false;
+				if(three_prime){
+					vector<int>::const_iterator mis_iter = mismatch_list.end();
+					mis_iter--;
+					while((*mis_iter)>new_offset){
+						if( mis_iter == mismatch_list.begin()){
+							end_reached = true;
+							break;
+						}
+						else{
+							--mis_iter;
+						}
+					}
+					entry.kept_first = 0;
+					entry.kept_last = end_reached ? 0 : (mis_iter - mismatch_list.begin()) + 1;
+				}
+				else{
+					vector<int>::const_iterator mis_iter = mismatch_list.begin();
+					while( (*mis_iter)< new_offset ){
+						++mis_iter;
+						if(mis_iter==mismatch_list.end()){
+							end_reached = true;
+							break;
+						}
+					}
+					entry.kept_first = end_reached ? 0 : mis_iter - mismatch_list.begin();
+					entry.kept_last = end_reached ? 0 : mismatch_list.size();
+				}
+			}
+		}
+		else{
+			//Palindromic insertion: reversed complement of the last (3') or first (5') nucleotides
+			const int palindrome_length = -deletion;
+			tmp_str.assign( three_prime ? previous_str.end() - palindrome_length : previous_str.begin() , three_prime ? previous_str.end() : previous_str.begin() + palindrome_length);
+			reverse(tmp_str.begin() , tmp_str.end());
+			make_transversions(tmp_str);
+			entry.palindrome_first = profile_nucleotides.size();
+			profile_nucleotides.insert(profile_nucleotides.end() , tmp_str.begin() , tmp_str.end());
+			entry.palindrome_last = profile_nucleotides.size();
+
+			//Count mismatches of the palindromic nucleotides
+			entry.extra_first = profile_mismatches.size();
+			if(three_prime){
+				entry.kept_first = 0;
+				entry.kept_last = mismatch_list.size();
+			}
+			else{
+				//5' palindromic nucleotides come before the gene, the whole list is stored sorted
+				profile_mismatches.insert(profile_mismatches.end() , mismatch_list.begin() , mismatch_list.end());
+			}
+			const int first_read_position = three_prime ? offset + 1 : new_offset;
+			for(int i = 0 ; i != palindrome_length ; ++i ){
+				const int read_position = first_read_position + i;
+				if( check_read_bounds and ( (read_position < 0) or (read_position >= (int) int_sequence.size()) ) ){
+					continue;
+				}
+				if(not comp_nt_int(tmp_str[i] , int_sequence.at(read_position))){
+					profile_mismatches.push_back(read_position);
+				}
+			}
+			if(not three_prime){
+				sort(profile_mismatches.begin() + entry.extra_first , profile_mismatches.end());
+			}
+			entry.extra_last = profile_mismatches.size();
+		}
+		entry.computed = true;
+	}
+
+	mismatches_vector.assign(mismatch_list.begin() + entry.kept_first , mismatch_list.begin() + entry.kept_last);
+	mismatches_vector.insert(mismatches_vector.end() , profile_mismatches.begin() + entry.extra_first , profile_mismatches.begin() + entry.extra_last);
+
+	//Deleted sequences are slices of the upstream sequence, only palindromic insertions need to be written (without reallocating)
+	if(deletion >= 0){
+		return three_prime ? previous_str.substr(0 , previous_str.size() - deletion) : previous_str.substr(deletion);
+	}
+	if(three_prime){
+		new_str.assign(previous_str.begin() , previous_str.end());
+		new_str.insert(new_str.end() , profile_nucleotides.begin() + entry.palindrome_first , profile_nucleotides.begin() + entry.palindrome_last);
+	}
+	else{
+		new_str.assign(profile_nucleotides.begin() + entry.palindrome_first , profile_nucleotides.begin() + entry.palindrome_last);
+		new_str.insert(new_str.end() , previous_str.begin() , previous_str.end());
+	}
+	return new_str;
+}
+
  void Deletion::add_to_marginals(long double scenario_proba , Marginal_array_p& updated_marginals) const{
  	if(viterbi_run){
  		 updated_marginals[this->new_index]=scenario_proba;
@@ -1685,6 +1553,7 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
  	else{
  		 updated_marginals[this->new_index]+=scenario_proba;
  	}
+ 	record_touched_marginal(this->new_index);
  }
 
 
@@ -1806,13 +1675,14 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 	 case D_gene:
 		 switch(this->event_side){
 
+		 //D deletions also shorten the VJ junction of a VDJ model that goes through the D gene
 		 case Five_prime:
-			 if(seq_type==VD_ins_seq) return true;
+			 if(seq_type==VD_ins_seq or seq_type==VJ_ins_seq) return true;
 			 else return false;
 			 break;
 
 		 case Three_prime:
-			 if(seq_type==DJ_ins_seq) return true;
+			 if(seq_type==DJ_ins_seq or seq_type==VJ_ins_seq) return true;
 			 else return false;
 			 break;
 		 }
@@ -1835,32 +1705,15 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
  void Deletion::iterate_initialize_Len_proba(Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  std::queue<std::shared_ptr<Rec_Event>>& model_queue , double& scenario_proba , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int& seq_len/*=0*/ ) const{
 
 	 if(this->has_effect_on(considered_junction)){
-		base_index = base_index_map.at(this->event_index,0);
+		const size_t len_base_index = base_index_map.at(this->event_index,0);
+		//Length shift and max proba (in case the event is child of another) of each realization
+		vector<pair<int,double>> length_shifts;
+		length_shifts.reserve(this->event_realizations.size());
 		for(unordered_map <string, Event_realization>::const_iterator iter = this->event_realizations.begin() ; iter!= this->event_realizations.end() ; ++iter){
-
-	/*		//Update base index map
-			for(forward_list<tuple<int,int,int>>::const_iterator jiter = memory_and_offsets.begin() ; jiter!=memory_and_offsets.end() ; ++jiter){
-				//Get previous index for the considered event
-				int previous_index = base_index_map.at(get<0>(*jiter),get<1>(*jiter)-1);
-				//Update the index given the realization and the offset
-				previous_index += iter->second.index *get<2>(*jiter);
-				//Set the value
-				base_index_map.set_value(get<0>(*jiter) , previous_index , get<1>(*jiter));
-			}*/
-
-
-
-			//Get the max proba for this realization (in case the event is child of another)
-			double real_max_proba = 0;
-			for(size_t i = 0 ; i!=this->event_marginal_size/this->size() ; ++i){
-				if(model_parameters_point[base_index + (*iter).second.index + i*this->size()]>real_max_proba){
-					real_max_proba = model_parameters_point[base_index + (*iter).second.index + i*this->size()];
-				}
-			}
-			//Update the length and the probability in the recursive call
-			Rec_Event::iterate_initialize_Len_proba_wrap_up(considered_junction , length_best_proba_map ,  model_queue ,  scenario_proba*real_max_proba , model_parameters_point , base_index_map , constructed_sequences , seq_len -(*iter).second.value_int);
-
+			length_shifts.emplace_back(-(*iter).second.value_int , get_len_proba_realization_bound(len_base_index , (*iter).second.index , model_parameters_point));
 		}
+		//Deletions do not change the constructed sequences, the downstream events are explored once
+		Rec_Event::iterate_initialize_Len_proba_shifts(considered_junction , length_best_proba_map , model_queue , scenario_proba , length_shifts , model_parameters_point , base_index_map , constructed_sequences , seq_len);
 	}
 	else{
 		Rec_Event::iterate_initialize_Len_proba_wrap_up(considered_junction , length_best_proba_map ,  model_queue ,  scenario_proba , model_parameters_point , base_index_map , constructed_sequences , seq_len);
@@ -1872,16 +1725,18 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 	 switch(this->event_class){
 	 case V_gene:
 			vd_length_best_proba_map.clear();
+			vd_length_proba_bounds.clear();
 			vj_length_best_proba_map.clear();
+			vj_length_proba_bounds.clear();
 
 
 			if(d_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				vd_length_proba_bounds.initialize(VD_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 			else if(j_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				vj_length_proba_bounds.initialize(VJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 		 break;
 
@@ -1891,17 +1746,19 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 		 case Five_prime:
 				vd_length_best_proba_map.clear();
+				vd_length_proba_bounds.clear();
 				if(v_chosen){
-					double init_proba = 1.0;
-					this->Rec_Event::iterate_initialize_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+					this->initialize_downstream_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+					vd_length_proba_bounds.initialize(VD_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 				}
 			 break;
 
 		 case Three_prime:
 				dj_length_best_proba_map.clear();
+				dj_length_proba_bounds.clear();
 				if(j_chosen){
-					double init_proba = 1.0;
-					this->Rec_Event::iterate_initialize_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+					this->initialize_downstream_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+					dj_length_proba_bounds.initialize(DJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 				}
 			 break;
 		 }
@@ -1909,15 +1766,17 @@ void Deletion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_
 
 	 case J_gene:
 			dj_length_best_proba_map.clear();
+			dj_length_proba_bounds.clear();
 			vj_length_best_proba_map.clear();
+			vj_length_proba_bounds.clear();
 
 			if(d_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				dj_length_proba_bounds.initialize(DJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 			else if(v_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				vj_length_proba_bounds.initialize(VJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 		 break;
 
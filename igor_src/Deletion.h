@@ -38,6 +38,34 @@
 #include <random>
 #include <math.h>
 
+/**
+ * \struct Deletion_profile_key Deletion.h
+ * \brief Identifies the upstream sequence a deletion profile was computed for.
+ *
+ * The upstream sequence is identified by the mismatch list of its alignment, its template sequence and its offset.
+ * A mismatch list alone is not enough: when a read has no D alignment the D gene choice explores every D template
+ * with the same mismatch list, and two D templates of equal length can be placed at the same offset.
+ * The gene choice events view the templates in place, the template is thus identified by the viewed data and length.
+ */
+struct Deletion_profile_key{
+	Deletion_profile_key(): mismatch_list(nullptr) , str_data(nullptr) , str_size(0) , offset(INT16_MAX){}
+	bool matches(const Int_Str_view& str , const std::vector<int>& mismatch_list , int offset) const{
+		return (this->mismatch_list == &mismatch_list) and (str_data == str.data()) and (str_size == str.size()) and (this->offset == offset);
+	}
+	void assign(const Int_Str_view& str , const std::vector<int>& mismatch_list , int offset){
+		this->mismatch_list = &mismatch_list;
+		str_data = str.data();
+		str_size = str.size();
+		this->offset = offset;
+	}
+	void invalidate(){mismatch_list = nullptr;}
+
+	const std::vector<int>* mismatch_list;
+	const int* str_data;
+	std::size_t str_size;
+	int offset;
+};
+
 /**
  * \class Deletion Deletion.h
  * \brief Deletion recombination event
@@ -68,12 +96,14 @@ public:
 	//Virtual methods
 	std::shared_ptr<Rec_Event> copy();
 
-	inline void iterate(double& , Downstream_scenario_proba_bound_map& , const std::string& , const Int_Str& , Index_map& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::shared_ptr<Next_event_ptr>& , Marginal_array_p& , const Marginal_array_p& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , Seq_type_str_p_map& , Seq_offsets_map& , std::shared_ptr<Error_rate>& , std::map<size_t,std::shared_ptr<Counter>>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>> & , Safety_bool_map& , Mismatch_vectors_map& , double& , double&);
+	void iterate(double& , Scenario_context&);
 	void add_realization(int);
 	std::queue<int> draw_random_realization( const Marginal_array_p& , std::unordered_map<Rec_Event_name,int>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::unordered_map<Seq_type , std::string>& , std::mt19937_64&)const;
 	void write2txt(std::ofstream&);
 	void initialize_event( std::unordered_set<Rec_Event_name>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , Downstream_scenario_proba_bound_map& , Seq_type_str_p_map&  , Safety_bool_map& , std::shared_ptr<Error_rate> , Mismatch_vectors_map&,Seq_offsets_map&,Index_map&);
 	void add_to_marginals(long double , Marginal_array_p&) const;
+	void append_scenario_factors(std::vector<int>& factors) const{factors.push_back(new_index);} //Model parameter used by the current scenario (see Scenario_skeleton_cache)
+	void initialize_sequence_tables(){profile_key.invalidate();} //Invalidate the deletion profiles of the previous read (see Scenario_engine::explore())
 
 
 
@@ -86,6 +116,8 @@ public:
 
 private:
 	inline void iterate_common( std::forward_list<Event_realization>::const_iterator& , Index_map& ,const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>&  ,const Marginal_array_p& );
+	void prepare_deletion_profile(const Int_Str_view& , const std::vector<int>& , int);
+	inline Int_Str_view apply_deletion_profile(size_t , int , int , int , const Int_Str_view& , const std::vector<int>& , const Int_Str& , bool);
 
 	std::forward_list<Event_realization> int_value_and_index;
 
@@ -150,7 +182,8 @@ private:
 	double proba_contribution;
 	int new_index;
 	//Int_Str previous_str;//&
-	mutable Int_Str new_str;
+	mutable Int_Str new_str; //Only written for palindromic insertions
+	Int_Str_view deleted_str;
 	mutable Int_Str tmp_str;
 	mutable std::string gen_new_str;
 	mutable std::string gen_tmp_str;
@@ -181,10 +214,36 @@ private:
 	//Iterate common
 	int previous_marginal_index;
 
+	/*
+	 * Deletion profile of the upstream gene sequence: for each realization (in int_value_and_index order) the range of the upstream mismatch list
+	 * that is kept and, for palindromic insertions, the inserted nucleotides and their mismatches.
+	 * Entries are filled the first time a realization is reached. When the upstream sequence is the one of the gene alignment (all but the second D deletion)
+	 * the profile is kept as long as the same alignment (see Deletion_profile_key) is explored for the current read.
+	 */
+	struct Deletion_profile_entry{
+		Deletion_profile_entry(): computed(false) , kept_first(0) , kept_last(0) , palindrome_first(0) , palindrome_last(0) , extra_first(0) , extra_last(0){}
+		bool computed;
+		int kept_first; //Range of the upstream mismatch list
+		int kept_last;
+		int palindrome_first; //Range of profile_nucleotides
+		int palindrome_last;
+		int extra_first; //Range of profile_mismatches appended to the kept mismatches
+		int extra_last;
+	};
+	bool profile_cacheable;
+	Deletion_profile_key profile_key;
+	std::vector<Deletion_profile_entry> profile_entries;
+	std::vector<int> profile_nucleotides;
+	std::vector<int> profile_mismatches;
+
 	//Downstream junction length proba bounds
 		std::map<int,double> vd_length_best_proba_map;
 		std::map<int,double> vj_length_best_proba_map;
 		std::map<int,double> dj_length_best_proba_map;
+	//Downstream junction length proba bounds given the realizations of the parents of the downstream events
+		Conditional_length_proba_bounds vd_length_proba_bounds;
+		Conditional_length_proba_bounds vj_length_proba_bounds;
+		Conditional_length_proba_bounds dj_length_proba_bounds;
 };
 
 std::string& make_transversions(std::string& , bool);
@@ -24,10 +24,11 @@
  */
 
 #include "Dinuclmarkov.h"
+#include "Scenarioengine.h"
 
 using namespace std;
 
-Dinucl_markov::Dinucl_markov(Gene_class gene): Rec_Event()  ,  total_nucl_count(0) {
+Dinucl_markov::Dinucl_markov(Gene_class gene): Rec_Event() , max_vd_ins(0) , max_vj_ins(0) , max_dj_ins(0) , forward_stride(1) , backward_stride(1) , pending_weights(false) {
 	this->type = Event_type::Dinuclmarkov_t;
 	event_class = gene;
 	//Same indexes as Aligner::nt2int
@@ -48,7 +49,6 @@ Dinucl_markov::Dinucl_markov(Gene_class gene): Rec_Event()  ,  total_nucl_count(
 
 
 Dinucl_markov::~Dinucl_markov() {
-	// TODO delete realization indices
 	delete updated_upper_bound_proba;
 }
 
@@ -68,7 +68,13 @@ int Dinucl_markov::size()const{
 }
 
 
-void Dinucl_markov::iterate(double& scenario_proba , Downstream_scenario_proba_bound_map& downstream_proba_map , const string& sequence , const Int_Str& int_sequence , Index_map& base_index_map , const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map , shared_ptr<Next_event_ptr>& next_event_ptr_arr , Marginal_array_p& updated_marginals_point , const Marginal_array_p& model_parameters_point ,const unordered_map<Gene_class , vector<Alignment_data>>& allowed_realizations , Seq_type_str_p_map& constructed_sequences , Seq_offsets_map& seq_offsets ,shared_ptr<Error_rate>& error_rate_p, map<size_t,shared_ptr<Counter>>& counters_list , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , Safety_bool_map& safety_set , Mismatch_vectors_map& mismatches_lists, double& seq_max_prob_scenario , double& proba_threshold_factor){
+void Dinucl_markov::iterate(double& scenario_proba , Scenario_context& context){
+	Downstream_scenario_proba_bound_map& downstream_proba_map = context.downstream_proba_map;
+	const Int_Str& int_sequence = context.int_sequence;
+	Index_map& base_index_map = context.index_map;
+	const Marginal_array_p& model_parameters_point = context.model_parameters;
+	Seq_type_str_p_map& constructed_sequences = context.constructed_sequences;
+	Seq_offsets_map& seq_offsets = context.seq_offsets;
 	base_index = base_index_map.at(this->event_index);
 	new_scenario_proba = scenario_proba;
 	proba_contribution = 1;
@@ -81,66 +87,27 @@ void Dinucl_markov::iterate(double& scenario_proba , Downstream_scenario_proba_b
 	//For now do not include possible sequencing error
 	if(event_class == VD_genes || event_class == VDJ_genes){
 		correct_class = 1;
-		previous_seq = (*constructed_sequences.at(V_gene_seq));
-		Int_Str& vd_seq = (*constructed_sequences.at(VD_ins_seq));
-		vd_seq_size = vd_seq.size();
-		previous_seq_size = previous_seq.size();
-		//data_seq_substr = sequence.substr(seq_offsets.at(pair<Seq_type,Seq_side>(V_gene_seq,Five_prime)) + previous_seq_size , vd_seq.size());
-		//data_seq_substr = sequence.substr(seq_offsets.at(v_5_pair) + previous_seq_size , vd_seq.size());//TODO check this
-		//data_seq_substr = int_sequence.substr(seq_offsets.at(v_5_pair) + previous_seq_size , vd_seq.size());
-		data_seq_substr = int_sequence.substr(seq_offsets.at(V_gene_seq,Five_prime) + previous_seq_size , vd_seq.size()); //FIXME use precomputed vd seq size
-
-		previous_nt_str = previous_seq.back();
-		iterate_common( vd_realizations_indices , previous_nt_str  , vd_seq , model_parameters_point);
+		const Int_Str_view& v_seq = constructed_sequences.at(V_gene_seq);
+		Int_Str_view& vd_seq = constructed_sequences.at(VD_ins_seq);
+		vd_segment.anchor = seq_offsets.at(V_gene_seq,Five_prime) + v_seq.size();
+		iterate_segment(vd_segment , v_seq.back() , false , vd_seq , int_sequence , model_parameters_point);
 		downstream_proba_map.set_value(VD_ins_seq,1.0,memory_layer_proba_map_junction_1);
-		//constructed_sequences.at(VD_ins_seq) = &vd_seq;
-
 	}
 	if(event_class == DJ_genes || event_class == VDJ_genes){
 		correct_class = 1;
-/*		//TODO check the side taken into account for the first nucleotide
-		string d_seq = constructed_sequences.at(D_gene_seq);
-		size_t d_seq_size = d_seq.size();
-
-		size_t char_index = seq_offsets.at(pair<Seq_type,Seq_side>(V_gene_seq,Five_prime)) + constructed_sequences.at(V_gene_seq).size() + constructed_sequences.at(VD_ins_seq).size() + d_seq_size ;//TODO rewrite this and once deletion mechanism has been rewritten
-		string data_seq_substr = sequence.substr(char_index , constructed_sequences.at(DJ_ins_seq).size());
-		new_scenario_proba = iterate_common(new_scenario_proba , prev_seq.substr(prev_seq_size-1,1) , data_seq_substr , constructed_sequences.at(DJ_ins_seq) , base_index , write_index_list , model_parameters_point);
-		*/
-		previous_seq = (*constructed_sequences.at(J_gene_seq));
-		Int_Str& dj_seq = (*constructed_sequences.at(DJ_ins_seq));
-		dj_seq_size = dj_seq.size();
-		//string& constr_ins_seq = constructed_sequences.at(DJ_ins_seq);
-
-		//size_t char_index = seq_offsets.at(pair<Seq_type,Seq_side>(J_gene_seq,Five_prime)) -dj_seq.size();
-		//size_t char_index = seq_offsets.at(j_5_pair) -dj_seq.size();
-		size_t char_index = seq_offsets.at(J_gene_seq,Five_prime) -dj_seq.size();
-
-		//data_seq_substr = sequence.substr(char_index , dj_seq.size());
-		data_seq_substr = int_sequence.substr(char_index , dj_seq.size());
-
-
-		previous_nt_str = previous_seq.front();
-		reverse(data_seq_substr.begin(),data_seq_substr.end());
-		iterate_common( dj_realizations_indices , previous_nt_str , dj_seq , model_parameters_point);
-		reverse(dj_seq.begin(),dj_seq.end());
-
+		//The DJ insertion is read from the J side
+		const Int_Str_view& j_seq = constructed_sequences.at(J_gene_seq);
+		Int_Str_view& dj_seq = constructed_sequences.at(DJ_ins_seq);
+		dj_segment.anchor = seq_offsets.at(J_gene_seq,Five_prime) - 1;
+		iterate_segment(dj_segment , j_seq.front() , true , dj_seq , int_sequence , model_parameters_point);
 		downstream_proba_map.set_value(DJ_ins_seq,1.0,memory_layer_proba_map_junction_2);
-
 	}
 	if(event_class == VJ_genes){
 		correct_class = 1;
-		previous_seq = (*constructed_sequences.at(V_gene_seq));
-		Int_Str& vj_seq = (*constructed_sequences.at(VJ_ins_seq));
-		vj_seq_size = vj_seq.size();
-		previous_seq_size = previous_seq.size();
-		//data_seq_substr = sequence.substr(seq_offsets.at(v_5_pair) + previous_seq_size , vj_seq.size());
-		//data_seq_substr = int_sequence.substr(seq_offsets.at(v_5_pair) + previous_seq_size , vj_seq.size());
-		data_seq_substr = int_sequence.substr(seq_offsets.at(V_gene_seq,Five_prime) + previous_seq_size , vj_seq.size());
-
-
-		previous_nt_str = previous_seq.back();
-		iterate_common( vj_realizations_indices , previous_nt_str , vj_seq , model_parameters_point);
-
+		const Int_Str_view& v_seq = constructed_sequences.at(V_gene_seq);
+		Int_Str_view& vj_seq = constructed_sequences.at(VJ_ins_seq);
+		vj_segment.anchor = seq_offsets.at(V_gene_seq,Five_prime) + v_seq.size();
+		iterate_segment(vj_segment , v_seq.back() , false , vj_seq , int_sequence , model_parameters_point);
 		downstream_proba_map.set_value(VJ_ins_seq,1.0,memory_layer_proba_map_junction_1);
 	}
 	if(!correct_class){
@@ -154,8 +121,8 @@ void Dinucl_markov::iterate(double& scenario_proba , Downstream_scenario_proba_b
 	//Multiply all downstream probas
 	downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
-	if(scenario_upper_bound_proba>=(seq_max_prob_scenario*proba_threshold_factor)){
-		iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_point  , model_parameters_point , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists ,seq_max_prob_scenario , proba_threshold_factor);
+	if(not context.is_pruned(scenario_upper_bound_proba)){
+		iterate_wrap_up(new_scenario_proba , context);
 	}
 }
 
@@ -286,80 +253,117 @@ void Dinucl_markov::write2txt(ofstream& outfile){
 }
 
 
-void Dinucl_markov::iterate_common( int* indices_array , int& previous_assigned_nt  , Int_Str& ins_seq , const Marginal_array_p& model_parameters_point){
-
-	if(!ins_seq.empty()){
-		if(ins_seq.at(0)==-1){
-
-
-			//first_nt_index = event_realizations.at(previous_assigned_nt).index;
-			//sec_nt_index = event_realizations.at(data_seq_substr.substr(0,1)).index;
-
-			first_nt_index = previous_assigned_nt;//[0] -'0';
-			sec_nt_index = data_seq_substr[0] ;//-'0';
-
-			current_realizations_index_vec.emplace_back( sec_nt_index );
+/*
+ * Offset of the transition from the marginal base index, or the ambiguous_transition_code if one of the nucleotides is ambiguous
+ */
+int Dinucl_markov::transition_code(int first_nt , int second_nt) const{
+	if((first_nt<4) & (second_nt<4)){
+		return first_nt*4 + second_nt;
+	}
+	else{
+		return ambiguous_transition_code(first_nt , second_nt);
+	}
+}
 
-			//For this Dinucl_Markov model the values on the marginal array represents the conditional probability of a couple of nucleotides (N2 | N1)
-			if((first_nt_index<4) & (sec_nt_index<4)){
-				offset =  first_nt_index*event_realizations.size();
-				realization_final_index = base_index + offset + sec_nt_index;
-				proba_contribution*= model_parameters_point[realization_final_index];///compute_nt_freq(base_index+offset , model_parameters_point);
-				indices_array[0] = realization_final_index;
-			}
-			else{
-				//If an ambiguous nucleotide is present we take the average probability over possible underlying nts
-				proba_contribution*=dinuc_proba_matrix(first_nt_index,sec_nt_index);
-				indices_array[0] = -1;
-			}
+/*
+ * For this Dinucl_Markov model the values on the marginal array represents the conditional probability of a couple of nucleotides (N2 | N1)
+ * If an ambiguous nucleotide is present we take the average probability over possible underlying nts
+ */
+double Dinucl_markov::transition_proba(int code , const Marginal_array_p& model_parameters_point) const{
+	if(code>=0){
+		return model_parameters_point[base_index + code];
+	}
+	else{
+		return dinuc_proba_matrix((-1-code)/16 , (-1-code)%16);
+	}
+}
 
-			ins_seq.at(0) = data_seq_substr.at(0);
-			total_nucl_count+=1;
+/*
+ * Fill the transition codes of the read in one direction and the products of the transitions inside each segment of at most stride-1 nucleotides
+ */
+void Dinucl_markov::build_transition_tables(const Int_Str& int_sequence , bool backward , int stride , const Marginal_array_p& model_parameters_point , vector<int>& transitions , vector<double>& products) const{
+	const int seq_len = int_sequence.size();
+	transitions.assign(seq_len , 0);
+	products.assign(seq_len*stride , 0.0);
+	for(int position = 0 ; position != seq_len ; ++position){
+		const int previous_position = backward ? position + 1 : position - 1;
+		if( (previous_position >= 0) and (previous_position < seq_len) ){
+			transitions[position] = transition_code(int_sequence[previous_position] , int_sequence[position]);
 		}
-
-
-		for(size_t i = 1 ; i!= ins_seq.size() ; ++i){
-			if(ins_seq.at(i)==-1){
-
-				//first_nt_index = event_realizations.at(data_seq_substr.substr(i-1,1)).index;
-				//sec_nt_index = event_realizations.at(data_seq_substr.substr(i,1)).index;
-
-				first_nt_index = data_seq_substr[i-1];// -'0';
-				sec_nt_index = data_seq_substr[i];// -'0';
-
-				current_realizations_index_vec.emplace_back( sec_nt_index );
-
-				//For this Dinucl_Markov model the values on the marginal array represents the joint probability of a couple of nucleotides (N1 , N2)
-				if((first_nt_index<4) & (sec_nt_index<4)){
-					offset =  first_nt_index*event_realizations.size();
-					realization_final_index = base_index + offset + sec_nt_index;
-					proba_contribution*= model_parameters_point[base_index + offset + sec_nt_index];///compute_nt_freq(base_index+offset , model_parameters_point);
-					indices_array[i] = realization_final_index;
-				}
-				else{
-					//If an ambiguous nucleotide is present we take the average probability over possible underlying nts
-					proba_contribution*=dinuc_proba_matrix(first_nt_index,sec_nt_index);
-					indices_array[i] = -1;
-				}
-
-				ins_seq.at(i) = data_seq_substr.at(i);
-				total_nucl_count+=1;
+	}
+	for(int anchor = 0 ; anchor != seq_len ; ++anchor){
+		double* anchor_products = &products[anchor*stride];
+		anchor_products[0] = 1;
+		if(stride>1){
+			anchor_products[1] = 1;
+		}
+		for(int length = 2 ; length < stride ; ++length){
+			const int position = backward ? anchor - length + 1 : anchor + length - 1;
+			if( (position < 0) or (position >= seq_len) ){
+				break;
 			}
+			anchor_products[length] = anchor_products[length-1]*transition_proba(transitions[position] , model_parameters_point);
 		}
 	}
+}
 
+/**
+ * Build the per read transition tables, must be called before exploring the scenarios of a new read with the same model parameters.
+ * The tables assume the event has no parent (the marginal base index does not depend on the scenario), otherwise the segment probabilities are computed nucleotide by nucleotide.
+ */
+void Dinucl_markov::initialize_sequence_tables(const Int_Str& int_sequence , const Marginal_array_p& model_parameters_point){
+	base_index = unmutable_base_index;
+	if( (event_class == VD_genes) or (event_class == VDJ_genes) or (event_class == VJ_genes) ){
+		forward_stride = max(max_vd_ins , max_vj_ins) + 1;
+		build_transition_tables(int_sequence , false , forward_stride , model_parameters_point , forward_transitions , forward_products);
+		forward_weights.assign(forward_products.size() , 0.0);
+	}
+	if( (event_class == DJ_genes) or (event_class == VDJ_genes) ){
+		backward_stride = max_dj_ins + 1;
+		build_transition_tables(int_sequence , true , backward_stride , model_parameters_point , backward_transitions , backward_products);
+		backward_weights.assign(backward_products.size() , 0.0);
+	}
+	pending_weights = false;
 }
 
+/*
+ * Transition code of the i-th inserted nucleotide of the segment (the first one depends on the templated nucleotide)
+ */
+int Dinucl_markov::segment_transition(const Inserted_segment& segment , bool backward , int i) const{
+	if(i==0){
+		return segment.first_transition;
+	}
+	return backward ? backward_transitions[segment.anchor - i] : forward_transitions[segment.anchor + i];
+}
 
 /*
- * This way of proceeding is highly not optimal, should be modified
+ * The inserted nucleotides are the read nucleotides, the contribution of all transitions but the first is read from the per read tables
  */
-double Dinucl_markov::compute_nt_freq(int index , const Marginal_array_p& model_marginals) const{
-	double nucl_freq = 0;
-	for(size_t i = 0 ; i != event_realizations.size() ; ++i){
-		nucl_freq+=model_marginals[index + i];
+void Dinucl_markov::iterate_segment(Inserted_segment& segment , int previous_nt , bool backward , Int_Str_view& ins_seq , const Int_Str& int_sequence , const Marginal_array_p& model_parameters_point){
+	segment.length = ins_seq.size();
+	if(segment.length == 0){
+		return;
+	}
+	const int first_position = backward ? segment.anchor - segment.length + 1 : segment.anchor;
+	segment.first_transition = transition_code(previous_nt , int_sequence[segment.anchor]);
+	proba_contribution *= transition_proba(segment.first_transition , model_parameters_point);
+	if(base_index == unmutable_base_index){
+		proba_contribution *= backward ? backward_products[segment.anchor*backward_stride + segment.length] : forward_products[segment.anchor*forward_stride + segment.length];
+	}
+	else{
+		for(int i = 1 ; i != segment.length ; ++i){
+			proba_contribution *= transition_proba(segment_transition(segment , backward , i) , model_parameters_point);
+		}
+	}
+
+	//The constructed sequence is always in the read direction and is a slice of the read
+	ins_seq = Int_Str_view(int_sequence).substr(first_position , segment.length);
+	if(backward){
+		current_realizations_index_vec.insert(current_realizations_index_vec.end() , ins_seq.rbegin() , ins_seq.rend());
+	}
+	else{
+		current_realizations_index_vec.insert(current_realizations_index_vec.end() , ins_seq.begin() , ins_seq.end());
 	}
-	return nucl_freq;
 }
 
 void Dinucl_markov::ind_normalize(Marginal_array_p& marginal_array_p , size_t base_index) const{
@@ -415,47 +419,124 @@ void Dinucl_markov::initialize_event( unordered_set<Rec_Event_name>& processed_e
 		memory_layer_proba_map_junction_1 = downstream_proba_map.get_current_memory_layer(VJ_ins_seq);
 	}
 
-	vd_realizations_indices = new int [max_vd_ins];
-	vj_realizations_indices = new int [max_vj_ins];
-	dj_realizations_indices = new int [max_dj_ins];
-
 	unmutable_base_index = index_map.at(this->event_index,0);
 
 	this->Rec_Event::initialize_event(processed_events,events_map,offset_map,downstream_proba_map,constructed_sequences,safety_set,error_rate_p,mismatches_list,seq_offsets,index_map);
 
 }
 
+/*
+ * Appends the transitions of the current scenario, ambiguous ones being appended as their (negative) ambiguous_transition_code
+ */
+void Dinucl_markov::append_scenario_factors(vector<int>& factors) const{
+	const Inserted_segment* segments[] = {&vd_segment , &dj_segment , &vj_segment};
+	const bool backward[] = {false , true , false};
+	const bool used[] = {(event_class == VD_genes) or (event_class == VDJ_genes) , (event_class == DJ_genes) or (event_class == VDJ_genes) , event_class == VJ_genes};
+	for(size_t s = 0 ; s != 3 ; ++s){
+		if(not used[s]) continue;
+		for(int i = 0 ; i != segments[s]->length ; ++i){
+			const int code = segment_transition(*segments[s] , backward[s] , i);
+			factors.push_back( (code>=0) ? base_index + code : code );
+		}
+	}
+}
+
+/*
+ * Only the first transition of a segment is directly added to the marginals, the weights of the others are accumulated per segment and
+ * pushed once per read by flush_sequence_marginals() (or immediately for Viterbi runs or if the base index is not the one the tables were built with)
+ */
+void Dinucl_markov::add_segment_to_marginals(const Inserted_segment& segment , bool backward , long double scenario_proba , Marginal_array_p& updated_marginals) const{
+	if(segment.length == 0){
+		return;
+	}
+	if(segment.first_transition>=0){
+		updated_marginals[base_index + segment.first_transition] += scenario_proba;
+		record_touched_marginal(base_index + segment.first_transition);
+	}
+	if(segment.length == 1){
+		return;
+	}
+	if( viterbi_run or (base_index != unmutable_base_index) ){
+		for(int i = 1 ; i != segment.length ; ++i){
+			const int code = segment_transition(segment , backward , i);
+			if(code>=0){
+				updated_marginals[base_index + code] += scenario_proba;
+				record_touched_marginal(base_index + code);
+			}
+		}
+	}
+	else{
+		if(backward){
+			backward_weights[segment.anchor*backward_stride + segment.length] += scenario_proba;
+		}
+		else{
+			forward_weights[segment.anchor*forward_stride + segment.length] += scenario_proba;
+		}
+		pending_weights = true;
+	}
+}
+
+/*
+ * A segment of length l anchored at a covers the transitions at distance 1..l-1 from the anchor:
+ * the weight of the transition at distance d is the sum of the weights of the segments longer than d
+ */
+void Dinucl_markov::flush_segment_weights(bool backward , Marginal_array_p& updated_marginals) const{
+	const int stride = backward ? backward_stride : forward_stride;
+	const vector<int>& transitions = backward ? backward_transitions : forward_transitions;
+	vector<long double>& weights = backward ? backward_weights : forward_weights;
+	const int seq_len = transitions.size();
+	for(int anchor = 0 ; anchor != seq_len ; ++anchor){
+		long double* anchor_weights = &weights[anchor*stride];
+		long double cumulated_weight = 0;
+		for(int length = stride-1 ; length >= 2 ; --length){
+			cumulated_weight += anchor_weights[length];
+			anchor_weights[length] = 0;
+			if(cumulated_weight == 0) continue;
+			const int position = backward ? anchor - length + 1 : anchor + length - 1;
+			if( (position >= 0) and (position < seq_len) and (transitions[position] >= 0) ){
+				updated_marginals[base_index + transitions[position]] += cumulated_weight;
+				record_touched_marginal(base_index + transitions[position]);
+			}
+		}
+	}
+}
+
+/**
+ * Add the weights accumulated for the read to the marginals, must be called after exploring the scenarios of a read
+ */
+void Dinucl_markov::flush_sequence_marginals(Marginal_array_p& updated_marginals) const{
+	if(not pending_weights){
+		return;
+	}
+	base_index = unmutable_base_index;
+	if( (event_class == VD_genes) or (event_class == VDJ_genes) or (event_class == VJ_genes) ){
+		flush_segment_weights(false , updated_marginals);
+	}
+	if( (event_class == DJ_genes) or (event_class == VDJ_genes) ){
+		flush_segment_weights(true , updated_marginals);
+	}
+	pending_weights = false;
+}
+
 /**
- * \bug Will only count realizations of unambiguous nucleotides (realization indices>=0 since they are set to -1 in iterate_common)
+ * \bug Will only count realizations of unambiguous nucleotides
  */
 void Dinucl_markov::add_to_marginals(long double scenario_proba , Marginal_array_p& updated_marginals) const{
 	if(viterbi_run){
 		for(size_t i=0 ; i!=this->event_marginal_size ; ++i){
 			updated_marginals[unmutable_base_index + i] = 0;
 		}
+		record_touched_marginal_range(unmutable_base_index , this->event_marginal_size);
 	}
 
-
 	if(event_class == VD_genes || event_class == VDJ_genes){
-		for(size_t i = 0 ; i != vd_seq_size ; ++i){
-			if(vd_realizations_indices[i]>=0){
-				updated_marginals[vd_realizations_indices[i]] +=scenario_proba;
-			}
-		}
+		add_segment_to_marginals(vd_segment , false , scenario_proba , updated_marginals);
 	}
 	if(event_class == DJ_genes || event_class == VDJ_genes){
-		for(size_t i = 0 ; i != dj_seq_size ; ++i){
-			if(dj_realizations_indices[i]>=0){
-				updated_marginals[dj_realizations_indices[i]] +=scenario_proba;
-			}
-		}
+		add_segment_to_marginals(dj_segment , true , scenario_proba , updated_marginals);
 	}
 	if(event_class == VJ_genes){
-		for(size_t i = 0 ; i != vj_seq_size ; ++i){
-			if(vj_realizations_indices[i]>=0){
-				updated_marginals[vj_realizations_indices[i]] +=scenario_proba;
-			}
-		}
+		add_segment_to_marginals(vj_segment , false , scenario_proba , updated_marginals);
 	}
 }
 
@@ -538,7 +619,7 @@ void Dinucl_markov::initialize_crude_scenario_proba_bound(double& downstream_pro
 		correct_class = 1;
 		if(this->has_effect_on(considered_junction)){
 			if(constructed_sequences.exist(VD_ins_seq)){
-				scenario_proba*=pow(this->get_upper_bound_proba(),constructed_sequences.at(VD_ins_seq)->size());
+				scenario_proba*=pow(this->get_upper_bound_proba(),constructed_sequences.at(VD_ins_seq).size());
 			}
 			//Otherwise the proba contribution is 1
 		}
@@ -547,7 +628,7 @@ void Dinucl_markov::initialize_crude_scenario_proba_bound(double& downstream_pro
 		correct_class = 1;
 		if(this->has_effect_on(considered_junction)){
 			if(constructed_sequences.exist(DJ_ins_seq)){
-				scenario_proba*=pow(this->get_upper_bound_proba(),constructed_sequences.at(DJ_ins_seq)->size());
+				scenario_proba*=pow(this->get_upper_bound_proba(),constructed_sequences.at(DJ_ins_seq).size());
 			}
 			//Otherwise the proba contribution is 1
 		}
@@ -556,7 +637,7 @@ void Dinucl_markov::initialize_crude_scenario_proba_bound(double& downstream_pro
 		correct_class = 1;
 		if(this->has_effect_on(considered_junction)){
 			if(constructed_sequences.exist(VJ_ins_seq)){
-				scenario_proba*=pow(this->get_upper_bound_proba(),constructed_sequences.at(VJ_ins_seq)->size());
+				scenario_proba*=pow(this->get_upper_bound_proba(),constructed_sequences.at(VJ_ins_seq).size());
 			}
 			//Otherwise the proba contribution is 1
 		}
@@ -40,6 +40,14 @@
 #include "Errorrate.h"
 #include <random>
 
+/*
+ * Transitions involving an ambiguous nucleotide have no marginal index, they are stored as a negative code in the realizations indices
+ * so that the transition can be recovered (see Scenario_skeleton_cache)
+ */
+inline int ambiguous_transition_code(int first_nt , int second_nt){
+	return -1 - (first_nt*16 + second_nt);
+}
+
 /**
  * \class Dinucl_markov Dinucl_markov.h
  * \brief Dinucleotide insertion Markov model.
@@ -62,17 +70,23 @@ public:
 	//Accessors
 	std::shared_ptr<Rec_Event> copy();
 	int size() const;
+	const Matrix<double>& get_dinuc_proba_matrix() const{return dinuc_proba_matrix;}
 
 
-	inline void iterate(double& , Downstream_scenario_proba_bound_map& , const std::string& , const Int_Str& , Index_map& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::shared_ptr<Next_event_ptr>& , Marginal_array_p& , const Marginal_array_p& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , Seq_type_str_p_map& , Seq_offsets_map& , std::shared_ptr<Error_rate>& , std::map<size_t,std::shared_ptr<Counter>>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>> & , Safety_bool_map& , Mismatch_vectors_map& , double& , double&);
+	void iterate(double& , Scenario_context&);
 	void add_realization(int);
 	std::queue<int> draw_random_realization( const Marginal_array_p& , std::unordered_map<Rec_Event_name,int>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::unordered_map<Seq_type , std::string>& , std::mt19937_64&)const;
 	void write2txt(std::ofstream&);
 	void ind_normalize(Marginal_array_p&,size_t) const;
 	void initialize_event( std::unordered_set<Rec_Event_name>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , Downstream_scenario_proba_bound_map& , Seq_type_str_p_map& , Safety_bool_map& , std::shared_ptr<Error_rate> , Mismatch_vectors_map&,Seq_offsets_map&,Index_map&);
 	void add_to_marginals(long double , Marginal_array_p&) const;
+	void append_scenario_factors(std::vector<int>&) const;
 	void update_event_internal_probas(const Marginal_array_p& , const std::unordered_map<Rec_Event_name,int>&);
 
+	//Per read tables (see Scenario_engine::explore())
+	void initialize_sequence_tables(const Int_Str& , const Marginal_array_p&);
+	void flush_sequence_marginals(Marginal_array_p&) const;
+
 
 	double* get_updated_ptr();
 	void initialize_crude_scenario_proba_bound(double& , std::forward_list<double*>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>&);
@@ -88,24 +102,41 @@ private:
 	double* updated_upper_bound_proba; //This points to a double modified by the Insertion event given the number of insertion
 	Matrix<double> dinuc_proba_matrix;
 
-	int total_nucl_count;
-	//Int_Str vd_seq;//&
+	/*
+	 * Inserted segments are substrings of the read, read from the V side (forward) for VD and VJ insertions and from the J side (backward) for DJ insertions.
+	 * anchor is the read position of the inserted nucleotide adjacent to the templated one (previous_nt).
+	 */
+	struct Inserted_segment{
+		Inserted_segment(): first_transition(0) , anchor(0) , length(0){}
+		int first_transition; //Transition code from the templated nucleotide to the first inserted one
+		int anchor;
+		int length;
+	};
+
 	int max_vd_ins;
-	int* vd_realizations_indices;
-	size_t vd_seq_size;
-	//Int_Str vj_seq;//&
 	int max_vj_ins;
-	int* vj_realizations_indices;
-	size_t vj_seq_size;
-	//Int_Str dj_seq;//&
 	int max_dj_ins;
-	int* dj_realizations_indices;
-	size_t dj_seq_size;
-
-	Int_Str previous_seq;//&
-	size_t previous_seq_size;
-	int previous_nt_str;
-	Int_Str data_seq_substr;
+	Inserted_segment vd_segment;
+	Inserted_segment dj_segment;
+	Inserted_segment vj_segment;
+
+	/*
+	 * Per read tables:
+	 * - transition code of the couple of nucleotides (position-1 , position) in the forward direction and (position+1 , position) in the backward direction:
+	 *   first_nt*4 + second_nt (offset from the event base index) or the (negative) ambiguous_transition_code
+	 * - product of the probabilities of the transitions inside a segment indexed by [anchor*stride + length]
+	 *   (excluding the first transition that depends on the templated nucleotide)
+	 * - weights of the scenarios accepted for each segment, pushed to the marginals at the end of the sequence
+	 */
+	int forward_stride;
+	int backward_stride;
+	std::vector<int> forward_transitions;
+	std::vector<int> backward_transitions;
+	std::vector<double> forward_products;
+	std::vector<double> backward_products;
+	mutable std::vector<long double> forward_weights;
+	mutable std::vector<long double> backward_weights;
+	mutable bool pending_weights;
 
 	mutable int base_index;
 	int unmutable_base_index;
@@ -116,21 +147,14 @@ private:
 	int memory_layer_proba_map_junction_1;
 	int memory_layer_proba_map_junction_2;
 
-
-	//std::pair<Seq_type,Seq_side> v_5_pair = std::make_pair (V_gene_seq,Five_prime);
-	//std::pair<Seq_type,Seq_side> j_5_pair = std::make_pair (J_gene_seq,Five_prime);
-
-	//Iterate common
-	int first_nt_index;
-	int sec_nt_index;
-	int offset;
-	int realization_final_index;
-
-
-
-	inline void iterate_common( int* , int& , Int_Str& , const Marginal_array_p&);
+	inline int transition_code(int , int) const;
+	inline double transition_proba(int , const Marginal_array_p&) const;
+	void build_transition_tables(const Int_Str& , bool , int , const Marginal_array_p& , std::vector<int>& , std::vector<double>&) const;
+	inline void iterate_segment(Inserted_segment& , int , bool , Int_Str_view& , const Int_Str& , const Marginal_array_p&);
+	inline int segment_transition(const Inserted_segment& , bool , int) const;
+	inline void add_segment_to_marginals(const Inserted_segment& , bool , long double , Marginal_array_p&) const;
+	void flush_segment_weights(bool , Marginal_array_p&) const;
 	inline std::queue<int> draw_random_common(const std::string& , std::string& , const Marginal_array_p& , int , std::uniform_real_distribution<double>& , std::mt19937_64&) const;
-	inline double compute_nt_freq( int , const Marginal_array_p&) const;
 
 };
 
@@ -57,6 +57,37 @@ void Error_rate::norm_weights_by_seq_likelihood(Marginal_array_p& single_seq_mar
 	}
 }
 
+/**
+ * Sparse counterpart of the above, only normalizes the entries recorded in touched_indices (all other entries are assumed to be 0)
+ */
+void Error_rate::norm_weights_by_seq_likelihood(Marginal_array_p& single_seq_marginal_array , const Touched_marginals_indices& touched_indices , const double seq_weight/*=1 by default*/){
+	const vector<size_t>& indices = touched_indices.get_indices();
+	if(seq_likelihood!=0){
+		for(vector<size_t>::const_iterator iter = indices.begin() ; iter != indices.end() ; ++iter){
+			single_seq_marginal_array[*iter]/=this->seq_likelihood*seq_weight;
+		}
+	}
+	else{
+		for(vector<size_t>::const_iterator iter = indices.begin() ; iter != indices.end() ; ++iter){
+			single_seq_marginal_array[*iter]=0;
+		}
+	}
+}
+
+/*
+ * Adds the sequence specific counters of another error rate of the same type
+ * Used to merge the explorations of disjoint parts of the alignments of one sequence, derived classes add their own counters
+ */
+void Error_rate::add_seq_counters(const Error_rate& err_r){
+	if(this->type() != err_r.type()){
+		throw invalid_argument("Cannot add sequence counters of error rates of different types: " + this->type() + " and " + err_r.type());
+	}
+	seq_likelihood += err_r.seq_likelihood;
+	seq_probability += err_r.seq_probability;
+	seq_mean_error_number += err_r.seq_mean_error_number;
+	debug_number_scenarios += err_r.debug_number_scenarios;
+}
+
 double Error_rate::get_seq_mean_error_number() const{
 	if(seq_likelihood!=0){
 		return seq_mean_error_number/seq_likelihood;
@@ -29,7 +29,7 @@
 
 using namespace std;
 
-GenModel::GenModel(const Model_Parms& parms, const Model_marginals& marginals, const map<size_t,shared_ptr<Counter>>& count_list): model_parms(parms) , model_marginals(marginals) , counters_list(count_list){}
+GenModel::GenModel(const Model_Parms& parms, const Model_marginals& marginals, const map<size_t,shared_ptr<Counter>>& count_list): model_parms(parms) , model_marginals(marginals) , counters_list(count_list) , junction_dp(false) , skeleton_cache_memory(0) , skeleton_reexplore_period(0) , scenario_ordering(Alignment_order) , greedy_seed_pass(false) , read_proba_bounds(true) , generic_scenario_engine(false) , split_chunk_alignments(0) , seq_max_explored_branches(0) , seq_max_seconds(0){}
 
 GenModel::GenModel(const Model_Parms& parms, const Model_marginals& marginals):GenModel(parms , marginals , map<size_t,shared_ptr<Counter>>()){}
 
@@ -50,6 +50,29 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 }
 
 bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>>& sequences ,const  int iterations ,const string path , bool fast_iter/*=true*/ ,double likelihood_threshold/*=1e-25 by default*/ , bool viterbi_like/*=false*/ , double proba_threshold_factor/*=0.001 by default*/ , double mean_number_seq_err_thresh /*= INFINITY by default*/){
+	return this->run_inference(&sequences , NULL , iterations , path , fast_iter , likelihood_threshold , viterbi_like , proba_threshold_factor , mean_number_seq_err_thresh);
+}
+
+/*
+ * Evaluates sequences (single iteration without fast first iteration) as they are popped from the queue
+ * This is used by the fused align/evaluate pipeline such that alignments never need to be written or held entirely in memory
+ */
+bool GenModel::evaluate_seq_stream(Aligned_seq_queue& seq_queue , const string path , double likelihood_threshold , bool viterbi_like , double proba_threshold_factor , double mean_number_seq_err_thresh /*= INFINITY by default*/){
+	return this->run_inference(NULL , &seq_queue , 1 , path , false , likelihood_threshold , viterbi_like , proba_threshold_factor , mean_number_seq_err_thresh);
+}
+
+/*
+ * Performs the inference/evaluation either over a vector of sequences (sequences_p) or over batches popped from a queue (seq_queue_p)
+ * Exactly one of the two pointers must be non null, sequences from a queue can only be processed once (iterations must be one)
+ */
+bool GenModel::run_inference(const vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>>* sequences_p , Aligned_seq_queue* seq_queue_p ,const  int iterations ,const string path , bool fast_iter ,double likelihood_threshold , bool viterbi_like , double proba_threshold_factor , double mean_number_seq_err_thresh){
+
+	if( (sequences_p == NULL) == (seq_queue_p == NULL) ){
+		throw invalid_argument("Either a vector of sequences or a sequence queue must be provided in GenModel::run_inference");
+	}
+	if( (seq_queue_p != NULL) and ( (iterations != 1) or fast_iter ) ){
+		throw invalid_argument("Streamed sequences can only be processed for a single iteration without fast iteration");
+	}
 
 	//If viterbi like only the best scenario is of interest
 	if(viterbi_like){
@@ -76,7 +99,13 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 	unordered_map<Rec_Event_name,list<pair<shared_ptr<const Rec_Event>,int>>> inv_offset_map = model_marginals.get_inverse_offset_map(model_parms,model_queue);
 	int iteration_accomplished = 0;
 	ofstream log_file(path + string("inference_logs.txt"));
-	log_file<<"iteration_n;seq_processed;seq_index;nt_sequence;n_V_aligns;n_J_aligns;seq_likelihood;seq_mean_n_errors;seq_n_scenarios;seq_best_scenario;time"<<endl;
+	//The sequence budget columns are only written if a budget is set, leaving the default log format unchanged
+	const bool log_sequence_budget = (seq_max_explored_branches > 0) or (seq_max_seconds > 0);
+	log_file<<"iteration_n;seq_processed;seq_index;nt_sequence;n_V_aligns;n_J_aligns;seq_likelihood;seq_mean_n_errors;seq_n_scenarios;seq_best_scenario;time;seq_n_explored_branches;seq_n_pruned_branches";
+	if(log_sequence_budget){
+		log_file<<";seq_n_budget_exceeded;seq_proba_threshold_factor;seq_budget_outcome";
+	}
+	log_file<<endl;
 	ofstream general_logs(path + string("inference_info.out"));
 	//Dump all inference parameters to file
 	chrono::system_clock::time_point begin_time = chrono::system_clock::now();
@@ -91,9 +120,26 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 	general_logs<<"Viterbi like (only keeps the best scenario): "<<viterbi_like<<endl;
 	general_logs<<"Proba threshold ratio: "<<proba_threshold_factor<<"\t#(ratio between best scenario and current scenario needed to explore/count the scenario)"<<endl;
 	general_logs<<"Mean #errors threshold: "<<mean_number_seq_err_thresh<<"\t#Needs a very good reason to be set to another value than INFINITY"<<endl;
-
-	//Get the total number of sequences to process
-	const double total_number_seqs = sequences.size(); //Use a double for float division afterwards
+	general_logs<<"Junction forward/backward DP: "<<junction_dp<<"\t#(sums over all scenarios without thresholds, only for canonical models without counters)"<<endl;
+	general_logs<<"Scenario skeleton cache (MB): "<<skeleton_cache_memory/(1024*1024)<<"\t#(0: disabled, scenarios recorded at one iteration are replayed at the next ones)"<<endl;
+	general_logs<<"Scenario skeleton re-exploration period: "<<skeleton_reexplore_period<<"\t#(0: never re-explore cached sequences)"<<endl;
+	general_logs<<"Scenario ordering: "<<scenario_ordering_name(scenario_ordering)<<"\t#(alignment: as provided, best_first: decreasing gene prior times alignment error likelihood)"<<endl;
+	general_logs<<"Read specific gene choice bounds: "<<read_proba_bounds<<"\t#(bound the gene choices not yet explored with the read's alignments, 0: crude bounds)"<<endl;
+	general_logs<<"Generic scenario engine: "<<generic_scenario_engine<<"\t#(1: events called through their virtual methods, reference for the specialized dispatch)"<<endl;
+	general_logs<<"Greedy seeding pass: "<<greedy_seed_pass<<"\t#(explore the best alignments first to seed the best scenario probability of each sequence)"<<endl;
+	general_logs<<"Sequence budget: "<<seq_max_explored_branches<<" explored partial scenarios, "<<seq_max_seconds<<" seconds\t#(0: no limit, a sequence exhausting its budget is explored again with a tighter probability ratio threshold, up to 1 (Viterbi-like) without budget, not used with counters)"<<endl;
+	general_logs<<"Sequence splitting (max alignments per chunk): "<<split_chunk_alignments<<"\t#(0: disabled, sequences with more alignments for the first gene choice are explored as tasks over chunks of alignments)"<<endl;
+
+	//Get the total number of sequences to process (only known as they are pushed for streamed sequences)
+	double total_number_seqs = (sequences_p != NULL) ? sequences_p->size() : 0; //Use a double for float division afterwards
+
+	//Resolve the aligned gene names to realization indices once for all iterations (streamed sequences are resolved as they are popped)
+	const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>> model_events_map = model_parms.get_events_map();
+	if(sequences_p != NULL){
+		for(vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>>::const_iterator seq_iter = sequences_p->begin() ; seq_iter != sequences_p->end() ; ++seq_iter){
+			resolve_realization_indices(model_events_map , get<2>(*seq_iter));
+		}
+	}
 
 	/*
 	 * Get the list of fixed and inferred events and output them to the log file
@@ -145,6 +191,42 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 	#pragma omp declare reduction(+:shared_ptr<Error_rate>:add_to_err_rate(omp_out,omp_in)) initializer(omp_priv = omp_orig->copy())
 */
 
+	/*
+	 * Scenario skeletons of each sequence can be replayed at later iterations if exploring a sequence has no other effect than updating the marginals
+	 * and the error rate statistics (no counters, Viterbi runs or other error models). Fixed events are not credited when replaying.
+	 */
+	unique_ptr<Scenario_skeleton_cache> skeleton_cache;
+	if( (skeleton_cache_memory > 0) and (sequences_p != NULL) and (iterations > 1) and (not viterbi_like)
+			and (dynamic_cast<Single_error_rate*>(model_parms.get_err_rate_p().get()) != nullptr) ){
+		vector<char> credited_indices(model_marginals.get_length() , 0);
+		const list<shared_ptr<Rec_Event>> model_event_list = model_parms.get_event_list();
+		for(list<shared_ptr<Rec_Event>>::const_iterator iter = model_event_list.begin() ; iter!=model_event_list.end() ; ++iter){
+			if(not (*iter)->is_fixed()){
+				size_t event_index = index_map.at((*iter)->get_name());
+				fill(credited_indices.begin() + event_index , credited_indices.begin() + event_index + model_marginals.get_event_size(*iter , model_parms) , 1);
+			}
+		}
+		skeleton_cache.reset(new Scenario_skeleton_cache(sequences_p->size() , skeleton_cache_memory , skeleton_reexplore_period , credited_indices));
+	}
+
+	/*
+	 * The greedy seed raises the best scenario probability of each sequence before it is explored: the scenarios pruned against it must have been bounded by true upper bounds.
+	 * The error bounds of the hypermutation error models are heuristic, the seed is not used with them.
+	 */
+	const bool greedy_seed = greedy_seed_pass and (dynamic_cast<Single_error_rate*>(model_parms.get_err_rate_p().get()) != nullptr);
+	if(greedy_seed_pass and (not greedy_seed)){
+		cerr<<"Greedy seeding pass disabled: the error rate bounds of "<<model_parms.get_err_rate_p()->type()<<" are not true upper bounds"<<endl;
+		general_logs<<"Greedy seeding pass disabled: the error rate bounds of "<<model_parms.get_err_rate_p()->type()<<" are not true upper bounds"<<endl;
+	}
+
+	/*
+	 * Sequences are processed by decreasing cost so that the slowest ones do not end up alone at the end of an iteration
+	 * The cost is estimated from the alignments (see estimate_sequence_cost()) until the processing time of each sequence has been measured
+	 * on the same alignments at a previous iteration
+	 */
+	vector<double> measured_seq_times;
+	bool measured_seq_times_valid = false;
+
 	//Loop over iterations
 	while(iteration_accomplished!=iterations){
 
@@ -159,6 +241,10 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 
 		//Initialize counters for the log file
 		size_t sequences_processed = 0;
+		size_t next_seq_index = 0;
+		size_t sequences_replayed = 0;
+		size_t pruned_branches = 0;
+		size_t rejected_scenarios = 0;
 
 		new_marginals.debug_marg_name = "new_marginals";
 
@@ -167,15 +253,26 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 		//Take only best alignments if fast_iter
 		vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>> fast_iter_sequences;
 		if(fast_iter && iteration_accomplished==0){
-			fast_iter_sequences = sequences;
-			for(unordered_map<Gene_class , vector<Alignment_data>>::const_iterator gc_align_iter = std::get<2>(sequences.at(0)).begin() ; gc_align_iter != std::get<2>(sequences.at(0)).end() ; ++gc_align_iter){
+			fast_iter_sequences = *sequences_p;
+			for(unordered_map<Gene_class , vector<Alignment_data>>::const_iterator gc_align_iter = std::get<2>(sequences_p->at(0)).begin() ; gc_align_iter != std::get<2>(sequences_p->at(0)).end() ; ++gc_align_iter){
 				if ((*gc_align_iter).first == D_gene)continue;
 				fast_iter_sequences = get_best_aligns(fast_iter_sequences,(*gc_align_iter).first);
 			}
 			sequence_util_ptr = &fast_iter_sequences;
 		}
 		else{
-			sequence_util_ptr = &sequences;
+			sequence_util_ptr = sequences_p;
+		}
+
+		vector<size_t> processing_order;
+		vector<double> estimated_seq_costs;
+		if(seq_queue_p == NULL){
+			estimated_seq_costs.reserve(sequence_util_ptr->size());
+			for(vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>>::const_iterator seq_iter = sequence_util_ptr->begin() ; seq_iter != sequence_util_ptr->end() ; ++seq_iter){
+				estimated_seq_costs.push_back(estimate_sequence_cost(model_events_map , get<2>(*seq_iter)));
+			}
+			processing_order = decreasing_cost_order(measured_seq_times_valid ? measured_seq_times : estimated_seq_costs);
+			measured_seq_times.assign(sequence_util_ptr->size() , 0.0);
 		}
 
 		cerr<<"Performing Evaluate/Inference iteration "<<iteration_accomplished+1<<endl;
@@ -184,8 +281,18 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 		 * #pragma omp parallel for schedule(dynamic) reduction(+:error_rate_copy,new_marginals) firstprivate(model_queue,index_map,offset_map,model_marginals_copy,events_map , processed_events , safety_set , write_index_list) //num_threads(6)
 		 */
 
+		//Single thread objects registered for the end of iteration reductions
+		vector<Model_marginals*> threads_marginals_p;
+		vector<Error_rate*> threads_err_rate_p;
+		vector<map<size_t,shared_ptr<Counter>>*> threads_counter_list_p;
+		//Workspace of each thread, used by the tasks exploring the chunks of split sequences
+		vector<Exploration_workspace*> threads_workspace_p(omp_get_max_threads() , nullptr);
+		size_t sequences_split = 0;
+		size_t sequences_over_budget = 0;
+		size_t sequences_viterbi_fallback = 0;
+
 		//Declare variables to use OpenMP 3.1 standards
-		#pragma omp parallel shared(new_marginals,error_rate_copy,sequences_processed,sequence_util_ptr,sequences) firstprivate(model_queue,proba_threshold_factor ) //num_threads(1)
+		#pragma omp parallel shared(new_marginals,error_rate_copy,sequences_processed,sequences_replayed,pruned_branches,rejected_scenarios,skeleton_cache,next_seq_index,processing_order,measured_seq_times,sequence_util_ptr,seq_queue_p,total_number_seqs,threads_marginals_p,threads_err_rate_p,threads_counter_list_p,threads_workspace_p,sequences_split,sequences_over_budget,sequences_viterbi_fallback) firstprivate(model_queue,proba_threshold_factor ) //num_threads(1)
 		{
 			//Make single thread copies of objects for thread safety
 			Model_Parms single_thread_model_parms (model_parms);
@@ -252,22 +359,24 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 			}
 
 			/*
-			 * Initialize the array of next event pointers
-			 * This array replaces the formerly copied queue<shared_ptr<Rec_Event>> (was copied at each iterate_wrap_up call)
-			 * Each event will access the pointer corresponding to its identifier address when calling iterate inside iterate_wrap_up
-			 * The last event will point to null pointer enabling to call the error_rate
+			 * Compile the scenario exploration engine
+			 * It replaces the array of next event pointers (formerly a queue<shared_ptr<Rec_Event>> copied at each iterate_wrap_up call)
+			 * Each event calls the next one through the engine inside iterate_wrap_up, and the last event records the complete scenario
 			 */
-			shared_ptr<Next_event_ptr> next_event_ptr_arr (new Next_event_ptr[single_thread_model_parms.get_event_list().size()]);
-			init_single_thread_model_queue = single_thread_model_queue;
-			while(!init_single_thread_model_queue.empty()){
-				shared_ptr<Rec_Event> first_init_event = init_single_thread_model_queue.front();
-				init_single_thread_model_queue.pop();
-				if(!init_single_thread_model_queue.empty()){
-					next_event_ptr_arr.get()[first_init_event->get_event_identifier()] = init_single_thread_model_queue.front().get();
-				}
-				else{
-					//This is the last event thus we emplace a shared null pointer
-					next_event_ptr_arr.get()[first_init_event->get_event_identifier()] = NULL; //Next_event_ptr(NULL);
+			Scenario_engine scenario_engine(single_thread_model_queue , events_map , single_thread_counter_list , generic_scenario_engine);
+
+			/*
+			 * Compile the junction forward/backward evaluator if requested
+			 * Counters and Viterbi runs need to see individual scenarios, the scenario engine is then used
+			 */
+			unique_ptr<Junction_dp_evaluator> junction_dp_evaluator;
+			if(junction_dp and single_thread_counter_list.empty() and (not viterbi_like)){
+				junction_dp_evaluator = compile_junction_dp_evaluator(single_thread_model_queue , events_map , single_thread_index_map , single_thread_offset_map , single_thread_err_rate);
+			}
+			if(junction_dp and (not junction_dp_evaluator)){
+				#pragma omp single nowait
+				{
+					cerr<<"Junction DP not available for this model/run (counters, viterbi or non canonical model), scenarios will be enumerated."<<endl;
 				}
 			}
 
@@ -281,32 +390,53 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 			for(map<size_t,shared_ptr<Counter>>::iterator iter = single_thread_counter_list.begin() ; iter!=single_thread_counter_list.end() ; ++iter){
 				(*iter).second->initialize_counter(single_thread_model_parms , single_thread_marginals);
 			}
-			#pragma omp single nowait
-			{
-				cerr<<"Initializing probability bounds..."<<endl;
-			}
-			//Compute upper proba bounds for downstream scenarios for each event
-			double downstream_proba_bound = 1 ;
-			forward_list<double*> updated_proba_list ;
-			while(!init_single_thread_stack.empty()){
-				shared_ptr<Rec_Event> last_proba_init_event = init_single_thread_stack.top();
-				queue<shared_ptr<Rec_Event>> tmp_init_proba_single_thread_model_queue = single_thread_model_queue;
-				init_single_thread_stack.pop();
-				while(tmp_init_proba_single_thread_model_queue.front()!=last_proba_init_event){
-					tmp_init_proba_single_thread_model_queue.pop();
+			/*
+			 * Record or replay the scenario skeletons of the sequences
+			 * Skeletons are not recorded during a fast iteration since only the best alignments are considered
+			 */
+			const bool use_skeleton_cache = skeleton_cache and (not junction_dp_evaluator) and single_thread_counter_list.empty() and scenario_engine.can_record_skeletons()
+											and (not (fast_iter and (iteration_accomplished == 0)));
+			const bool replay_only = use_skeleton_cache and skeleton_cache->can_replay_all(iteration_accomplished);
+			Scenario_skeleton_recorder skeleton_recorder;
+			skeleton_recorder.error_rate_p = dynamic_cast<const Single_error_rate*>(single_thread_err_rate.get());
+			vector<double> skeleton_weights;
+
+			//Alignments of the current sequence in exploration order, and the best one of each gene for the greedy seeding pass
+			const bool order_best_first = (scenario_ordering == Best_first_order);
+			unordered_map<Gene_class , vector<Alignment_data>> ordered_alignments;
+			unordered_map<Gene_class , vector<Alignment_data>> seed_alignments;
+			size_t thread_pruned_branches = 0;
+			size_t thread_rejected_scenarios = 0;
+
+			//Scenario probability bounds are only used to prune the enumeration, the junction evaluator and skeleton replays do not need them
+			if( (not junction_dp_evaluator) and (not replay_only) ){
+				#pragma omp single nowait
+				{
+					cerr<<"Initializing probability bounds..."<<endl;
 				}
-				tmp_init_proba_single_thread_model_queue.pop();
-				last_proba_init_event->initialize_crude_scenario_proba_bound(downstream_proba_bound , updated_proba_list , events_map);
+				//Compute upper proba bounds for downstream scenarios for each event
+				double downstream_proba_bound = 1 ;
+				forward_list<double*> updated_proba_list ;
+				while(!init_single_thread_stack.empty()){
+					shared_ptr<Rec_Event> last_proba_init_event = init_single_thread_stack.top();
+					queue<shared_ptr<Rec_Event>> tmp_init_proba_single_thread_model_queue = single_thread_model_queue;
+					init_single_thread_stack.pop();
+					while(tmp_init_proba_single_thread_model_queue.front()!=last_proba_init_event){
+						tmp_init_proba_single_thread_model_queue.pop();
+					}
+					tmp_init_proba_single_thread_model_queue.pop();
+					last_proba_init_event->initialize_crude_scenario_proba_bound(downstream_proba_bound , updated_proba_list , events_map);
 
-				last_proba_init_event->initialize_Len_proba_bound(tmp_init_proba_single_thread_model_queue,single_thread_model_marginals.marginal_array_smart_p,index_mapp);
-				/*#pragma omp single nowait
+					last_proba_init_event->initialize_Len_proba_bound(tmp_init_proba_single_thread_model_queue,single_thread_model_marginals.marginal_array_smart_p,index_mapp);
+					/*#pragma omp single nowait
+					{
+						cerr<<last_proba_init_event->get_name()<<" initialized"<<endl;
+					}*/
+				}
+				#pragma omp single nowait
 				{
-					cerr<<last_proba_init_event->get_name()<<" initialized"<<endl;
-				}*/
-			}
-			#pragma omp single nowait
-			{
-				cerr<<"Initialization of probability bounds over."<<endl;
+					cerr<<"Initialization of probability bounds over."<<endl;
+				}
 			}
 
 			//Now let all the events in the need of it get their own updated copy of the marginals
@@ -319,46 +449,252 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 			chrono::system_clock::time_point single_seq_begin;
 			chrono::duration<double> seq_time;
 
+			/*
+			 * Single seq marginals are allocated once per thread and the events record the entries they write to.
+			 * Only these touched entries are normalized, merged to the single thread marginals and set back to 0 after each sequence.
+			 */
+			Model_marginals single_seq_marginals = single_thread_model_marginals.empty_copy();
+			single_seq_marginals.debug_marg_name = "single_seq_marginals";
+			Touched_marginals_indices seq_touched_marginals(single_seq_marginals.get_length());
+			for(list<shared_ptr<Rec_Event>>::iterator event_iter = events_list.begin() ; event_iter != events_list.end() ; ++event_iter){
+				(*event_iter)->set_touched_marginals(&seq_touched_marginals);
+			}
 
+			/*
+			 * Sequences with many alignments for the first gene choice are split in chunks of alignments explored as OpenMP tasks.
+			 * Idle threads pick up the chunks between two sequences or once all sequences have been distributed.
+			 * Counters, Viterbi runs and the junction evaluator need the whole sequence at once, skeletons are not recorded for split sequences.
+			 */
+			const shared_ptr<Rec_Event> first_event = single_thread_model_queue.front();
+			const bool split_sequences = (split_chunk_alignments > 0) and (first_event->get_type() == GeneChoice_t) and single_thread_counter_list.empty()
+											and (not junction_dp_evaluator) and (not viterbi_like);
+			const Gene_class split_gene = first_event->get_class();
+			//Sequence budgets, counters cannot discard the scenarios of an exhausted exploration
+			const bool sequence_budget = ( (seq_max_explored_branches > 0) or (seq_max_seconds > 0) ) and single_thread_counter_list.empty();
 
+			Exploration_workspace thread_workspace(downstream_proba_map , index_mapp , single_thread_offset_map , single_seq_marginals , seq_touched_marginals , single_thread_model_marginals.marginal_array_smart_p ,
+													constructed_sequences , seq_offsets , single_thread_err_rate , single_thread_counter_list , events_map , safety_set , mismatches_lists , scenario_engine);
+			threads_workspace_p[omp_get_thread_num()] = &thread_workspace;
 
-			//Loop over sequences in parallel, using the number of threads declared previously when declaring the parallel section
-			//Use dynamic scheduling to avoid loss of time due to synchronization
-
-			#pragma omp for schedule(dynamic) nowait
-			for(vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>>::const_iterator seq_it = (*sequence_util_ptr).begin() ; seq_it < (*sequence_util_ptr).end() ; ++seq_it){
 
-				single_seq_begin = chrono::system_clock::now();
 
-				//Make a copy of the queue that can be modified in iterate
-				queue<shared_ptr<Rec_Event>> model_queue_copy(single_thread_model_queue);
 
-				//Get the first event from the queue
-				shared_ptr<Rec_Event> first_event = model_queue_copy.front();
-				model_queue_copy.pop();
+			//Loop over sequences in parallel, using the number of threads declared previously when declaring the parallel section
+			//Sequences are distributed one at a time (equivalent to a dynamic scheduling) to avoid loss of time due to synchronization
+			//Streamed sequences are popped by batches from the queue as they are aligned
+			Aligned_seq_batch seq_batch;
+			size_t batch_position = 0;
+			const tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>* seq_it;
+			size_t seq_index = 0;
+
+			while(true){
+				if(split_sequences){
+					//Help with the chunks of split sequences before taking a new one
+					#pragma omp taskyield
+				}
+				if(seq_queue_p == NULL){
+					size_t order_position;
+					#pragma omp atomic capture
+					order_position = next_seq_index++;
+					if(order_position >= processing_order.size()){
+						break;
+					}
+					seq_index = processing_order[order_position];
+					seq_it = &(*sequence_util_ptr)[seq_index];
+				}
+				else{
+					if(batch_position == seq_batch.size()){
+						if(not seq_queue_p->pop(seq_batch)){
+							break;
+						}
+						for(Aligned_seq_batch::const_iterator batch_iter = seq_batch.begin() ; batch_iter != seq_batch.end() ; ++batch_iter){
+							resolve_realization_indices(events_map , get<2>(*batch_iter));
+						}
+						batch_position = 0;
+						continue;
+					}
+					seq_it = &seq_batch[batch_position];
+					++batch_position;
+				}
 
+				single_seq_begin = chrono::system_clock::now();
 
-				//Initialize single seq marginals
-				Model_marginals single_seq_marginals = single_thread_model_marginals.empty_copy();
 				double init_proba = 1;
 				//double init_tmp_err_w_proba = 1;
 				double max_proba_scenario = likelihood_threshold/proba_threshold_factor;
 
 				Int_Str int_sequence = nt2int(get<1>(*seq_it));
+				size_t seq_explored_branches = 0;
+				size_t seq_pruned_branches = 0;
+				double seq_threshold_factor = proba_threshold_factor;
+				size_t seq_budget_exceeded = 0;
+				bool seq_viterbi_fallback = false;
+				double seq_seed_proba_scenario = 0;
 
 				//cout<<int_sequence<<endl;
 
-				single_seq_marginals.debug_marg_name = "single_seq_marginals";
-
 				/*
-				 * Call iterate on the first event
+				 * Call iterate on the first event through the scenario engine
 				 * The method will be called recursively for each event, this is equivalent to a nested loop and enumerates all possible scenarios
 				 * The weight of each recombination scenario is added to the single_seq_marginals on the fly
+				 * The junction evaluator instead sums over all scenarios by dynamic programming and adds the expected counts directly
 				 */
 				try{
-
-					first_event->iterate(init_proba , downstream_proba_map , get<1>(*seq_it) , int_sequence , index_mapp , single_thread_offset_map , next_event_ptr_arr , single_seq_marginals.marginal_array_smart_p , single_thread_model_marginals.marginal_array_smart_p , get<2>(*seq_it) , constructed_sequences , seq_offsets , single_thread_err_rate , single_thread_counter_list , events_map , safety_set , mismatches_lists , max_proba_scenario , proba_threshold_factor);
-
+					const bool replay_skeleton = use_skeleton_cache and skeleton_cache->can_replay(seq_index , iteration_accomplished);
+					const bool record_skeleton = use_skeleton_cache and (not replay_skeleton) and skeleton_cache->should_record(seq_index);
+					if(junction_dp_evaluator){
+						junction_dp_evaluator->evaluate(int_sequence , get<2>(*seq_it) , single_thread_model_marginals.marginal_array_smart_p , single_seq_marginals.marginal_array_smart_p , seq_touched_marginals , *static_cast<Single_error_rate*>(single_thread_err_rate.get()));
+						max_proba_scenario = junction_dp_evaluator->get_best_scenario_proba();
+					}
+					else if(replay_skeleton){
+						skeleton_cache->replay(seq_index , single_thread_model_marginals.marginal_array_smart_p , scenario_engine.get_dinucl_events() , likelihood_threshold , proba_threshold_factor ,
+								single_seq_marginals.marginal_array_smart_p , seq_touched_marginals , *static_cast<Single_error_rate*>(single_thread_err_rate.get()) , max_proba_scenario , skeleton_weights);
+						#pragma omp atomic
+						++sequences_replayed;
+					}
+					else{
+						const unordered_map<Gene_class , vector<Alignment_data>>* seq_alignments_p = &get<2>(*seq_it);
+						if(read_proba_bounds){
+							init_read_proba_bounds(events_map , *single_thread_err_rate , get<2>(*seq_it) , int_sequence.size() , downstream_proba_map);
+						}
+						if(order_best_first or greedy_seed){
+							order_alignments_best_first(events_map , *single_thread_err_rate , get<2>(*seq_it) , ordered_alignments);
+							if(order_best_first){
+								seq_alignments_p = &ordered_alignments;
+							}
+						}
+
+						/*
+						 * Greedy seeding pass: explore (without recording anything) the scenarios of the best alignment of the V and J genes with the tightest threshold.
+						 * The D gene keeps all its alignments: the D positions that are not aligned are only explored when none of the D alignments fits between the V and J ones,
+						 * a single D alignment could open scenarios that the full exploration does not contain and seed a probability it never reaches.
+						 * The seed scenarios are thus also explored afterwards and, the bounds being true upper bounds, the best scenario cannot be pruned.
+						 * Not used with a threshold factor of 1: the seed is then the probability of the best scenario, rounding errors could prune it when it is explored again.
+						 */
+						if(greedy_seed and (proba_threshold_factor < 1.0)){
+							seed_alignments.clear();
+							for(unordered_map<Gene_class , vector<Alignment_data>>::const_iterator gc_iter = ordered_alignments.begin() ; gc_iter != ordered_alignments.end() ; ++gc_iter){
+								const size_t n_seed_alignments = (gc_iter->first == D_gene) ? gc_iter->second.size() : min((size_t) 1 , gc_iter->second.size());
+								seed_alignments[gc_iter->first].assign(gc_iter->second.begin() , gc_iter->second.begin() + n_seed_alignments);
+							}
+							double seed_proba_scenario = likelihood_threshold;
+							double seed_threshold_factor = 1.0;
+							double seed_init_proba = 1;
+							Scenario_context seed_context(downstream_proba_map , get<1>(*seq_it) , int_sequence , index_mapp , single_thread_offset_map , single_seq_marginals.marginal_array_smart_p , single_thread_model_marginals.marginal_array_smart_p , seed_alignments , constructed_sequences , seq_offsets , single_thread_err_rate , single_thread_counter_list , events_map , safety_set , mismatches_lists , seed_proba_scenario , seed_threshold_factor , scenario_engine);
+							seed_context.dry_run = true;
+							scenario_engine.explore(seed_init_proba , seed_context);
+							single_thread_err_rate->clean_seq_counters();
+							seq_explored_branches += seed_context.explored_branches;
+							seq_pruned_branches += seed_context.pruned_branches;
+							seq_seed_proba_scenario = seed_proba_scenario;
+						}
+
+						/*
+						 * Sequence budget: an exploration exhausting the budget is discarded and the sequence is explored again with a tighter threshold factor.
+						 * Each attempt starts again from the likelihood threshold (or the greedy seed if the factor is below 1), the scenarios of a discarded attempt are not recorded.
+						 * The last attempt (factor 1) is not bounded and runs as a Viterbi run: the events and the error rate only keep the most likely scenario.
+						 */
+						const bool split_sequence = split_sequences and (not record_skeleton) and (seq_alignments_p->count(split_gene) != 0) and (seq_alignments_p->at(split_gene).size() > split_chunk_alignments);
+						while(true){
+							const bool bounded_attempt = sequence_budget and (seq_threshold_factor < 1.0);
+							const size_t attempt_max_branches = (bounded_attempt and (seq_max_explored_branches > 0)) ? seq_max_explored_branches : numeric_limits<size_t>::max();
+							const chrono::steady_clock::time_point attempt_deadline = (bounded_attempt and (seq_max_seconds > 0)) ?
+									chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seq_max_seconds)) : chrono::steady_clock::time_point::max();
+							bool budget_exceeded = false;
+							max_proba_scenario = likelihood_threshold/seq_threshold_factor;
+							if(seq_threshold_factor < 1.0){
+								max_proba_scenario = max(max_proba_scenario , seq_seed_proba_scenario);
+							}
+							seq_viterbi_fallback = sequence_budget and (seq_budget_exceeded > 0) and (not bounded_attempt) and (not viterbi_like);
+							if(seq_viterbi_fallback){
+								set_viterbi_run(single_thread_model_queue , *single_thread_err_rate , true);
+							}
+
+							//The chunk explorations do not support Viterbi runs
+							if(split_sequence and (not seq_viterbi_fallback)){
+								//The chunks share the best scenario probability of the sequence, their contributions are added in chunk order
+								vector<Sequence_chunk> seq_chunks = split_alignments(*seq_alignments_p , split_gene , split_chunk_alignments , max_proba_scenario);
+								atomic<double> shared_max_proba_scenario(max_proba_scenario);
+								while(thread_workspace.chunk_err_rates.size() < seq_chunks.size()){
+									thread_workspace.chunk_err_rates.push_back(single_thread_err_rate->copy());
+								}
+								for(size_t chunk_index = 0 ; chunk_index != seq_chunks.size() ; ++chunk_index){
+									seq_chunks[chunk_index].err_rate_p = thread_workspace.chunk_err_rates[chunk_index];
+									seq_chunks[chunk_index].shared_max_proba_scenario_p = &shared_max_proba_scenario;
+								}
+								//The chunks share the sequence budget
+								const size_t chunk_max_branches = (attempt_max_branches == numeric_limits<size_t>::max()) ? attempt_max_branches : max((size_t) 1 , attempt_max_branches/seq_chunks.size());
+								//Chunks are taken in order by this thread and by helper tasks picked up by idle threads: without idle threads the chunks are explored in the order of the unsplit exploration
+								atomic<size_t> next_chunk(0);
+								const size_t n_helpers = min(seq_chunks.size() , (size_t) omp_get_num_threads()) - 1;
+								for(size_t helper = 0 ; helper != n_helpers ; ++helper){
+									#pragma omp task shared(seq_chunks,next_chunk,int_sequence,threads_workspace_p,seq_threshold_factor,chunk_max_branches,attempt_deadline)
+									{
+										explore_sequence_chunks(*threads_workspace_p[omp_get_thread_num()] , get<1>(*seq_it) , int_sequence , read_proba_bounds , seq_threshold_factor , chunk_max_branches , attempt_deadline , seq_chunks , next_chunk);
+									}
+								}
+								explore_sequence_chunks(thread_workspace , get<1>(*seq_it) , int_sequence , read_proba_bounds , seq_threshold_factor , chunk_max_branches , attempt_deadline , seq_chunks , next_chunk);
+								#pragma omp taskwait
+								for(vector<Sequence_chunk>::const_iterator chunk_iter = seq_chunks.begin() ; chunk_iter != seq_chunks.end() ; ++chunk_iter){
+									add_sequence_chunk(*chunk_iter , single_seq_marginals , seq_touched_marginals , *single_thread_err_rate);
+									seq_explored_branches += (*chunk_iter).explored_branches;
+									seq_pruned_branches += (*chunk_iter).pruned_branches;
+									thread_rejected_scenarios += (*chunk_iter).rejected_scenarios;
+									budget_exceeded = budget_exceeded or (*chunk_iter).budget_exceeded;
+								}
+								max_proba_scenario = shared_max_proba_scenario.load();
+							}
+							else{
+								//After a split attempt the read bounds are those of the alignments of the last chunk
+								if(read_proba_bounds and split_sequence){
+									init_read_proba_bounds(events_map , *single_thread_err_rate , get<2>(*seq_it) , int_sequence.size() , downstream_proba_map);
+								}
+								double attempt_init_proba = init_proba;
+								Scenario_context scenario_context(downstream_proba_map , get<1>(*seq_it) , int_sequence , index_mapp , single_thread_offset_map , single_seq_marginals.marginal_array_smart_p , single_thread_model_marginals.marginal_array_smart_p , *seq_alignments_p , constructed_sequences , seq_offsets , single_thread_err_rate , single_thread_counter_list , events_map , safety_set , mismatches_lists , max_proba_scenario , seq_threshold_factor , scenario_engine);
+								if(bounded_attempt){
+									scenario_context.set_budget(attempt_max_branches , attempt_deadline);
+								}
+								if(record_skeleton){
+									skeleton_recorder.clear(skeleton_cache->get_record_max_size());
+									scenario_context.skeleton_recorder = &skeleton_recorder;
+								}
+								scenario_engine.explore(attempt_init_proba , scenario_context);
+								budget_exceeded = scenario_context.is_budget_exceeded();
+								//Sequences explored with a tightened threshold are not recorded, they get a new budget at the next iteration
+								if(record_skeleton and (not budget_exceeded) and (seq_budget_exceeded == 0)){
+									skeleton_cache->store(seq_index , iteration_accomplished , skeleton_recorder);
+								}
+								seq_explored_branches += scenario_context.explored_branches;
+								seq_pruned_branches += scenario_context.pruned_branches;
+								thread_rejected_scenarios += scenario_context.rejected_scenarios;
+							}
+							if(seq_viterbi_fallback){
+								set_viterbi_run(single_thread_model_queue , *single_thread_err_rate , false);
+							}
+
+							if(not budget_exceeded){
+								break;
+							}
+							single_thread_err_rate->clean_seq_counters();
+							single_seq_marginals.reset_touched(seq_touched_marginals);
+							seq_touched_marginals.clear();
+							++seq_budget_exceeded;
+							//At least ten times tighter, and halving log(factor) so that very permissive thresholds reach 1 in a few attempts (a null factor prunes nothing)
+							seq_threshold_factor = (seq_threshold_factor > 0) ? min(1.0 , max(10*seq_threshold_factor , sqrt(seq_threshold_factor))) : numeric_limits<double>::min();
+						}
+						if(split_sequence){
+							#pragma omp atomic
+							++sequences_split;
+						}
+						if(seq_budget_exceeded > 0){
+							#pragma omp atomic
+							++sequences_over_budget;
+						}
+						if(seq_viterbi_fallback){
+							#pragma omp atomic
+							++sequences_viterbi_fallback;
+						}
+					}
 				}
 
 				catch(exception& except){
@@ -374,15 +710,23 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 
 
 				//Normalize the weights on the single_seq_marginal so that each sequence has the same weight when merged to the single_thread_marginals
-				single_thread_err_rate->norm_weights_by_seq_likelihood(single_seq_marginals.marginal_array_smart_p,single_seq_marginals.get_length());
+				single_thread_err_rate->norm_weights_by_seq_likelihood(single_seq_marginals.marginal_array_smart_p,seq_touched_marginals);
 				seq_time = chrono::system_clock::now() - single_seq_begin;
+				if(seq_queue_p == NULL){
+					measured_seq_times[seq_index] = seq_time.count();
+				}
 				#pragma omp critical(dump_seq_info)
 				{
 					++sequences_processed;
 					//Output useful infos in the log file
 					//log_file<<iteration_accomplished<<";"<<sequences_processed<<";"<<(*seq_it).first<<";"<<(*seq_it).second.at(V_gene).size()<<";"<<(*seq_it).second.at(D_gene).size()<<";"<<(*seq_it).second.at(J_gene).size()<<";"<<single_thread_err_rate->get_seq_probability()<<";"<<single_thread_err_rate->get_seq_likelihood()<<";"<<single_thread_err_rate->debug_number_scenarios<<";"<<max_proba_scenario<<endl;
-					log_file<<iteration_accomplished<<";"<<sequences_processed<<";"<<get<0>(*seq_it)<<";"<<get<1>(*seq_it)<<";"<<get<2>(*seq_it).at(V_gene).size()<<";"<<get<2>(*seq_it).at(J_gene).size()<<";"<<single_thread_err_rate->get_seq_likelihood()<<";"<<single_thread_err_rate->get_seq_mean_error_number()<<";"<<single_thread_err_rate->debug_number_scenarios<<";"<<max_proba_scenario<<";"<<seq_time.count()<<endl;
+					log_file<<iteration_accomplished<<";"<<sequences_processed<<";"<<get<0>(*seq_it)<<";"<<get<1>(*seq_it)<<";"<<get<2>(*seq_it).at(V_gene).size()<<";"<<get<2>(*seq_it).at(J_gene).size()<<";"<<single_thread_err_rate->get_seq_likelihood()<<";"<<single_thread_err_rate->get_seq_mean_error_number()<<";"<<single_thread_err_rate->debug_number_scenarios<<";"<<max_proba_scenario<<";"<<seq_time.count()<<";"<<seq_explored_branches<<";"<<seq_pruned_branches;
+					if(log_sequence_budget){
+						log_file<<";"<<seq_budget_exceeded<<";"<<seq_threshold_factor<<";"<<(seq_viterbi_fallback ? "viterbi" : ( (seq_budget_exceeded > 0) ? "tightened" : "within_budget" ));
+					}
+					log_file<<endl;
 				}
+				thread_pruned_branches += seq_pruned_branches;
 				for(map<size_t,shared_ptr<Counter>>::iterator iter = single_thread_counter_list.begin() ; iter!=single_thread_counter_list.end() ; ++iter){
 					iter->second->count_sequence(single_thread_err_rate->get_seq_likelihood() , single_seq_marginals , single_thread_model_parms);
 					#pragma omp critical(dump_counters)
@@ -397,15 +741,22 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 					single_thread_err_rate->add_to_norm_counter();
 
 					//Add the single_seq_marginals to the single thread marginals
-					single_thread_marginals+=single_seq_marginals;
+					single_thread_marginals.add_touched(single_seq_marginals,seq_touched_marginals);
 				}
 				else{
 					//Erase seq specific counters so that it won't contribute to the error rate
 					single_thread_err_rate->clean_seq_counters();
 				}
 
+				//Clean the single seq marginals for the next sequence
+				single_seq_marginals.reset_touched(seq_touched_marginals);
+				seq_touched_marginals.clear();
+
 				#pragma omp critical (update_progress_bar)
 				{
+					if(seq_queue_p != NULL){
+						total_number_seqs = seq_queue_p->get_n_pushed_seqs();
+					}
 					if(sequences_processed%100 == 0){
 						//Output current progress to cerr
 						show_progress_bar(cerr,sequences_processed/total_number_seqs, "Iteration "+ to_string(iteration_accomplished+1), 50);
@@ -415,10 +766,47 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 			}
 
 
+			#pragma omp atomic
+			pruned_branches += thread_pruned_branches;
+			#pragma omp atomic
+			rejected_scenarios += thread_rejected_scenarios;
+
 			//Merge single thread error_rates and marginals
-			#pragma omp critical(merge_marginals_and_er)
+			const int n_threads = omp_get_num_threads();
+			const int thread_num = omp_get_thread_num();
+			#pragma omp single
 			{
-				new_marginals+=single_thread_marginals;
+				threads_marginals_p.assign(n_threads,nullptr);
+				threads_err_rate_p.assign(n_threads,nullptr);
+				threads_counter_list_p.assign(n_threads,nullptr);
+			}
+			threads_marginals_p[thread_num] = &single_thread_marginals;
+			threads_err_rate_p[thread_num] = single_thread_err_rate.get();
+			threads_counter_list_p[thread_num] = &single_thread_counter_list;
+			#pragma omp barrier
+
+			//Each thread sums the same contiguous slice of all single thread marginals onto new_marginals
+			size_t marginals_slice_size = (new_marginals.get_length() + n_threads - 1)/n_threads;
+			size_t slice_begin = min(new_marginals.get_length() , thread_num*marginals_slice_size);
+			size_t slice_end = min(new_marginals.get_length() , slice_begin + marginals_slice_size);
+			for(int i = 0 ; i != n_threads ; ++i){
+				new_marginals.add_range(*threads_marginals_p[i] , slice_begin , slice_end);
+			}
+			#pragma omp barrier
+
+			//Tree reduction of error rates and counters: at each level thread i merges thread i+stride objects into its own
+			for(int stride = 1 ; stride < n_threads ; stride*=2){
+				if( (thread_num % (2*stride) == 0) and (thread_num + stride < n_threads) ){
+					add_to_err_rate(threads_err_rate_p[thread_num] , threads_err_rate_p[thread_num + stride]);
+					map<size_t,shared_ptr<Counter>>& other_counter_list = *threads_counter_list_p[thread_num + stride];
+					for(map<size_t,shared_ptr<Counter>>::iterator iter = single_thread_counter_list.begin() ; iter!=single_thread_counter_list.end() ; ++iter){
+						(*iter).second->add_to_counter(other_counter_list.at((*iter).first));
+					}
+				}
+				//Objects of other threads must not be destroyed before being merged
+				#pragma omp barrier
+			}
+			if(thread_num == 0){
 				add_to_err_rate(error_rate_copy.get(),single_thread_err_rate.get());
 				for(map<size_t,shared_ptr<Counter>>::iterator iter = single_thread_counter_list.begin() ; iter!=single_thread_counter_list.end() ; ++iter){
 					counters_list.at((*iter).first)->add_to_counter((*iter).second);
@@ -438,7 +826,7 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 		this->model_parms.set_error_ratep(error_rate_copy);
 		new_marginals.normalize(inv_offset_map , index_map , model_queue);
 		new_marginals.copy_fixed_events_marginals(this->model_marginals,this->model_parms,index_map);
-		this->model_marginals = new_marginals;
+		this->model_marginals = std::move(new_marginals);
 		++iteration_accomplished;
 
 		this->model_marginals.write2txt(path+string("iteration_")+to_string(iteration_accomplished)+string(".txt"),this->model_parms);
@@ -447,6 +835,27 @@ bool GenModel::infer_model(const vector<tuple<int,string,unordered_map<Gene_clas
 		//Close current iteration progress bar
 		close_progress_bar(cerr, "Iteration " + to_string(iteration_accomplished), 50);
 
+		if(seq_queue_p == NULL){
+			general_logs<<"Iteration "<<iteration_accomplished<<": "<<(measured_seq_times_valid ? "measured" : "estimated")<<" sequence costs used for scheduling, "<<sequence_cost_model_summary(estimated_seq_costs , measured_seq_times)<<endl;
+			//Times measured during the fast iteration are not representative of the full alignments
+			measured_seq_times_valid = not (fast_iter and (iteration_accomplished == 1));
+		}
+
+		if(log_sequence_budget){
+			general_logs<<"Iteration "<<iteration_accomplished<<": "<<sequences_over_budget<<" sequences exhausted their budget and were explored with a tighter probability ratio threshold, "<<sequences_viterbi_fallback<<" of them with a Viterbi run (see seq_n_budget_exceeded and seq_budget_outcome in inference_logs.txt)"<<endl;
+		}
+		if(split_chunk_alignments > 0){
+			general_logs<<"Iteration "<<iteration_accomplished<<": "<<sequences_split<<" sequences explored as tasks over chunks of at most "<<split_chunk_alignments<<" alignments"<<endl;
+		}
+
+		cerr<<"Scenario pruning ("<<scenario_ordering_name(scenario_ordering)<<" ordering"<<(greedy_seed ? ", greedy seeding" : "")<<"): "<<pruned_branches<<" branches pruned, "<<rejected_scenarios<<" complete scenarios rejected"<<endl;
+		general_logs<<"Iteration "<<iteration_accomplished<<": "<<pruned_branches<<" branches pruned and "<<rejected_scenarios<<" complete scenarios rejected by the probability threshold ("<<scenario_ordering_name(scenario_ordering)<<" ordering, greedy seeding: "<<greedy_seed<<")"<<endl;
+
+		if(skeleton_cache){
+			cerr<<"Scenario skeleton cache: "<<sequences_replayed<<" sequences replayed, "<<skeleton_cache->get_number_cached_sequences()<<" sequences cached ("<<skeleton_cache->get_memory_usage()/(1024*1024)<<" MB)"<<endl;
+			general_logs<<"Iteration "<<iteration_accomplished<<": "<<sequences_replayed<<" sequences replayed from the scenario skeleton cache, "<<skeleton_cache->get_number_cached_sequences()<<" sequences cached ("<<skeleton_cache->get_memory_usage()/(1024*1024)<<" MB)"<<endl;
+		}
+
 	}
 	//Create a copy of the last iteration results with identifiable name
 	this->model_marginals.write2txt(path+string("final_marginals.txt"),this->model_parms);
@@ -555,8 +964,27 @@ void GenModel::generate_sequences(int number_seq,bool generate_errors , string f
 		model_queue_copy.pop();
 	}
 
+	//Use the generation kernel specialized for the model topology if there is one
+	unique_ptr<Sequence_generator> canonical_generator = compile_canonical_generator(model_queue , this->model_marginals.marginal_array_smart_p , index_map , offset_map);
+	if(canonical_generator){
+		clog<<"Using the compiled generation kernel for the "<<canonical_topology_str(canonical_generator->get_topology())<<" topology"<<endl;
+	}
+
+	pair<string,queue<queue<int>>> sequence;
 	for(size_t seq = 0 ; seq != number_seq ; ++seq){
-		pair<string,queue<queue<int>>> sequence = this->generate_unique_sequence(model_queue , index_map ,offset_map , generator,false);
+		if(canonical_generator){
+			canonical_generator->generate(generator , sequence.first);
+			//Only build the realizations queue if someone reads it
+			if(not transform_func_and_data.empty()){
+				sequence.second = canonical_generator->get_realizations_queue();
+			}
+			else{
+				sequence.second = queue<queue<int>>();
+			}
+		}
+		else{
+			sequence = this->generate_unique_sequence(model_queue , index_map ,offset_map , generator,false);
+		}
 		if(generate_errors){
 			sequence.second.push(this->model_parms.get_err_rate_p()->generate_errors(sequence.first,generator));
 		}
@@ -566,8 +994,12 @@ void GenModel::generate_sequences(int number_seq,bool generate_errors , string f
 		}
 
 		if(not output_only_func){
-			outfile_ind_seq<<seq<<";"<<sequence.first<<endl;
+			outfile_ind_seq<<seq<<";"<<sequence.first<<'\n';
 			outfile_ind_real<<seq;
+			if(canonical_generator and transform_func_and_data.empty()){
+				//The realizations queue then only contains the errors
+				canonical_generator->write_realizations(outfile_ind_real);
+			}
 			queue<queue<int>>& realizations = sequence.second;
 			while(!realizations.empty()){
 				outfile_ind_real<<";";
@@ -583,7 +1015,7 @@ void GenModel::generate_sequences(int number_seq,bool generate_errors , string f
 				outfile_ind_real<<")";
 				realizations.pop();
 			}
-			outfile_ind_real<<endl;
+			outfile_ind_real<<'\n';
 		}
 
 		if(seq%1000 == 0){
@@ -666,9 +1098,275 @@ void GenModel::write_seq_real2txt(string filename_ind_seq , string filename_ind_
 
 }
 
+/*
+ * Switch the events of a model queue and the error rate to (or back from) a Viterbi run, only the most likely scenario of the sequence is then recorded
+ */
+void set_viterbi_run(queue<shared_ptr<Rec_Event>> model_queue , Error_rate& error_rate , bool viterbi_run){
+	while(not model_queue.empty()){
+		model_queue.front()->set_viterbi_run(viterbi_run);
+		model_queue.pop();
+	}
+	error_rate.set_viterbi_run(viterbi_run);
+}
+
+/*
+ * Store in the alignments of a sequence the index of their gene among the realizations of the corresponding gene choice
+ */
+void resolve_realization_indices(const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , const unordered_map<Gene_class , vector<Alignment_data>>& alignments){
+	for(unordered_map<Gene_class , vector<Alignment_data>>::const_iterator gc_iter = alignments.begin() ; gc_iter != alignments.end() ; ++gc_iter){
+		unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>::const_iterator event_iter = events_map.find(make_tuple(GeneChoice_t,gc_iter->first,Undefined_side));
+		if(event_iter != events_map.end()){
+			static_pointer_cast<const Gene_choice>(event_iter->second)->resolve_realization_indices(gc_iter->second);
+		}
+	}
+}
+
+/*
+ * Copy the alignments of a sequence sorted by decreasing upper bound of their scenarios probability (see Scenario_ordering)
+ * The bound of an alignment is the largest prior of its gene (over all conditioning realizations) times the error likelihood of its mismatches
+ * Ties keep the original alignment order
+ */
+void order_alignments_best_first(const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , Error_rate& error_rate , const unordered_map<Gene_class , vector<Alignment_data>>& alignments , unordered_map<Gene_class , vector<Alignment_data>>& ordered_alignments){
+	ordered_alignments.clear();
+	vector<pair<double,size_t>> alignment_bounds;
+	for(unordered_map<Gene_class , vector<Alignment_data>>::const_iterator gc_iter = alignments.begin() ; gc_iter != alignments.end() ; ++gc_iter){
+		vector<Alignment_data>& ordered_vect = ordered_alignments[gc_iter->first];
+		unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>::const_iterator event_iter = events_map.find(make_tuple(GeneChoice_t,gc_iter->first,Undefined_side));
+		if(event_iter == events_map.end()){
+			ordered_vect = gc_iter->second;
+			continue;
+		}
+		const Gene_choice& gene_choice = *static_pointer_cast<const Gene_choice>(event_iter->second);
+
+		alignment_bounds.clear();
+		for(size_t i = 0 ; i != gc_iter->second.size() ; ++i){
+			const Alignment_data& alignment = gc_iter->second[i];
+			alignment_bounds.push_back(make_pair(-gene_choice.get_realization_upper_bound_proba(alignment)*error_rate.get_err_rate_upper_bound(alignment.mismatches.size(),0) , i));
+		}
+		sort(alignment_bounds.begin() , alignment_bounds.end());
+
+		ordered_vect.reserve(alignment_bounds.size());
+		for(vector<pair<double,size_t>>::const_iterator bound_iter = alignment_bounds.begin() ; bound_iter != alignment_bounds.end() ; ++bound_iter){
+			ordered_vect.push_back(gc_iter->second[bound_iter->second]);
+		}
+	}
+}
+
+/*
+ * Set the read specific upper bounds of the gene choices in the first layer of the downstream proba map (see Gene_choice::get_read_upper_bound_proba())
+ * Each gene choice overwrites its own entry with the bound of the chosen alignment, the first layer is thus only used before the gene is chosen
+ */
+void init_read_proba_bounds(const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , Error_rate& error_rate , const unordered_map<Gene_class , vector<Alignment_data>>& alignments , size_t sequence_size , Downstream_scenario_proba_bound_map& downstream_proba_map){
+	static const vector<pair<Gene_class,Seq_type>> gene_seq_types = {make_pair(V_gene,V_gene_seq) , make_pair(J_gene,J_gene_seq)};
+	static const vector<Alignment_data> no_alignments;
+	for(vector<pair<Gene_class,Seq_type>>::const_iterator gene_iter = gene_seq_types.begin() ; gene_iter != gene_seq_types.end() ; ++gene_iter){
+		unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>::const_iterator event_iter = events_map.find(make_tuple(GeneChoice_t,gene_iter->first,Undefined_side));
+		if(event_iter == events_map.end()){
+			continue;
+		}
+		unordered_map<Gene_class , vector<Alignment_data>>::const_iterator align_iter = alignments.find(gene_iter->first);
+		const vector<Alignment_data>& gene_alignments = (align_iter != alignments.end()) ? align_iter->second : no_alignments;
+		downstream_proba_map.set_first_layer_value(gene_iter->second , static_pointer_cast<const Gene_choice>(event_iter->second)->get_read_upper_bound_proba(gene_alignments , error_rate , sequence_size));
+	}
+
+	/*
+	 * VJ junction: for each offset of the read's alignments of the first of the V and J choices, best junction length bound of the last one over the offsets of its alignments.
+	 * This is at least the bound the last choice sets for any of its alignments, the branches of the first choice can thus be pruned before exploring the other gene.
+	 */
+	unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>::const_iterator v_iter = events_map.find(make_tuple(GeneChoice_t,V_gene,Undefined_side));
+	unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>::const_iterator j_iter = events_map.find(make_tuple(GeneChoice_t,J_gene,Undefined_side));
+	if( (v_iter == events_map.end()) or (j_iter == events_map.end()) ){
+		return;
+	}
+	shared_ptr<Gene_choice> first_choice_p = static_pointer_cast<Gene_choice>(v_iter->second);
+	shared_ptr<Gene_choice> last_choice_p = static_pointer_cast<Gene_choice>(j_iter->second);
+	if(not first_choice_p->bounds_read_vj_junction()){
+		swap(first_choice_p , last_choice_p);
+	}
+	if( (not first_choice_p->bounds_read_vj_junction()) or (not last_choice_p->has_alignment_vj_junction()) ){
+		return;
+	}
+	unordered_map<Gene_class , vector<Alignment_data>>::const_iterator first_align_iter = alignments.find(first_choice_p->get_class());
+	unordered_map<Gene_class , vector<Alignment_data>>::const_iterator last_align_iter = alignments.find(last_choice_p->get_class());
+	set<int> last_offsets;
+	if(last_align_iter != alignments.end()){
+		for(vector<Alignment_data>::const_iterator iter = last_align_iter->second.begin() ; iter != last_align_iter->second.end() ; ++iter){
+			last_offsets.emplace(last_choice_p->get_vj_junction_offset(*iter));
+		}
+	}
+	unordered_map<int,double> junction_bounds;
+	if(first_align_iter != alignments.end()){
+		for(vector<Alignment_data>::const_iterator iter = first_align_iter->second.begin() ; iter != first_align_iter->second.end() ; ++iter){
+			const int first_offset = first_choice_p->get_vj_junction_offset(*iter);
+			if(junction_bounds.count(first_offset) != 0){
+				continue;
+			}
+			double junction_bound = 0;
+			for(set<int>::const_iterator offset_iter = last_offsets.begin() ; offset_iter != last_offsets.end() ; ++offset_iter){
+				if(first_choice_p->get_class() == V_gene){
+					junction_bound = max(junction_bound , last_choice_p->get_vj_junction_upper_bound_proba(first_offset , *offset_iter));
+				}
+				else{
+					junction_bound = max(junction_bound , last_choice_p->get_vj_junction_upper_bound_proba(*offset_iter , first_offset));
+				}
+			}
+			junction_bounds.emplace(first_offset , junction_bound);
+		}
+	}
+	first_choice_p->set_read_vj_junction_bounds(junction_bounds);
+}
+
+string scenario_ordering_name(Scenario_ordering ordering){
+	switch(ordering){
+		case Alignment_order:
+			return "alignment";
+		case Best_first_order:
+			return "best_first";
+		default:
+			throw invalid_argument("Unknown Scenario_ordering in scenario_ordering_name()");
+	}
+}
+
+/*
+ * Splits the alignments of a gene in chunks of at most max_chunk_alignments alignments, the alignments of the other genes are part of every chunk
+ * Chunks hold consecutive alignments so that, the best scenario probability being shared by the chunks, exploring them in order prunes exactly as the unsplit exploration
+ */
+vector<Sequence_chunk> split_alignments(const unordered_map<Gene_class , vector<Alignment_data>>& alignments , Gene_class split_gene , size_t max_chunk_alignments , double max_proba_scenario){
+	const vector<Alignment_data>& gene_alignments = alignments.at(split_gene);
+	const size_t n_chunks = (gene_alignments.size() + max_chunk_alignments - 1)/max_chunk_alignments;
+	vector<Sequence_chunk> chunks(n_chunks);
+	for(vector<Sequence_chunk>::iterator chunk_iter = chunks.begin() ; chunk_iter != chunks.end() ; ++chunk_iter){
+		(*chunk_iter).alignments = alignments;
+		(*chunk_iter).alignments[split_gene].clear();
+		(*chunk_iter).max_proba_scenario = max_proba_scenario;
+	}
+	for(size_t i = 0 ; i != gene_alignments.size() ; ++i){
+		chunks[(i*n_chunks)/gene_alignments.size()].alignments[split_gene].push_back(gene_alignments[i]);
+	}
+	return chunks;
+}
+
+/*
+ * Explores the scenarios of a chunk of the alignments of a sequence with the given thread workspace, within the given budget (see Scenario_context::set_budget())
+ * The sequence counters of the error rate and the touched single sequence marginals are moved to the chunk accumulators, leaving the workspace clean
+ * Exceptions cannot leave an OpenMP task, they are stored in the chunk and thrown again by add_sequence_chunk()
+ */
+void explore_sequence_chunk(Exploration_workspace& workspace , const string& sequence , const Int_Str& int_sequence , bool read_proba_bounds , double proba_threshold_factor ,
+							size_t max_explored_branches , chrono::steady_clock::time_point deadline , Sequence_chunk& chunk){
+	try{
+		if(read_proba_bounds){
+			init_read_proba_bounds(workspace.events_map , *workspace.error_rate_p , chunk.alignments , int_sequence.size() , workspace.downstream_proba_map);
+		}
+		double init_proba = 1;
+		Scenario_context chunk_context(workspace.downstream_proba_map , sequence , int_sequence , workspace.index_map , workspace.offset_map , workspace.single_seq_marginals.marginal_array_smart_p , workspace.model_parameters ,
+										chunk.alignments , workspace.constructed_sequences , workspace.seq_offsets , workspace.error_rate_p , workspace.counters_list , workspace.events_map ,
+										workspace.safety_set , workspace.mismatches_lists , chunk.max_proba_scenario , proba_threshold_factor , workspace.engine);
+		chunk_context.shared_max_prob_scenario = chunk.shared_max_proba_scenario_p;
+		chunk_context.set_budget(max_explored_branches , deadline);
+		workspace.engine.explore(init_proba , chunk_context);
+		chunk.budget_exceeded = chunk_context.is_budget_exceeded();
+		chunk.explored_branches = chunk_context.explored_branches;
+		chunk.pruned_branches = chunk_context.pruned_branches;
+		chunk.rejected_scenarios = chunk_context.rejected_scenarios;
+
+		chunk.err_rate_p->clean_seq_counters();
+		chunk.err_rate_p->add_seq_counters(*workspace.error_rate_p);
+
+		const vector<size_t>& touched_indices = workspace.touched_marginals.get_indices();
+		chunk.marginals.reserve(touched_indices.size());
+		for(vector<size_t>::const_iterator iter = touched_indices.begin() ; iter != touched_indices.end() ; ++iter){
+			chunk.marginals.emplace_back(*iter , workspace.single_seq_marginals.marginal_array_smart_p[*iter]);
+		}
+	}
+	catch(exception& except){
+		chunk.exception_message = except.what();
+	}
+	workspace.error_rate_p->clean_seq_counters();
+	workspace.single_seq_marginals.reset_touched(workspace.touched_marginals);
+	workspace.touched_marginals.clear();
+}
+
+/*
+ * Explores the chunks of a sequence that are not taken yet, in chunk order, until none is left
+ */
+void explore_sequence_chunks(Exploration_workspace& workspace , const string& sequence , const Int_Str& int_sequence , bool read_proba_bounds , double proba_threshold_factor ,
+							size_t max_explored_branches , chrono::steady_clock::time_point deadline , vector<Sequence_chunk>& chunks , atomic<size_t>& next_chunk){
+	for(size_t chunk_index = next_chunk++ ; chunk_index < chunks.size() ; chunk_index = next_chunk++){
+		explore_sequence_chunk(workspace , sequence , int_sequence , read_proba_bounds , proba_threshold_factor , max_explored_branches , deadline , chunks[chunk_index]);
+	}
+}
+
+/*
+ * Adds the contribution of an explored chunk to the sequence marginals and error rate counters
+ */
+void add_sequence_chunk(const Sequence_chunk& chunk , Model_marginals& single_seq_marginals , Touched_marginals_indices& touched_marginals , Error_rate& err_rate){
+	if(not chunk.exception_message.empty()){
+		throw runtime_error("Exception caught exploring a chunk of the sequence alignments: " + chunk.exception_message);
+	}
+	err_rate.add_seq_counters(*chunk.err_rate_p);
+	for(vector<pair<size_t,long double>>::const_iterator iter = chunk.marginals.begin() ; iter != chunk.marginals.end() ; ++iter){
+		single_seq_marginals.marginal_array_smart_p[(*iter).first] += (*iter).second;
+		touched_marginals.touch((*iter).first);
+	}
+}
+
+/*
+ * Rough estimate of the time needed to explore the scenarios of a sequence: the number of gene alignment combinations
+ * times the number of nucleotides between the best V alignment 3' end and the best J alignment 5' end (insertions and deletions to explore)
+ */
+double estimate_sequence_cost(const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , const unordered_map<Gene_class , vector<Alignment_data>>& alignments){
+	double n_combinations = 1;
+	for(unordered_map<Gene_class , vector<Alignment_data>>::const_iterator gc_iter = alignments.begin() ; gc_iter != alignments.end() ; ++gc_iter){
+		n_combinations *= max((size_t) 1 , gc_iter->second.size());
+	}
+
+	int junction_length = 0;
+	unordered_map<Gene_class , vector<Alignment_data>>::const_iterator v_iter = alignments.find(V_gene);
+	unordered_map<Gene_class , vector<Alignment_data>>::const_iterator j_iter = alignments.find(J_gene);
+	unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>::const_iterator v_event_iter = events_map.find(make_tuple(GeneChoice_t,V_gene,Undefined_side));
+	if( (v_iter != alignments.end()) and (j_iter != alignments.end()) and (not v_iter->second.empty()) and (not j_iter->second.empty()) and (v_event_iter != events_map.end()) ){
+		const Alignment_data& v_alignment = v_iter->second.front();
+		const int v_3_offset = v_alignment.offset + static_pointer_cast<const Gene_choice>(v_event_iter->second)->get_aligned_realization(v_alignment).value_str_int.size() - 1;
+		junction_length = max(0 , j_iter->second.front().offset - v_3_offset - 1);
+	}
+	return n_combinations*(junction_length + 1);
+}
+
+/*
+ * Order of the sequences by decreasing cost, ties keep the input order
+ */
+vector<size_t> decreasing_cost_order(const vector<double>& seq_costs){
+	vector<size_t> order(seq_costs.size());
+	for(size_t i = 0 ; i != order.size() ; ++i){
+		order[i] = i;
+	}
+	stable_sort(order.begin() , order.end() , [&seq_costs](size_t i , size_t j){return seq_costs[i] > seq_costs[j];});
+	return order;
+}
+
+/*
+ * Least squares scale between the estimated costs and the measured times (seconds per cost unit), and the share of the total time spent on the slowest sequence
+ */
+string sequence_cost_model_summary(const vector<double>& estimated_costs , const vector<double>& measured_times){
+	double cross_sum = 0;
+	double square_sum = 0;
+	double total_time = 0;
+	double max_time = 0;
+	for(size_t i = 0 ; i != min(estimated_costs.size() , measured_times.size()) ; ++i){
+		cross_sum += estimated_costs[i]*measured_times[i];
+		square_sum += estimated_costs[i]*estimated_costs[i];
+		total_time += measured_times[i];
+		max_time = max(max_time , measured_times[i]);
+	}
+	ostringstream summary;
+	summary<<"cost model: "<<((square_sum > 0) ? cross_sum/square_sum : 0)<<" s per unit, slowest sequence: "<<max_time<<" s ("<<((total_time > 0) ? 100*max_time/total_time : 0)<<"% of the sequences time)";
+	return summary.str();
+}
+
 /*
  * Extract the best alignment for each sequence for a given gene class (used for the fast iter)
  */
+
 vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>> get_best_aligns (const vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>>& all_aligns, Gene_class gc){
 
 	vector<tuple<int,string,unordered_map<Gene_class , vector<Alignment_data>>>> all_aligns_copy (all_aligns);
@@ -35,6 +35,11 @@
 #include "Model_marginals.h"
 #include "Errorrate.h"
 #include "Utils.h"
+#include "Alignmentpipeline.h"
+#include "Scenarioengine.h"
+#include "Canonicalgenerator.h"
+#include "Junctiondp.h"
+#include "Scenarioskeleton.h"
 #include <list>
 #include <map>
 #include <string>
@@ -45,10 +50,77 @@
 #include <stdexcept>
 #include <stack>
 #include <memory>
+#include <atomic>
+#include <algorithm>
+#include <sstream>
 
 //Make typedef for the function pointers
 typedef void (*gen_seq_trans)(size_t , std::pair<std::string , std::queue<std::queue<int>>>,std::shared_ptr<void>);
 
+/**
+ * Order in which the alignments of each gene are explored
+ * - Alignment_order: order of the alignments as provided (default)
+ * - Best_first_order: decreasing upper bound of the gene choice probability times the error likelihood of the alignment mismatches,
+ * likely scenarios are then reached first which raises the pruning threshold early
+ */
+enum Scenario_ordering{Alignment_order , Best_first_order};
+
+/**
+ * \struct Exploration_workspace GenModel.h
+ * \brief Thread local objects needed to explore the scenarios of a sequence.
+ *
+ * Each thread of GenModel::run_inference() registers its own workspace. A task exploring a chunk of the alignments of a heavy sequence
+ * uses the workspace of the thread executing it, which is idle since tasks only run between two sequences or while waiting for the chunks of a sequence.
+ */
+struct Exploration_workspace{
+	Exploration_workspace(Downstream_scenario_proba_bound_map& downstream_proba_map , Index_map& index_map ,
+			const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& offset_map , Model_marginals& single_seq_marginals ,
+			Touched_marginals_indices& touched_marginals , const Marginal_array_p& model_parameters , Seq_type_str_p_map& constructed_sequences , Seq_offsets_map& seq_offsets ,
+			std::shared_ptr<Error_rate>& error_rate_p , std::map<size_t,std::shared_ptr<Counter>>& counters_list ,
+			const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& events_map , Safety_bool_map& safety_set ,
+			Mismatch_vectors_map& mismatches_lists , const Scenario_engine& engine):
+				downstream_proba_map(downstream_proba_map) , index_map(index_map) , offset_map(offset_map) , single_seq_marginals(single_seq_marginals) ,
+				touched_marginals(touched_marginals) , model_parameters(model_parameters) , constructed_sequences(constructed_sequences) , seq_offsets(seq_offsets) ,
+				error_rate_p(error_rate_p) , counters_list(counters_list) , events_map(events_map) , safety_set(safety_set) , mismatches_lists(mismatches_lists) , engine(engine) , chunk_err_rates(){}
+
+	Downstream_scenario_proba_bound_map& downstream_proba_map;
+	Index_map& index_map;
+	const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& offset_map;
+	Model_marginals& single_seq_marginals;
+	Touched_marginals_indices& touched_marginals;
+	const Marginal_array_p& model_parameters;
+	Seq_type_str_p_map& constructed_sequences;
+	Seq_offsets_map& seq_offsets;
+	std::shared_ptr<Error_rate>& error_rate_p;
+	std::map<size_t,std::shared_ptr<Counter>>& counters_list;
+	const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& events_map;
+	Safety_bool_map& safety_set;
+	Mismatch_vectors_map& mismatches_lists;
+	const Scenario_engine& engine;
+	std::vector<std::shared_ptr<Error_rate>> chunk_err_rates; //Sequence counters accumulators of the chunks of the sequences split by this thread, copied once and reused
+};
+
+/**
+ * \struct Sequence_chunk GenModel.h
+ * \brief A chunk of the alignments of a sequence explored as a separate task, and its contribution to the sequence.
+ *
+ * The chunks of a sequence share its best scenario probability so that each chunk prunes as an unsplit exploration would.
+ * The contributions are added to the sequence in chunk order once all chunks have been explored.
+ */
+struct Sequence_chunk{
+	Sequence_chunk(): alignments() , err_rate_p() , marginals() , max_proba_scenario(0) , shared_max_proba_scenario_p(nullptr) , explored_branches(0) , pruned_branches(0) , rejected_scenarios(0) , budget_exceeded(false) , exception_message(){}
+	std::unordered_map<Gene_class , std::vector<Alignment_data>> alignments;
+	std::shared_ptr<Error_rate> err_rate_p; //Accumulates the sequence counters of the chunk, reused across sequences (see Exploration_workspace::chunk_err_rates)
+	std::vector<std::pair<size_t,long double>> marginals; //Touched single sequence marginals entries
+	double max_proba_scenario;
+	std::atomic<double>* shared_max_proba_scenario_p; //Best scenario probability of the sequence, shared by all its chunks
+	size_t explored_branches;
+	size_t pruned_branches;
+	size_t rejected_scenarios;
+	bool budget_exceeded; //The exploration of the chunk exhausted the sequence budget
+	std::string exception_message; //Set if the exploration of the chunk threw
+};
+
 /**
  * Hardcode a data structure for the function extracting CDR3s in generated sequences
  */
@@ -159,6 +231,7 @@ public:
 	bool infer_model(const std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class , std::vector<Alignment_data>>>>& sequences ,const  int iterations ,const std::string path, bool fast_iter , double likelihood_threshold=1e-25 , bool viterbi_like=false);
 	bool infer_model(const std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class , std::vector<Alignment_data>>>>& sequences ,const  int iterations ,const std::string path, bool fast_iter=true , double likelihood_threshold=1e-25 , double proba_threshold_factor=0.001 );
 	bool infer_model(const std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class , std::vector<Alignment_data>>>>& sequences ,const  int iterations ,const std::string path, bool fast_iter , double likelihood_threshold , bool viterbi_like , double proba_threshold_factor , double mean_number_seq_err_thresh = INFINITY);
+	bool evaluate_seq_stream(Aligned_seq_queue& seq_queue , const std::string path , double likelihood_threshold , bool viterbi_like , double proba_threshold_factor , double mean_number_seq_err_thresh = INFINITY);
 
 	std::forward_list<std::pair<std::string , std::queue<std::queue<int>>>> generate_sequences (int,bool);
 	void generate_sequences(int,bool,std::string,std::string,std::list<std::pair<gen_seq_trans,std::shared_ptr<void>>> = std::list<std::pair<gen_seq_trans,std::shared_ptr<void>>>(),bool output_only_func = false , int=-1);
@@ -167,6 +240,13 @@ public:
 	bool readtxt ();
 	void write_seq2txt(std::string,std::forward_list<std::string>);
 	void write_seq_real2txt(std::string , std::string , std::forward_list<std::pair<std::string , std::queue<std::queue<int>>>>);
+	void set_junction_dp(bool use_junction_dp){junction_dp = use_junction_dp;}
+	void set_skeleton_cache(size_t max_memory_mb , int reexplore_period){skeleton_cache_memory = max_memory_mb*1024*1024; skeleton_reexplore_period = reexplore_period;}
+	void set_scenario_ordering(Scenario_ordering ordering , bool greedy_seed){scenario_ordering = ordering; greedy_seed_pass = greedy_seed;}
+	void set_read_proba_bounds(bool use_read_bounds){read_proba_bounds = use_read_bounds;}
+	void set_generic_scenario_engine(bool use_generic_engine){generic_scenario_engine = use_generic_engine;}
+	void set_sequence_splitting(size_t max_chunk_alignments){split_chunk_alignments = max_chunk_alignments;}
+	void set_sequence_budget(size_t max_explored_branches , double max_seconds){seq_max_explored_branches = max_explored_branches; seq_max_seconds = max_seconds;}
 
 	//write alignments, load alignments
 
@@ -174,6 +254,17 @@ private:
 	Model_Parms model_parms;
 	Model_marginals model_marginals;
 	std::map<size_t,std::shared_ptr<Counter>> counters_list;//Size_t is a unique identifier for the Counter(useful for adding them up)
+	bool junction_dp;//Sum over scenarios with the junction forward/backward evaluator when the model allows it
+	size_t skeleton_cache_memory;//Memory budget (bytes) to replay the scenarios of each sequence across iterations, 0 to disable
+	int skeleton_reexplore_period;
+	Scenario_ordering scenario_ordering;//Order of exploration of the gene alignments
+	bool greedy_seed_pass;//Seed the best scenario probability of each sequence by exploring its best alignments first
+	bool read_proba_bounds;//Bound the contribution of the gene choices not yet explored using the read's alignments (see init_read_proba_bounds())
+	bool generic_scenario_engine;//Call all events through their virtual methods (reference path, see Scenario_engine)
+	size_t split_chunk_alignments;//Sequences with more alignments for the first gene choice are explored as OpenMP tasks over chunks of at most this many alignments, 0 to disable
+	size_t seq_max_explored_branches;//Exploration budget of each sequence in explored partial scenarios, 0 for no limit
+	double seq_max_seconds;//Exploration budget of each sequence in seconds, 0 for no limit
+	bool run_inference(const std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class , std::vector<Alignment_data>>>>* sequences_p , Aligned_seq_queue* seq_queue_p ,const  int iterations ,const std::string path, bool fast_iter , double likelihood_threshold , bool viterbi_like , double proba_threshold_factor , double mean_number_seq_err_thresh);
 	std::pair<std::string , std::queue<std::queue<int>>> generate_unique_sequence(std::queue<std::shared_ptr<Rec_Event>> , std::unordered_map<Rec_Event_name,int> , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::mt19937_64& , bool =true);
 	Model_marginals compute_marginals(std::list<std::string> sequences);
 	Model_marginals compute_seq_marginals (std::string sequence);
@@ -182,6 +273,18 @@ private:
 };
 
 std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class , std::vector<Alignment_data>>>> get_best_aligns (const std::vector<std::tuple<int,std::string,std::unordered_map<Gene_class , std::vector<Alignment_data>>>>&, Gene_class);
+void set_viterbi_run(std::queue<std::shared_ptr<Rec_Event>> , Error_rate& , bool);
+void resolve_realization_indices(const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>&);
+void order_alignments_best_first(const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , Error_rate& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , std::unordered_map<Gene_class , std::vector<Alignment_data>>&);
+std::string scenario_ordering_name(Scenario_ordering);
+double estimate_sequence_cost(const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>&);
+std::vector<size_t> decreasing_cost_order(const std::vector<double>&);
+std::string sequence_cost_model_summary(const std::vector<double>& , const std::vector<double>&);
+std::vector<Sequence_chunk> split_alignments(const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , Gene_class , size_t , double);
+void explore_sequence_chunk(Exploration_workspace& , const std::string& , const Int_Str& , bool , double , size_t , std::chrono::steady_clock::time_point , Sequence_chunk&);
+void explore_sequence_chunks(Exploration_workspace& , const std::string& , const Int_Str& , bool , double , size_t , std::chrono::steady_clock::time_point , std::vector<Sequence_chunk>& , std::atomic<size_t>&);
+void add_sequence_chunk(const Sequence_chunk& , Model_marginals& , Touched_marginals_indices& , Error_rate&);
+void init_read_proba_bounds(const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , Error_rate& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , size_t , Downstream_scenario_proba_bound_map&);
 
 
 
@@ -24,6 +24,7 @@
  */
 
 #include "Genechoice.h"
+#include "Scenarioengine.h"
 
 using namespace std;
 
@@ -42,7 +43,8 @@ Gene_choice::Gene_choice(Gene_class gene): Rec_Event(gene , Undefined_side ),
 		base_index(-1) , new_scenario_proba(-1) , new_tmp_err_w_proba(-1) , proba_contribution(-1) , new_index(-1) , alignment_offset_p(NULL),
 		memory_layer_cs(-1) , memory_layer_mismatches(-1) , memory_layer_safety_1(-1) , memory_layer_safety_2(-1) , memory_layer_off_threep(-1) , memory_layer_off_fivep(-1) , memory_layer_offset_check1(-1) , memory_layer_offset_check2(-1) ,
 		v_chosen(false) , v_choice_exist(true) , d_chosen(false) , d_choice_exist(false) , j_chosen(false) , j_choice_exist(true),
-		d_5_max_del(INT16_MIN) , d_5_min_del(INT16_MAX) , d_5_real_max_del(INT16_MIN) , j_5_max_del(INT16_MIN) , j_5_min_del(INT16_MIN) , v_3_max_del(INT16_MIN) , v_3_min_del(INT16_MAX) , d_3_max_del(INT16_MIN) , d_3_min_del(INT16_MAX){
+		d_5_max_del(INT16_MIN) , d_5_min_del(INT16_MAX) , d_5_real_max_del(INT16_MIN) , j_5_max_del(INT16_MIN) , j_5_min_del(INT16_MIN) , v_3_max_del(INT16_MIN) , v_3_min_del(INT16_MAX) , d_3_max_del(INT16_MIN) , d_3_min_del(INT16_MAX),
+		read_vj_junction_bound(false) , alignment_vj_junction(false) , read_vj_junction_bounds_set(false){
 	this->type = Event_type::GeneChoice_t;
 	this->update_event_name();
 }
@@ -109,7 +111,19 @@ void Gene_choice::set_genomic_templates(const vector<pair<string,string>>& genom
 
 
 
-void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bound_map& downstream_proba_map ,const string& sequence , const Int_Str& int_sequence , Index_map& base_index_map , const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map , shared_ptr<Next_event_ptr>& next_event_ptr_arr , Marginal_array_p& updated_marginals_pointer , const Marginal_array_p& model_parameters_pointer ,const unordered_map<Gene_class , vector<Alignment_data>>& allowed_realizations , Seq_type_str_p_map& constructed_sequences , Seq_offsets_map& seq_offsets ,shared_ptr<Error_rate>& error_rate_p , map<size_t,shared_ptr<Counter>>& counters_list , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map  , Safety_bool_map& safety_set , Mismatch_vectors_map& mismatches_lists, double& seq_max_prob_scenario , double& proba_threshold_factor){
+void Gene_choice::iterate(double& scenario_proba , Scenario_context& context){
+	Downstream_scenario_proba_bound_map& downstream_proba_map = context.downstream_proba_map;
+	const string& sequence = context.sequence;
+	const Int_Str& int_sequence = context.int_sequence;
+	Index_map& base_index_map = context.index_map;
+	const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map = context.offset_map;
+	const Marginal_array_p& model_parameters_pointer = context.model_parameters;
+	const unordered_map<Gene_class , vector<Alignment_data>>& allowed_realizations = context.allowed_realizations;
+	Seq_type_str_p_map& constructed_sequences = context.constructed_sequences;
+	Seq_offsets_map& seq_offsets = context.seq_offsets;
+	shared_ptr<Error_rate>& error_rate_p = context.error_rate_p;
+	Safety_bool_map& safety_set = context.safety_set;
+	Mismatch_vectors_map& mismatches_lists = context.mismatches_lists;
 	base_index = base_index_map.at(this->event_index);
 
 
@@ -172,18 +186,18 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 				if((*iter).offset>=0){
 					//gene_seq = this->event_realizations.at((*iter).gene_name).value_str ;
 					//Use integer sequence (allow indexing on nucleotide identity)
-					gene_seq = this->event_realizations.at((*iter).gene_name).value_str_int ;
+					gene_seq = get_aligned_realization(*iter).value_str_int ;
 					v_5_off = (*iter).offset;
 				}
 				else{
 					//If the offset is negative then the whole V-gene is not visible in the sequence thus only the aligned part of the gene is used.
 					//gene_seq = this->event_realizations.at((*iter).gene_name).value_str.substr( -(*iter).offset ) ;
 					//Use integer sequence (allow indexing on nucleotide identity)
-					gene_seq = this->event_realizations.at((*iter).gene_name).value_str_int.substr( -(*iter).offset ) ;
+					gene_seq = Int_Str_view(get_aligned_realization(*iter).value_str_int).substr( -(*iter).offset ) ;
 					v_5_off = 0;
 				}
 				//Insert the gene sequence as the constructed V gene sequence
-				constructed_sequences.set_value(V_gene_seq , &gene_seq , memory_layer_cs);
+				constructed_sequences.set_value(V_gene_seq , gene_seq , memory_layer_cs);
 
 
 				//Compute v_3_offset
@@ -224,14 +238,14 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 				}
 
 				//Compute gene choice realization index
-				current_realizations_index_vec[0] = this->event_realizations.at((*iter).gene_name).index;
+				current_realizations_index_vec[0] = get_aligned_realization(*iter).index;
 				new_index = base_index + current_realizations_index_vec[0];
 				new_scenario_proba = scenario_proba;
 				//new_tmp_err_w_proba = tmp_err_w_proba;
 				proba_contribution=1;
 
 				//State pointers
-				current_realization_index = &this->event_realizations.at((*iter).gene_name).index;
+				current_realization_index = &get_aligned_realization(*iter).index;
 				alignment_offset_p = &(*iter).offset;
 
 				proba_contribution = iterate_common( proba_contribution , current_realizations_index_vec[0] , base_index , base_index_map  , offset_map , model_parameters_pointer );
@@ -250,18 +264,25 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 				//Update downstream proba map and compute the downstream proba bound for this event
 					scenario_upper_bound_proba = new_scenario_proba;
 
+					//Junction length proba bounds given the chosen parents of the downstream events
+					const map<int,double>& vd_length_proba_map = vd_length_proba_bounds.get_length_proba_map(vd_length_best_proba_map , model_parameters_pointer , base_index_map);
+					const map<int,double>& vj_length_proba_map = vj_length_proba_bounds.get_length_proba_map(vj_length_best_proba_map , model_parameters_pointer , base_index_map);
 					//Get VD or VJ junction upper bound proba
 					if(d_chosen){
-						if(vd_length_best_proba_map.count(d_offset - v_3_off -1)<=0){
+						if(vd_length_proba_map.count(d_offset - v_3_off -1)<=0){
 							continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 						}
-						downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(d_offset - v_3_off -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(VD_ins_seq , vd_length_proba_map.at(d_offset - v_3_off -1) , memory_layer_proba_map_junction);
 					}
 					else if(j_chosen){
-						if(vj_length_best_proba_map.count(j_offset - v_3_off -1)<=0){
+						if(vj_length_proba_map.count(j_offset - v_3_off -1)<=0){
 							continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 						}
-						downstream_proba_map.set_value(VJ_ins_seq , vj_length_best_proba_map.at(j_offset - v_3_off -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(VJ_ins_seq , vj_length_proba_map.at(j_offset - v_3_off -1) , memory_layer_proba_map_junction);
+					}
+					else if(read_vj_junction_bound){
+						//J not chosen yet: best VJ junction length bound over the read's J alignments
+						downstream_proba_map.set_value(VJ_ins_seq , get_read_vj_junction_bound(v_3_off) , memory_layer_proba_map_junction);
 					}
 
 					//Count the number of mismatches that will not go away whatever the number off deletions
@@ -272,17 +293,18 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 						++endogeneous_mismatches;
 						++mism_iter;
 					}
-					downstream_proba_map.set_value(V_gene_seq , error_rate_p->get_err_rate_upper_bound(endogeneous_mismatches,gene_seq.size()-v_3_max_del-endogeneous_mismatches) , memory_layer_proba_map_seq);
+					//Error free nucleotides left with the maximum number of deletions (palindromic nucleotides are not aligned and cannot be counted)
+					downstream_proba_map.set_value(V_gene_seq , error_rate_p->get_err_rate_upper_bound(endogeneous_mismatches,max((int) gene_seq.size() + min(v_3_max_del,0) - (int) endogeneous_mismatches , 0)) , memory_layer_proba_map_seq);
 
 					//Multiply all downstream probas
 					downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
 				//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-				if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+				if(context.is_pruned(scenario_upper_bound_proba)){
 					continue;
 				}
 
-				Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_pointer  , model_parameters_pointer , allowed_realizations , constructed_sequences  , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
+				Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 			}
 	}
 			break;
@@ -347,9 +369,9 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 			for(vector<Alignment_data>::const_iterator iter = allowed_realizations.at(D_gene).begin() ; iter != allowed_realizations.at(D_gene).end() ; ++iter ){
 
 				//gene_seq = this->event_realizations.at((*iter).gene_name).value_str;
-				gene_seq = this->event_realizations.at((*iter).gene_name).value_str_int;
+				gene_seq = get_aligned_realization(*iter).value_str_int;
 
-				constructed_sequences.set_value(D_gene_seq,&gene_seq,memory_layer_cs);
+				constructed_sequences.set_value(D_gene_seq,gene_seq,memory_layer_cs);
 
 				d_5_off = (*iter).offset;
 				d_3_off = (*iter).offset +  gene_seq.size()-1;
@@ -387,7 +409,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 				//FIXME deal with state pointers for D
 
 
-				current_realizations_index_vec[0] = this->event_realizations.at((*iter).gene_name).index;
+				current_realizations_index_vec[0] = get_aligned_realization(*iter).index;
 				new_index = base_index + current_realizations_index_vec[0];
 				new_scenario_proba = scenario_proba;
 				//new_tmp_err_w_proba = tmp_err_w_proba;
@@ -407,26 +429,29 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 				//Update downstream proba map and compute the downstream proba bound for this event
 					scenario_upper_bound_proba = new_scenario_proba;
 
+					//Junction length proba bounds given the chosen parents of the downstream events
+					const map<int,double>& vd_length_proba_map = vd_length_proba_bounds.get_length_proba_map(vd_length_best_proba_map , model_parameters_pointer , base_index_map);
+					const map<int,double>& dj_length_proba_map = dj_length_proba_bounds.get_length_proba_map(dj_length_best_proba_map , model_parameters_pointer , base_index_map);
 					//Get DJ or VJ junction upper bound proba
 					if(v_chosen and j_chosen){
-						if(vd_length_best_proba_map.count(d_5_off - v_offset -1)<=0 or dj_length_best_proba_map.count(j_offset - d_3_off  -1)<=0){
+						if(vd_length_proba_map.count(d_5_off - v_offset -1)<=0 or dj_length_proba_map.count(j_offset - d_3_off  -1)<=0){
 							continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 						}
 						downstream_proba_map.set_value(VJ_ins_seq, 1.0 , memory_layer_proba_map_junction);
-						downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
-						downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(j_offset - d_3_off  -1) , memory_layer_proba_map_junction_d3);
+						downstream_proba_map.set_value(VD_ins_seq , vd_length_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
+						downstream_proba_map.set_value(DJ_ins_seq , dj_length_proba_map.at(j_offset - d_3_off  -1) , memory_layer_proba_map_junction_d3);
 					}
 					else if(v_chosen){
-						if(vd_length_best_proba_map.count(d_5_off - v_offset -1)<=0){
+						if(vd_length_proba_map.count(d_5_off - v_offset -1)<=0){
 							continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 						}
-						downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
+						downstream_proba_map.set_value(VD_ins_seq , vd_length_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
 					}
 					else if(j_chosen){
-						if(dj_length_best_proba_map.count(j_offset - d_3_off  -1)<=0){
+						if(dj_length_proba_map.count(j_offset - d_3_off  -1)<=0){
 							continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 						}
-						downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(j_offset - d_3_off  -1) , memory_layer_proba_map_junction_d3);
+						downstream_proba_map.set_value(DJ_ins_seq , dj_length_proba_map.at(j_offset - d_3_off  -1) , memory_layer_proba_map_junction_d3);
 					}
 
 					//Count the number of mismatches that will not go away even with maximum number of deletions
@@ -451,11 +476,11 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 					downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
 				//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-				if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+				if(context.is_pruned(scenario_upper_bound_proba)){
 					continue;
 				}
 				no_d_align = false;
-				Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_pointer  , model_parameters_pointer , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
+				Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 			}
 
 			if(no_d_align){
@@ -467,10 +492,10 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 				if(v_chosen and j_chosen){
 					int vj_len = j_offset - v_offset - 1;
 					if(vj_length_d_position_proba.count(vj_len)!=0){
-						const vector<tuple<string,int,int,double>>& d_positions_vector = vj_length_d_position_proba.at(vj_len);
-						for(vector<tuple<string,int,int,double>>::const_iterator d_position_iter = d_positions_vector.begin() ; d_position_iter!=d_positions_vector.end() ; ++d_position_iter){
+						const vector<tuple<int,int,int,double>>& d_positions_vector = vj_length_d_position_proba.at(vj_len);
+						for(vector<tuple<int,int,int,double>>::const_iterator d_position_iter = d_positions_vector.begin() ; d_position_iter!=d_positions_vector.end() ; ++d_position_iter){
 
-							const Event_realization& d_real = this->event_realizations.at(get<0>(*d_position_iter));
+							const Event_realization& d_real = *realizations_by_index[get<0>(*d_position_iter)];
 
 							//d_5_off is v 3' offset + vd junction length
 							d_5_off = v_offset + get<1>(*d_position_iter);
@@ -489,7 +514,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 							}
 
 							gene_seq = d_real.value_str_int;
-							constructed_sequences.set_value(D_gene_seq,&gene_seq,memory_layer_cs);
+							constructed_sequences.set_value(D_gene_seq,gene_seq,memory_layer_cs);
 
 							current_realizations_index_vec[0] = d_real.index;
 							new_index = base_index + current_realizations_index_vec[0];
@@ -509,9 +534,20 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 										continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 									}*/
 									downstream_proba_map.set_value(VJ_ins_seq, 1.0 , memory_layer_proba_map_junction);
+									downstream_proba_map.set_value(D_gene_seq , 1.0 , memory_layer_proba_map_seq); //Lift the penalty on D gene seq
+
+									//The positions are sorted by decreasing best D gene prior (over the realizations of its parents) times junction length bounds, once this bound is pruned so are the following positions
+									double position_upper_bound_proba = scenario_proba*get<3>(*d_position_iter);
+									downstream_proba_map.set_value(VD_ins_seq , 1.0 , memory_layer_proba_map_junction_d2);
+									downstream_proba_map.set_value(DJ_ins_seq , 1.0 , memory_layer_proba_map_junction_d3);
+									downstream_proba_map.multiply_all(position_upper_bound_proba,current_downstream_proba_memory_layers);
+									if(position_upper_bound_proba < context.seq_max_prob_scenario*context.proba_threshold_factor){
+										++context.pruned_branches;
+										break;
+									}
+
 									downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(get<1>(*d_position_iter)) , memory_layer_proba_map_junction_d2);
 									downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(get<2>(*d_position_iter)) , memory_layer_proba_map_junction_d3);
-									downstream_proba_map.set_value(D_gene_seq , 1.0 , memory_layer_proba_map_seq); //Lift the penalty on D gene seq
 
 	/*							}
 								else if(v_chosen){
@@ -531,9 +567,8 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 									downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
 
-							//If even without taking the weight of errors into account not good, then any lower one not good
-								if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
-									break;
+								if(context.is_pruned(scenario_upper_bound_proba)){
+									continue;
 								}
 
 
@@ -567,7 +602,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 								scenario_upper_bound_proba = new_scenario_proba;
 								downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
-								if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+								if(context.is_pruned(scenario_upper_bound_proba)){
 									continue;
 								}
 
@@ -580,7 +615,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 							seq_offsets.set_value(D_gene_seq,Five_prime,d_5_off,memory_layer_off_fivep);
 							seq_offsets.set_value(D_gene_seq,Three_prime,d_5_off+d_size-1,memory_layer_off_threep);
 
-							Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_pointer  , model_parameters_pointer , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
+							Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 
 						}
 
@@ -623,7 +658,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 
 						//Always the same sequence for the given D
 						gene_seq = (*d_gene_iter).second.value_str_int;
-						constructed_sequences.set_value(D_gene_seq,&gene_seq,memory_layer_cs);
+						constructed_sequences.set_value(D_gene_seq,gene_seq,memory_layer_cs);
 
 						current_realizations_index_vec[0] = d_gene_iter->second.index;
 						new_index = base_index + current_realizations_index_vec[0];
@@ -633,7 +668,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 						proba_contribution = iterate_common( proba_contribution , current_realizations_index_vec[0] , base_index , base_index_map , offset_map , model_parameters_pointer );
 						//new_tmp_err_w_proba = tmp_err_w_proba*proba_contribution;
 	/*					compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-						if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+						if(context.is_pruned(scenario_upper_bound_proba)){
 							continue;
 						}*/
 
@@ -673,26 +708,29 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 							//Update downstream proba map and compute the downstream proba bound for this event
 								scenario_upper_bound_proba = new_scenario_proba;
 
+								//Junction length proba bounds given the chosen parents of the downstream events
+								const map<int,double>& vd_length_proba_map = vd_length_proba_bounds.get_length_proba_map(vd_length_best_proba_map , model_parameters_pointer , base_index_map);
+								const map<int,double>& dj_length_proba_map = dj_length_proba_bounds.get_length_proba_map(dj_length_best_proba_map , model_parameters_pointer , base_index_map);
 								//Get DJ or VJ junction upper bound proba
 								if(v_chosen and j_chosen){
-									if(vd_length_best_proba_map.count(d_5_off - v_offset -1)<=0 or dj_length_best_proba_map.count(j_offset - d_full_3_offset  -1)<=0){
+									if(vd_length_proba_map.count(d_5_off - v_offset -1)<=0 or dj_length_proba_map.count(j_offset - d_full_3_offset  -1)<=0){
 										continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 									}
 									downstream_proba_map.set_value(VJ_ins_seq, 1.0 , memory_layer_proba_map_junction);
-									downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
-									downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(j_offset - d_full_3_offset  -1) , memory_layer_proba_map_junction_d3);
+									downstream_proba_map.set_value(VD_ins_seq , vd_length_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
+									downstream_proba_map.set_value(DJ_ins_seq , dj_length_proba_map.at(j_offset - d_full_3_offset  -1) , memory_layer_proba_map_junction_d3);
 								}
 								else if(v_chosen){
-									if(vd_length_best_proba_map.count(d_5_off - v_offset -1)<=0){
+									if(vd_length_proba_map.count(d_5_off - v_offset -1)<=0){
 										continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 									}
-									downstream_proba_map.set_value(VD_ins_seq , vd_length_best_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
+									downstream_proba_map.set_value(VD_ins_seq , vd_length_proba_map.at(d_5_off - v_offset -1) , memory_layer_proba_map_junction_d2);
 								}
 								else if(j_chosen){
-									if(dj_length_best_proba_map.count(j_offset - d_full_3_offset  -1)<=0){
+									if(dj_length_proba_map.count(j_offset - d_full_3_offset  -1)<=0){
 										continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 									}
-									downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(j_offset - d_full_3_offset  -1) , memory_layer_proba_map_junction_d3);
+									downstream_proba_map.set_value(DJ_ins_seq , dj_length_proba_map.at(j_offset - d_full_3_offset  -1) , memory_layer_proba_map_junction_d3);
 								}
 
 								//Count the number of mismatches that will not go away even with maximum number of deletions
@@ -717,12 +755,12 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 								downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
 							//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-							if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+							if(context.is_pruned(scenario_upper_bound_proba)){
 								continue;
 							}
 
 
-							Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_pointer  , model_parameters_pointer , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
+							Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 
 							//test++;
 
@@ -833,7 +871,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 					}
 				}
 
-				current_realizations_index_vec[0] = this->event_realizations.at((*iter).gene_name).index;
+				current_realizations_index_vec[0] = get_aligned_realization(*iter).index;
 				new_index = base_index + current_realizations_index_vec[0];
 				new_scenario_proba = scenario_proba;
 				//new_tmp_err_w_proba = tmp_err_w_proba;
@@ -841,7 +879,7 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 
 
 				//State pointers
-				current_realization_index = &this->event_realizations.at((*iter).gene_name).index;
+				current_realization_index = &get_aligned_realization(*iter).index;
 				alignment_offset_p = &(*iter).offset;
 
 
@@ -853,9 +891,9 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 
 				//Compute the number of nucleotides at the end of the sequence that are not aligned with the J-gene and remove them
 				//gene_seq = this->event_realizations.at((*iter).gene_name).value_str.substr(0,sequence.size() - (*iter).offset);
-				gene_seq = this->event_realizations.at((*iter).gene_name).value_str_int.substr(0,sequence.size() - (*iter).offset);
+				gene_seq = Int_Str_view(get_aligned_realization(*iter).value_str_int).substr(0,sequence.size() - (*iter).offset);
 
-				constructed_sequences.set_value(J_gene_seq , &gene_seq , memory_layer_cs);
+				constructed_sequences.set_value(J_gene_seq , gene_seq , memory_layer_cs);
 
 				seq_offsets.set_value(J_gene_seq,Five_prime,(*iter).offset,memory_layer_off_fivep);
 				seq_offsets.set_value(J_gene_seq,Three_prime,(*iter).offset + gene_seq.size()-1,memory_layer_off_threep);
@@ -867,18 +905,25 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 				//Update downstream proba map and compute the downstream proba bound for this event
 					scenario_upper_bound_proba = new_scenario_proba;
 
+					//Junction length proba bounds given the chosen parents of the downstream events
+					const map<int,double>& dj_length_proba_map = dj_length_proba_bounds.get_length_proba_map(dj_length_best_proba_map , model_parameters_pointer , base_index_map);
+					const map<int,double>& vj_length_proba_map = vj_length_proba_bounds.get_length_proba_map(vj_length_best_proba_map , model_parameters_pointer , base_index_map);
 					//Get DJ or VJ junction upper bound proba
 					if(d_chosen){
-						if(dj_length_best_proba_map.count( j_5_off - d_offset  -1)<=0){
+						if(dj_length_proba_map.count( j_5_off - d_offset  -1)<=0){
 							continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 						}
-						downstream_proba_map.set_value(DJ_ins_seq , dj_length_best_proba_map.at(j_5_off - d_offset  -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(DJ_ins_seq , dj_length_proba_map.at(j_5_off - d_offset  -1) , memory_layer_proba_map_junction);
 					}
 					else if(v_chosen){
-						if(vj_length_best_proba_map.count(j_5_off - v_offset -1)<=0){
+						if(vj_length_proba_map.count(j_5_off - v_offset -1)<=0){
 							continue; //This means no scenario can lead to a correct solution, would need to be changed for Error models with in/dels
 						}
-						downstream_proba_map.set_value(VJ_ins_seq , vj_length_best_proba_map.at(j_5_off - v_offset -1) , memory_layer_proba_map_junction);
+						downstream_proba_map.set_value(VJ_ins_seq , vj_length_proba_map.at(j_5_off - v_offset -1) , memory_layer_proba_map_junction);
+					}
+					else if(read_vj_junction_bound){
+						//V not chosen yet: best VJ junction length bound over the read's V alignments
+						downstream_proba_map.set_value(VJ_ins_seq , get_read_vj_junction_bound(j_5_off) , memory_layer_proba_map_junction);
 					}
 
 					//Count the number of mismatches that will not go away even with maximum number of deletions
@@ -889,17 +934,18 @@ void Gene_choice::iterate( double& scenario_proba , Downstream_scenario_proba_bo
 						++endogeneous_mismatches;
 						++rev_mism_iter;
 					}
-					downstream_proba_map.set_value(J_gene_seq , error_rate_p->get_err_rate_upper_bound(endogeneous_mismatches,gene_seq.size()-j_5_max_del-endogeneous_mismatches) , memory_layer_proba_map_seq);
+					//Error free nucleotides left with the maximum number of deletions (palindromic nucleotides are not aligned and cannot be counted)
+					downstream_proba_map.set_value(J_gene_seq , error_rate_p->get_err_rate_upper_bound(endogeneous_mismatches,max((int) gene_seq.size() + min(j_5_max_del,0) - (int) endogeneous_mismatches , 0)) , memory_layer_proba_map_seq);
 
 					//Multiply all downstream probas
 					downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
 				//compute_upper_bound_scenario_proba(new_tmp_err_w_proba);
-				if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+				if(context.is_pruned(scenario_upper_bound_proba)){
 					continue;
 				}
 
-				Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_pointer  , model_parameters_pointer , allowed_realizations , constructed_sequences  , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
+				Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 			}
 		}
 			break;
@@ -1028,6 +1074,10 @@ void Gene_choice::initialize_event( unordered_set<Rec_Event_name>& processed_eve
 		j_chosen=false;
 	}
 
+	//The first of the V and J choices can bound the VJ junction with the read's alignments of the other gene (see set_read_vj_junction_bounds())
+	read_vj_junction_bound = (not d_chosen) and ( ((this->event_class == V_gene) and j_choice_exist and (not j_chosen)) or ((this->event_class == J_gene) and v_choice_exist and (not v_chosen)) );
+	clear_read_vj_junction_bounds();
+
 	switch(this->event_class){
 		case V_gene:
 			seq_offsets.request_memory_layer(V_gene_seq,Three_prime);
@@ -1055,7 +1105,7 @@ void Gene_choice::initialize_event( unordered_set<Rec_Event_name>& processed_eve
 				downstream_proba_map.request_memory_layer(VD_ins_seq);
 				memory_layer_proba_map_junction = downstream_proba_map.get_current_memory_layer(VD_ins_seq);
 			}
-			else if(j_chosen){
+			else if(j_chosen or read_vj_junction_bound){
 				downstream_proba_map.request_memory_layer(VJ_ins_seq);
 				memory_layer_proba_map_junction = downstream_proba_map.get_current_memory_layer(VJ_ins_seq);
 			}
@@ -1142,7 +1192,7 @@ void Gene_choice::initialize_event( unordered_set<Rec_Event_name>& processed_eve
 					downstream_proba_map.request_memory_layer(DJ_ins_seq);
 					memory_layer_proba_map_junction = downstream_proba_map.get_current_memory_layer(DJ_ins_seq);
 				}
-				else if(v_chosen){
+				else if(v_chosen or read_vj_junction_bound){
 					downstream_proba_map.request_memory_layer(VJ_ins_seq);
 					memory_layer_proba_map_junction = downstream_proba_map.get_current_memory_layer(VJ_ins_seq);
 				}
@@ -1228,10 +1278,137 @@ void Gene_choice::initialize_event( unordered_set<Rec_Event_name>& processed_eve
 		j_5_min_del=0;
 		j_5_max_del=0;
 	}
+
+	//The VJ junction length of the last of the V and J choices only depends on the alignment offsets if no V 3' or J 5' deletion has been explored
+	alignment_vj_junction = (not d_chosen) and ( ((this->event_class == V_gene) and j_chosen) or ((this->event_class == J_gene) and v_chosen) );
+	for(const pair<Gene_class,Seq_side>& del_key : {make_pair(V_gene,Three_prime) , make_pair(J_gene,Five_prime)}){
+		if(events_map.count(tuple<Event_type,Gene_class,Seq_side>(Deletion_t,del_key.first,del_key.second)) != 0
+				and processed_events.count(events_map.at(tuple<Event_type,Gene_class,Seq_side>(Deletion_t,del_key.first,del_key.second))->get_name()) != 0){
+			alignment_vj_junction = false;
+		}
+	}
+	index_realizations();
 	this->Rec_Event::initialize_event(processed_events,events_map,offset_map,downstream_proba_map,constructed_sequences,safety_set,error_rate_p,mismatches_list,seq_offsets,index_map);
 
 }
 
+/*
+ * Build the direct access to the realizations by their index used during the exploration of the scenarios
+ */
+void Gene_choice::index_realizations(){
+	int max_index = -1;
+	for(unordered_map<string,Event_realization>::const_iterator iter = this->event_realizations.begin() ; iter != this->event_realizations.end() ; ++iter){
+		max_index = max(max_index , iter->second.index);
+	}
+	realizations_by_index.assign(max_index+1 , nullptr);
+	for(unordered_map<string,Event_realization>::const_iterator iter = this->event_realizations.begin() ; iter != this->event_realizations.end() ; ++iter){
+		if(iter->second.index >= 0){
+			realizations_by_index[iter->second.index] = &iter->second;
+		}
+	}
+}
+
+/*
+ * Also keeps for each gene its largest prior over all realizations of the conditioning events
+ * The realizations of the gene choice are the innermost dimension of its marginals (see Model_marginals::get_inverse_offset_map())
+ */
+void Gene_choice::set_crude_upper_bound_proba(size_t base_index , size_t event_size , Marginal_array_p& marginal_array_p){
+	Rec_Event::set_crude_upper_bound_proba(base_index , event_size , marginal_array_p);
+	const size_t n_realizations = this->size();
+	realization_upper_bound_probas.assign(n_realizations , 0.0);
+	for(size_t i = 0 ; i != event_size ; ++i){
+		double& realization_bound = realization_upper_bound_probas[i%n_realizations];
+		realization_bound = max(realization_bound , (double) marginal_array_p[base_index + i]);
+	}
+}
+
+/*
+ * Offset of the alignment's gene on the VJ junction side: V 3' offset (before deletions) or J 5' offset
+ */
+int Gene_choice::get_vj_junction_offset(const Alignment_data& alignment) const{
+	switch(this->event_class){
+		case V_gene:
+			return alignment.offset + (int) get_aligned_realization(alignment).value_str_int.size() - 1;
+		case J_gene:
+			return alignment.offset;
+		default:
+			throw invalid_argument("Gene_choice::get_vj_junction_offset() is only defined for V and J gene choices");
+	}
+}
+
+/*
+ * VJ junction length proba bound this gene choice sets for the given V 3' and J 5' offsets when it is the last of the V and J choices (0 if no scenario fits the junction)
+ */
+double Gene_choice::get_vj_junction_upper_bound_proba(int v_3_offset , int j_5_offset) const{
+	map<int,double>::const_iterator bound_iter = vj_length_best_proba_map.find(j_5_offset - v_3_offset - 1);
+	return (bound_iter != vj_length_best_proba_map.end()) ? bound_iter->second : 0.0;
+}
+
+/*
+ * Sets the VJ junction length proba bound of each offset (see get_vj_junction_offset()) of the read's alignments of this gene, maximized over the read's alignments of the other gene.
+ * Without read bounds (or for an offset absent from the map) the junction bound is 1 (resp. 0), such that the first of the V and J choices can prune the branches none of the other gene's alignments can complete.
+ */
+void Gene_choice::set_read_vj_junction_bounds(const unordered_map<int,double>& junction_bounds){
+	read_vj_junction_bounds = junction_bounds;
+	read_vj_junction_bounds_set = true;
+}
+
+void Gene_choice::clear_read_vj_junction_bounds(){
+	read_vj_junction_bounds.clear();
+	read_vj_junction_bounds_set = false;
+}
+
+/*
+ * Upper bound of the probability contribution of this gene choice for a read, before any gene has been chosen:
+ * the largest gene prior times the error rate bound of the mismatches that no deletion can remove, maximized over the read's alignments.
+ * The error term is the same as the one set in the downstream proba map when the gene is chosen in iterate(), such that the bound can only get tighter once the gene is chosen.
+ * The D gene prior is already part of the VJ junction length bound (see has_effect_on()) and D can be explored at positions that are not aligned, its bound is thus left to 1.
+ */
+double Gene_choice::get_read_upper_bound_proba(const vector<Alignment_data>& alignments , Error_rate& error_rate , size_t sequence_size) const{
+	if( (this->event_class != V_gene) and (this->event_class != J_gene) ){
+		return 1.0;
+	}
+
+	double read_bound = 0;
+	for(vector<Alignment_data>::const_iterator iter = alignments.begin() ; iter != alignments.end() ; ++iter){
+		const size_t full_size = get_aligned_realization(*iter).value_str_int.size();
+		size_t n_mismatches = 0;
+		long long n_error_free;
+		if(this->event_class == V_gene){
+			const size_t gene_size = ((*iter).offset >= 0) ? full_size : full_size + (*iter).offset;
+			const int v_3_offset = max((*iter).offset , 0) + (int) gene_size - 1;
+			vector<int>::const_iterator mism_it = iter->mismatches.begin();
+			while( (mism_it != iter->mismatches.end()) and ((*mism_it) <= v_3_offset + v_3_max_del) ){
+				++n_mismatches;
+				++mism_it;
+			}
+			n_error_free = (long long) gene_size + min(v_3_max_del,0) - n_mismatches;
+		}
+		else{
+			const size_t gene_size = min(full_size , sequence_size - (*iter).offset);
+			vector<int>::const_reverse_iterator rev_mism_it = iter->mismatches.rbegin();
+			while( (rev_mism_it != iter->mismatches.rend()) and ((*rev_mism_it) >= (*iter).offset - j_5_max_del) ){
+				++n_mismatches;
+				++rev_mism_it;
+			}
+			n_error_free = (long long) gene_size + min(j_5_max_del,0) - n_mismatches;
+		}
+		read_bound = max(read_bound , get_realization_upper_bound_proba(*iter)*error_rate.get_err_rate_upper_bound(n_mismatches , max(n_error_free , 0LL)));
+	}
+	return read_bound;
+}
+
+/**
+ * Store in each alignment the index of its gene among the realizations of this event, such that the gene name is not hashed for each explored alignment.
+ * Alignments whose gene is unknown to the event are left unresolved (and will raise an error if explored).
+ */
+void Gene_choice::resolve_realization_indices(const vector<Alignment_data>& alignments) const{
+	for(vector<Alignment_data>::const_iterator iter = alignments.begin() ; iter != alignments.end() ; ++iter){
+		unordered_map<string,Event_realization>::const_iterator real_iter = this->event_realizations.find(iter->gene_name);
+		iter->realization_index = (real_iter != this->event_realizations.end()) ? real_iter->second.index : -1;
+	}
+}
+
 
 /**
  * All add_to_marginals should take into account the possibility to perform viterbi runs(take only the most likely scenario into account)
@@ -1243,6 +1420,7 @@ void Gene_choice::add_to_marginals(long double scenario_proba , Marginal_array_p
 	else{
 		updated_marginals[this->new_index]+=scenario_proba;
 	}
+	record_touched_marginal(this->new_index);
 }
 
 bool Gene_choice::has_effect_on(Seq_type seq_type) const{
@@ -1271,32 +1449,15 @@ bool Gene_choice::has_effect_on(Seq_type seq_type) const{
 void Gene_choice::iterate_initialize_Len_proba(Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  std::queue<std::shared_ptr<Rec_Event>>& model_queue , double& scenario_proba , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int& seq_len/*=0*/ ) const{
 
 	if(this->has_effect_on(considered_junction)){
-		base_index = base_index_map.at(this->event_index,0);
+		const size_t len_base_index = base_index_map.at(this->event_index,0);
+		//Length and max proba (in case the event is child of another) of each realization
+		vector<pair<int,double>> length_shifts;
+		length_shifts.reserve(this->event_realizations.size());
 		for(unordered_map <string, Event_realization>::const_iterator iter = this->event_realizations.begin() ; iter!= this->event_realizations.end() ; ++iter){
-
-
-	/*		//Update base index map
-			for(forward_list<tuple<int,int,int>>::const_iterator jiter = memory_and_offsets.begin() ; jiter!=memory_and_offsets.end() ; ++jiter){
-				//Get previous index for the considered event
-				int previous_index = base_index_map.at(get<0>(*jiter),get<1>(*jiter)-1);
-				//Update the index given the realization and the offset
-				previous_index += iter->second.index *get<2>(*jiter);
-				//Set the value
-				base_index_map.set_value(get<0>(*jiter) , previous_index , get<1>(*jiter));
-			}*/
-
-
-			//Get the max proba for this realization (in case the event is child of another)
-			double real_max_proba = 0;
-			for(size_t i = 0 ; i!=this->event_marginal_size/this->size() ; ++i){
-				if(model_parameters_point[base_index + (*iter).second.index + i*this->size()]>real_max_proba){
-					real_max_proba = model_parameters_point[base_index + (*iter).second.index + i*this->size()];
-				}
-			}
-			//Update the length within and probability in the recursive call
-			Rec_Event::iterate_initialize_Len_proba_wrap_up(considered_junction , length_best_proba_map ,  model_queue ,  scenario_proba*real_max_proba , model_parameters_point , base_index_map , constructed_sequences , seq_len+(*iter).second.value_str.length());
-
+			length_shifts.emplace_back((*iter).second.value_str.length() , get_len_proba_realization_bound(len_base_index , (*iter).second.index , model_parameters_point));
 		}
+		//The gene sequence is not part of the constructed sequences read by the downstream events, these are explored once
+		Rec_Event::iterate_initialize_Len_proba_shifts(considered_junction , length_best_proba_map , model_queue , scenario_proba , length_shifts , model_parameters_point , base_index_map , constructed_sequences , seq_len);
 	}
 	else{
 		Rec_Event::iterate_initialize_Len_proba_wrap_up(considered_junction , length_best_proba_map ,  model_queue ,  scenario_proba , model_parameters_point , base_index_map , constructed_sequences , seq_len);
@@ -1309,31 +1470,35 @@ void Gene_choice::initialize_Len_proba_bound(queue<shared_ptr<Rec_Event>>& model
 	switch (this->event_class) {
 		case V_gene:
 			vd_length_best_proba_map.clear();
+			vd_length_proba_bounds.clear();
 			vj_length_best_proba_map.clear();
+			vj_length_proba_bounds.clear();
 
 			if(d_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				vd_length_proba_bounds.initialize(VD_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 			else if(j_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				vj_length_proba_bounds.initialize(VJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 			break;
 		case D_gene:
 			vd_length_best_proba_map.clear();
+			vd_length_proba_bounds.clear();
 			dj_length_best_proba_map.clear();
+			dj_length_proba_bounds.clear();
 			vj_length_d_position_proba.clear();
 
 			if(v_chosen){
-				double init_proba = 1.0;
 				constructed_sequences.reset();
-				this->Rec_Event::iterate_initialize_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(VD_ins_seq,vd_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				vd_length_proba_bounds.initialize(VD_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 			if(j_chosen){
-				double init_proba = 1.0;
 				constructed_sequences.reset();
-				this->Rec_Event::iterate_initialize_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				dj_length_proba_bounds.initialize(DJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 
 			if(v_chosen and j_chosen){
@@ -1357,17 +1522,17 @@ void Gene_choice::initialize_Len_proba_bound(queue<shared_ptr<Rec_Event>>& model
 							junction_len = d_gene_iter->second.value_str.size() + vd_len_iter->first + dj_len_iter->first;
 
 							if(vj_length_d_position_proba.count(junction_len)!=0){
-								vj_length_d_position_proba.at(junction_len).emplace_back(d_gene_iter->first,vd_len_iter->first,dj_len_iter->first,(d_gene_max_proba*vd_len_iter->second*dj_len_iter->second));
+								vj_length_d_position_proba.at(junction_len).emplace_back(d_gene_iter->second.index,vd_len_iter->first,dj_len_iter->first,(d_gene_max_proba*vd_len_iter->second*dj_len_iter->second));
 							}
 							else{
-								vj_length_d_position_proba.emplace(piecewise_construct,make_tuple(junction_len),make_tuple(1,make_tuple(d_gene_iter->first,vd_len_iter->first,dj_len_iter->first,(d_gene_max_proba*vd_len_iter->second*dj_len_iter->second))));
+								vj_length_d_position_proba.emplace(piecewise_construct,make_tuple(junction_len),make_tuple(1,make_tuple(d_gene_iter->second.index,vd_len_iter->first,dj_len_iter->first,(d_gene_max_proba*vd_len_iter->second*dj_len_iter->second))));
 							}
 						}
 					}
 				}
 
 				//Now sort each vector in the map in decreasing order of probability (according to the model)
-				for(map<int,vector<tuple<string,int,int,double>>>::iterator d_position_map_iter = vj_length_d_position_proba.begin() ; d_position_map_iter!=vj_length_d_position_proba.end() ; ++d_position_map_iter){
+				for(map<int,vector<tuple<int,int,int,double>>>::iterator d_position_map_iter = vj_length_d_position_proba.begin() ; d_position_map_iter!=vj_length_d_position_proba.end() ; ++d_position_map_iter){
 					sort(d_position_map_iter->second.begin(),d_position_map_iter->second.end(),D_position_tuple);
 				}
 			}
@@ -1375,15 +1540,17 @@ void Gene_choice::initialize_Len_proba_bound(queue<shared_ptr<Rec_Event>>& model
 			break;
 		case J_gene:
 			dj_length_best_proba_map.clear();
+			dj_length_proba_bounds.clear();
 			vj_length_best_proba_map.clear();
+			vj_length_proba_bounds.clear();
 
 			if(d_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(DJ_ins_seq,dj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				dj_length_proba_bounds.initialize(DJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 			else if(v_chosen){
-				double init_proba = 1.0;
-				this->Rec_Event::iterate_initialize_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+				this->initialize_downstream_Len_proba(VJ_ins_seq,vj_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences);
+				vj_length_proba_bounds.initialize(VJ_ins_seq , *this , model_queue , model_parameters_point , base_index_map);
 			}
 			break;
 		default:
@@ -62,7 +62,7 @@ public:
 	virtual ~Gene_choice();
 	//Virtual methods overload
 	std::shared_ptr<Rec_Event> copy();
-	inline void iterate(double& , Downstream_scenario_proba_bound_map& , const std::string& , const Int_Str& , Index_map& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::shared_ptr<Next_event_ptr>& , Marginal_array_p& , const Marginal_array_p& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , Seq_type_str_p_map& , Seq_offsets_map& , std::shared_ptr<Error_rate>& , std::map<size_t,std::shared_ptr<Counter>>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>> & , Safety_bool_map& , Mismatch_vectors_map& , double& , double&);
+	void iterate(double& , Scenario_context&);
 	void add_realization(int);
 	bool add_realization(std::string gene_name , std::string gene_sequence);
 	void set_genomic_templates(const std::vector<std::pair<std::string,std::string>>&);
@@ -70,6 +70,46 @@ public:
 	void write2txt(std::ofstream&);
 	void initialize_event( std::unordered_set<Rec_Event_name>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , Downstream_scenario_proba_bound_map& , Seq_type_str_p_map& , Safety_bool_map& , std::shared_ptr<Error_rate> ,Mismatch_vectors_map&,Seq_offsets_map&,Index_map&);
 	void add_to_marginals(long double , Marginal_array_p&) const;
+	void append_scenario_factors(std::vector<int>& factors) const{factors.push_back(new_index);} //Model parameter used by the current scenario (see Scenario_skeleton_cache)
+	void resolve_realization_indices(const std::vector<Alignment_data>&) const;
+
+	/**
+	 * Realization of an alignment, read from its resolved index when available to avoid hashing the gene name
+	 */
+	const Event_realization& get_aligned_realization(const Alignment_data& alignment) const{
+		if( (alignment.realization_index >= 0) and ((size_t) alignment.realization_index < realizations_by_index.size()) ){
+			return *realizations_by_index[alignment.realization_index];
+		}
+		return this->event_realizations.at(alignment.gene_name);
+	}
+
+	/**
+	 * Largest prior of the alignment's gene over all realizations of the conditioning events (see set_crude_upper_bound_proba())
+	 */
+	double get_realization_upper_bound_proba(const Alignment_data& alignment) const{
+		return realization_upper_bound_probas.at(get_aligned_realization(alignment).index);
+	}
+	void set_crude_upper_bound_proba(size_t , size_t , Marginal_array_p&);
+	double get_read_upper_bound_proba(const std::vector<Alignment_data>& , Error_rate& , size_t) const;
+	/**
+	 * Whether this gene choice is the first of the V and J choices and bounds the VJ junction with the alignments of the read (see set_read_vj_junction_bounds())
+	 */
+	bool bounds_read_vj_junction() const{return read_vj_junction_bound;}
+	/**
+	 * Whether this gene choice is the last of the V and J choices and reads its VJ junction length bound from the V and J alignment offsets only (no V 3' or J 5' deletion explored before)
+	 */
+	bool has_alignment_vj_junction() const{return alignment_vj_junction;}
+	int get_vj_junction_offset(const Alignment_data&) const;
+	double get_vj_junction_upper_bound_proba(int , int) const;
+	void set_read_vj_junction_bounds(const std::unordered_map<int,double>&);
+	void clear_read_vj_junction_bounds();
+	double get_read_vj_junction_bound(int junction_offset) const{
+		if(not read_vj_junction_bounds_set){
+			return 1.0;
+		}
+		std::unordered_map<int,double>::const_iterator bound_iter = read_vj_junction_bounds.find(junction_offset);
+		return (bound_iter != read_vj_junction_bounds.end()) ? bound_iter->second : 0.0;
+	}
 
 
 	//Proba bound related computation methods
@@ -81,6 +121,10 @@ public:
 
 private:
 	inline double iterate_common(double ,const int&  , int , Index_map& ,const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& ,const Marginal_array_p&);
+	void index_realizations();
+
+	std::vector<const Event_realization*> realizations_by_index; //Indexed by Event_realization::index
+	std::vector<double> realization_upper_bound_probas; //Indexed by Event_realization::index
 
 
 	//Inference variables
@@ -131,7 +175,7 @@ private:
 	double new_scenario_proba;
 	double new_tmp_err_w_proba;
 	double proba_contribution;
-	Int_Str gene_seq;
+	Int_Str_view gene_seq; //View on the realization's sequence
 	int new_index;
 	const int* alignment_offset_p;
 	std::vector<int>::const_iterator mism_iter;
@@ -177,9 +221,19 @@ private:
 		std::map<int,double> vd_length_best_proba_map;
 		std::map<int,double> vj_length_best_proba_map;
 		std::map<int,double> dj_length_best_proba_map;
+	//Downstream junction length proba bounds given the realizations of the parents of the downstream events
+		Conditional_length_proba_bounds vd_length_proba_bounds;
+		Conditional_length_proba_bounds vj_length_proba_bounds;
+		Conditional_length_proba_bounds dj_length_proba_bounds;
+
+	//Read VJ junction length proba bounds, by V 3' (resp. J 5') offset when V (resp. J) is chosen before J (resp. V)
+		bool read_vj_junction_bound;
+		bool alignment_vj_junction;
+		bool read_vj_junction_bounds_set;
+		std::unordered_map<int,double> read_vj_junction_bounds;
 
 	//No D prunning proba bound map
-		std::map<int,std::vector<std::tuple<std::string,int,int,double>>> vj_length_d_position_proba;
+		std::map<int,std::vector<std::tuple<int,int,int,double>>> vj_length_d_position_proba; //D realization index, VD and DJ lengths, proba bound
 
 		D_position_comparator D_position_tuple;
 
@@ -298,24 +298,24 @@ double Hypermutation_global_errorrate::compare_sequences_error_prob (double scen
 
 	scenario_resulting_sequence.clear();
 	if(v_gene){
-		scenario_resulting_sequence += (*constructed_sequences[V_gene_seq]);
+		scenario_resulting_sequence += constructed_sequences[V_gene_seq];
 	}
 	if(d_gene){
 		if(vd_ins){
-			scenario_resulting_sequence+=(*constructed_sequences[VD_ins_seq]);
+			scenario_resulting_sequence+=constructed_sequences[VD_ins_seq];
 		}
-		scenario_resulting_sequence+=(*constructed_sequences[D_gene_seq]);
+		scenario_resulting_sequence+=constructed_sequences[D_gene_seq];
 		if(dj_ins){
-			scenario_resulting_sequence+=(*constructed_sequences[DJ_ins_seq]);
+			scenario_resulting_sequence+=constructed_sequences[DJ_ins_seq];
 		}
 	}
 	else{
 		if(vj_ins){
-			scenario_resulting_sequence+=(*constructed_sequences[VJ_ins_seq]);
+			scenario_resulting_sequence+=constructed_sequences[VJ_ins_seq];
 		}
 	}
 	if(j_gene){
-		scenario_resulting_sequence+=(*constructed_sequences[J_gene_seq]);
+		scenario_resulting_sequence+=constructed_sequences[J_gene_seq];
 	}
 
 
@@ -1625,6 +1625,20 @@ void Hypermutation_global_errorrate::clean_seq_counters(){
 }
 
 
+void Hypermutation_global_errorrate::add_seq_counters(const Error_rate& err_r){
+	this->Error_rate::add_seq_counters(err_r);
+	const Hypermutation_global_errorrate& hypermutation_err_r = dynamic_cast<const Hypermutation_global_errorrate&>(err_r);
+	if(this->mutation_Nmer_size != hypermutation_err_r.mutation_Nmer_size){
+		throw invalid_argument("Cannot add sequence counters of hypermutation error rates with different Nmer sizes in Hypermutation_global_errorrate::add_seq_counters()");
+	}
+	size_t array_size = pow(4,mutation_Nmer_size);
+	for(size_t ii=0 ; ii != array_size ; ++ii){
+		one_seq_Nmer_N_SHM[ii] += hypermutation_err_r.one_seq_Nmer_N_SHM[ii];
+		one_seq_Nmer_N_bg[ii] += hypermutation_err_r.one_seq_Nmer_N_bg[ii];
+	}
+}
+
+
 void Hypermutation_global_errorrate::clean_all_counters(){
 
 	size_t array_size = pow(4,mutation_Nmer_size);
@@ -64,6 +64,7 @@ public:
 	void initialize(const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>&);
 	void add_to_norm_counter();
 	void clean_seq_counters();
+	void add_seq_counters(const Error_rate&);
 	void clean_all_counters();
 	void write2txt(std::ofstream&);
 	void set_output_Nmer_stream(std::string);
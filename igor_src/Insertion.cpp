@@ -25,6 +25,7 @@
  */
 
 #include "Insertion.h"
+#include "Scenarioengine.h"
 
 
 using namespace std;
@@ -93,7 +94,13 @@ bool Insertion::add_realization(int insertion_number){
 	return 0;
 }
 
-void Insertion::iterate(double& scenario_proba , Downstream_scenario_proba_bound_map& downstream_proba_map , const string& sequence , const Int_Str& int_sequence , Index_map& base_index_map , const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map , shared_ptr<Next_event_ptr>& next_event_ptr_arr , Marginal_array_p& updated_marginals_point , const Marginal_array_p& model_parameters_point ,const unordered_map<Gene_class , vector<Alignment_data>>& allowed_realizations , Seq_type_str_p_map& constructed_sequences , Seq_offsets_map& seq_offsets , shared_ptr<Error_rate>& error_rate_p , map<size_t,shared_ptr<Counter>>& counters_list , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , Safety_bool_map& safety_set , Mismatch_vectors_map& mismatches_lists, double& seq_max_prob_scenario , double& proba_threshold_factor){
+void Insertion::iterate(double& scenario_proba , Scenario_context& context){
+	Downstream_scenario_proba_bound_map& downstream_proba_map = context.downstream_proba_map;
+	Index_map& base_index_map = context.index_map;
+	const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map = context.offset_map;
+	const Marginal_array_p& model_parameters_point = context.model_parameters;
+	Seq_type_str_p_map& constructed_sequences = context.constructed_sequences;
+	Seq_offsets_map& seq_offsets = context.seq_offsets;
 	base_index = base_index_map.at(this->event_index);
 	new_scenario_proba = scenario_proba;
 	proba_contribution = 1;
@@ -138,9 +145,8 @@ void Insertion::iterate(double& scenario_proba , Downstream_scenario_proba_bound
 
 						proba_contribution = (*this).iterate_common( proba_contribution , insertions , base_index , base_index_map , offset_map , model_parameters_point);
 						if(proba_contribution!=0){
-							inserted_str.assign(insertions , -1);
-							new_index = base_index + this->event_realizations.at(to_string(insertions)).index; //FIXME this should not exist
-							constructed_sequences[VD_ins_seq]= &inserted_str;
+							new_index = base_index + realization_index;
+							constructed_sequences[VD_ins_seq] = unknown_nucleotides(insertions);
 							downstream_proba_map.set_value(VD_ins_seq,junction_length_best_proba_map.at(insertions),memory_layer_proba_map_junction);
 						}
 					//}
@@ -180,9 +186,8 @@ void Insertion::iterate(double& scenario_proba , Downstream_scenario_proba_bound
 
 
 					if(proba_contribution!=0){
-						inserted_str.assign(insertions , -1);
-						new_index = base_index + this->event_realizations.at(to_string(insertions)).index;
-						constructed_sequences[DJ_ins_seq]= &inserted_str;
+						new_index = base_index + realization_index;
+						constructed_sequences[DJ_ins_seq] = unknown_nucleotides(insertions);
 						downstream_proba_map.set_value(DJ_ins_seq,junction_length_best_proba_map.at(insertions),memory_layer_proba_map_junction);
 					}
 
@@ -230,9 +235,8 @@ void Insertion::iterate(double& scenario_proba , Downstream_scenario_proba_bound
 
 
 				if(proba_contribution!=0){
-					inserted_str.assign(insertions , -1);
-					new_index = base_index + realization_index;//this->event_realizations.at(to_string(insertions)).index;
-					constructed_sequences[VJ_ins_seq] = &inserted_str;
+					new_index = base_index + realization_index;
+					constructed_sequences[VJ_ins_seq] = unknown_nucleotides(insertions);
 					downstream_proba_map.set_value(VJ_ins_seq,junction_length_best_proba_map.at(insertions),memory_layer_proba_map_junction);
 				}
 
@@ -256,8 +260,8 @@ void Insertion::iterate(double& scenario_proba , Downstream_scenario_proba_bound
 		//Multiply all downstream probas
 		downstream_proba_map.multiply_all(scenario_upper_bound_proba,current_downstream_proba_memory_layers);
 
-		if(scenario_upper_bound_proba>=(seq_max_prob_scenario*proba_threshold_factor)){
-			Rec_Event::iterate_wrap_up(new_scenario_proba , downstream_proba_map , sequence , int_sequence , base_index_map , offset_map , next_event_ptr_arr  , updated_marginals_point  , model_parameters_point , allowed_realizations , constructed_sequences , seq_offsets , error_rate_p , counters_list , events_map , safety_set ,mismatches_lists,seq_max_prob_scenario,proba_threshold_factor);
+		if(not context.is_pruned(scenario_upper_bound_proba)){
+			Rec_Event::iterate_wrap_up(new_scenario_proba , context);
 		}
 	}
 }
@@ -267,12 +271,22 @@ void Insertion::iterate(double& scenario_proba , Downstream_scenario_proba_bound
 /*
  *This short method performs the iterate operations common to all Rec_event (modify index map and fetch realization probability)
  */
+/**
+ * Inserted sequence of unknown nucleotides (their identity is set by the downstream Dinucl_markov event if any), as a view on a buffer only grown when needed
+ */
+Int_Str_view Insertion::unknown_nucleotides(int n_insertions) const{
+	if(inserted_str.size() < (size_t) n_insertions){
+		inserted_str.assign(n_insertions , -1);
+	}
+	return Int_Str_view(inserted_str).substr(0 , n_insertions);
+}
+
 inline double Insertion::iterate_common(double scenario_proba , int insertions , int base_index , Index_map& base_index_map ,const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map ,const Marginal_array_p& model_parameters_point){
 
 	//insertions_str = to_string(insertions);
 	//TODO just output proba contribution no need to take it as argument
-	if(this->ordered_realization_map.count(insertions)>0){
-		realization_index = this->ordered_realization_map.at(insertions).index;
+	if( (insertions >= 0) and ((size_t) insertions < realization_index_by_insertions.size()) and (realization_index_by_insertions[insertions] >= 0) ){
+		realization_index = realization_index_by_insertions[insertions];
 		current_realizations_index_vec[0] = realization_index;
 	}else{
 		//discard out of range cases
@@ -378,6 +392,7 @@ void Insertion::add_to_marginals(long double scenario_proba , Marginal_array_p&
 	else{
 		updated_marginals[this->new_index]+=scenario_proba;
 	}
+	record_touched_marginal(this->new_index);
 }
 
 
@@ -408,11 +423,16 @@ void Insertion::initialize_crude_scenario_proba_bound(double& downstream_proba_b
 	this->event_upper_bound_proba = 0;
 	shared_ptr<Rec_Event> dinuc_event_p;
 
-	//TODO remove this and correct the way ordered realization map works
-	 ordered_realization_map.clear();
-	 for(unordered_map<string,Event_realization>::const_iterator iter=(*this).event_realizations.begin() ; iter != (*this).event_realizations.end() ; ++iter){
-		 ordered_realization_map.emplace ((*iter).second.value_int,(*iter).second);
-	 }
+	//Realization index of each number of insertions, -1 if it is not a realization of the event
+	realization_index_by_insertions.clear();
+	for(unordered_map<string,Event_realization>::const_iterator iter=(*this).event_realizations.begin() ; iter != (*this).event_realizations.end() ; ++iter){
+		if((*iter).second.value_int >= 0){
+			if((size_t) (*iter).second.value_int >= realization_index_by_insertions.size()){
+				realization_index_by_insertions.resize((*iter).second.value_int + 1 , -1);
+			}
+			realization_index_by_insertions[(*iter).second.value_int] = (*iter).second.index;
+		}
+	}
 
 	switch(this->event_class){
 	//TODO be careful in case there is both VDJ and VD/DJ (however this should not happen)
@@ -496,7 +516,7 @@ void Insertion::initialize_crude_scenario_proba_bound(double& downstream_proba_b
 
 	if(this->has_effect_on(considered_junction)){
 
-		base_index = base_index_map.at(this->event_index,0);
+		const size_t len_base_index = base_index_map.at(this->event_index,0);
 
 		//Insert sequence in the right constructed sequence
 		Seq_type seq_type;
@@ -528,16 +548,10 @@ void Insertion::initialize_crude_scenario_proba_bound(double& downstream_proba_b
 
 
 			//Get the max proba for this realization (in case the event is child of another)
-			double real_max_proba = 0;
-			for(size_t i = 0 ; i!=this->event_marginal_size/this->size() ; ++i){
-				if(model_parameters_point[base_index + (*iter).second.index + i*this->size()]>real_max_proba){
-					real_max_proba = model_parameters_point[base_index + (*iter).second.index + i*this->size()];
-				}
-			}
+			const double real_max_proba = get_len_proba_realization_bound(len_base_index , (*iter).second.index , model_parameters_point);
 
 			//Build an inserted sequence to let the Dinuc know about the number of insertions considered
-			inserted_str.assign(iter->second.value_int , -1);
-			constructed_sequences[seq_type] = &inserted_str;
+			constructed_sequences[seq_type] = unknown_nucleotides(iter->second.value_int);
 
 			//Update the length and the probability within the recursive call
 			Rec_Event::iterate_initialize_Len_proba_wrap_up(considered_junction , length_best_proba_map ,  model_queue ,  scenario_proba*real_max_proba , model_parameters_point , base_index_map , constructed_sequences , seq_len+(*iter).second.value_int);
@@ -570,11 +584,10 @@ void Insertion::initialize_crude_scenario_proba_bound(double& downstream_proba_b
 
 		junction_length_best_proba_map.clear();
 
+		//Bounds of the downstream events (e.g. the Dinucl_markov) for each number of insertions, the insertion probability being part of the scenario probability when they are read
 		for(unordered_map <string, Event_realization>::const_iterator iter = this->event_realizations.begin() ; iter!= this->event_realizations.end() ; ++iter){
-			inserted_str.assign(iter->second.value_int , -1);
-			constructed_sequences[seq_type] = &inserted_str;
-			double init_proba = 1.0;
-			this->Rec_Event::iterate_initialize_Len_proba(seq_type,junction_length_best_proba_map,model_queue,init_proba,model_parameters_point,base_index_map,constructed_sequences);
+			constructed_sequences[seq_type] = unknown_nucleotides(iter->second.value_int);
+			this->initialize_downstream_Len_proba(seq_type,junction_length_best_proba_map,model_queue,model_parameters_point,base_index_map,constructed_sequences,iter->second.value_int);
 		}
 
  }
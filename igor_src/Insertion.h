@@ -62,13 +62,14 @@ public:
 
 	//virtual methods
 	std::shared_ptr<Rec_Event> copy();
-	inline void iterate(double& , Downstream_scenario_proba_bound_map& , const std::string& , const Int_Str& , Index_map& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::shared_ptr<Next_event_ptr>& , Marginal_array_p& , const Marginal_array_p& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , Seq_type_str_p_map& , Seq_offsets_map& , std::shared_ptr<Error_rate>& , std::map<size_t,std::shared_ptr<Counter>>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>> & , Safety_bool_map& , Mismatch_vectors_map& , double& , double&);
+	void iterate(double& , Scenario_context&);
 	bool add_realization(int);
 	std::queue<int> draw_random_realization( const Marginal_array_p& , std::unordered_map<Rec_Event_name,int>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::unordered_map<Seq_type , std::string>& , std::mt19937_64&)const ;
 	void write2txt(std::ofstream&);
 
 	void initialize_event( std::unordered_set<Rec_Event_name>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , Downstream_scenario_proba_bound_map& , Seq_type_str_p_map& , Safety_bool_map& , std::shared_ptr<Error_rate> ,Mismatch_vectors_map&,Seq_offsets_map&,Index_map&);
 	void add_to_marginals(long double , Marginal_array_p&) const;
+	void append_scenario_factors(std::vector<int>& factors) const{factors.push_back(new_index);} //Model parameter used by the current scenario (see Scenario_skeleton_cache)
 	void set_crude_upper_bound_proba(size_t , size_t , Marginal_array_p&) ;
 	void initialize_crude_scenario_proba_bound(double& , std::forward_list<double*>& ,const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>&);
 
@@ -79,11 +80,12 @@ public:
 
 private:
 	inline double iterate_common(double , int , int , Index_map& ,const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& ,const Marginal_array_p&);
+	Int_Str_view unknown_nucleotides(int) const;
 
-	std::map<int,Event_realization> ordered_realization_map;
+	std::vector<int> realization_index_by_insertions;
 	std::map<int,double> junction_length_best_proba_map;
 
-	mutable Int_Str inserted_str;
+	mutable Int_Str inserted_str; //Unknown (-1) nucleotides viewed by the constructed inserted sequences
 	mutable int base_index;
 	double new_scenario_proba;
 	double proba_contribution;
@@ -33,6 +33,11 @@ Int_Str& Int_Str::operator+=(const Int_Str& other){
 	return *this;
 }
 
+Int_Str& Int_Str::operator+=(const Int_Str_view& other){
+	this->insert(this->end() , other.begin() , other.end());
+	return *this;
+}
+
 Int_Str& Int_Str::operator +=(const int& a){
 	this->push_back(a);
 	return *this;
@@ -47,6 +52,10 @@ Int_Str& Int_Str::append(const Int_Str& other){
 	return (*this)+= other;
 }
 
+Int_Str& Int_Str::append(const Int_Str_view& other){
+	return (*this)+= other;
+}
+
 Int_Str& Int_Str::append(const int& a){
 	return (*this)+=a;
 }
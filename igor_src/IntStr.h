@@ -29,6 +29,61 @@
 
 #include <vector>
 #include <ostream>
+#include <iterator>
+#include <stdexcept>
+
+/**
+ * \class Int_Str_view IntStr.h
+ * \brief Non owning read only slice of an integer nucleotide sequence (the Int_Str equivalent of a string_view).
+ * \version 1.0
+ *
+ * Used for the sequences constructed while exploring scenarios: gene sequences, deleted gene sequences and inserted nucleotides
+ * are views on the gene templates, on the read or on buffers owned by the events instead of copies.
+ * The viewed buffer must outlive the view and must not be reallocated while the view is in use.
+ */
+class Int_Str_view{
+public:
+	typedef const int* const_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	static const std::size_t npos = -1;
+
+	Int_Str_view(): data_p(nullptr) , length(0){}
+	Int_Str_view(const int* data , std::size_t len): data_p(data) , length(len){}
+	Int_Str_view(const std::vector<int>& int_str): data_p(int_str.data()) , length(int_str.size()){}
+
+	//Capacity
+	std::size_t size() const{return length;}
+	bool empty() const{return length==0;}
+
+	//Element access
+	const int& operator[](std::size_t pos) const{return data_p[pos];}
+	const int& at(std::size_t pos) const{
+		if(pos>=length){throw std::out_of_range("Position out of range in Int_Str_view::at()");}
+		return data_p[pos];
+	}
+	const int& front() const{return data_p[0];}
+	const int& back() const{return data_p[length-1];}
+	const int* data() const{return data_p;}
+
+	//Iterators
+	const_iterator begin() const{return data_p;}
+	const_iterator end() const{return data_p + length;}
+	const_reverse_iterator rbegin() const{return const_reverse_iterator(end());}
+	const_reverse_iterator rend() const{return const_reverse_iterator(begin());}
+
+	//Same semantic as Int_Str::substr() without copying
+	Int_Str_view substr(std::size_t pos = 0 , std::size_t len = npos) const{
+		if( (len == npos) or (pos+len >= length) ){
+			return Int_Str_view(data_p + pos , length - pos);
+		}
+		return Int_Str_view(data_p + pos , len);
+	}
+
+private:
+	const int* data_p;
+	std::size_t length;
+};
 
 class Int_Str: public std::vector<int> {
 
@@ -37,10 +92,12 @@ public:
 	static const std::size_t npos = -1;
 
 	Int_Str& operator+=(const Int_Str&);
+	Int_Str& operator+=(const Int_Str_view&);
 	Int_Str& operator+=(const int&);
 	Int_Str& operator+=( int&& );
 	//Int_Str& operator+=(int);
 	Int_Str& append(const Int_Str&);
+	Int_Str& append(const Int_Str_view&);
 	Int_Str& append(const int&);
 
 	Int_Str operator+(const Int_Str&) const;
@@ -0,0 +1,915 @@
+/*
+ * Junctiondp.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Junctiondp.h"
+
+using namespace std;
+
+Junction_dp_evaluator::Junction_dp_evaluator(Canonical_topology topology , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map ,
+		const unordered_map<Rec_Event_name,int>& index_map , const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map):
+			topology(topology) , supported(false) , read_p(nullptr) , read_len(0) , model_parameters_p(nullptr) , error_rate(0) , first_max_ins(0) , second_max_ins(0) ,
+			sliding_d_computed(false) , d_5_window_first(0) , d_5_window_last(-1) , d_3_window_first(0) , d_3_window_last(-1) , seq_likelihood(0) , seq_probability(0) , seq_errors(0) , seq_weighted_er(0) , seq_n_scenarios(0) , seq_best_scenario(0){
+
+	if(topology == Generic_topology){
+		return;
+	}
+	const bool vdj = (topology != VJ_topology);
+
+	//Invert the offset map to get the parents of each event and the stride they apply
+	unordered_map<Rec_Event_name,vector<pair<Rec_Event_name,int>>> parents_map;
+	for(unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>::const_iterator iter = offset_map.begin() ; iter != offset_map.end() ; ++iter){
+		for(vector<pair<shared_ptr<const Rec_Event>,int>>::const_iterator jiter = (*iter).second.begin() ; jiter != (*iter).second.end() ; ++jiter){
+			parents_map[(*jiter).first->get_name()].push_back(make_pair((*iter).first , (*jiter).second));
+		}
+	}
+
+	//Events need to be known before looking up their children
+	v_choice.event_p = events_map.at(make_tuple(GeneChoice_t,V_gene,Undefined_side)).get();
+	j_choice.event_p = events_map.at(make_tuple(GeneChoice_t,J_gene,Undefined_side)).get();
+	if(vdj){
+		d_choice.event_p = events_map.at(make_tuple(GeneChoice_t,D_gene,Undefined_side)).get();
+		d_5_del.event_p = events_map.at(make_tuple(Deletion_t,D_gene,Five_prime)).get();
+		d_3_del.event_p = events_map.at(make_tuple(Deletion_t,D_gene,Three_prime)).get();
+	}
+
+	supported = true;
+	compile_event(v_choice , events_map.at(make_tuple(GeneChoice_t,V_gene,Undefined_side)) , index_map , parents_map , true , true , true , nullptr);
+	compile_event(j_choice , events_map.at(make_tuple(GeneChoice_t,J_gene,Undefined_side)) , index_map , parents_map , true , true , true , nullptr);
+	compile_event(v_3_del , events_map.at(make_tuple(Deletion_t,V_gene,Three_prime)) , index_map , parents_map , true , false , false , nullptr);
+	compile_event(j_5_del , events_map.at(make_tuple(Deletion_t,J_gene,Five_prime)) , index_map , parents_map , false , false , true , nullptr);
+	if(vdj){
+		compile_event(d_choice , events_map.at(make_tuple(GeneChoice_t,D_gene,Undefined_side)) , index_map , parents_map , true , true , true , nullptr);
+		compile_event(d_5_del , events_map.at(make_tuple(Deletion_t,D_gene,Five_prime)) , index_map , parents_map , false , true , false , &d_3_del);
+		compile_event(d_3_del , events_map.at(make_tuple(Deletion_t,D_gene,Three_prime)) , index_map , parents_map , false , true , false , &d_5_del);
+		if( (d_5_del.del_stride != 0) and (d_3_del.del_stride != 0) ){
+			supported = false;
+		}
+		compile_event(first_ins , events_map.at(make_tuple(Insertion_t,VD_genes,Undefined_side)) , index_map , parents_map , false , false , false , nullptr);
+		compile_event(first_dinucl , events_map.at(make_tuple(Dinuclmarkov_t,VD_genes,Undefined_side)) , index_map , parents_map , false , false , false , nullptr);
+		compile_event(second_ins , events_map.at(make_tuple(Insertion_t,DJ_genes,Undefined_side)) , index_map , parents_map , false , false , false , nullptr);
+		compile_event(second_dinucl , events_map.at(make_tuple(Dinuclmarkov_t,DJ_genes,Undefined_side)) , index_map , parents_map , false , false , false , nullptr);
+	}
+	else{
+		compile_event(first_ins , events_map.at(make_tuple(Insertion_t,VJ_genes,Undefined_side)) , index_map , parents_map , false , false , false , nullptr);
+		compile_event(first_dinucl , events_map.at(make_tuple(Dinuclmarkov_t,VJ_genes,Undefined_side)) , index_map , parents_map , false , false , false , nullptr);
+	}
+
+	first_max_ins = first_ins.value_indices.size() - 1;
+	second_max_ins = vdj ? second_ins.value_indices.size() - 1 : 0;
+}
+
+/*
+ * Fetch the realizations, base index and parents strides of an event.
+ * The evaluator is not supported if the event has a parent it cannot account for (allow_* flags for gene choices, other_del for the D deletions)
+ */
+void Junction_dp_evaluator::compile_event(Compiled_event& compiled_event , shared_ptr<Rec_Event> event_p , const unordered_map<Rec_Event_name,int>& index_map ,
+		const unordered_map<Rec_Event_name,vector<pair<Rec_Event_name,int>>>& parents_map , bool allow_v , bool allow_d , bool allow_j , const Compiled_event* other_del){
+	compiled_event.event_p = event_p.get();
+	compiled_event.base_index = index_map.at(event_p->get_name());
+
+	const unordered_map<string,Event_realization>& realizations_map = event_p->get_realizations_map();
+	int max_value = 0;
+	for(unordered_map<string,Event_realization>::const_iterator iter = realizations_map.begin() ; iter != realizations_map.end() ; ++iter){
+		compiled_event.values.push_back((*iter).second.value_int);
+		compiled_event.indices.push_back((*iter).second.index);
+		max_value = max(max_value , (*iter).second.value_int);
+	}
+	if(event_p->get_type() == Insertion_t){
+		compiled_event.value_indices.assign(max_value+1 , -1);
+		for(size_t i = 0 ; i != compiled_event.values.size() ; ++i){
+			if(compiled_event.values[i] >= 0){
+				compiled_event.value_indices[compiled_event.values[i]] = compiled_event.indices[i];
+			}
+		}
+	}
+
+	if(parents_map.count(event_p->get_name()) != 0){
+		const vector<pair<Rec_Event_name,int>>& parents = parents_map.at(event_p->get_name());
+		for(vector<pair<Rec_Event_name,int>>::const_iterator iter = parents.begin() ; iter != parents.end() ; ++iter){
+			if(allow_v and ((*iter).first == v_choice.event_p->get_name())){
+				compiled_event.v_stride = (*iter).second;
+			}
+			else if(allow_j and ((*iter).first == j_choice.event_p->get_name())){
+				compiled_event.j_stride = (*iter).second;
+			}
+			else if(allow_d and (d_choice.event_p != nullptr) and ((*iter).first == d_choice.event_p->get_name())){
+				compiled_event.d_stride = (*iter).second;
+			}
+			else if( (other_del != nullptr) and ((*iter).first == other_del->event_p->get_name()) ){
+				compiled_event.del_stride = (*iter).second;
+			}
+			else{
+				supported = false;
+			}
+		}
+	}
+}
+
+double Junction_dp_evaluator::transition_proba(const Compiled_event& dinucl , int first_nt , int second_nt) const{
+	if( (first_nt<4) & (second_nt<4) ){
+		return (*model_parameters_p)[dinucl.base_index + first_nt*dinucl.indices.size() + second_nt];
+	}
+	else{
+		//Same average over the underlying nucleotides as Dinucl_markov::iterate()
+		return static_cast<const Dinucl_markov*>(dinucl.event_p)->get_dinuc_proba_matrix()(first_nt,second_nt);
+	}
+}
+
+/*
+ * Ambiguous nucleotides transitions are not counted in the marginals (see Dinucl_markov::add_to_marginals())
+ */
+int Junction_dp_evaluator::transition_index(const Compiled_event& dinucl , int first_nt , int second_nt) const{
+	if( (first_nt<4) & (second_nt<4) ){
+		return dinucl.base_index + first_nt*dinucl.indices.size() + second_nt;
+	}
+	return -1;
+}
+
+double Junction_dp_evaluator::error_proba(int n_errors , int genomic_nucl) const{
+	return pow(error_rate/3,n_errors)*pow(1-error_rate,genomic_nucl-n_errors);
+}
+
+double Junction_dp_evaluator::gene_proba(int v_index , int j_index , int d_index) const{
+	const Marginal_array_p& model_parameters = *model_parameters_p;
+	double proba = model_parameters[v_choice.base_index + v_choice.j_stride*j_index + v_choice.d_stride*d_index + v_index]
+							   *model_parameters[j_choice.base_index + j_choice.v_stride*v_index + j_choice.d_stride*d_index + j_index];
+	if(topology != VJ_topology){
+		proba *= model_parameters[d_choice.base_index + d_choice.v_stride*v_index + d_choice.j_stride*j_index + d_index];
+	}
+	return proba;
+}
+
+void Junction_dp_evaluator::add_marginal(Marginal_array_p& seq_marginals , Touched_marginals_indices& touched_marginals , int index , long double value) const{
+	seq_marginals[index] += value;
+	touched_marginals.touch(index);
+}
+
+/*
+ * Insertion probabilities and products of the dinucleotide transitions lying strictly inside an inserted segment.
+ * first_inner[a*(max+1)+n] is the product of the transitions read[i-1]->read[i] for a<i<a+n (segment of length n starting at a)
+ * second_inner[b*(max+1)+n] is the product of the transitions read[i+1]->read[i] for b-n<i<b (DJ segments are read from the J side)
+ */
+void Junction_dp_evaluator::build_junction_tables(){
+	const Int_Str& read = *read_p;
+	const Marginal_array_p& model_parameters = *model_parameters_p;
+
+	first_ins_proba.assign(first_max_ins+1 , 0);
+	for(int n = 0 ; n <= first_max_ins ; ++n){
+		if(first_ins.value_indices[n] >= 0){
+			first_ins_proba[n] = model_parameters[first_ins.base_index + first_ins.value_indices[n]];
+		}
+	}
+	first_inner.assign(read_len*(first_max_ins+1) , 0);
+	for(int a = 0 ; a != read_len ; ++a){
+		double* inner = &first_inner[a*(first_max_ins+1)];
+		if(first_max_ins >= 1){
+			inner[1] = 1;
+		}
+		for(int n = 2 ; (n <= first_max_ins) and (a+n-1 < read_len) ; ++n){
+			inner[n] = inner[n-1]*transition_proba(first_dinucl , read[a+n-2] , read[a+n-1]);
+		}
+	}
+
+	if(topology != VJ_topology){
+		second_ins_proba.assign(second_max_ins+1 , 0);
+		for(int n = 0 ; n <= second_max_ins ; ++n){
+			if(second_ins.value_indices[n] >= 0){
+				second_ins_proba[n] = model_parameters[second_ins.base_index + second_ins.value_indices[n]];
+			}
+		}
+		second_inner.assign(read_len*(second_max_ins+1) , 0);
+		for(int b = 0 ; b != read_len ; ++b){
+			double* inner = &second_inner[b*(second_max_ins+1)];
+			if(second_max_ins >= 1){
+				inner[1] = 1;
+			}
+			for(int n = 2 ; (n <= second_max_ins) and (b-n+1 >= 0) ; ++n){
+				inner[n] = inner[n-1]*transition_proba(second_dinucl , read[b-n+2] , read[b-n+1]);
+			}
+		}
+	}
+}
+
+/*
+ * Enumerate the V 3' deletions with the same rules as Gene_choice::iterate() and Deletion::iterate()
+ * and sum the first junction over its insertions for each position of its 3' boundary on the read
+ */
+void Junction_dp_evaluator::build_v_alignment(const Alignment_data& alignment , Gene_alignment& gene_alignment){
+	const Int_Str& read = *read_p;
+	const Marginal_array_p& model_parameters = *model_parameters_p;
+	const Event_realization& gene = static_cast<const Gene_choice*>(v_choice.event_p)->get_aligned_realization(alignment);
+	gene_alignment.gene_index = gene.index;
+
+	Int_Str gene_seq;
+	int v_5_off;
+	if(alignment.offset>=0){
+		gene_seq = gene.value_str_int;
+		v_5_off = alignment.offset;
+	}
+	else{
+		gene_seq = gene.value_str_int.substr(-alignment.offset);
+		v_5_off = 0;
+	}
+	const int gene_size = gene_seq.size();
+	const int v_3_off = v_5_off + gene_size - 1;
+	gene_alignment.outer_offset = v_5_off;
+
+	gene_alignment.states.clear();
+	for(size_t k = 0 ; k != v_3_del.values.size() ; ++k){
+		const int deletion = v_3_del.values[k];
+		if(gene_size <= deletion){
+			continue;
+		}
+		const int v_3_new_off = v_3_off - deletion;
+		if(v_3_new_off < 0){
+			continue;
+		}
+		Deletion_state state;
+		state.boundary = v_3_new_off;
+		state.n_errors = 0;
+		if(deletion >= 0){
+			for(vector<int>::const_iterator iter = alignment.mismatches.begin() ; iter != alignment.mismatches.end() ; ++iter){
+				if((*iter) <= v_3_new_off){
+					++state.n_errors;
+				}
+			}
+			state.nt = gene_seq[gene_size-1-deletion];
+		}
+		else{
+			if( (v_3_new_off >= read_len) or (-deletion > gene_size) ){
+				continue;
+			}
+			Int_Str palindrome = gene_seq.substr(gene_size + deletion);
+			reverse(palindrome.begin() , palindrome.end());
+			make_transversions(palindrome);
+			state.n_errors = alignment.mismatches.size();
+			for(int i = 0 ; i != -deletion ; ++i){
+				if(not comp_nt_int(palindrome[i] , read[v_3_off+1+i])){
+					++state.n_errors;
+				}
+			}
+			state.nt = palindrome.back();
+		}
+		state.marginal_index = v_3_del.base_index + v_3_del.v_stride*gene.index + v_3_del.indices[k];
+		state.proba = model_parameters[state.marginal_index];
+		if(state.proba == 0){
+			continue;
+		}
+		state.err_proba = error_proba(state.n_errors , gene_size - deletion);
+		gene_alignment.states.push_back(state);
+	}
+
+	const int n_ins = first_max_ins + 1;
+	gene_alignment.junction_w.assign(read_len*n_ins , 0);
+	gene_alignment.junction_we.assign(read_len*n_ins , 0);
+	gene_alignment.junction_p.assign(read_len*n_ins , 0);
+	gene_alignment.sum_w.assign(read_len , 0);
+	gene_alignment.sum_we.assign(read_len , 0);
+	gene_alignment.sum_p.assign(read_len , 0);
+	gene_alignment.sum_cnt.assign(read_len , 0);
+	gene_alignment.max_w.assign(read_len , 0);
+	for(vector<Deletion_state>::const_iterator iter = gene_alignment.states.begin() ; iter != gene_alignment.states.end() ; ++iter){
+		const Deletion_state& state = *iter;
+		for(int n = 0 ; n != n_ins ; ++n){
+			const int downstream = state.boundary + n + 1;
+			if(downstream >= read_len){
+				break;
+			}
+			double junction_proba = first_ins_proba[n];
+			if( (n > 0) and (junction_proba != 0) ){
+				junction_proba *= transition_proba(first_dinucl , state.nt , read[state.boundary+1])*first_inner[(state.boundary+1)*n_ins + n];
+			}
+			if(junction_proba == 0){
+				continue;
+			}
+			const int index = downstream*n_ins + n;
+			gene_alignment.junction_p[index] = state.proba*junction_proba;
+			gene_alignment.junction_w[index] = gene_alignment.junction_p[index]*state.err_proba;
+			gene_alignment.junction_we[index] = gene_alignment.junction_w[index]*state.n_errors;
+			gene_alignment.sum_w[downstream] += gene_alignment.junction_w[index];
+			gene_alignment.sum_we[downstream] += gene_alignment.junction_we[index];
+			gene_alignment.sum_p[downstream] += gene_alignment.junction_p[index];
+			gene_alignment.sum_cnt[downstream] += 1;
+			gene_alignment.max_w[downstream] = max(gene_alignment.max_w[downstream] , gene_alignment.junction_w[index]);
+		}
+	}
+}
+
+/*
+ * Enumerate the J 5' deletions with the same rules as Gene_choice::iterate() and Deletion::iterate()
+ * For VDJ models the DJ junction is summed over its insertions for each position of its 5' boundary (stored at D 3' offset + 1)
+ */
+void Junction_dp_evaluator::build_j_alignment(const Alignment_data& alignment , Gene_alignment& gene_alignment){
+	const Int_Str& read = *read_p;
+	const Marginal_array_p& model_parameters = *model_parameters_p;
+	const Event_realization& gene = static_cast<const Gene_choice*>(j_choice.event_p)->get_aligned_realization(alignment);
+	gene_alignment.gene_index = gene.index;
+
+	const Int_Str gene_seq = gene.value_str_int.substr(0 , read_len - alignment.offset);
+	const int gene_size = gene_seq.size();
+	const int j_5_off = alignment.offset;
+	gene_alignment.outer_offset = j_5_off + gene_size - 1;
+
+	gene_alignment.states.clear();
+	for(size_t k = 0 ; k != j_5_del.values.size() ; ++k){
+		const int deletion = j_5_del.values[k];
+		if(gene_size <= deletion){
+			continue;
+		}
+		const int j_5_new_off = j_5_off + deletion;
+		Deletion_state state;
+		state.boundary = j_5_new_off;
+		state.n_errors = 0;
+		if(deletion >= 0){
+			for(vector<int>::const_iterator iter = alignment.mismatches.begin() ; iter != alignment.mismatches.end() ; ++iter){
+				if((*iter) >= j_5_new_off){
+					++state.n_errors;
+				}
+			}
+			state.nt = gene_seq[deletion];
+		}
+		else{
+			if( (-deletion > gene_size) or (j_5_new_off < 0) ){
+				continue;
+			}
+			Int_Str palindrome = gene_seq.substr(0 , -deletion);
+			reverse(palindrome.begin() , palindrome.end());
+			make_transversions(palindrome);
+			state.n_errors = alignment.mismatches.size();
+			for(int i = 0 ; i != -deletion ; ++i){
+				if(not comp_nt_int(palindrome[i] , read[j_5_new_off+i])){
+					++state.n_errors;
+				}
+			}
+			state.nt = palindrome.front();
+		}
+		state.marginal_index = j_5_del.base_index + j_5_del.j_stride*gene.index + j_5_del.indices[k];
+		state.proba = model_parameters[state.marginal_index];
+		if(state.proba == 0){
+			continue;
+		}
+		state.err_proba = error_proba(state.n_errors , gene_size - deletion);
+		gene_alignment.states.push_back(state);
+	}
+
+	if(topology == VJ_topology){
+		return;
+	}
+
+	const int n_ins = second_max_ins + 1;
+	gene_alignment.junction_w.assign(read_len*n_ins , 0);
+	gene_alignment.junction_we.assign(read_len*n_ins , 0);
+	gene_alignment.junction_p.assign(read_len*n_ins , 0);
+	gene_alignment.sum_w.assign(read_len , 0);
+	gene_alignment.sum_we.assign(read_len , 0);
+	gene_alignment.sum_p.assign(read_len , 0);
+	gene_alignment.sum_cnt.assign(read_len , 0);
+	gene_alignment.max_w.assign(read_len , 0);
+	for(vector<Deletion_state>::const_iterator iter = gene_alignment.states.begin() ; iter != gene_alignment.states.end() ; ++iter){
+		const Deletion_state& state = *iter;
+		for(int n = 0 ; n != n_ins ; ++n){
+			//Position of the D 3' end shifted by one
+			const int upstream = state.boundary - n;
+			if(upstream < 0){
+				break;
+			}
+			double junction_proba = second_ins_proba[n];
+			if( (n > 0) and (junction_proba != 0) ){
+				junction_proba *= transition_proba(second_dinucl , state.nt , read[state.boundary-1])*second_inner[(state.boundary-1)*n_ins + n];
+			}
+			if(junction_proba == 0){
+				continue;
+			}
+			const int index = upstream*n_ins + n;
+			gene_alignment.junction_p[index] = state.proba*junction_proba;
+			gene_alignment.junction_w[index] = gene_alignment.junction_p[index]*state.err_proba;
+			gene_alignment.junction_we[index] = gene_alignment.junction_w[index]*state.n_errors;
+			gene_alignment.sum_w[upstream] += gene_alignment.junction_w[index];
+			gene_alignment.sum_we[upstream] += gene_alignment.junction_we[index];
+			gene_alignment.sum_p[upstream] += gene_alignment.junction_p[index];
+			gene_alignment.sum_cnt[upstream] += 1;
+			gene_alignment.max_w[upstream] = max(gene_alignment.max_w[upstream] , gene_alignment.junction_w[index]);
+		}
+	}
+}
+
+/*
+ * Enumerate the D 5' and 3' deletions of a D placed at d_5_off with the same rules as Deletion::iterate()
+ */
+void Junction_dp_evaluator::build_d_placement(const Event_realization& gene , int d_5_off , const vector<int>& mismatches , D_placement& placement) const{
+	const Int_Str& read = *read_p;
+	const Marginal_array_p& model_parameters = *model_parameters_p;
+	const Int_Str& gene_seq = gene.value_str_int;
+	const int gene_size = gene_seq.size();
+	const int d_3_off = d_5_off + gene_size - 1;
+
+	placement.gene_index = gene.index;
+	placement.states.clear();
+
+	Int_Str d_5_seq;
+	vector<int> d_5_mismatches;
+	for(size_t kx = 0 ; kx != d_5_del.values.size() ; ++kx){
+		const int d_5_deletion = d_5_del.values[kx];
+		if(gene_size < d_5_deletion){
+			continue;
+		}
+		const int d_5_new_off = d_5_off + d_5_deletion;
+		if( (d_5_new_off < 0) or (d_5_new_off >= read_len) ){
+			continue;
+		}
+		//No V alignment can reach this D 5' boundary, the state would not contribute
+		if( (d_5_new_off < d_5_window_first) or (d_5_new_off > d_5_window_last) ){
+			continue;
+		}
+		d_5_mismatches.clear();
+		if(d_5_deletion >= 0){
+			d_5_seq = gene_seq.substr(d_5_deletion);
+			for(vector<int>::const_iterator iter = mismatches.begin() ; iter != mismatches.end() ; ++iter){
+				if((*iter) >= d_5_new_off){
+					d_5_mismatches.push_back(*iter);
+				}
+			}
+		}
+		else{
+			if(-d_5_deletion > gene_size){
+				continue;
+			}
+			Int_Str palindrome = gene_seq.substr(0 , -d_5_deletion);
+			reverse(palindrome.begin() , palindrome.end());
+			make_transversions(palindrome);
+			d_5_seq = palindrome + gene_seq;
+			d_5_mismatches = mismatches;
+			for(int i = 0 ; i != -d_5_deletion ; ++i){
+				if( (d_5_new_off+i < read_len) and (not comp_nt_int(palindrome[i] , read[d_5_new_off+i])) ){
+					d_5_mismatches.push_back(d_5_new_off+i);
+				}
+			}
+		}
+		const int d_5_size = d_5_seq.size();
+
+		for(size_t ky = 0 ; ky != d_3_del.values.size() ; ++ky){
+			const int d_3_deletion = d_3_del.values[ky];
+			if(d_5_size < d_3_deletion){
+				continue;
+			}
+			const int d_3_new_off = d_3_off - d_3_deletion;
+			if( (d_3_new_off + 1 < d_3_window_first) or (d_3_new_off + 1 > d_3_window_last) ){
+				continue;
+			}
+			D_state state;
+			state.n_errors = 0;
+			if(d_3_deletion >= 0){
+				for(vector<int>::const_iterator iter = d_5_mismatches.begin() ; iter != d_5_mismatches.end() ; ++iter){
+					if((*iter) <= d_3_new_off){
+						++state.n_errors;
+					}
+				}
+			}
+			else{
+				if( (d_3_new_off >= read_len) or (-d_3_deletion > d_5_size) ){
+					continue;
+				}
+				Int_Str palindrome = d_5_seq.substr(d_5_size + d_3_deletion);
+				reverse(palindrome.begin() , palindrome.end());
+				make_transversions(palindrome);
+				state.n_errors = d_5_mismatches.size();
+				for(int i = 0 ; i != -d_3_deletion ; ++i){
+					if( (d_3_off+1+i >= 0) and (not comp_nt_int(palindrome[i] , read[d_3_off+1+i])) ){
+						++state.n_errors;
+					}
+				}
+			}
+			state.d_5_offset = d_5_new_off;
+			state.d_3_offset = d_3_new_off;
+			state.d_5_marginal_index = d_5_del.base_index + d_5_del.d_stride*gene.index + d_5_del.del_stride*d_3_del.indices[ky] + d_5_del.indices[kx];
+			state.d_3_marginal_index = d_3_del.base_index + d_3_del.d_stride*gene.index + d_3_del.del_stride*d_5_del.indices[kx] + d_3_del.indices[ky];
+			state.proba = model_parameters[state.d_5_marginal_index]*model_parameters[state.d_3_marginal_index];
+			if(state.proba == 0){
+				continue;
+			}
+			state.err_proba = error_proba(state.n_errors , d_5_size - d_3_deletion);
+			placement.states.push_back(state);
+		}
+	}
+}
+
+/*
+ * Placements of every D at every position of the read, used when no D alignment yields a scenario (as the no_d_align case of Gene_choice::iterate())
+ */
+void Junction_dp_evaluator::build_sliding_d_placements(){
+	const Int_Str& read = *read_p;
+	sliding_d_placements.clear();
+	vector<int> mismatches;
+	D_placement placement;
+	const int min_d_5_del = *min_element(d_5_del.values.begin() , d_5_del.values.end());
+	const int max_d_5_del = *max_element(d_5_del.values.begin() , d_5_del.values.end());
+	const unordered_map<string,Event_realization>& realizations_map = d_choice.event_p->get_realizations_map();
+	for(unordered_map<string,Event_realization>::const_iterator iter = realizations_map.begin() ; iter != realizations_map.end() ; ++iter){
+		const Int_Str& gene_seq = (*iter).second.value_str_int;
+		const int gene_size = gene_seq.size();
+		//Only offsets for which some D 5' deletion lands in the window reached by the V alignments
+		const int first_d_5_off = max(-gene_size , d_5_window_first - max_d_5_del);
+		const int last_d_5_off = min(read_len - 1 , d_5_window_last - min_d_5_del);
+		for(int d_5_off = first_d_5_off ; d_5_off <= last_d_5_off ; ++d_5_off){
+			mismatches.clear();
+			for(int i = 0 ; i != gene_size ; ++i){
+				if( (d_5_off+i >= 0) and (d_5_off+i < read_len) and (gene_seq[i] != read[d_5_off+i]) ){
+					mismatches.push_back(d_5_off+i);
+				}
+			}
+			build_d_placement((*iter).second , d_5_off , mismatches , placement);
+			if(not placement.states.empty()){
+				sliding_d_placements.push_back(placement);
+			}
+		}
+	}
+	sliding_d_computed = true;
+}
+
+void Junction_dp_evaluator::compute_d_windows(){
+	d_5_window_first = read_len;
+	d_5_window_last = -1;
+	for(vector<Gene_alignment>::const_iterator iter = v_alignments.begin() ; iter != v_alignments.end() ; ++iter){
+		for(int i = 0 ; i != read_len ; ++i){
+			if((*iter).sum_w[i] != 0){
+				d_5_window_first = min(d_5_window_first , i);
+				d_5_window_last = max(d_5_window_last , i);
+			}
+		}
+	}
+	d_3_window_first = read_len;
+	d_3_window_last = -1;
+	for(vector<Gene_alignment>::const_iterator iter = j_alignments.begin() ; iter != j_alignments.end() ; ++iter){
+		for(int i = 0 ; i != read_len ; ++i){
+			if((*iter).sum_w[i] != 0){
+				d_3_window_first = min(d_3_window_first , i);
+				d_3_window_last = max(d_3_window_last , i);
+			}
+		}
+	}
+}
+
+long double Junction_dp_evaluator::vdj_pair_likelihood(const Gene_alignment& v_alignment , const Gene_alignment& j_alignment , const vector<D_placement>& placements) const{
+	long double likelihood = 0;
+	for(vector<D_placement>::const_iterator iter = placements.begin() ; iter != placements.end() ; ++iter){
+		const double genes_proba = gene_proba(v_alignment.gene_index , j_alignment.gene_index , (*iter).gene_index);
+		if(genes_proba == 0){
+			continue;
+		}
+		for(vector<D_state>::const_iterator jiter = (*iter).states.begin() ; jiter != (*iter).states.end() ; ++jiter){
+			if((*jiter).d_3_offset + 1 >= read_len){
+				continue;
+			}
+			likelihood += genes_proba*(*jiter).proba*(*jiter).err_proba*v_alignment.sum_w[(*jiter).d_5_offset]*j_alignment.sum_w[(*jiter).d_3_offset + 1];
+		}
+	}
+	return likelihood;
+}
+
+/*
+ * Forward/backward pass over V 3' boundary -> D states -> J 5' boundary for a V and a J alignment.
+ * The weights flowing into each D 5' boundary (from the V side) and out of each D 3' boundary (to the J side) are summed over all D placements
+ * and used afterwards as backward weights for the V and J side events.
+ */
+void Junction_dp_evaluator::evaluate_vdj_pair(const Gene_alignment& v_alignment , const Gene_alignment& j_alignment , const vector<D_placement>& placements ,
+		Marginal_array_p& seq_marginals , Touched_marginals_indices& touched_marginals){
+	const int n_first_ins = first_max_ins + 1;
+	const int n_second_ins = second_max_ins + 1;
+	v_posterior_weights.assign(read_len , 0);
+	j_posterior_weights.assign(read_len , 0);
+	e_vec_w.assign(read_len*n_first_ins , 0);
+	e_vec_we.assign(read_len*n_first_ins , 0);
+
+	for(vector<D_placement>::const_iterator iter = placements.begin() ; iter != placements.end() ; ++iter){
+		const double genes_proba = gene_proba(v_alignment.gene_index , j_alignment.gene_index , (*iter).gene_index);
+		if(genes_proba == 0){
+			continue;
+		}
+		long double placement_likelihood = 0;
+		for(vector<D_state>::const_iterator jiter = (*iter).states.begin() ; jiter != (*iter).states.end() ; ++jiter){
+			const D_state& state = *jiter;
+			const int upstream = state.d_3_offset + 1;
+			if(upstream >= read_len){
+				continue;
+			}
+			const double v_w = v_alignment.sum_w[state.d_5_offset];
+			const double j_w = j_alignment.sum_w[upstream];
+			if( (v_w == 0) or (j_w == 0) ){
+				continue;
+			}
+			const double d_w = genes_proba*state.proba*state.err_proba;
+			v_posterior_weights[state.d_5_offset] += d_w*j_w;
+			j_posterior_weights[upstream] += v_w*d_w;
+
+			const long double scenarios_w = v_w*d_w*j_w;
+			placement_likelihood += scenarios_w;
+			add_marginal(seq_marginals , touched_marginals , state.d_5_marginal_index , scenarios_w);
+			add_marginal(seq_marginals , touched_marginals , state.d_3_marginal_index , scenarios_w);
+
+			seq_probability += genes_proba*state.proba*v_alignment.sum_p[state.d_5_offset]*j_alignment.sum_p[upstream];
+			seq_errors += d_w*(v_alignment.sum_we[state.d_5_offset]*j_w + v_w*state.n_errors*j_w + v_w*j_alignment.sum_we[upstream]);
+			seq_n_scenarios += v_alignment.sum_cnt[state.d_5_offset]*j_alignment.sum_cnt[upstream];
+			seq_best_scenario = max(seq_best_scenario , v_alignment.max_w[state.d_5_offset]*d_w*j_alignment.max_w[upstream]);
+
+			//Keep the number of VD insertions for the error rate statistics
+			const double* junction_w = &v_alignment.junction_w[state.d_5_offset*n_first_ins];
+			const double* junction_we = &v_alignment.junction_we[state.d_5_offset*n_first_ins];
+			double* vec_w = &e_vec_w[upstream*n_first_ins];
+			double* vec_we = &e_vec_we[upstream*n_first_ins];
+			for(int a = 0 ; a != n_first_ins ; ++a){
+				if(junction_w[a] != 0){
+					vec_w[a] += junction_w[a]*d_w;
+					vec_we[a] += junction_we[a]*d_w + junction_w[a]*d_w*state.n_errors;
+				}
+			}
+		}
+		if(placement_likelihood != 0){
+			add_marginal(seq_marginals , touched_marginals , v_choice.base_index + v_choice.j_stride*j_alignment.gene_index + v_choice.d_stride*(*iter).gene_index + v_alignment.gene_index , placement_likelihood);
+			add_marginal(seq_marginals , touched_marginals , j_choice.base_index + j_choice.v_stride*v_alignment.gene_index + j_choice.d_stride*(*iter).gene_index + j_alignment.gene_index , placement_likelihood);
+			add_marginal(seq_marginals , touched_marginals , d_choice.base_index + d_choice.v_stride*v_alignment.gene_index + d_choice.j_stride*j_alignment.gene_index + (*iter).gene_index , placement_likelihood);
+			seq_likelihood += placement_likelihood;
+		}
+	}
+
+	add_v_side_posteriors(v_alignment , seq_marginals , touched_marginals);
+	add_j_side_posteriors(j_alignment , seq_marginals , touched_marginals);
+
+	//The number of genomic nucleotides is the span between the V 5' and J 3' ends minus the insertions
+	const int span = j_alignment.outer_offset - v_alignment.outer_offset + 1;
+	for(int upstream = 0 ; upstream != read_len ; ++upstream){
+		const double* vec_w = &e_vec_w[upstream*n_first_ins];
+		const double* vec_we = &e_vec_we[upstream*n_first_ins];
+		for(int b = 0 ; b != n_second_ins ; ++b){
+			const double j_w = j_alignment.junction_w[upstream*n_second_ins + b];
+			if(j_w == 0){
+				continue;
+			}
+			const double j_we = j_alignment.junction_we[upstream*n_second_ins + b];
+			for(int a = 0 ; a != n_first_ins ; ++a){
+				if(vec_w[a] != 0){
+					seq_weighted_er += (vec_we[a]*j_w + vec_w[a]*j_we)/(span - a - b);
+				}
+			}
+		}
+	}
+}
+
+void Junction_dp_evaluator::evaluate_vj_pair(const Gene_alignment& v_alignment , const Gene_alignment& j_alignment , Marginal_array_p& seq_marginals , Touched_marginals_indices& touched_marginals){
+	const int n_first_ins = first_max_ins + 1;
+	v_posterior_weights.assign(read_len , 0);
+	const double genes_proba = gene_proba(v_alignment.gene_index , j_alignment.gene_index , 0);
+	if(genes_proba == 0){
+		return;
+	}
+	const int span = j_alignment.outer_offset - v_alignment.outer_offset + 1;
+
+	long double pair_likelihood = 0;
+	for(vector<Deletion_state>::const_iterator iter = j_alignment.states.begin() ; iter != j_alignment.states.end() ; ++iter){
+		const Deletion_state& state = *iter;
+		const double v_w = v_alignment.sum_w[state.boundary];
+		if(v_w == 0){
+			continue;
+		}
+		const double j_w = genes_proba*state.proba*state.err_proba;
+		v_posterior_weights[state.boundary] += j_w;
+
+		const long double scenarios_w = v_w*j_w;
+		pair_likelihood += scenarios_w;
+		add_marginal(seq_marginals , touched_marginals , state.marginal_index , scenarios_w);
+
+		seq_probability += genes_proba*state.proba*v_alignment.sum_p[state.boundary];
+		seq_errors += j_w*(v_alignment.sum_we[state.boundary] + v_w*state.n_errors);
+		seq_n_scenarios += v_alignment.sum_cnt[state.boundary];
+		seq_best_scenario = max(seq_best_scenario , v_alignment.max_w[state.boundary]*j_w);
+
+		const double* junction_w = &v_alignment.junction_w[state.boundary*n_first_ins];
+		const double* junction_we = &v_alignment.junction_we[state.boundary*n_first_ins];
+		for(int a = 0 ; a != n_first_ins ; ++a){
+			if(junction_w[a] != 0){
+				seq_weighted_er += (junction_we[a]*j_w + junction_w[a]*j_w*state.n_errors)/(span - a);
+			}
+		}
+	}
+	if(pair_likelihood != 0){
+		add_marginal(seq_marginals , touched_marginals , v_choice.base_index + v_choice.j_stride*j_alignment.gene_index + v_alignment.gene_index , pair_likelihood);
+		add_marginal(seq_marginals , touched_marginals , j_choice.base_index + j_choice.v_stride*v_alignment.gene_index + j_alignment.gene_index , pair_likelihood);
+		seq_likelihood += pair_likelihood;
+	}
+
+	add_v_side_posteriors(v_alignment , seq_marginals , touched_marginals);
+}
+
+/*
+ * Backward pass on the V side: v_posterior_weights holds the weight of everything downstream of the first junction for each of its 3' boundaries
+ * Inner dinucleotide transitions are accumulated as a difference array over the read positions
+ */
+void Junction_dp_evaluator::add_v_side_posteriors(const Gene_alignment& v_alignment , Marginal_array_p& seq_marginals , Touched_marginals_indices& touched_marginals){
+	const Int_Str& read = *read_p;
+	const int n_ins = first_max_ins + 1;
+	for(vector<Deletion_state>::const_iterator iter = v_alignment.states.begin() ; iter != v_alignment.states.end() ; ++iter){
+		const Deletion_state& state = *iter;
+		long double deletion_posterior = 0;
+		for(int n = 0 ; n != n_ins ; ++n){
+			const int downstream = state.boundary + n + 1;
+			if(downstream >= read_len){
+				break;
+			}
+			const double junction_w = v_alignment.junction_w[downstream*n_ins + n];
+			if( (junction_w == 0) or (v_posterior_weights[downstream] == 0) ){
+				continue;
+			}
+			const long double posterior = junction_w*v_posterior_weights[downstream];
+			deletion_posterior += posterior;
+			add_marginal(seq_marginals , touched_marginals , first_ins.base_index + first_ins.value_indices[n] , posterior);
+			if(n > 0){
+				const int first_transition = transition_index(first_dinucl , state.nt , read[state.boundary+1]);
+				if(first_transition >= 0){
+					add_marginal(seq_marginals , touched_marginals , first_transition , posterior);
+				}
+				first_coverage[state.boundary+2] += posterior;
+				first_coverage[state.boundary+1+n] -= posterior;
+			}
+		}
+		if(deletion_posterior != 0){
+			add_marginal(seq_marginals , touched_marginals , state.marginal_index , deletion_posterior);
+		}
+	}
+}
+
+/*
+ * Backward pass on the J side: j_posterior_weights holds the weight of everything upstream of the DJ junction for each of its 5' boundaries
+ */
+void Junction_dp_evaluator::add_j_side_posteriors(const Gene_alignment& j_alignment , Marginal_array_p& seq_marginals , Touched_marginals_indices& touched_marginals){
+	const Int_Str& read = *read_p;
+	const int n_ins = second_max_ins + 1;
+	for(vector<Deletion_state>::const_iterator iter = j_alignment.states.begin() ; iter != j_alignment.states.end() ; ++iter){
+		const Deletion_state& state = *iter;
+		long double deletion_posterior = 0;
+		for(int n = 0 ; n != n_ins ; ++n){
+			const int upstream = state.boundary - n;
+			if(upstream < 0){
+				break;
+			}
+			const double junction_w = j_alignment.junction_w[upstream*n_ins + n];
+			if( (junction_w == 0) or (j_posterior_weights[upstream] == 0) ){
+				continue;
+			}
+			const long double posterior = junction_w*j_posterior_weights[upstream];
+			deletion_posterior += posterior;
+			add_marginal(seq_marginals , touched_marginals , second_ins.base_index + second_ins.value_indices[n] , posterior);
+			if(n > 0){
+				const int first_transition = transition_index(second_dinucl , state.nt , read[state.boundary-1]);
+				if(first_transition >= 0){
+					add_marginal(seq_marginals , touched_marginals , first_transition , posterior);
+				}
+				second_coverage[state.boundary-n] += posterior;
+				second_coverage[state.boundary-1] -= posterior;
+			}
+		}
+		if(deletion_posterior != 0){
+			add_marginal(seq_marginals , touched_marginals , state.marginal_index , deletion_posterior);
+		}
+	}
+}
+
+/*
+ * Convert the difference array of inner dinucleotide transitions to marginals
+ * Position i holds the transition read[i-1]->read[i] (or read[i+1]->read[i] if reversed)
+ */
+void Junction_dp_evaluator::add_coverage_posteriors(const Compiled_event& dinucl , const vector<long double>& coverage , bool reversed , Marginal_array_p& seq_marginals , Touched_marginals_indices& touched_marginals){
+	const Int_Str& read = *read_p;
+	long double posterior = 0;
+	for(int i = 0 ; i != read_len ; ++i){
+		posterior += coverage[i];
+		if(posterior <= 0){
+			continue;
+		}
+		int transition;
+		if(reversed){
+			if(i+1 >= read_len){
+				continue;
+			}
+			transition = transition_index(dinucl , read[i+1] , read[i]);
+		}
+		else{
+			if(i == 0){
+				continue;
+			}
+			transition = transition_index(dinucl , read[i-1] , read[i]);
+		}
+		if(transition >= 0){
+			add_marginal(seq_marginals , touched_marginals , transition , posterior);
+		}
+	}
+}
+
+/*
+ * Computes the likelihood of the sequence summed over all its scenarios and adds the expected counts of each realization to seq_marginals.
+ * The sequence statistics of the error rate are set as if the scenarios had been explored one by one.
+ */
+void Junction_dp_evaluator::evaluate(const Int_Str& int_sequence , const unordered_map<Gene_class , vector<Alignment_data>>& alignments ,
+		const Marginal_array_p& model_parameters , Marginal_array_p& seq_marginals , Touched_marginals_indices& touched_marginals , Single_error_rate& error_rate_obj){
+	if(not supported){
+		throw runtime_error("Junction_dp_evaluator::evaluate() called for an unsupported model");
+	}
+	read_p = &int_sequence;
+	read_len = int_sequence.size();
+	model_parameters_p = &model_parameters;
+	error_rate = error_rate_obj.get_model_rate();
+	seq_likelihood = 0;
+	seq_probability = 0;
+	seq_errors = 0;
+	seq_weighted_er = 0;
+	seq_n_scenarios = 0;
+	seq_best_scenario = 0;
+
+	build_junction_tables();
+	first_coverage.assign(read_len+1 , 0);
+	second_coverage.assign(read_len+1 , 0);
+
+	const vector<Alignment_data>& v_aligns = alignments.at(V_gene);
+	v_alignments.resize(v_aligns.size());
+	for(size_t i = 0 ; i != v_aligns.size() ; ++i){
+		build_v_alignment(v_aligns[i] , v_alignments[i]);
+	}
+	const vector<Alignment_data>& j_aligns = alignments.at(J_gene);
+	j_alignments.resize(j_aligns.size());
+	for(size_t i = 0 ; i != j_aligns.size() ; ++i){
+		build_j_alignment(j_aligns[i] , j_alignments[i]);
+	}
+
+	if(topology == VJ_topology){
+		for(vector<Gene_alignment>::const_iterator v_iter = v_alignments.begin() ; v_iter != v_alignments.end() ; ++v_iter){
+			for(vector<Gene_alignment>::const_iterator j_iter = j_alignments.begin() ; j_iter != j_alignments.end() ; ++j_iter){
+				evaluate_vj_pair(*v_iter , *j_iter , seq_marginals , touched_marginals);
+			}
+		}
+		add_coverage_posteriors(first_dinucl , first_coverage , false , seq_marginals , touched_marginals);
+	}
+	else{
+		compute_d_windows();
+		aligned_d_placements.clear();
+		sliding_d_computed = false;
+		unordered_map<Gene_class , vector<Alignment_data>>::const_iterator d_aligns_iter = alignments.find(D_gene);
+		if(d_aligns_iter != alignments.end()){
+			D_placement placement;
+			for(vector<Alignment_data>::const_iterator iter = (*d_aligns_iter).second.begin() ; iter != (*d_aligns_iter).second.end() ; ++iter){
+				build_d_placement(static_cast<const Gene_choice*>(d_choice.event_p)->get_aligned_realization(*iter) , (*iter).offset , (*iter).mismatches , placement);
+				if(not placement.states.empty()){
+					aligned_d_placements.push_back(placement);
+				}
+			}
+		}
+
+		for(vector<Gene_alignment>::const_iterator v_iter = v_alignments.begin() ; v_iter != v_alignments.end() ; ++v_iter){
+			for(vector<Gene_alignment>::const_iterator j_iter = j_alignments.begin() ; j_iter != j_alignments.end() ; ++j_iter){
+				const vector<D_placement>* placements = &aligned_d_placements;
+				if(vdj_pair_likelihood(*v_iter , *j_iter , aligned_d_placements) == 0){
+					if(not sliding_d_computed){
+						build_sliding_d_placements();
+					}
+					placements = &sliding_d_placements;
+				}
+				evaluate_vdj_pair(*v_iter , *j_iter , *placements , seq_marginals , touched_marginals);
+			}
+		}
+		add_coverage_posteriors(first_dinucl , first_coverage , false , seq_marginals , touched_marginals);
+		add_coverage_posteriors(second_dinucl , second_coverage , true , seq_marginals , touched_marginals);
+	}
+
+	error_rate_obj.set_seq_statistics(seq_likelihood , seq_probability , seq_errors , seq_weighted_er , static_cast<int>(min(seq_n_scenarios , double(numeric_limits<int>::max()))));
+}
+
+/**
+ * Returns a junction evaluator for the model, or a null pointer if the model is not supported (the scenario engine should then be used)
+ */
+unique_ptr<Junction_dp_evaluator> compile_junction_dp_evaluator(const queue<shared_ptr<Rec_Event>>& model_queue , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map ,
+		const unordered_map<Rec_Event_name,int>& index_map , const unordered_map<Rec_Event_name,vector<pair<shared_ptr<const Rec_Event>,int>>>& offset_map , const shared_ptr<Error_rate>& error_rate_p){
+	Canonical_topology topology = detect_canonical_topology(model_queue);
+	if( (topology == Generic_topology) or (dynamic_cast<Single_error_rate*>(error_rate_p.get()) == nullptr) ){
+		return unique_ptr<Junction_dp_evaluator>();
+	}
+	unique_ptr<Junction_dp_evaluator> evaluator(new Junction_dp_evaluator(topology , events_map , index_map , offset_map));
+	if(not evaluator->is_supported()){
+		return unique_ptr<Junction_dp_evaluator>();
+	}
+	return evaluator;
+}
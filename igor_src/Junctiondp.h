@@ -0,0 +1,202 @@
+/*
+ * Junctiondp.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_JUNCTIONDP_H_
+#define IGOR_SRC_JUNCTIONDP_H_
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include "Canonicaltopology.h"
+#include "Singleerrorrate.h"
+#include "Aligner.h"
+#include "IntStr.h"
+#include "Utils.h"
+
+/**
+ * \class Junction_dp_evaluator Junctiondp.h
+ * \brief Forward/backward evaluation of the recombination junction for canonical models.
+ * \version 1.0
+ *
+ * Given a V and a J alignment (and a D placement for VDJ models) the probability of a scenario factorizes along the read:
+ * V 3' deletion | VD insertions | D deletions | DJ insertions | J 5' deletion, where neighbouring factors only interact
+ * through the position of their common boundary on the read. Instead of enumerating every combination of deletions,
+ * the sum over scenarios is computed by a forward pass over these boundaries and the expected event counts (marginals and
+ * error statistics used by the EM update) are recovered from the matching backward pass.
+ * The cost per (V,D,J) placement is thus linear in the number of realizations of each deletion instead of their product.
+ *
+ * Only canonical models whose deletions depend on their own gene (and D deletions on each other), whose insertions and dinucleotide
+ * Markov chains are independent and with a Single_error_rate are supported.
+ * Scenarios are never pruned: this is equivalent to an exploration with null probability ratio and likelihood thresholds.
+ */
+class Junction_dp_evaluator {
+public:
+	Junction_dp_evaluator(Canonical_topology , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& ,
+			const std::unordered_map<Rec_Event_name,int>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>&);
+	virtual ~Junction_dp_evaluator(){};
+
+	bool is_supported() const{return supported;}
+	Canonical_topology get_topology() const{return topology;}
+	double get_best_scenario_proba() const{return seq_best_scenario;}
+
+	void evaluate(const Int_Str& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , const Marginal_array_p& , Marginal_array_p& , Touched_marginals_indices& , Single_error_rate&);
+
+private:
+	struct Compiled_event{
+		const Rec_Event* event_p;
+		int base_index;
+		int v_stride;
+		int d_stride;
+		int j_stride;
+		int del_stride;//Stride applied by the other D deletion
+		std::vector<int> values;
+		std::vector<int> indices;
+		std::vector<int> value_indices;//Realization index for each value of an insertion event (-1 if not a realization)
+		Compiled_event(): event_p(nullptr) , base_index(0) , v_stride(0) , d_stride(0) , j_stride(0) , del_stride(0){}
+	};
+
+	//A deletion realization on the V (or J) gene, boundary is the position of the last (first) templated nucleotide on the read
+	struct Deletion_state{
+		int boundary;
+		int nt;
+		double proba;
+		double err_proba;
+		int n_errors;
+		int marginal_index;
+	};
+
+	struct Gene_alignment{
+		int gene_index;
+		int outer_offset;//5' offset of the V or 3' offset of the J on the read
+		std::vector<Deletion_state> states;
+		//Junction side tables indexed by [position*(max_ins+1) + n_ins]
+		std::vector<double> junction_w;
+		std::vector<double> junction_we;
+		std::vector<double> junction_p;
+		//Sums over insertions indexed by position
+		std::vector<double> sum_w;
+		std::vector<double> sum_we;
+		std::vector<double> sum_p;
+		std::vector<double> sum_cnt;
+		std::vector<double> max_w;//Best scenario weight over insertions
+	};
+
+	struct D_state{
+		int d_5_offset;
+		int d_3_offset;
+		double proba;
+		double err_proba;
+		int n_errors;
+		int d_5_marginal_index;
+		int d_3_marginal_index;
+	};
+
+	struct D_placement{
+		int gene_index;
+		std::vector<D_state> states;
+	};
+
+	Canonical_topology topology;
+	bool supported;
+
+	Compiled_event v_choice;
+	Compiled_event d_choice;
+	Compiled_event j_choice;
+	Compiled_event v_3_del;
+	Compiled_event d_5_del;
+	Compiled_event d_3_del;
+	Compiled_event j_5_del;
+	Compiled_event first_ins;//VD or VJ
+	Compiled_event first_dinucl;
+	Compiled_event second_ins;//DJ
+	Compiled_event second_dinucl;
+
+	//Per sequence workspace
+	const Int_Str* read_p;
+	int read_len;
+	const Marginal_array_p* model_parameters_p;
+	double error_rate;
+	int first_max_ins;
+	int second_max_ins;
+	std::vector<double> first_ins_proba;
+	std::vector<double> second_ins_proba;
+	std::vector<double> first_inner;
+	std::vector<double> second_inner;
+	std::vector<Gene_alignment> v_alignments;
+	std::vector<Gene_alignment> j_alignments;
+	std::vector<D_placement> aligned_d_placements;
+	std::vector<D_placement> sliding_d_placements;
+	bool sliding_d_computed;
+	//Range of D 5' offsets (D 3' offsets + 1) reached by at least one V (J) alignment
+	int d_5_window_first;
+	int d_5_window_last;
+	int d_3_window_first;
+	int d_3_window_last;
+	std::vector<long double> v_posterior_weights;
+	std::vector<long double> j_posterior_weights;
+	std::vector<double> e_vec_w;
+	std::vector<double> e_vec_we;
+	std::vector<long double> first_coverage;
+	std::vector<long double> second_coverage;
+
+	//Per sequence statistics
+	long double seq_likelihood;
+	long double seq_probability;
+	long double seq_errors;
+	long double seq_weighted_er;
+	double seq_n_scenarios;
+	double seq_best_scenario;
+
+	void compile_event(Compiled_event& , std::shared_ptr<Rec_Event> , const std::unordered_map<Rec_Event_name,int>& ,
+			const std::unordered_map<Rec_Event_name,std::vector<std::pair<Rec_Event_name,int>>>& , bool allow_v , bool allow_d , bool allow_j , const Compiled_event* other_del);
+
+	double transition_proba(const Compiled_event& , int , int) const;
+	int transition_index(const Compiled_event& , int , int) const;
+	double error_proba(int , int) const;
+	double gene_proba(int , int , int) const;
+	void add_marginal(Marginal_array_p& , Touched_marginals_indices& , int , long double) const;
+
+	void build_junction_tables();
+	void build_v_alignment(const Alignment_data& , Gene_alignment&);
+	void build_j_alignment(const Alignment_data& , Gene_alignment&);
+	void build_d_placement(const Event_realization& , int , const std::vector<int>& , D_placement&) const;
+	void build_sliding_d_placements();
+	void compute_d_windows();
+
+	long double vdj_pair_likelihood(const Gene_alignment& , const Gene_alignment& , const std::vector<D_placement>&) const;
+	void evaluate_vdj_pair(const Gene_alignment& , const Gene_alignment& , const std::vector<D_placement>& , Marginal_array_p& , Touched_marginals_indices&);
+	void evaluate_vj_pair(const Gene_alignment& , const Gene_alignment& , Marginal_array_p& , Touched_marginals_indices&);
+	void add_v_side_posteriors(const Gene_alignment& , Marginal_array_p& , Touched_marginals_indices&);
+	void add_j_side_posteriors(const Gene_alignment& , Marginal_array_p& , Touched_marginals_indices&);
+	void add_coverage_posteriors(const Compiled_event& , const std::vector<long double>& , bool , Marginal_array_p& , Touched_marginals_indices&);
+};
+
+std::unique_ptr<Junction_dp_evaluator> compile_junction_dp_evaluator(const std::queue<std::shared_ptr<Rec_Event>>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& ,
+		const std::unordered_map<Rec_Event_name,int>& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , const std::shared_ptr<Error_rate>&);
+
+
+#endif /* IGOR_SRC_JUNCTIONDP_H_ */
@@ -51,6 +51,13 @@ Model_marginals::Model_marginals(const Model_marginals& other):marginal_array_sm
 	}
 }
 
+/*
+ * Steals the other's array, leaving it empty
+ */
+Model_marginals::Model_marginals(Model_marginals&& other) noexcept:debug_marg_name(std::move(other.debug_marg_name)) , marginal_array_smart_p(std::move(other.marginal_array_smart_p)) , marginal_arr_size(other.marginal_arr_size){
+	other.marginal_arr_size = 0;
+}
+
 Model_marginals::Model_marginals(size_t arr_size):marginal_arr_size(arr_size){
 	marginal_array_smart_p = Marginal_array_p(new long double[marginal_arr_size]);
 	this->null_initialize();
@@ -688,21 +695,52 @@ Model_marginals& Model_marginals::operator=(const Model_marginals& other){
 	return *this;
 }
 
-Model_marginals& Model_marginals::operator +=(Model_marginals marginals){
+Model_marginals& Model_marginals::operator=(Model_marginals&& other) noexcept{
+	if(this != &other){
+		this->marginal_arr_size = other.marginal_arr_size;
+		this->marginal_array_smart_p = std::move(other.marginal_array_smart_p);
+		other.marginal_arr_size = 0;
+	}
+	return *this;
+}
+
+Model_marginals& Model_marginals::operator +=(const Model_marginals& marginals){
 	if(this->marginal_arr_size != marginals.marginal_arr_size){
 		throw invalid_argument("Model_marginals must have the same size in : Model_marginals::operator+=");
 	}
 	else{
-		for(size_t i = 0 ; i!= this->marginal_arr_size ; ++i){
-			this->marginal_array_smart_p[i]+=marginals.marginal_array_smart_p[i];
-		}
+		this->add_range(marginals.marginal_array_smart_p.get() , 0 , this->marginal_arr_size);
 	}
 	return *this;
 }
 
-Model_marginals& Model_marginals::operator -=(Model_marginals marginals){
+/**
+ * Add the entries [first_index,last_index) of marginals to the corresponding entries of this marginals.
+ * Disjoint ranges can be merged concurrently by different threads.
+ */
+void Model_marginals::add_range(const Model_marginals& marginals , size_t first_index , size_t last_index){
 	if(this->marginal_arr_size != marginals.marginal_arr_size){
-		throw invalid_argument("Model_marginals must have the same size in : Model_marginals::operator+=");
+		throw invalid_argument("Model_marginals must have the same size in : Model_marginals::add_range");
+	}
+	this->add_range(marginals.marginal_array_smart_p.get() , first_index , last_index);
+}
+
+/**
+ * Add the entries [first_index,last_index) of a raw marginal array (of at least this marginals length) to this marginals.
+ */
+void Model_marginals::add_range(const long double* marginal_array , size_t first_index , size_t last_index){
+	if(last_index > this->marginal_arr_size or first_index > last_index){
+		throw out_of_range("Invalid range [" + to_string(first_index) + "," + to_string(last_index) + ") for marginals of size " + to_string(this->marginal_arr_size) + " in Model_marginals::add_range");
+	}
+	long double* this_array = this->marginal_array_smart_p.get();
+	for(size_t i = first_index ; i!= last_index ; ++i){
+		this_array[i]+=marginal_array[i];
+	}
+}
+
+Model_marginals& Model_marginals::operator -=(const Model_marginals& marginals){
+	if(this->marginal_arr_size != marginals.marginal_arr_size){
+		throw invalid_argument("Model_marginals must have the same size in : Model_marginals::operator-=");
 	}
 	else{
 		for(size_t i = 0 ; i!= this->marginal_arr_size ; ++i){
@@ -712,14 +750,40 @@ Model_marginals& Model_marginals::operator -=(Model_marginals marginals){
 	return *this;
 }
 
-Model_marginals Model_marginals::operator +(Model_marginals marginals){
+/**
+ * Scatter the entries of marginals recorded in touched_indices onto this marginals.
+ * Equivalent to operator+= if all other entries of marginals are 0.
+ */
+void Model_marginals::add_touched(const Model_marginals& marginals , const Touched_marginals_indices& touched_indices){
+	if(this->marginal_arr_size != marginals.marginal_arr_size){
+		throw invalid_argument("Model_marginals must have the same size in : Model_marginals::add_touched");
+	}
+	const vector<size_t>& indices = touched_indices.get_indices();
+	for(vector<size_t>::const_iterator iter = indices.begin() ; iter != indices.end() ; ++iter){
+		this->marginal_array_smart_p[*iter]+=marginals.marginal_array_smart_p[*iter];
+	}
+}
+
+/**
+ * Set back to 0 the entries recorded in touched_indices
+ */
+void Model_marginals::reset_touched(const Touched_marginals_indices& touched_indices){
+	const vector<size_t>& indices = touched_indices.get_indices();
+	for(vector<size_t>::const_iterator iter = indices.begin() ; iter != indices.end() ; ++iter){
+		this->marginal_array_smart_p[*iter] = 0;
+	}
+}
+
+Model_marginals Model_marginals::operator +(const Model_marginals& marginals) const{
 	Model_marginals temp = *this;
-	return temp+=marginals;
+	temp+=marginals;
+	return temp;
 }
 
-Model_marginals Model_marginals::operator -(Model_marginals marginals){
+Model_marginals Model_marginals::operator -(const Model_marginals& marginals) const{
 	Model_marginals temp = *this;
-	return temp-=marginals;
+	temp-=marginals;
+	return temp;
 }
 
 
@@ -62,6 +62,7 @@ public:
 	Model_marginals();
 	Model_marginals(const Model_Parms&);
 	Model_marginals(const Model_marginals&);
+	Model_marginals(Model_marginals&&) noexcept;
 	virtual ~Model_marginals();
 	size_t compute_size(const Model_Parms&);
 	size_t get_event_size( std::shared_ptr<const Rec_Event> , const Model_Parms&) const;
@@ -69,10 +70,15 @@ public:
 	std::pair<std::list<std::pair<Rec_Event_name,size_t>>,std::shared_ptr<long double>> compute_event_marginal_probability(Rec_Event_name , const std::set<Rec_Event_name>& , const Model_Parms& ) const;
 
 	Model_marginals& operator=(const Model_marginals&);
-	Model_marginals& operator +=(Model_marginals );
-	Model_marginals& operator -=(Model_marginals );
-	Model_marginals operator +(Model_marginals );
-	Model_marginals operator -(Model_marginals );
+	Model_marginals& operator=(Model_marginals&&) noexcept;
+	Model_marginals& operator +=(const Model_marginals& );
+	Model_marginals& operator -=(const Model_marginals& );
+	Model_marginals operator +(const Model_marginals& ) const;
+	Model_marginals operator -(const Model_marginals& ) const;
+	void add_range(const Model_marginals& , size_t , size_t);
+	void add_range(const long double* , size_t , size_t);
+	void add_touched(const Model_marginals& , const Touched_marginals_indices&);
+	void reset_touched(const Touched_marginals_indices&);
 	void normalize(std::unordered_map<Rec_Event_name,std::list<std::pair<std::shared_ptr<const Rec_Event>,int>>> , std::unordered_map<Rec_Event_name,int> , std::queue<std::shared_ptr<Rec_Event>>);
 	void uniform_initialize(const Model_Parms&);
 	void null_initialize();
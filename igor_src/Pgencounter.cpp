@@ -97,24 +97,24 @@ void Pgen_counter::initialize_counter(const Model_Parms& parms , const Model_mar
 void Pgen_counter::count_scenario(long double scenario_seq_joint_proba , double scenario_probability , const string& original_sequence ,  Seq_type_str_p_map& constructed_sequences , const Seq_offsets_map& seq_offsets , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , Mismatch_vectors_map& mismatches_lists ){
 	scenario_resulting_sequence.clear();
 	if(v_gene){
-		scenario_resulting_sequence += (*constructed_sequences[V_gene_seq]);
+		scenario_resulting_sequence += constructed_sequences[V_gene_seq];
 	}
 	if(d_gene){
 		if(vd_ins){
-			scenario_resulting_sequence+=(*constructed_sequences[VD_ins_seq]);
+			scenario_resulting_sequence+=constructed_sequences[VD_ins_seq];
 		}
-		scenario_resulting_sequence+=(*constructed_sequences[D_gene_seq]);
+		scenario_resulting_sequence+=constructed_sequences[D_gene_seq];
 		if(dj_ins){
-			scenario_resulting_sequence+=(*constructed_sequences[DJ_ins_seq]);
+			scenario_resulting_sequence+=constructed_sequences[DJ_ins_seq];
 		}
 	}
 	else{
 		if(vj_ins){
-			scenario_resulting_sequence+=(*constructed_sequences[VJ_ins_seq]);
+			scenario_resulting_sequence+=constructed_sequences[VJ_ins_seq];
 		}
 	}
 	if(j_gene){
-		scenario_resulting_sequence+=(*constructed_sequences[J_gene_seq]);
+		scenario_resulting_sequence+=constructed_sequences[J_gene_seq];
 	}
 
 
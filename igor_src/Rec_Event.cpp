@@ -26,12 +26,14 @@
 
 #include "Rec_Event.h"
 #include "Counter.h"
+#include "Scenarioengine.h"
+#include <limits>
 
 using namespace std;
 
 //std::ofstream log_file(std::string("/media/quentin/419a9e2c-2635-471b-baa0-58a693d04d87/data/tcr_murugan/one_seq_comp/logs.txt"));
 
-Rec_Event::Rec_Event(Gene_class gene , Seq_side side ): priority(0) , event_class(gene) , event_side(side) , name("Undefined_event_name") ,len_min(INT16_MAX) , len_max(INT16_MIN) , type(Undefined_t), event_index(INT16_MIN) , updated(false),fixed(false) , current_realizations_index_vec(vector<int>()) , scenario_downstream_upper_bound_proba(-1),event_upper_bound_proba(-1),scenario_upper_bound_proba(-1),current_realization_index(nullptr){} //FIXME why does this exist? anyway fix initilization
+Rec_Event::Rec_Event(Gene_class gene , Seq_side side ): priority(0) , event_class(gene) , event_side(side) , name("Undefined_event_name") ,len_min(INT16_MAX) , len_max(INT16_MIN) , type(Undefined_t), event_index(INT16_MIN) , updated(false),fixed(false) , current_realizations_index_vec(vector<int>()) , scenario_downstream_upper_bound_proba(-1),event_upper_bound_proba(-1),scenario_upper_bound_proba(-1),current_realization_index(nullptr),touched_marginals_p(nullptr),len_proba_parents_realization(-1){} //FIXME why does this exist? anyway fix initilization
 
 
 Rec_Event::Rec_Event(Gene_class gene , Seq_side side , unordered_map<string , Event_realization>& realizations): Rec_Event(gene,side)  {
@@ -104,65 +106,12 @@ int Rec_Event::get_event_identifier() const {
 }
 
 
-void Rec_Event::iterate_wrap_up(double& scenario_proba , Downstream_scenario_proba_bound_map& downstream_proba_map , const std::string& sequence , const Int_Str& int_sequence , Index_map& index_map , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& offset_map , std::shared_ptr<Next_event_ptr>& next_event_ptr_arr  , Marginal_array_p& updated_marginal_array_p , const Marginal_array_p& model_parameters_point ,const std::unordered_map<Gene_class , std::vector<Alignment_data>>& allowed_realizations , Seq_type_str_p_map& constructed_sequences  , Seq_offsets_map& seq_offsets , std::shared_ptr<Error_rate>& error_rate_p , map<size_t,shared_ptr<Counter>>& counters_list ,const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& events_map  , Safety_bool_map& safety_set , Mismatch_vectors_map& mismatches_lists , double& seq_max_prob_scenario , double& proba_threshold_factor){
-
-
-/*			if(seq_offsets.count(make_pair(J_gene_seq, Three_prime))!=0){
-
-					int offset3=seq_offsets.at(make_pair(J_gene_seq, Three_prime));
-					int offset5=seq_offsets.at(make_pair(J_gene_seq, Five_prime));
-					if(offset5==0){
-						cout<<"problem"<<endl;
-					}
-					if(offset3==0){
-						cout<<"big_problem"<<endl;
-					}
-
-	 		  }*/
-
-
-	if(next_event_ptr_arr.get()[this->event_index]){ //Tests whether the next event pointer is null
-			//Recursive call to iterate
-			//TODO consider adding a threshold for too low probability events(if necessary)
-		next_event_ptr_arr.get()[this->event_index]->iterate(scenario_proba , downstream_proba_map , sequence , int_sequence , index_map , offset_map , next_event_ptr_arr , updated_marginal_array_p , model_parameters_point , allowed_realizations , constructed_sequences  , seq_offsets , error_rate_p , counters_list , events_map , safety_set , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
-
-
-	}
-	else{
-
-		long double scenario_error_w_proba = error_rate_p->compare_sequences_error_prob( scenario_proba , sequence , constructed_sequences , seq_offsets , events_map , mismatches_lists , seq_max_prob_scenario , proba_threshold_factor);
-
-		//TODO add a monitor of the likelihood at each iteration
-
-		//TODO implement sequence comparison in the error rate class
-		//log_file<<scenario_error_w_proba<<endl;
-		//Add the full recombination scenario probability to the marginals
-		/*for(forward_list<int*>::const_iterator iter = write_index_list.begin() ; iter!=write_index_list.end() ; iter++){
-			updated_marginal_array_p[*(*iter)] += scenario_error_w_proba;
-			if(((*iter)==2865) & (!constructed_sequences.at(VD_ins_seq).empty())){
-				cout<<"error"<<endl;
-			}
-			if(((*iter)==2896) & (!constructed_sequences.at(DJ_ins_seq).empty())){
-				cout<<"error"<<endl;
-			}
-		}*/
-
-		if(scenario_error_w_proba>=seq_max_prob_scenario*proba_threshold_factor){
-			if(scenario_error_w_proba>seq_max_prob_scenario){seq_max_prob_scenario=scenario_error_w_proba;}
-
-			for(std::map<size_t,std::shared_ptr<Counter>>::iterator iter = counters_list.begin() ; iter != counters_list.end() ; ++iter){
-				(*iter).second->count_scenario(scenario_error_w_proba ,scenario_proba , sequence , constructed_sequences , seq_offsets , events_map , mismatches_lists );
-			}
-
-			for(std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>::const_iterator iter = events_map.begin() ; iter != events_map.end() ; iter++){
-				if(!(*iter).second->is_fixed()){
-					(*iter).second->add_to_marginals(scenario_error_w_proba , updated_marginal_array_p);
-				}
-			}
-		}
-
-
-	}
+/**
+ * Call iterate on the next event or record the complete scenario if this event is the last one
+ * The actual dispatch is performed by the compiled Scenario_engine
+ */
+void Rec_Event::iterate_wrap_up(double& scenario_proba , Scenario_context& context){
+	context.engine.iterate_next(this->event_index , scenario_proba , context);
 }
 
 
@@ -300,3 +249,158 @@ void Rec_Event::iterate_initialize_Len_proba_wrap_up(Seq_type considered_junctio
 
 }
 
+
+/*
+ * Called by the events that only shift the junction length (their realizations do not change the constructed sequences read by the downstream events):
+ * the length-max_proba_bound of the downstream events is computed once and combined with the (length shift , probability) of each realization,
+ * this gives the same bounds as a recursive call for each realization at the cost of a single one.
+ */
+void Rec_Event::iterate_initialize_Len_proba_shifts(Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  const std::queue<std::shared_ptr<Rec_Event>>& model_queue , double scenario_proba , const std::vector<std::pair<int,double>>& length_shifts , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int seq_len ) const{
+	map<int,double> downstream_length_proba_map;
+	this->initialize_downstream_Len_proba(considered_junction , downstream_length_proba_map , model_queue , model_parameters_point , base_index_map , constructed_sequences);
+	for(vector<pair<int,double>>::const_iterator shift_iter = length_shifts.begin() ; shift_iter != length_shifts.end() ; ++shift_iter){
+		for(map<int,double>::const_iterator len_iter = downstream_length_proba_map.begin() ; len_iter != downstream_length_proba_map.end() ; ++len_iter){
+			const double length_proba = scenario_proba*shift_iter->second*len_iter->second;
+			map<int,double>::iterator best_iter = length_best_proba_map.find(seq_len + shift_iter->first + len_iter->first);
+			if(best_iter == length_best_proba_map.end()){
+				length_best_proba_map.emplace(seq_len + shift_iter->first + len_iter->first , length_proba);
+			}
+			else if(length_proba > best_iter->second){
+				best_iter->second = length_proba;
+			}
+		}
+	}
+}
+
+/*
+ * Fills up the length-max_proba_bound of a junction for the events of the model queue only, i.e. downstream of this event.
+ * The event itself is left out: when its bounds are read its realization is chosen, its probability is already part of the scenario probability and its length part of the junction offsets.
+ */
+void Rec_Event::initialize_downstream_Len_proba(Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  const std::queue<std::shared_ptr<Rec_Event>>& model_queue , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int seq_len ) const{
+	Rec_Event::iterate_initialize_Len_proba_wrap_up(considered_junction , length_best_proba_map , model_queue , 1.0 , model_parameters_point , base_index_map , constructed_sequences , seq_len);
+}
+
+/*
+ * Probability of a realization used by iterate_initialize_Len_proba(): the largest one over the realizations of the parents of the event,
+ * or the one given the parents realizations if these are chosen (see Conditional_length_proba_bounds)
+ */
+double Rec_Event::get_len_proba_realization_bound(size_t base_index , int realization_index , const Marginal_array_p& model_parameters_point) const{
+	if(len_proba_parents_realization >= 0){
+		return model_parameters_point[base_index + realization_index + len_proba_parents_realization*this->size()];
+	}
+	double real_max_proba = 0;
+	for(size_t i = 0 ; i!=this->event_marginal_size/this->size() ; ++i){
+		if(model_parameters_point[base_index + realization_index + i*this->size()]>real_max_proba){
+			real_max_proba = model_parameters_point[base_index + realization_index + i*this->size()];
+		}
+	}
+	return real_max_proba;
+}
+
+Conditional_length_proba_bounds::Conditional_length_proba_bounds(): junction(VJ_ins_seq) , last_key(0) , last_length_proba_map_p(nullptr){}
+
+/*
+ * Records the events of the model queue after the given event whose parents are all chosen before or by the event, the length proba bounds are then conditioned on the realizations of their parents.
+ * The given event itself is left out of the bounds: its probability is already accounted for in the scenario probability (see initialize_downstream_Len_proba()).
+ * A junction receiving the length of a downstream gene (the VJ junction of a VDJ model) is not conditioned: the events shortening the gene are conditioned on the gene that is not chosen yet.
+ * Insertions are not conditioned since the downstream Dinucl_markov reads their length.
+ */
+void Conditional_length_proba_bounds::initialize(Seq_type considered_junction , const Rec_Event& event , const queue<shared_ptr<Rec_Event>>& downstream_queue , const Marginal_array_p& model_parameters_point , Index_map& base_index_map){
+	this->clear();
+	junction = considered_junction;
+
+	//Events with a parent that is not chosen yet
+	unordered_set<int> unresolved_events;
+	int max_event_identifier = event.event_index;
+	for(queue<shared_ptr<Rec_Event>> tmp_queue = downstream_queue ; not tmp_queue.empty() ; tmp_queue.pop()){
+		if( (tmp_queue.front()->get_type() == GeneChoice_t) and tmp_queue.front()->has_effect_on(junction) ){
+			return;
+		}
+		for(forward_list<tuple<int,int,int>>::const_iterator child_iter = tmp_queue.front()->memory_and_offsets.begin() ; child_iter != tmp_queue.front()->memory_and_offsets.end() ; ++child_iter){
+			unresolved_events.emplace(get<0>(*child_iter));
+		}
+		max_event_identifier = max(max_event_identifier , tmp_queue.front()->event_index);
+	}
+
+	//The base indices without parents are read on a separate index map since reading a memory layer moves the current memory layer of an Index_map
+	base_index_map_p = make_shared<Index_map>(max_event_identifier + 1);
+	base_index_map_p->set_value(event.event_index , base_index_map.at(event.event_index,0) , 0);
+	queue<shared_ptr<Rec_Event>> unconditioned_queue;
+	for(queue<shared_ptr<Rec_Event>> tmp_queue = downstream_queue ; not tmp_queue.empty() ; tmp_queue.pop()){
+		const shared_ptr<Rec_Event>& downstream_event_p = tmp_queue.front();
+		const size_t base_index = base_index_map.at(downstream_event_p->event_index,0);
+		base_index_map_p->set_value(downstream_event_p->event_index , base_index , 0);
+		const size_t n_parents_realizations = downstream_event_p->event_marginal_size/downstream_event_p->size();
+		if( downstream_event_p->has_effect_on(junction) and (n_parents_realizations > 1) and (unresolved_events.count(downstream_event_p->event_index) == 0)
+				and (downstream_event_p->get_type() != Insertion_t) and (downstream_event_p->get_type() != Dinuclmarkov_t) ){
+			conditioned_events.emplace_back(downstream_event_p.get() , base_index , n_parents_realizations);
+			conditioned_length_proba_maps.emplace_back(n_parents_realizations);
+		}
+		else{
+			unconditioned_queue.push(downstream_event_p);
+		}
+	}
+
+	if(not conditioned_events.empty()){
+		//Length proba bounds of the downstream events that are not conditioned
+		Seq_type_str_p_map constructed_sequences(6);
+		event.initialize_downstream_Len_proba(junction , unconditioned_length_proba_map , unconditioned_queue , model_parameters_point , *base_index_map_p , constructed_sequences);
+	}
+}
+
+void Conditional_length_proba_bounds::clear(){
+	conditioned_events.clear();
+	conditioned_length_proba_maps.clear();
+	unconditioned_length_proba_map.clear();
+	base_index_map_p.reset();
+	length_proba_maps.clear();
+	last_length_proba_map_p = nullptr;
+}
+
+/*
+ * Returns the length proba bounds given the current realizations of the parents of the conditioned events (read on the index map used for the exploration),
+ * or the unconditioned ones if no event can be conditioned.
+ * Since the events contribute independently to the length proba bounds, these are the unconditioned events bounds combined with the bounds of each conditioned event given its parents.
+ */
+const map<int,double>& Conditional_length_proba_bounds::get_length_proba_map(const map<int,double>& length_best_proba_map , const Marginal_array_p& model_parameters_point , Index_map& base_index_map){
+	if(conditioned_events.empty()){
+		return length_best_proba_map;
+	}
+	size_t key = 0;
+	for(vector<tuple<const Rec_Event*,size_t,size_t>>::const_iterator iter = conditioned_events.begin() ; iter != conditioned_events.end() ; ++iter){
+		key = key*get<2>(*iter) + (base_index_map.at(get<0>(*iter)->event_index) - get<1>(*iter))/get<0>(*iter)->size();
+	}
+	if( (last_length_proba_map_p != nullptr) and (key == last_key) ){
+		return *last_length_proba_map_p;
+	}
+	unordered_map<size_t,map<int,double>>::iterator map_iter = length_proba_maps.find(key);
+	if(map_iter == length_proba_maps.end()){
+		map_iter = length_proba_maps.emplace(key , unconditioned_length_proba_map).first;
+		for(size_t i = 0 ; i != conditioned_events.size() ; ++i){
+			const Rec_Event* conditioned_event_p = get<0>(conditioned_events[i]);
+			const size_t parents_realization = (base_index_map.at(conditioned_event_p->event_index) - get<1>(conditioned_events[i]))/conditioned_event_p->size();
+			//Length proba bounds of the event alone given the realizations of its parents
+			map<int,double>& event_length_proba_map = conditioned_length_proba_maps[i][parents_realization];
+			if(event_length_proba_map.empty()){
+				conditioned_event_p->len_proba_parents_realization = parents_realization;
+				Seq_type_str_p_map constructed_sequences(6);
+				queue<shared_ptr<Rec_Event>> empty_queue;
+				double init_proba = 1.0;
+				conditioned_event_p->Rec_Event::iterate_initialize_Len_proba(junction , event_length_proba_map , empty_queue , init_proba , model_parameters_point , *base_index_map_p , constructed_sequences);
+				conditioned_event_p->len_proba_parents_realization = -1;
+			}
+			//Best proba for each length of the combination
+			map<int,double> combined_length_proba_map;
+			for(map<int,double>::const_iterator len_iter = map_iter->second.begin() ; len_iter != map_iter->second.end() ; ++len_iter){
+				for(map<int,double>::const_iterator event_len_iter = event_length_proba_map.begin() ; event_len_iter != event_length_proba_map.end() ; ++event_len_iter){
+					double& length_proba = combined_length_proba_map[len_iter->first + event_len_iter->first];
+					length_proba = max(length_proba , len_iter->second*event_len_iter->second);
+				}
+			}
+			map_iter->second.swap(combined_length_proba_map);
+		}
+	}
+	last_key = key;
+	last_length_proba_map_p = &map_iter->second;
+	return map_iter->second;
+}
@@ -47,6 +47,7 @@
 #include <map>
 
 class Counter;
+struct Scenario_context;
 
 
 //class Model_marginals; //forward declare model marginals to avoid circular inclusion
@@ -97,6 +98,7 @@ struct Event_realization {
  *
  */
 class Rec_Event {
+	friend class Conditional_length_proba_bounds;//Conditions the length proba bounds on the realizations of the parents of the downstream events
 public:
 	Rec_Event();
 	Rec_Event(Gene_class, Seq_side );
@@ -110,24 +112,25 @@ public:
 	 * \author Q.Marcou
 	 * \version 1.0
 	 * \param [in,out] scenario_proba Probability of the currently explored (incomplete) scenario
-	 * \param [in,out] downstream_proba_map
-	 * \param [in] sequence The studied sequence in nucleotide code
-	 * \param [in] int_sequence The studied sequence in integer code
-	 * \param [in,out] base_index_map Dynamic map recording where probabilities should be read on the marginals.
-	 * \param [in] offset_map Tells the event by how much indices from the children events should be modified
-	 * \param [in] next_event_ptr_arr Indicates the next event to call iterate on
-	 * \param [in] updated_marginals_point Summary marginals on which complete scenario posteriors are recorded
-	 * \param [in] model_parameters_point Current recombination probability distribution
-	 * \param [in] allowed_realizations The set of genomic templates alignment
-	 * \param [in,out] constructed_sequences Map containing the (incomplete) scenario's resulting sequence
-	 * \param [in,out] seq_offsets Map containing the 3' and 5' offsets of each scenario sequence piece
-	 * \param [in] error_rate_p Pointer to the error model object
-	 * \param [in] counters_list The list of Counter to be counted
-	 * \param [in] events_map A map containing all events contained in the Model_parms, accessible through their type, gene class and side.
-	 * \param [in,out] safety_set A map indicating whether checks on offsets overlap should be performed
-	 * \param [in,out] mismatches_lists A map containing the (incomplete) scenario mismatches
-	 * \param [in] seq_max_prob_scenario Most likely scenario's probability for the considered sequence
-	 * \param [in] proba_threshold_factor Threshold on probability ratio between most likely scenario and explored scenario
+	 * \param [in,out] context The scenario exploration state, containing:
+	 *  - downstream_proba_map
+	 *  - sequence The studied sequence in nucleotide code
+	 *  - int_sequence The studied sequence in integer code
+	 *  - index_map Dynamic map recording where probabilities should be read on the marginals.
+	 *  - offset_map Tells the event by how much indices from the children events should be modified
+	 *  - updated_marginals Summary marginals on which complete scenario posteriors are recorded
+	 *  - model_parameters Current recombination probability distribution
+	 *  - allowed_realizations The set of genomic templates alignment
+	 *  - constructed_sequences Map containing the (incomplete) scenario's resulting sequence
+	 *  - seq_offsets Map containing the 3' and 5' offsets of each scenario sequence piece
+	 *  - error_rate_p Pointer to the error model object
+	 *  - counters_list The list of Counter to be counted
+	 *  - events_map A map containing all events contained in the Model_parms, accessible through their type, gene class and side.
+	 *  - safety_set A map indicating whether checks on offsets overlap should be performed
+	 *  - mismatches_lists A map containing the (incomplete) scenario mismatches
+	 *  - seq_max_prob_scenario Most likely scenario's probability for the considered sequence
+	 *  - proba_threshold_factor Threshold on probability ratio between most likely scenario and explored scenario
+	 *  - engine The compiled Scenario_engine indicating the next event to call iterate on
 	 *
 	 *
 	 * \return void
@@ -140,13 +143,13 @@ public:
 	 *  It is further modified to take into account the current event's realization when its children realization probabilities will be read.
 	 *
 	 */
-	virtual void iterate(double& , Downstream_scenario_proba_bound_map& , const std::string& , const Int_Str& , Index_map& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& , std::shared_ptr<Next_event_ptr>& , Marginal_array_p& , const Marginal_array_p& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , Seq_type_str_p_map& , Seq_offsets_map& , std::shared_ptr<Error_rate>& , std::map<size_t,std::shared_ptr<Counter>>& , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>> & , Safety_bool_map& , Mismatch_vectors_map& , double& , double&)=0 ;
+	virtual void iterate(double& , Scenario_context&)=0 ;
 	bool set_priority(int);
 
 	//Accessors
 	const Gene_class get_class() const{return event_class;};
 	const Seq_side get_side() const{return event_side;};
-	const std::unordered_map<std::string , Event_realization>  get_realizations_map() const{return event_realizations;};
+	const std::unordered_map<std::string , Event_realization>& get_realizations_map() const{return event_realizations;};
 	const int get_priority() const{return priority;};
 	const Rec_Event_name get_name() const{return name;};
 	const std::string get_nickname() const{return nickname;};
@@ -175,6 +178,7 @@ public:
 	void fix(bool fix_status) {fixed = fix_status;}
 	bool is_fixed() const{return fixed;}
 	void set_viterbi_run(bool viterbi_like){viterbi_run = viterbi_like;}
+	void set_touched_marginals(Touched_marginals_indices* touched_indices_p){touched_marginals_p = touched_indices_p;}
 	virtual double* get_updated_ptr();
 	void compute_crude_upper_bound_scenario_proba( double& ) ;
 	const std::vector<int>& get_current_realizations_index_vec() const{return current_realizations_index_vec;};
@@ -182,6 +186,8 @@ public:
 	//Proba bound related computation methods
 	virtual bool has_effect_on(Seq_type) const= 0;
 	void iterate_initialize_Len_proba_wrap_up( Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  std::queue<std::shared_ptr<Rec_Event>> model_queue , double scenario_proba , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int seq_len ) const;
+	void iterate_initialize_Len_proba_shifts( Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  const std::queue<std::shared_ptr<Rec_Event>>& model_queue , double scenario_proba , const std::vector<std::pair<int,double>>& length_shifts , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int seq_len ) const;
+	void initialize_downstream_Len_proba( Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  const std::queue<std::shared_ptr<Rec_Event>>& model_queue , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int seq_len = 0 ) const;
 	virtual void iterate_initialize_Len_proba( Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  std::queue<std::shared_ptr<Rec_Event>>& model_queue , double& scenario_proba , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences , int& seq_len ) const = 0;
 	void iterate_initialize_Len_proba( Seq_type considered_junction ,  std::map<int,double>& length_best_proba_map ,  std::queue<std::shared_ptr<Rec_Event>>& model_queue , double& scenario_proba , const Marginal_array_p& model_parameters_point , Index_map& base_index_map , Seq_type_str_p_map& constructed_sequences  ) const ;
 	virtual void initialize_Len_proba_bound(std::queue<std::shared_ptr<Rec_Event>>& model_queue , const Marginal_array_p& model_parameters_point , Index_map& base_index_map ) =0;
@@ -212,15 +218,28 @@ protected:
 	std::vector<int> current_realizations_index_vec;
 	const int* current_realization_index;
 	int current_downstream_proba_memory_layers[6];
+	Touched_marginals_indices* touched_marginals_p; //If not null, records the marginal entries written by add_to_marginals
+	mutable int len_proba_parents_realization; //Index of the parents realizations used by iterate_initialize_Len_proba(), -1: maximum over all of them
 
 
 
 
 
+	void record_touched_marginal(size_t index) const{
+		if(touched_marginals_p != nullptr){
+			touched_marginals_p->touch(index);
+		}
+	}
+	void record_touched_marginal_range(size_t first_index , size_t range_length) const{
+		if(touched_marginals_p != nullptr){
+			touched_marginals_p->touch_range(first_index,range_length);
+		}
+	}
+	double get_len_proba_realization_bound(size_t , int , const Marginal_array_p&) const;
 	int compare_sequences(std::string,std::string);//TODO should probably not be a member functino
 	void add_realization(const Event_realization&);
 	//inline void iterate_wrap_up(double& , double& , const std::string& , const std::string& , Index_map& , const std::unordered_map<Rec_Event_name,std::vector<std::pair<const Rec_Event*,int>>>& , std::queue<Rec_Event*>  , Marginal_array_p&  , const Marginal_array_p& , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& , Seq_type_str_p_map& , Seq_offsets_map& ,std::shared_ptr<Error_rate>&,const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>,const Rec_Event*>&  , Safety_bool_map& , Mismatch_vectors_map& , double& , double&);
-	void iterate_wrap_up(double& scenario_proba , Downstream_scenario_proba_bound_map& downstream_proba_map , const std::string& sequence , const Int_Str& int_sequence , Index_map& index_map , const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& offset_map , std::shared_ptr<Next_event_ptr>& next_event_ptr_arr  , Marginal_array_p& updated_marginal_array_p , const Marginal_array_p& model_parameters_point ,const std::unordered_map<Gene_class , std::vector<Alignment_data>>& allowed_realizations , Seq_type_str_p_map& constructed_sequences  , Seq_offsets_map& seq_offsets , std::shared_ptr<Error_rate>& error_rate_p , std::map<size_t,std::shared_ptr<Counter>>& counters_list,const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& events_map  , Safety_bool_map& safety_set , Mismatch_vectors_map& mismatches_lists , double& seq_max_prob_scenario , double& proba_threshold_factor);
+	void iterate_wrap_up(double& scenario_proba , Scenario_context& context);
 
 };
 
@@ -231,6 +250,32 @@ struct Event_comparator {
 	 }
 };
 
+/**
+ * \class Conditional_length_proba_bounds Rec_Event.h
+ * \brief Junction length proba bounds of an event conditioned on the chosen parents of the downstream events.
+ *
+ * The length proba bounds computed in initialize_Len_proba_bound() take for each downstream event the largest probability over the realizations of its parents.
+ * The parents of some of these events are already chosen when the bound is used (e.g. the V and J 3' and 5' deletions once the V and J genes are chosen),
+ * their probabilities given the chosen parents are used instead. The length proba bounds are computed the first time a combination of these parents realizations is met.
+ */
+class Conditional_length_proba_bounds{
+public:
+	Conditional_length_proba_bounds();
+	void initialize(Seq_type , const Rec_Event& , const std::queue<std::shared_ptr<Rec_Event>>& , const Marginal_array_p& , Index_map&);
+	void clear();
+	const std::map<int,double>& get_length_proba_map(const std::map<int,double>& , const Marginal_array_p& , Index_map&);
+
+private:
+	Seq_type junction;
+	std::vector<std::tuple<const Rec_Event*,size_t,size_t>> conditioned_events; //Event, base index without parents, number of parents realizations
+	std::vector<std::vector<std::map<int,double>>> conditioned_length_proba_maps; //By conditioned event and parents realization, computed when first needed
+	std::map<int,double> unconditioned_length_proba_map; //Length proba bounds of the downstream events that are not conditioned
+	std::shared_ptr<Index_map> base_index_map_p; //Base indices without parents of the events involved in the length proba bounds
+	std::unordered_map<size_t,std::map<int,double>> length_proba_maps; //By combination of the conditioned events parents realizations
+	size_t last_key;
+	const std::map<int,double>* last_length_proba_map_p;
+};
+
 
 
 #endif /* REC_EVENT_H_ */
@@ -0,0 +1,257 @@
+/*
+ * Scenarioengine.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Scenarioengine.h"
+
+using namespace std;
+
+/**
+ * Compile the model queue (events sorted by processing order) into the chain of steps explored for each sequence.
+ * The events map and counters list must be the ones used by the thread exploring the scenarios.
+ * If generic is true events are not dispatched on their type and the marginals are not recorded through the canonical topology (reference path).
+ */
+Scenario_engine::Scenario_engine(queue<shared_ptr<Rec_Event>> model_queue , const unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>& events_map , const map<size_t,shared_ptr<Counter>>& counters_list , bool generic): generic(generic) , n_events(model_queue.size()){
+	if(model_queue.empty()){
+		throw invalid_argument("Cannot compile a Scenario_engine from an empty model queue");
+	}
+
+	topology = generic ? Generic_topology : detect_canonical_topology(model_queue);
+
+	next_steps.resize(model_queue.size());
+	first_step = compile_dispatch_step(model_queue.front().get());
+	while(not model_queue.empty()){
+		Rec_Event* event_p = model_queue.front().get();
+		model_queue.pop();
+		queue_events.push_back(event_p);
+		queue_updates_marginals.push_back(not event_p->is_fixed());
+		//The per read tables are needed whatever the dispatch
+		const Compiled_step typed_step = compile_step(event_p);
+		queue_steps.push_back(compile_dispatch_step(event_p));
+		if(typed_step.type == Deletion_t){
+			deletion_events.push_back(static_cast<Deletion*>(event_p));
+		}
+		if(typed_step.type == Dinuclmarkov_t){
+			dinucl_events.push_back(static_cast<const Dinucl_markov*>(event_p));
+			dinucl_tables_events.push_back(static_cast<Dinucl_markov*>(event_p));
+		}
+		int event_identifier = event_p->get_event_identifier();
+		if( (event_identifier < 0) or (static_cast<size_t>(event_identifier) >= next_steps.size()) ){
+			throw runtime_error("Event \"" + event_p->get_name() + "\" has an invalid identifier (" + to_string(event_identifier) + ") in Scenario_engine::Scenario_engine()");
+		}
+		if(not model_queue.empty()){
+			next_steps[event_identifier] = compile_dispatch_step(model_queue.front().get());
+		}
+		//else the last event has a null next step, the scenario is complete
+	}
+
+	for(unordered_map<tuple<Event_type,Gene_class,Seq_side>, shared_ptr<Rec_Event>>::const_iterator iter = events_map.begin() ; iter != events_map.end() ; ++iter){
+		if(not (*iter).second->is_fixed()){
+			marginals_steps.push_back(compile_dispatch_step((*iter).second.get()));
+		}
+	}
+
+	for(map<size_t,shared_ptr<Counter>>::const_iterator iter = counters_list.begin() ; iter != counters_list.end() ; ++iter){
+		counters.push_back((*iter).second.get());
+	}
+}
+
+/**
+ * The event type is only used for direct dispatch if the dynamic type of the event matches it
+ */
+Scenario_engine::Compiled_step Scenario_engine::compile_step(Rec_Event* event_p){
+	switch(event_p->get_type()){
+		case GeneChoice_t:
+			if(dynamic_cast<Gene_choice*>(event_p) != nullptr) return Compiled_step(event_p , GeneChoice_t);
+			break;
+		case Deletion_t:
+			if(dynamic_cast<Deletion*>(event_p) != nullptr) return Compiled_step(event_p , Deletion_t);
+			break;
+		case Insertion_t:
+			if(dynamic_cast<Insertion*>(event_p) != nullptr) return Compiled_step(event_p , Insertion_t);
+			break;
+		case Dinuclmarkov_t:
+			if(dynamic_cast<Dinucl_markov*>(event_p) != nullptr) return Compiled_step(event_p , Dinuclmarkov_t);
+			break;
+		default:
+			break;
+	}
+	return Compiled_step(event_p , Undefined_t);
+}
+
+/**
+ * Compute the error weighted probability of a complete scenario, count it and add it to the marginals
+ */
+void Scenario_engine::complete_scenario(double& scenario_proba , Scenario_context& context) const{
+	long double scenario_error_w_proba = context.error_rate_p->compare_sequences_error_prob( scenario_proba , context.sequence , context.constructed_sequences , context.seq_offsets , context.events_map , context.mismatches_lists , context.seq_max_prob_scenario , context.proba_threshold_factor);
+
+	if(scenario_error_w_proba>=context.seq_max_prob_scenario*context.proba_threshold_factor){
+		if(scenario_error_w_proba>context.seq_max_prob_scenario){
+			context.seq_max_prob_scenario=scenario_error_w_proba;
+			if(context.shared_max_prob_scenario != nullptr){
+				context.sync_max_prob_scenario();
+			}
+		}
+
+		if(context.dry_run){
+			return;
+		}
+
+		for(vector<Counter*>::const_iterator iter = counters.begin() ; iter != counters.end() ; ++iter){
+			(*iter)->count_scenario(scenario_error_w_proba , scenario_proba , context.sequence , context.constructed_sequences , context.seq_offsets , context.events_map , context.mismatches_lists);
+		}
+
+		if(context.skeleton_recorder != nullptr){
+			record_skeleton(*context.skeleton_recorder);
+		}
+
+		switch(topology){
+			case Tcr_beta_topology:
+				record_canonical_marginals<Tcr_beta_signature>(scenario_error_w_proba , context.updated_marginals);
+				return;
+			case Bcr_heavy_topology:
+				record_canonical_marginals<Bcr_heavy_signature>(scenario_error_w_proba , context.updated_marginals);
+				return;
+			case VJ_topology:
+				record_canonical_marginals<VJ_signature>(scenario_error_w_proba , context.updated_marginals);
+				return;
+			default:
+				break;
+		}
+
+		for(vector<Compiled_step>::const_iterator iter = marginals_steps.begin() ; iter != marginals_steps.end() ; ++iter){
+			switch((*iter).type){
+				case GeneChoice_t:
+					static_cast<Gene_choice*>((*iter).event_p)->Gene_choice::add_to_marginals(scenario_error_w_proba , context.updated_marginals);
+					break;
+				case Deletion_t:
+					static_cast<Deletion*>((*iter).event_p)->Deletion::add_to_marginals(scenario_error_w_proba , context.updated_marginals);
+					break;
+				case Insertion_t:
+					static_cast<Insertion*>((*iter).event_p)->Insertion::add_to_marginals(scenario_error_w_proba , context.updated_marginals);
+					break;
+				case Dinuclmarkov_t:
+					static_cast<Dinucl_markov*>((*iter).event_p)->Dinucl_markov::add_to_marginals(scenario_error_w_proba , context.updated_marginals);
+					break;
+				default:
+					(*iter).event_p->add_to_marginals(scenario_error_w_proba , context.updated_marginals);
+					break;
+			}
+		}
+	}
+	else{
+		++context.rejected_scenarios;
+	}
+}
+
+/**
+ * Scenario skeletons can only be recorded if all events are of a known type
+ */
+bool Scenario_engine::can_record_skeletons() const{
+	for(vector<Compiled_step>::const_iterator iter = queue_steps.begin() ; iter != queue_steps.end() ; ++iter){
+		if((*iter).type == Undefined_t){
+			return false;
+		}
+	}
+	return dinucl_events.size() < 256;
+}
+
+/**
+ * Append the model parameters indices and error counts of the current scenario to the recorder (see Scenarioskeleton.h for the layout)
+ */
+void Scenario_engine::record_skeleton(Scenario_skeleton_recorder& recorder) const{
+	if(recorder.overflow){
+		return;
+	}
+	vector<int>& arena = recorder.arena;
+	const size_t header = arena.size();
+	arena.push_back(0);
+	arena.push_back(recorder.error_rate_p->get_scenario_number_errors());
+	arena.push_back(recorder.error_rate_p->get_scenario_genomic_nucl());
+	int dinucl_slot = 0;
+	for(vector<Compiled_step>::const_iterator iter = queue_steps.begin() ; iter != queue_steps.end() ; ++iter){
+		switch((*iter).type){
+			case GeneChoice_t:
+				static_cast<const Gene_choice*>((*iter).event_p)->append_scenario_factors(arena);
+				break;
+			case Deletion_t:
+				static_cast<const Deletion*>((*iter).event_p)->append_scenario_factors(arena);
+				break;
+			case Insertion_t:
+				static_cast<const Insertion*>((*iter).event_p)->append_scenario_factors(arena);
+				break;
+			case Dinuclmarkov_t:
+			{
+				const size_t first_factor = arena.size();
+				static_cast<const Dinucl_markov*>((*iter).event_p)->append_scenario_factors(arena);
+				for(size_t i = first_factor ; i != arena.size() ; ++i){
+					if(arena[i] < 0){
+						arena[i] = skeleton_ambiguous_factor(dinucl_slot , arena[i]);
+					}
+				}
+				++dinucl_slot;
+				break;
+			}
+			default:
+				throw runtime_error("Cannot record the skeleton of a scenario with an event of unknown type in Scenario_engine::record_skeleton()");
+		}
+	}
+	arena[header] = arena.size() - header - skeleton_header_size;
+	if(arena.size() > recorder.max_size){
+		recorder.overflow = true;
+		vector<int>().swap(arena);
+	}
+}
+
+//Number of explored partial scenarios between two reads of the clock
+static const size_t budget_clock_period = 4096;
+
+/**
+ * Limits the exploration to the given number of explored partial scenarios and/or until the given time point
+ * (std::numeric_limits<size_t>::max() and steady_clock::time_point::max() for no limit)
+ */
+void Scenario_context::set_budget(size_t max_branches , chrono::steady_clock::time_point exploration_deadline){
+	max_explored_branches = max_branches;
+	deadline = exploration_deadline;
+	budget_exceeded = false;
+	//Check (and schedule the next check) at the next explored partial scenario
+	next_budget_check = explored_branches;
+}
+
+/**
+ * Called by is_pruned() every budget_clock_period explored partial scenarios, returns true once the budget is exhausted
+ */
+bool Scenario_context::is_budget_exhausted(){
+	if(not budget_exceeded){
+		if( (explored_branches >= max_explored_branches)
+				or ( (deadline != chrono::steady_clock::time_point::max()) and (chrono::steady_clock::now() >= deadline) ) ){
+			budget_exceeded = true;
+			//Check at every call from now on
+			next_budget_check = 0;
+		}
+		else if(deadline != chrono::steady_clock::time_point::max()){
+			next_budget_check = min(max_explored_branches , explored_branches + budget_clock_period);
+		}
+		else{
+			next_budget_check = max_explored_branches;
+		}
+	}
+	return budget_exceeded;
+}
@@ -0,0 +1,267 @@
+/*
+ * Scenarioengine.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_SCENARIOENGINE_H_
+#define IGOR_SRC_SCENARIOENGINE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <memory>
+#include <unordered_map>
+#include <tuple>
+#include <chrono>
+#include <limits>
+#include <atomic>
+#include "Rec_Event.h"
+#include "Genechoice.h"
+#include "Deletion.h"
+#include "Insertion.h"
+#include "Dinuclmarkov.h"
+#include "Errorrate.h"
+#include "Counter.h"
+#include "Utils.h"
+#include "Canonicaltopology.h"
+#include "Scenarioskeleton.h"
+
+class Scenario_engine;
+
+/**
+ * \struct Scenario_context Scenarioengine.h
+ * \brief Gathers the per thread and per sequence state shared by all events during the exploration of a sequence's scenarios.
+ * \version 1.0
+ *
+ * This replaces the ~20 arguments formerly forwarded through each Rec_Event::iterate call.
+ * See Rec_Event::iterate() for the description of each field.
+ */
+struct Scenario_context{
+	Scenario_context(Downstream_scenario_proba_bound_map& downstream_proba_map , const std::string& sequence , const Int_Str& int_sequence , Index_map& index_map ,
+			const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& offset_map , Marginal_array_p& updated_marginals ,
+			const Marginal_array_p& model_parameters , const std::unordered_map<Gene_class , std::vector<Alignment_data>>& allowed_realizations ,
+			Seq_type_str_p_map& constructed_sequences , Seq_offsets_map& seq_offsets , std::shared_ptr<Error_rate>& error_rate_p ,
+			std::map<size_t,std::shared_ptr<Counter>>& counters_list , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& events_map ,
+			Safety_bool_map& safety_set , Mismatch_vectors_map& mismatches_lists , double& seq_max_prob_scenario , double& proba_threshold_factor , const Scenario_engine& engine):
+				downstream_proba_map(downstream_proba_map) , sequence(sequence) , int_sequence(int_sequence) , index_map(index_map) , offset_map(offset_map) ,
+				updated_marginals(updated_marginals) , model_parameters(model_parameters) , allowed_realizations(allowed_realizations) ,
+				constructed_sequences(constructed_sequences) , seq_offsets(seq_offsets) , error_rate_p(error_rate_p) , counters_list(counters_list) ,
+				events_map(events_map) , safety_set(safety_set) , mismatches_lists(mismatches_lists) , seq_max_prob_scenario(seq_max_prob_scenario) ,
+				proba_threshold_factor(proba_threshold_factor) , engine(engine) , skeleton_recorder(nullptr) , dry_run(false) , shared_max_prob_scenario(nullptr) ,
+					explored_branches(0) , pruned_branches(0) , rejected_scenarios(0) , max_explored_branches(std::numeric_limits<size_t>::max()) ,
+					deadline(std::chrono::steady_clock::time_point::max()) , next_budget_check(std::numeric_limits<size_t>::max()) , budget_exceeded(false){}
+
+	/**
+	 * Returns true if a partial scenario whose probability cannot exceed the given upper bound must be pruned, and counts it
+	 * Once the exploration budget is exhausted all partial scenarios are pruned so that the exploration returns quickly
+	 */
+	bool is_pruned(double scenario_upper_bound_proba){
+		if(shared_max_prob_scenario != nullptr){
+			sync_max_prob_scenario();
+		}
+		if(scenario_upper_bound_proba<(seq_max_prob_scenario*proba_threshold_factor)){
+			++pruned_branches;
+			return true;
+		}
+		if( (explored_branches >= next_budget_check) and is_budget_exhausted() ){
+			return true;
+		}
+		++explored_branches;
+		return false;
+	}
+
+	/**
+	 * Raises seq_max_prob_scenario to the best scenario probability shared with the explorations of the other chunks of the sequence, or publishes it if it is larger
+	 */
+	void sync_max_prob_scenario(){
+		double shared_max = shared_max_prob_scenario->load(std::memory_order_relaxed);
+		if(shared_max > seq_max_prob_scenario){
+			seq_max_prob_scenario = shared_max;
+		}
+		else{
+			while( (seq_max_prob_scenario > shared_max) and (not shared_max_prob_scenario->compare_exchange_weak(shared_max , seq_max_prob_scenario , std::memory_order_relaxed)) ){}
+		}
+	}
+
+	void set_budget(size_t , std::chrono::steady_clock::time_point);
+	bool is_budget_exhausted();
+
+	Downstream_scenario_proba_bound_map& downstream_proba_map;
+	const std::string& sequence;
+	const Int_Str& int_sequence;
+	Index_map& index_map;
+	const std::unordered_map<Rec_Event_name,std::vector<std::pair<std::shared_ptr<const Rec_Event>,int>>>& offset_map;
+	Marginal_array_p& updated_marginals;
+	const Marginal_array_p& model_parameters;
+	const std::unordered_map<Gene_class , std::vector<Alignment_data>>& allowed_realizations;
+	Seq_type_str_p_map& constructed_sequences;
+	Seq_offsets_map& seq_offsets;
+	std::shared_ptr<Error_rate>& error_rate_p;
+	std::map<size_t,std::shared_ptr<Counter>>& counters_list;
+	const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& events_map;
+	Safety_bool_map& safety_set;
+	Mismatch_vectors_map& mismatches_lists;
+	double& seq_max_prob_scenario;
+	double& proba_threshold_factor;
+	const Scenario_engine& engine;
+	Scenario_skeleton_recorder* skeleton_recorder; //If not null the accepted scenarios are recorded (see Scenario_skeleton_cache)
+	bool dry_run; //If true complete scenarios only raise seq_max_prob_scenario (greedy seeding pass), nothing is recorded
+	std::atomic<double>* shared_max_prob_scenario; //If not null the best scenario probability is shared with concurrent explorations of the same sequence (see Sequence_chunk)
+	size_t explored_branches; //Partial scenarios whose probability upper bound passed the threshold
+	size_t pruned_branches; //Partial scenarios discarded by their probability upper bound
+	size_t rejected_scenarios; //Complete scenarios discarded by the threshold
+
+private:
+	size_t max_explored_branches; //Exploration budget (see set_budget())
+	std::chrono::steady_clock::time_point deadline;
+	size_t next_budget_check; //Number of explored branches at which the budget is checked next
+	bool budget_exceeded;
+
+public:
+	bool is_budget_exceeded() const{return budget_exceeded;}
+};
+
+/**
+ * \class Scenario_engine Scenarioengine.h
+ * \brief Dispatches the recursive exploration of the recombination scenarios of a sequence for a given model topology.
+ * \version 1.0
+ *
+ * The engine is compiled once per thread from the model queue: it stores for each event the concrete type of the next event to explore,
+ * the list of events whose marginals are updated and the list of counters.
+ * Events are then chained through direct (non virtual) calls to their iterate() method, and complete scenarios are recorded without
+ * walking the events map. Events of unknown type are called through the virtual Rec_Event::iterate() (generic path).
+ * If the model has a canonical topology (see Canonicaltopology.h) the marginals of complete scenarios are recorded by a loop unrolled at compile time.
+ * A generic engine calls every event through the virtual methods and is kept as a reference to compare the specialized dispatch against.
+ *
+ * The engine holds raw pointers to the events and counters, these must outlive it.
+ */
+class Scenario_engine {
+public:
+	Scenario_engine(std::queue<std::shared_ptr<Rec_Event>> , const std::unordered_map<std::tuple<Event_type,Gene_class,Seq_side>, std::shared_ptr<Rec_Event>>& , const std::map<size_t,std::shared_ptr<Counter>>& , bool generic=false);
+
+	/**
+	 * Explore all the scenarios of the context's read, the per read tables of the deletion and dinucleotide Markov events are built before and the batched marginals pushed after
+	 */
+	void explore(double& scenario_proba , Scenario_context& context) const{
+		for(std::vector<Deletion*>::const_iterator iter = deletion_events.begin() ; iter != deletion_events.end() ; ++iter){
+			(*iter)->initialize_sequence_tables();
+		}
+		for(std::vector<Dinucl_markov*>::const_iterator iter = dinucl_tables_events.begin() ; iter != dinucl_tables_events.end() ; ++iter){
+			(*iter)->initialize_sequence_tables(context.int_sequence , context.model_parameters);
+		}
+		run_step(first_step , scenario_proba , context);
+		for(std::vector<Dinucl_markov*>::const_iterator iter = dinucl_tables_events.begin() ; iter != dinucl_tables_events.end() ; ++iter){
+			(*iter)->flush_sequence_marginals(context.updated_marginals);
+		}
+	}
+
+	/**
+	 * Explore the event following the event with identifier event_identifier, or record the complete scenario if it was the last one
+	 */
+	void iterate_next(int event_identifier , double& scenario_proba , Scenario_context& context) const{
+		const Compiled_step& next_step = next_steps[event_identifier];
+		if(next_step.event_p != nullptr){
+			run_step(next_step , scenario_proba , context);
+		}
+		else{
+			complete_scenario(scenario_proba , context);
+		}
+	}
+
+	void complete_scenario(double& , Scenario_context&) const;
+	size_t get_n_events() const{return n_events;}
+	Canonical_topology get_topology() const{return topology;}
+	bool can_record_skeletons() const;
+	const std::vector<const Dinucl_markov*>& get_dinucl_events() const{return dinucl_events;}
+
+private:
+	struct Compiled_step{
+		Compiled_step(): event_p(nullptr) , type(Undefined_t){}
+		Compiled_step(Rec_Event* ptr , Event_type event_type): event_p(ptr) , type(event_type){}
+		Rec_Event* event_p;
+		Event_type type;
+	};
+
+	/*
+	 * Adds a complete scenario to the marginals for a canonical topology, the type of each event being known from its queue position
+	 */
+	struct Canonical_marginals_recorder{
+		Canonical_marginals_recorder(Rec_Event* const* events , const char* updates_marginals , long double scenario_proba , Marginal_array_p& updated_marginals):
+			events(events) , updates_marginals(updates_marginals) , scenario_proba(scenario_proba) , updated_marginals(updated_marginals){}
+
+		template<Canonical_event_role Role> void step(size_t slot){
+			typedef typename Canonical_role_traits<Role>::event_class Event_class;
+			if(updates_marginals[slot]){
+				static_cast<Event_class*>(events[slot])->Event_class::add_to_marginals(scenario_proba , updated_marginals);
+			}
+		}
+
+		Rec_Event* const* events;
+		const char* updates_marginals;
+		const long double scenario_proba;
+		Marginal_array_p& updated_marginals;
+	};
+
+	template<class Signature> void record_canonical_marginals(long double scenario_proba , Marginal_array_p& updated_marginals) const{
+		Canonical_marginals_recorder recorder(queue_events.data() , queue_updates_marginals.data() , scenario_proba , updated_marginals);
+		Canonical_signature_steps<Signature>::type::run(recorder);
+	}
+
+	static Compiled_step compile_step(Rec_Event*);
+	Compiled_step compile_dispatch_step(Rec_Event* event_p) const{return generic ? Compiled_step(event_p , Undefined_t) : compile_step(event_p);}
+	void record_skeleton(Scenario_skeleton_recorder&) const;
+
+	void run_step(const Compiled_step& step , double& scenario_proba , Scenario_context& context) const{
+		switch(step.type){
+			case GeneChoice_t:
+				static_cast<Gene_choice*>(step.event_p)->Gene_choice::iterate(scenario_proba , context);
+				break;
+			case Deletion_t:
+				static_cast<Deletion*>(step.event_p)->Deletion::iterate(scenario_proba , context);
+				break;
+			case Insertion_t:
+				static_cast<Insertion*>(step.event_p)->Insertion::iterate(scenario_proba , context);
+				break;
+			case Dinuclmarkov_t:
+				static_cast<Dinucl_markov*>(step.event_p)->Dinucl_markov::iterate(scenario_proba , context);
+				break;
+			default:
+				step.event_p->iterate(scenario_proba , context);
+				break;
+		}
+	}
+
+	bool generic; //All events are called through their virtual methods
+	Compiled_step first_step;
+	std::vector<Compiled_step> next_steps; //Indexed by event identifier
+	std::vector<Compiled_step> marginals_steps; //Non fixed events updating the marginals at the end of each scenario
+	std::vector<Counter*> counters;
+	size_t n_events;
+	Canonical_topology topology;
+	std::vector<Rec_Event*> queue_events; //Events in queue order
+	std::vector<char> queue_updates_marginals; //Whether the event in the same queue position is not fixed
+	std::vector<Compiled_step> queue_steps; //Events in queue order with their dispatch type
+	std::vector<const Dinucl_markov*> dinucl_events; //Dinucleotide Markov events in queue order, their position is the slot used by scenario skeletons
+	std::vector<Dinucl_markov*> dinucl_tables_events; //Same events, whose per read tables are built by explore()
+	std::vector<Deletion*> deletion_events; //Deletion events whose per read tables are reset by explore()
+};
+
+
+#endif /* IGOR_SRC_SCENARIOENGINE_H_ */
@@ -0,0 +1,162 @@
+/*
+ * Scenarioskeleton.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Scenarioskeleton.h"
+
+using namespace std;
+
+/**
+ * credited_indices must have the size of the marginal array and flag the indices of the non fixed events
+ */
+Scenario_skeleton_cache::Scenario_skeleton_cache(size_t n_sequences , size_t max_memory_bytes , int reexplore_period , const vector<char>& credited_indices):
+		skeletons(n_sequences) , recorded_iteration(n_sequences,-1) , uncacheable(n_sequences,0) , credited_indices(credited_indices) ,
+		max_memory(max_memory_bytes) , memory_usage(0) , reexplore_period(reexplore_period){}
+
+bool Scenario_skeleton_cache::can_replay(size_t seq_index , int iteration) const{
+	if(recorded_iteration[seq_index] < 0){
+		return false;
+	}
+	return (reexplore_period <= 0) or (iteration - recorded_iteration[seq_index] < reexplore_period);
+}
+
+bool Scenario_skeleton_cache::can_replay_all(int iteration) const{
+	for(size_t seq_index = 0 ; seq_index != skeletons.size() ; ++seq_index){
+		if(not can_replay(seq_index , iteration)){
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Number of integers a recorder may write before the sequence is considered too large to be cached
+ */
+size_t Scenario_skeleton_cache::get_record_max_size() const{
+	size_t used;
+	#pragma omp atomic read
+	used = memory_usage;
+	return (used < max_memory) ? (max_memory - used)/sizeof(int) : 0;
+}
+
+/**
+ * Replace the skeleton of the sequence by the recorded one if it fits in the memory budget.
+ * Sequences whose skeleton does not fit are flagged and will be explored at each iteration without being recorded.
+ */
+void Scenario_skeleton_cache::store(size_t seq_index , int iteration , Scenario_skeleton_recorder& recorder){
+	const size_t old_bytes = skeletons[seq_index].size()*sizeof(int);
+	const size_t new_bytes = recorder.overflow ? 0 : recorder.arena.size()*sizeof(int);
+	bool fits;
+	#pragma omp critical(skeleton_cache_memory)
+	{
+		fits = (not recorder.overflow) and (memory_usage - old_bytes + new_bytes <= max_memory);
+		memory_usage -= old_bytes;
+		if(fits){
+			memory_usage += new_bytes;
+		}
+	}
+	if(fits){
+		vector<int>(recorder.arena.begin() , recorder.arena.end()).swap(skeletons[seq_index]);
+		recorded_iteration[seq_index] = iteration;
+	}
+	else{
+		vector<int>().swap(skeletons[seq_index]);
+		recorded_iteration[seq_index] = -1;
+		uncacheable[seq_index] = 1;
+	}
+}
+
+/**
+ * Sum the recorded scenarios of a sequence with the current model parameters and add their weights to the marginals.
+ * As in Scenario_engine::complete_scenario() scenarios are only accounted for if their probability is above the best scenario probability
+ * (or likelihood_threshold/proba_threshold_factor) times the probability threshold factor, the best scenario being known beforehand here.
+ */
+void Scenario_skeleton_cache::replay(size_t seq_index , const Marginal_array_p& model_parameters , const vector<const Dinucl_markov*>& dinucl_events , double likelihood_threshold , double proba_threshold_factor ,
+		Marginal_array_p& updated_marginals , Touched_marginals_indices& touched_marginals , Single_error_rate& error_rate , double& seq_max_prob_scenario , vector<double>& weights_buffer) const{
+	const vector<int>& arena = skeletons[seq_index];
+	const double model_rate = error_rate.get_model_rate();
+
+	//First pass: scenario probabilities with and without errors
+	weights_buffer.clear();
+	double best_scenario = 0;
+	size_t position = 0;
+	while(position != arena.size()){
+		const int n_factors = arena[position];
+		const int n_errors = arena[position+1];
+		const int genomic_nucl = arena[position+2];
+		const int* factors = &arena[position + skeleton_header_size];
+		double scenario_proba = 1;
+		for(int i = 0 ; i != n_factors ; ++i){
+			if(factors[i] >= 0){
+				scenario_proba *= model_parameters[factors[i]];
+			}
+			else{
+				const int code = -1 - factors[i];
+				scenario_proba *= dinucl_events[code/256]->get_dinuc_proba_matrix()((code%256)/16 , code%16);
+			}
+		}
+		const double scenario_err_proba = scenario_proba*pow(model_rate/3,n_errors)*pow(1-model_rate,genomic_nucl-n_errors);
+		weights_buffer.push_back(scenario_proba);
+		weights_buffer.push_back(scenario_err_proba);
+		best_scenario = max(best_scenario , scenario_err_proba);
+		position += skeleton_header_size + n_factors;
+	}
+
+	seq_max_prob_scenario = max(best_scenario , likelihood_threshold/proba_threshold_factor);
+	const double threshold = seq_max_prob_scenario*proba_threshold_factor;
+
+	//Second pass: accumulate the accepted scenarios
+	long double seq_likelihood = 0;
+	long double seq_probability = 0;
+	long double seq_mean_error_number = 0;
+	long double seq_weighted_er = 0;
+	int n_scenarios = 0;
+	position = 0;
+	size_t scenario = 0;
+	while(position != arena.size()){
+		const int n_factors = arena[position];
+		const int n_errors = arena[position+1];
+		const int genomic_nucl = arena[position+2];
+		const int* factors = &arena[position + skeleton_header_size];
+		const double scenario_proba = weights_buffer[2*scenario];
+		const long double scenario_err_proba = weights_buffer[2*scenario+1];
+		position += skeleton_header_size + n_factors;
+		++scenario;
+		if( (scenario_err_proba < threshold) or (scenario_err_proba == 0) ){
+			continue;
+		}
+		seq_likelihood += scenario_err_proba;
+		seq_probability += scenario_proba;
+		seq_mean_error_number += n_errors*scenario_err_proba;
+		seq_weighted_er += scenario_err_proba*(double(n_errors)/double(genomic_nucl));
+		++n_scenarios;
+		for(int i = 0 ; i != n_factors ; ++i){
+			if( (factors[i] >= 0) and credited_indices[factors[i]] ){
+				updated_marginals[factors[i]] += scenario_err_proba;
+				touched_marginals.touch(factors[i]);
+			}
+		}
+	}
+	error_rate.set_seq_statistics(seq_likelihood , seq_probability , seq_mean_error_number , seq_weighted_er , n_scenarios);
+}
+
+size_t Scenario_skeleton_cache::get_number_cached_sequences() const{
+	return count_if(recorded_iteration.begin() , recorded_iteration.end() , [](int iteration){return iteration>=0;});
+}
@@ -0,0 +1,109 @@
+/*
+ * Scenarioskeleton.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_SCENARIOSKELETON_H_
+#define IGOR_SRC_SCENARIOSKELETON_H_
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include "Rec_Event.h"
+#include "Dinuclmarkov.h"
+#include "Singleerrorrate.h"
+#include "Utils.h"
+
+/*
+ * Layout of a recorded scenario in a sequence arena:
+ * [number of factors , number of errors , number of genomic nucleotides , factor_1 , ... , factor_n]
+ * A factor >= 0 is the index of a model parameter in the marginal array (also the index credited in the marginals if the event is not fixed).
+ * A negative factor is an ambiguous dinucleotide transition: -1 - (dinucl_slot*256 + first_nt*16 + second_nt)
+ */
+const int skeleton_header_size = 3;
+
+inline int skeleton_ambiguous_factor(int dinucl_slot , int ambiguous_transition_code){
+	//ambiguous_transition_code is -1 - (first_nt*16 + second_nt) (see Dinucl_markov::iterate_common())
+	return ambiguous_transition_code - 256*dinucl_slot;
+}
+
+/**
+ * \struct Scenario_skeleton_recorder Scenarioskeleton.h
+ * \brief Per thread buffer in which the Scenario_engine writes the scenarios accepted during the exploration of one sequence.
+ * \version 1.0
+ *
+ * Recording stops (overflow is set) once the arena exceeds max_size integers, the sequence is then not cached.
+ */
+struct Scenario_skeleton_recorder{
+	Scenario_skeleton_recorder(): error_rate_p(nullptr) , max_size(0) , overflow(false){}
+	void clear(size_t max_arena_size){
+		arena.clear();
+		max_size = max_arena_size;
+		overflow = false;
+	}
+
+	const Single_error_rate* error_rate_p;
+	std::vector<int> arena;
+	size_t max_size;
+	bool overflow;
+};
+
+/**
+ * \class Scenario_skeleton_cache Scenarioskeleton.h
+ * \brief Cross iteration cache of the scenarios of each sequence for the EM inference.
+ * \version 1.0
+ *
+ * Between EM iterations the read, its alignments and the set of structurally valid scenarios do not change, only their probabilities do.
+ * The marginal indices and error counts of the scenarios accepted when exploring a sequence are thus recorded once, and the following iterations
+ * replay them as a sparse weighted sum instead of calling iterate() on every event.
+ * Since scenarios pruned by the probability bounds at recording time are missing from the skeleton, sequences are explored again (and their skeleton
+ * re-recorded) every reexplore_period iterations (0: never).
+ *
+ * The cache is shared by all threads: each sequence's arena is only written by the thread processing it, the memory budget is updated in a critical section.
+ * Only models made of the standard events, a Single_error_rate, without counters and without Viterbi runs can be replayed.
+ */
+class Scenario_skeleton_cache {
+public:
+	Scenario_skeleton_cache(size_t n_sequences , size_t max_memory_bytes , int reexplore_period , const std::vector<char>& credited_indices);
+	virtual ~Scenario_skeleton_cache(){};
+
+	bool can_replay(size_t seq_index , int iteration) const;
+	bool can_replay_all(int iteration) const;
+	bool should_record(size_t seq_index) const{return not uncacheable[seq_index];}
+	size_t get_record_max_size() const;
+	void store(size_t seq_index , int iteration , Scenario_skeleton_recorder&);
+
+	void replay(size_t seq_index , const Marginal_array_p& model_parameters , const std::vector<const Dinucl_markov*>& dinucl_events , double likelihood_threshold , double proba_threshold_factor ,
+			Marginal_array_p& updated_marginals , Touched_marginals_indices& touched_marginals , Single_error_rate& error_rate , double& seq_max_prob_scenario , std::vector<double>& weights_buffer) const;
+
+	size_t get_memory_usage() const{return memory_usage;}
+	size_t get_number_cached_sequences() const;
+
+private:
+	std::vector<std::vector<int>> skeletons; //One arena per sequence
+	std::vector<int> recorded_iteration;
+	std::vector<char> uncacheable;
+	std::vector<char> credited_indices; //Marginal indices belonging to non fixed events
+	size_t max_memory;
+	size_t memory_usage;
+	int reexplore_period;
+};
+
+#endif /* IGOR_SRC_SCENARIOSKELETON_H_ */
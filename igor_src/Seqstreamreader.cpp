@@ -0,0 +1,288 @@
+/*
+ * Seqstreamreader.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Seqstreamreader.h"
+
+using namespace std;
+
+//Size of the blocks read from the (possibly compressed) file
+static const size_t seq_stream_buffer_size = 1<<20;
+
+Seq_stream_reader::Seq_stream_reader(string filename , Fileformat format): filename(filename) , format(format) , infile(NULL) ,
+		buffer(seq_stream_buffer_size) , buffer_pos(0) , buffer_fill(0) , eof_reached(false) , exhausted(false) , header_pending(false) ,
+		quality_trimming(false) , min_quality(0) , min_length(0) , phred_offset(33) ,
+		record_count(0) , n_records_read(0) , n_records_discarded(0) , n_trimmed_nt(0){
+
+	if( (format != FASTA_f) and (format != FASTQ_f) and (format != TXT_f)){
+		throw invalid_argument("Seq_stream_reader can only stream FASTA, FASTQ or TXT files");
+	}
+	//gzopen reads both gzipped and plain files
+	infile = gzopen(filename.c_str(),"rb");
+	if(infile == NULL){
+		throw runtime_error("File not found: "+filename);
+	}
+	gzbuffer(infile,seq_stream_buffer_size);
+}
+
+Seq_stream_reader::~Seq_stream_reader() {
+	if(infile != NULL){
+		gzclose(infile);
+	}
+}
+
+/*
+ * Enable quality trimming for FASTQ files.
+ * Nucleotides with a Phred score strictly lower than min_qual are trimmed from both ends of the read,
+ * reads shorter than min_len after trimming are discarded.
+ */
+void Seq_stream_reader::set_quality_trimming(int min_qual , size_t min_len , int phred_off/*=33*/){
+	if(format != FASTQ_f){
+		throw invalid_argument("Quality trimming can only be performed on FASTQ files");
+	}
+	this->quality_trimming = true;
+	this->min_quality = min_qual;
+	this->min_length = min_len;
+	this->phred_offset = phred_off;
+}
+
+/*
+ * Reads the next line from the buffer (refilling it if needed), strips the trailing '\r' if any.
+ * Returns false only once the end of the file is reached and no character could be read.
+ */
+bool Seq_stream_reader::next_line(string& line){
+	line.clear();
+	bool read_any = false;
+	while(true){
+		if(buffer_pos == buffer_fill){
+			if(eof_reached){
+				break;
+			}
+			int n_read = gzread(infile,buffer.data(),buffer.size());
+			if(n_read<0){
+				int errnum;
+				throw runtime_error("Error while reading " + filename + ": " + string(gzerror(infile,&errnum)));
+			}
+			if(n_read == 0){
+				eof_reached = true;
+				break;
+			}
+			buffer_pos = 0;
+			buffer_fill = n_read;
+		}
+		read_any = true;
+		const char* start = buffer.data() + buffer_pos;
+		const char* newline = static_cast<const char*>(memchr(start , '\n' , buffer_fill - buffer_pos));
+		if(newline != NULL){
+			line.append(start , newline - start);
+			buffer_pos += (newline - start) + 1;
+			break;
+		}
+		else{
+			line.append(start , buffer_fill - buffer_pos);
+			buffer_pos = buffer_fill;
+		}
+	}
+	if( (not line.empty()) and (line[line.size()-1] == '\r')){
+		line.erase(line.size()-1);
+	}
+	return read_any;
+}
+
+/*
+ * Upper cases the sequence in place
+ */
+void Seq_stream_reader::normalize_sequence(string& seq_str) const{
+	for(string::iterator iter = seq_str.begin() ; iter != seq_str.end() ; ++iter){
+		if( ((*iter)>='a') and ((*iter)<='z')){
+			(*iter) -= ('a' - 'A');
+		}
+	}
+}
+
+/*
+ * Trims low quality nucleotides on both ends of the read
+ * Returns false if the read should be discarded
+ */
+bool Seq_stream_reader::trim_sequence(string& seq_str , const string& quality_str){
+	if(quality_str.size() != seq_str.size()){
+		throw runtime_error("Sequence and quality strings have different lengths for FASTQ record " + to_string(record_count) + " in file " + filename);
+	}
+	size_t first = 0;
+	size_t last = seq_str.size();
+	while( (first<last) and ((quality_str[first] - phred_offset) < min_quality) ){
+		++first;
+	}
+	while( (last>first) and ((quality_str[last-1] - phred_offset) < min_quality) ){
+		--last;
+	}
+	n_trimmed_nt += seq_str.size() - (last-first);
+	if( (last-first) < min_length or (last == first) ){
+		return false;
+	}
+	if( (first != 0) or (last != seq_str.size()) ){
+		seq_str = seq_str.substr(first , last-first);
+	}
+	return true;
+}
+
+/*
+ * Reads the next record of the file into seq_str
+ * Returns false when the end of the file is reached
+ */
+bool Seq_stream_reader::next_record(string& seq_str){
+	seq_str.clear();
+	switch(format){
+	case FASTA_f:
+	{
+		//Skip anything preceding the first header
+		while(not header_pending){
+			if(not next_line(line_str)){
+				return false;
+			}
+			if( (not line_str.empty()) and (line_str[0] == '>')){
+				header_pending = true;
+			}
+		}
+		header_pending = false;
+		while(next_line(line_str)){
+			if( (not line_str.empty()) and (line_str[0] == '>')){
+				header_pending = true;
+				break;
+			}
+			seq_str += line_str;
+		}
+		return true;
+	}
+	case FASTQ_f:
+	{
+		//Skip empty lines between records
+		do{
+			if(not next_line(line_str)){
+				return false;
+			}
+		}while(line_str.empty());
+		if(line_str[0] != '@'){
+			throw runtime_error("Malformed FASTQ record " + to_string(record_count) + " in file " + filename + ": expected a header line starting with '@', read \"" + line_str + "\"");
+		}
+		if( (not next_line(seq_str))
+				or (not next_line(line_str))
+				or (not next_line(qual_str))
+				or line_str.empty()
+				or (line_str[0] != '+') ){
+			throw runtime_error("Truncated or malformed FASTQ record " + to_string(record_count) + " in file " + filename);
+		}
+		return true;
+	}
+	case TXT_f:
+	{
+		//One sequence per line, empty lines are ignored
+		do{
+			if(not next_line(seq_str)){
+				return false;
+			}
+		}while(seq_str.empty());
+		return true;
+	}
+	default:
+		throw invalid_argument("Unknown file format for Seq_stream_reader");
+	}
+}
+
+/*
+ * Appends at most max_chunk_size indexed sequences to the chunk vector
+ * Returns the number of sequences appended, 0 once the file is exhausted
+ */
+size_t Seq_stream_reader::read_chunk(vector<pair<const int,const string>>& chunk , size_t max_chunk_size){
+	size_t n_appended = 0;
+	string seq_str;
+	while( (n_appended<max_chunk_size) and (not exhausted)){
+		if(not next_record(seq_str)){
+			exhausted = true;
+			break;
+		}
+		int seq_index = record_count;
+		++record_count;
+		++n_records_read;
+		if(quality_trimming and (not trim_sequence(seq_str,qual_str))){
+			++n_records_discarded;
+			continue;
+		}
+		normalize_sequence(seq_str);
+		chunk.emplace_back(seq_index , seq_str);
+		++n_appended;
+	}
+	return n_appended;
+}
+
+/*
+ * Convenience function reading all (remaining) records at once
+ */
+vector<pair<const int,const string>> Seq_stream_reader::read_all(){
+	vector<pair<const int,const string>> sequence_vect;
+	while(not exhausted){
+		read_chunk(sequence_vect , seq_stream_buffer_size);
+	}
+	return sequence_vect;
+}
+
+/*
+ * Detect the input sequence file format from its extension
+ * Sets is_gzipped to true if the file bears a .gz extension (the format is then inferred from the preceding extension)
+ * Files without extension are considered as text files without header
+ */
+Fileformat detect_seq_file_format(string filename , bool& is_gzipped){
+	is_gzipped = false;
+	size_t extension_index = filename.rfind(".");
+	if(extension_index == string::npos){
+		return TXT_f;
+	}
+	string extension = filename.substr(extension_index , string::npos);
+	transform(extension.begin(),extension.end(),extension.begin(),::tolower);
+	if(extension == ".gz"){
+		is_gzipped = true;
+		string stripped_filename = filename.substr(0,extension_index);
+		extension_index = stripped_filename.rfind(".");
+		if(extension_index == string::npos){
+			return TXT_f;
+		}
+		extension = stripped_filename.substr(extension_index , string::npos);
+		transform(extension.begin(),extension.end(),extension.begin(),::tolower);
+	}
+
+	if( (extension == ".fasta") or (extension == ".fa") or (extension == ".fna")){
+		return FASTA_f;
+	}
+	else if( (extension == ".fastq") or (extension == ".fq")){
+		return FASTQ_f;
+	}
+	else if(extension == ".csv"){
+		if(is_gzipped){
+			throw invalid_argument("Gzipped CSV input sequence files are not supported, use FASTA, FASTQ or TXT files instead");
+		}
+		return CSV_f;
+	}
+	else if(extension == ".txt"){
+		return TXT_f;
+	}
+	else{
+		throw invalid_argument("Unknown file extension \"" + extension + "\" for input sequences file! ");
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ * Seqstreamreader.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_SEQSTREAMREADER_H_
+#define IGOR_SRC_SEQSTREAMREADER_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+#include "Utils.h"
+
+
+/**
+ * \class Seq_stream_reader Seqstreamreader.h
+ * \brief Buffered reader streaming indexed sequences out of FASTA/FASTQ/TXT files, gzipped or not.
+ * \version 1.0
+ *
+ * Reads the input file by large blocks through zlib (which reads uncompressed files transparently) and hands
+ * sequences over by chunks of bounded size, such that the whole file never needs to be held in memory.
+ * Sequences are indexed by their record number in the input file and converted to upper case.
+ *
+ * For FASTQ files an optional quality trimming can be performed in the same pass: nucleotides with a Phred score
+ * below the given threshold are trimmed from both ends of the read, and reads shorter than the minimal length after
+ * trimming are discarded (their index is skipped).
+ */
+class Seq_stream_reader {
+public:
+	Seq_stream_reader(std::string , Fileformat);
+	virtual ~Seq_stream_reader();
+
+	void set_quality_trimming(int , size_t , int phred_offset = 33);
+
+	size_t read_chunk(std::vector<std::pair<const int,const std::string>>& , size_t);
+	std::vector<std::pair<const int,const std::string>> read_all();
+
+	bool is_exhausted() const{return exhausted;}
+	size_t get_n_records_read() const{return n_records_read;}
+	size_t get_n_records_discarded() const{return n_records_discarded;}
+	size_t get_n_trimmed_nt() const{return n_trimmed_nt;}
+
+private:
+	//Forbid copies since the reader owns the file handle
+	Seq_stream_reader(const Seq_stream_reader&);
+	Seq_stream_reader& operator=(const Seq_stream_reader&);
+
+	bool next_line(std::string&);
+	bool next_record(std::string&);
+	void normalize_sequence(std::string&) const;
+	bool trim_sequence(std::string& , const std::string&);
+
+	std::string filename;
+	Fileformat format;
+	gzFile infile;
+
+	std::vector<char> buffer;
+	size_t buffer_pos;
+	size_t buffer_fill;
+	bool eof_reached;
+	bool exhausted;
+
+	std::string line_str;
+	bool header_pending;
+	std::string qual_str;
+
+	bool quality_trimming;
+	int min_quality;
+	size_t min_length;
+	int phred_offset;
+
+	int record_count;
+	size_t n_records_read;
+	size_t n_records_discarded;
+	size_t n_trimmed_nt;
+};
+
+Fileformat detect_seq_file_format(std::string , bool&);
+
+#endif /* IGOR_SRC_SEQSTREAMREADER_H_ */
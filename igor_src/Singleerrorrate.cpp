@@ -63,8 +63,8 @@ Error_rate* Single_error_rate::add_checked(Error_rate* err_r){
 
 const double& Single_error_rate::get_err_rate_upper_bound(size_t n_errors , size_t n_error_free) {
 	if( n_errors>this->max_err || n_error_free>this->max_noerr){
-		//Need to increase the matrix size (anyway the matrix is at very most read_len^2
-		this->build_upper_bound_matrix(max(this->max_err,n_errors + 10) , max(this->max_noerr , n_error_free+10));
+		//Need to increase the matrix size (anyway the matrix is at very most read_len^2), the dimension that is large enough must not shrink
+		this->build_upper_bound_matrix(max(this->max_err+1,n_errors + 10) , max(this->max_noerr+1 , n_error_free+10));
 	}
 
 	return this->upper_bound_proba_mat(n_errors,n_error_free);
@@ -98,9 +98,9 @@ double Single_error_rate::compare_sequences_error_prob (double scenario_probabil
 	//cout<<constructed_sequences.at(V_gene_seq);
 	genomic_nucl=0;
 
-	Int_Str& v_gene_seq = (*constructed_sequences[V_gene_seq]);
-	Int_Str& d_gene_seq = (*constructed_sequences[D_gene_seq]);
-	Int_Str& j_gene_seq = (*constructed_sequences[J_gene_seq]);
+	const Int_Str_view& v_gene_seq = constructed_sequences[V_gene_seq];
+	const Int_Str_view& d_gene_seq = constructed_sequences[D_gene_seq];
+	const Int_Str_view& j_gene_seq = constructed_sequences[J_gene_seq];
 
 	vector<int>& v_mismatch_list = *mismatches_lists[V_gene_seq];
 	if(mismatches_lists.exist(D_gene_seq)){
@@ -279,6 +279,23 @@ void Single_error_rate::clean_seq_counters(){
 	seq_mean_error_number=0;
 }
 
+void Single_error_rate::add_seq_counters(const Error_rate& err_r){
+	this->Error_rate::add_seq_counters(err_r);
+	seq_weighted_er += dynamic_cast<const Single_error_rate&>(err_r).seq_weighted_er;
+}
+
+/*
+ * Sets the sequence specific counters in one go when the scenarios have not been explored one by one (see Junction_dp_evaluator)
+ * The counters must hold the same sums as the ones accumulated by compare_sequences_error_prob()
+ */
+void Single_error_rate::set_seq_statistics(long double likelihood , long double probability , long double mean_error_number , long double weighted_er , int number_scenarios){
+	seq_likelihood = likelihood;
+	seq_probability = probability;
+	seq_mean_error_number = mean_error_number;
+	seq_weighted_er = weighted_er;
+	debug_number_scenarios = number_scenarios;
+}
+
 void Single_error_rate::write2txt(ofstream& outfile){
 	outfile<<"#SingleErrorRate"<<endl;
 	outfile<<model_rate<<endl;
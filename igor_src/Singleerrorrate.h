@@ -51,6 +51,7 @@ public:
 	void update();
 	void add_to_norm_counter();
 	void clean_seq_counters();
+	void add_seq_counters(const Error_rate&);
 	Single_error_rate operator+(Single_error_rate);
 	Single_error_rate& operator+=(Single_error_rate);
 	void write2txt(std::ofstream&);
@@ -61,6 +62,10 @@ public:
 	void build_upper_bound_matrix(size_t,size_t);
 	int get_number_non_zero_likelihood_seqs() const{return number_seq;};
 	std::queue<int>  generate_errors(std::string& , std::mt19937_64&) const;
+	double get_model_rate() const{return model_rate;}
+	int get_scenario_number_errors() const{return number_errors;} //For the last scenario passed to compare_sequences_error_prob
+	int get_scenario_genomic_nucl() const{return genomic_nucl;}
+	void set_seq_statistics(long double , long double , long double , long double , int);
 
 
 
@@ -0,0 +1,482 @@
+/*
+ * Stripedsw.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Stripedsw.h"
+#include <limits>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define IGOR_STRIPED_SW_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//Score given to the padding positions of the striped profile
+static const int16_t padding_score = INT16_MIN/2;
+//Maximal absolute value accepted for substitution scores and gap penalty
+static const double max_abs_score = INT16_MAX/2;
+
+static Simd_level detect_simd_level(){
+#ifdef IGOR_STRIPED_SW_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")){
+		return AVX2_simd;
+	}
+	if(__builtin_cpu_supports("sse2")){
+		return SSE2_simd;
+	}
+#endif
+	return No_simd;
+}
+
+/*
+ * Returns the best instruction set available on this CPU (detected once)
+ */
+Simd_level get_simd_level(){
+	static const Simd_level simd_level = detect_simd_level();
+	return simd_level;
+}
+
+/*
+ * Checks that the substitution scores and gap penalty can be represented exactly by the 16 bits kernels
+ */
+static bool scores_fit_int16(const Matrix<double>& substitution_matrix , int gap_penalty){
+	if( (gap_penalty<0) or (gap_penalty>max_abs_score) ){
+		return false;
+	}
+	for(int i = 0 ; i != substitution_matrix.get_n_rows() ; ++i){
+		for(int j = 0 ; j != substitution_matrix.get_n_cols() ; ++j){
+			double score = substitution_matrix(i,j);
+			if( (score != floor(score)) or (fabs(score)>max_abs_score) ){
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+#ifdef IGOR_STRIPED_SW_X86
+
+/*
+ * Striped SW score pass using SSE2 (8 lanes of 16 bits)
+ * h_store, h_load and e_vect must hold seg_length*8 scores
+ */
+static int16_t striped_max_score_sse2(const int16_t* profile , size_t seg_length , const Int_Str& target , int16_t gap_penalty , bool local_align , int16_t* h_store , int16_t* h_load , int16_t* e_vect){
+	const __m128i v_gap = _mm_set1_epi16(gap_penalty);
+	const __m128i v_zero = _mm_setzero_si128();
+	//Vertical gap opened from the null first row, only reaches the first lane
+	const __m128i v_first_lane_gap = _mm_setr_epi16(-gap_penalty,0,0,0,0,0,0,0);
+	const __m128i v_f_init = _mm_setr_epi16(-gap_penalty,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN);
+	__m128i v_max = _mm_set1_epi16(INT16_MIN);
+
+	for(size_t s = 0 ; s != seg_length ; ++s){
+		_mm_storeu_si128((__m128i*) (h_store + 8*s) , v_zero);
+		_mm_storeu_si128((__m128i*) (e_vect + 8*s) , _mm_set1_epi16(-gap_penalty));
+	}
+
+	for(size_t j = 1 ; j < target.size() ; ++j){
+		const int16_t* target_profile = profile + target[j]*seg_length*8;
+		//Diagonal move from the last segment of the previous column, the first row is null
+		__m128i v_h = _mm_slli_si128(_mm_loadu_si128((__m128i*) (h_store + 8*(seg_length-1))) , 2);
+		swap(h_store , h_load);
+		__m128i v_f = v_f_init;
+
+		for(size_t s = 0 ; s != seg_length ; ++s){
+			v_h = _mm_adds_epi16(v_h , _mm_loadu_si128((__m128i*) (target_profile + 8*s)));
+			__m128i v_e = _mm_loadu_si128((__m128i*) (e_vect + 8*s));
+			v_h = _mm_max_epi16(v_h , v_e);
+			v_h = _mm_max_epi16(v_h , v_f);
+			if(local_align){
+				v_h = _mm_max_epi16(v_h , v_zero);
+			}
+			v_max = _mm_max_epi16(v_max , v_h);
+			_mm_storeu_si128((__m128i*) (h_store + 8*s) , v_h);
+
+			__m128i v_h_gap = _mm_subs_epi16(v_h , v_gap);
+			_mm_storeu_si128((__m128i*) (e_vect + 8*s) , _mm_max_epi16(_mm_subs_epi16(v_e , v_gap) , v_h_gap));
+			v_f = _mm_max_epi16(_mm_subs_epi16(v_f , v_gap) , v_h_gap);
+			v_h = _mm_loadu_si128((__m128i*) (h_load + 8*s));
+		}
+
+		//Lazy F loop: propagate vertical gaps across lanes until they cannot improve any score
+		for(size_t k = 0 ; k != 8 ; ++k){
+			v_f = _mm_adds_epi16(_mm_slli_si128(v_f , 2) , v_first_lane_gap);
+			for(size_t s = 0 ; s != seg_length ; ++s){
+				v_h = _mm_loadu_si128((__m128i*) (h_store + 8*s));
+				if(_mm_movemask_epi8(_mm_cmpgt_epi16(v_f , v_h)) == 0){
+					goto column_complete;
+				}
+				v_h = _mm_max_epi16(v_h , v_f);
+				v_max = _mm_max_epi16(v_max , v_h);
+				_mm_storeu_si128((__m128i*) (h_store + 8*s) , v_h);
+				__m128i v_e = _mm_loadu_si128((__m128i*) (e_vect + 8*s));
+				_mm_storeu_si128((__m128i*) (e_vect + 8*s) , _mm_max_epi16(v_e , _mm_subs_epi16(v_h , v_gap)));
+				v_f = _mm_subs_epi16(v_f , v_gap);
+			}
+		}
+		column_complete: ;
+	}
+
+	int16_t lanes_max[8];
+	_mm_storeu_si128((__m128i*) lanes_max , v_max);
+	return *max_element(lanes_max , lanes_max + 8);
+}
+
+/*
+ * Shifts the 16 bits lanes of a 256 bits vector by one lane, shifting in a zero
+ */
+__attribute__((target("avx2")))
+static inline __m256i shift_lanes_avx2(__m256i v){
+	return _mm256_alignr_epi8(v , _mm256_permute2x128_si256(v , v , 0x08) , 14);
+}
+
+/*
+ * Striped SW score pass using AVX2 (16 lanes of 16 bits)
+ * h_store, h_load and e_vect must hold seg_length*16 scores
+ */
+__attribute__((target("avx2")))
+static int16_t striped_max_score_avx2(const int16_t* profile , size_t seg_length , const Int_Str& target , int16_t gap_penalty , bool local_align , int16_t* h_store , int16_t* h_load , int16_t* e_vect){
+	const __m256i v_gap = _mm256_set1_epi16(gap_penalty);
+	const __m256i v_zero = _mm256_setzero_si256();
+	//Vertical gap opened from the null first row, only reaches the first lane
+	const __m256i v_first_lane_gap = _mm256_setr_epi16(-gap_penalty,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0);
+	const __m256i v_f_init = _mm256_setr_epi16(-gap_penalty,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,
+			INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN,INT16_MIN);
+	__m256i v_max = _mm256_set1_epi16(INT16_MIN);
+
+	for(size_t s = 0 ; s != seg_length ; ++s){
+		_mm256_storeu_si256((__m256i*) (h_store + 16*s) , v_zero);
+		_mm256_storeu_si256((__m256i*) (e_vect + 16*s) , _mm256_set1_epi16(-gap_penalty));
+	}
+
+	for(size_t j = 1 ; j < target.size() ; ++j){
+		const int16_t* target_profile = profile + target[j]*seg_length*16;
+		//Diagonal move from the last segment of the previous column, the first row is null
+		__m256i v_h = shift_lanes_avx2(_mm256_loadu_si256((__m256i*) (h_store + 16*(seg_length-1))));
+		swap(h_store , h_load);
+		__m256i v_f = v_f_init;
+
+		for(size_t s = 0 ; s != seg_length ; ++s){
+			v_h = _mm256_adds_epi16(v_h , _mm256_loadu_si256((__m256i*) (target_profile + 16*s)));
+			__m256i v_e = _mm256_loadu_si256((__m256i*) (e_vect + 16*s));
+			v_h = _mm256_max_epi16(v_h , v_e);
+			v_h = _mm256_max_epi16(v_h , v_f);
+			if(local_align){
+				v_h = _mm256_max_epi16(v_h , v_zero);
+			}
+			v_max = _mm256_max_epi16(v_max , v_h);
+			_mm256_storeu_si256((__m256i*) (h_store + 16*s) , v_h);
+
+			__m256i v_h_gap = _mm256_subs_epi16(v_h , v_gap);
+			_mm256_storeu_si256((__m256i*) (e_vect + 16*s) , _mm256_max_epi16(_mm256_subs_epi16(v_e , v_gap) , v_h_gap));
+			v_f = _mm256_max_epi16(_mm256_subs_epi16(v_f , v_gap) , v_h_gap);
+			v_h = _mm256_loadu_si256((__m256i*) (h_load + 16*s));
+		}
+
+		//Lazy F loop: propagate vertical gaps across lanes until they cannot improve any score
+		for(size_t k = 0 ; k != 16 ; ++k){
+			v_f = _mm256_adds_epi16(shift_lanes_avx2(v_f) , v_first_lane_gap);
+			for(size_t s = 0 ; s != seg_length ; ++s){
+				v_h = _mm256_loadu_si256((__m256i*) (h_store + 16*s));
+				if(_mm256_movemask_epi8(_mm256_cmpgt_epi16(v_f , v_h)) == 0){
+					goto column_complete;
+				}
+				v_h = _mm256_max_epi16(v_h , v_f);
+				v_max = _mm256_max_epi16(v_max , v_h);
+				_mm256_storeu_si256((__m256i*) (h_store + 16*s) , v_h);
+				__m256i v_e = _mm256_loadu_si256((__m256i*) (e_vect + 16*s));
+				_mm256_storeu_si256((__m256i*) (e_vect + 16*s) , _mm256_max_epi16(v_e , _mm256_subs_epi16(v_h , v_gap)));
+				v_f = _mm256_subs_epi16(v_f , v_gap);
+			}
+		}
+		column_complete: ;
+	}
+
+	int16_t lanes_max[16];
+	_mm256_storeu_si256((__m256i*) lanes_max , v_max);
+	return *max_element(lanes_max , lanes_max + 16);
+}
+
+/*
+ * Inter sequence SW score pass using SSE2: one target sequence per lane (8 lanes of 16 bits)
+ * The profile holds for each residue and row the substitution scores of the 8 targets, h_col must hold n_rows*8 scores
+ */
+static void interseq_max_scores_sse2(const int16_t* profile , size_t n_rows , const Int_Str& genomic_seq , int16_t gap_penalty , bool local_align , int16_t* h_col , int16_t* lanes_max){
+	const __m128i v_gap = _mm_set1_epi16(gap_penalty);
+	const __m128i v_zero = _mm_setzero_si128();
+	__m128i v_max = _mm_set1_epi16(INT16_MIN);
+
+	for(size_t i = 0 ; i != n_rows ; ++i){
+		_mm_storeu_si128((__m128i*) (h_col + 8*i) , v_zero);
+	}
+
+	for(size_t j = 1 ; j < genomic_seq.size() ; ++j){
+		const int16_t* residue_profile = profile + genomic_seq[j]*n_rows*8;
+		//The first row is null
+		__m128i v_diag = v_zero;
+		__m128i v_up = v_zero;
+		for(size_t i = 0 ; i != n_rows ; ++i){
+			__m128i v_left = _mm_loadu_si128((__m128i*) (h_col + 8*i));
+			__m128i v_h = _mm_adds_epi16(v_diag , _mm_loadu_si128((__m128i*) (residue_profile + 8*i)));
+			v_h = _mm_max_epi16(v_h , _mm_subs_epi16(v_left , v_gap));
+			v_h = _mm_max_epi16(v_h , _mm_subs_epi16(v_up , v_gap));
+			if(local_align){
+				v_h = _mm_max_epi16(v_h , v_zero);
+			}
+			v_max = _mm_max_epi16(v_max , v_h);
+			_mm_storeu_si128((__m128i*) (h_col + 8*i) , v_h);
+			v_diag = v_left;
+			v_up = v_h;
+		}
+	}
+	_mm_storeu_si128((__m128i*) lanes_max , v_max);
+}
+
+/*
+ * Inter sequence SW score pass using AVX2: one target sequence per lane (16 lanes of 16 bits)
+ * The profile holds for each residue and row the substitution scores of the 16 targets, h_col must hold n_rows*16 scores
+ */
+__attribute__((target("avx2")))
+static void interseq_max_scores_avx2(const int16_t* profile , size_t n_rows , const Int_Str& genomic_seq , int16_t gap_penalty , bool local_align , int16_t* h_col , int16_t* lanes_max){
+	const __m256i v_gap = _mm256_set1_epi16(gap_penalty);
+	const __m256i v_zero = _mm256_setzero_si256();
+	__m256i v_max = _mm256_set1_epi16(INT16_MIN);
+
+	for(size_t i = 0 ; i != n_rows ; ++i){
+		_mm256_storeu_si256((__m256i*) (h_col + 16*i) , v_zero);
+	}
+
+	for(size_t j = 1 ; j < genomic_seq.size() ; ++j){
+		const int16_t* residue_profile = profile + genomic_seq[j]*n_rows*16;
+		//The first row is null
+		__m256i v_diag = v_zero;
+		__m256i v_up = v_zero;
+		for(size_t i = 0 ; i != n_rows ; ++i){
+			__m256i v_left = _mm256_loadu_si256((__m256i*) (h_col + 16*i));
+			__m256i v_h = _mm256_adds_epi16(v_diag , _mm256_loadu_si256((__m256i*) (residue_profile + 16*i)));
+			v_h = _mm256_max_epi16(v_h , _mm256_subs_epi16(v_left , v_gap));
+			v_h = _mm256_max_epi16(v_h , _mm256_subs_epi16(v_up , v_gap));
+			if(local_align){
+				v_h = _mm256_max_epi16(v_h , v_zero);
+			}
+			v_max = _mm256_max_epi16(v_max , v_h);
+			_mm256_storeu_si256((__m256i*) (h_col + 16*i) , v_h);
+			v_diag = v_left;
+			v_up = v_h;
+		}
+	}
+	_mm256_storeu_si256((__m256i*) lanes_max , v_max);
+}
+
+#endif
+
+/*
+ * Builds the striped profile of the target sequence
+ * The first nucleotide of the target is not used since the first row of the SW matrix is null in Aligner::sw_align
+ */
+Striped_sw_profile::Striped_sw_profile(const Int_Str& int_data_sequence , const Matrix<double>& substitution_matrix , int gap_pen , bool local):
+		enabled(false) , simd_level(get_simd_level()) , local_align(local) , gap_penalty(0) , n_lanes(0) , seg_length(0) , n_residues(0) {
+
+	switch(simd_level){
+	case SSE2_simd:
+		n_lanes = 8;
+		break;
+	case AVX2_simd:
+		n_lanes = 16;
+		break;
+	default:
+		//No SIMD support, the scalar alignment is used
+		return;
+	}
+
+	//Check that all scores are exactly represented
+	if(not scores_fit_int16(substitution_matrix , gap_pen)){
+		return;
+	}
+	n_residues = substitution_matrix.get_n_cols();
+	for(Int_Str::const_iterator iter = int_data_sequence.begin() ; iter != int_data_sequence.end() ; ++iter){
+		if( ((*iter)<0) or ((*iter)>=substitution_matrix.get_n_rows()) ){
+			return;
+		}
+	}
+
+	gap_penalty = gap_pen;
+	size_t n_rows = (int_data_sequence.size()>0) ? int_data_sequence.size()-1 : 0;
+	seg_length = max((n_rows + n_lanes - 1)/n_lanes , (size_t) 1);
+
+	//Lane k of segment s holds row s + k*seg_length
+	profile.assign(n_residues*seg_length*n_lanes , padding_score);
+	for(size_t residue = 0 ; residue != n_residues ; ++residue){
+		for(size_t s = 0 ; s != seg_length ; ++s){
+			for(size_t k = 0 ; k != n_lanes ; ++k){
+				size_t row = s + k*seg_length;
+				if(row < n_rows){
+					profile[(residue*seg_length + s)*n_lanes + k] = substitution_matrix(int_data_sequence[row+1],residue);
+				}
+			}
+		}
+	}
+	h_store.resize(seg_length*n_lanes);
+	h_load.resize(seg_length*n_lanes);
+	e_vect.resize(seg_length*n_lanes);
+	enabled = (n_rows > 0);
+}
+
+Striped_sw_profile::~Striped_sw_profile() {
+	// TODO Auto-generated destructor stub
+}
+
+/*
+ * Returns an upper bound of the maximum score of the SW matrix between the profiled sequence and the genomic template
+ * Returns INT16_MAX if the bound cannot be computed (the template should then be aligned)
+ */
+int Striped_sw_profile::max_score(const Int_Str& int_genomic_sequence) const{
+	if(not enabled){
+		return INT16_MAX;
+	}
+	if(int_genomic_sequence.size()<2){
+		//Empty SW matrix, no alignment can be found
+		return numeric_limits<int>::min();
+	}
+	for(Int_Str::const_iterator iter = int_genomic_sequence.begin() ; iter != int_genomic_sequence.end() ; ++iter){
+		if( ((*iter)<0) or ((size_t)(*iter)>=n_residues) ){
+			return INT16_MAX;
+		}
+	}
+#ifdef IGOR_STRIPED_SW_X86
+	switch(simd_level){
+	case SSE2_simd:
+		return striped_max_score_sse2(profile.data() , seg_length , int_genomic_sequence , gap_penalty , local_align , h_store.data() , h_load.data() , e_vect.data());
+	case AVX2_simd:
+		return striped_max_score_avx2(profile.data() , seg_length , int_genomic_sequence , gap_penalty , local_align , h_store.data() , h_load.data() , e_vect.data());
+	default:
+		break;
+	}
+#endif
+	return INT16_MAX;
+}
+
+/*
+ * Returns the number of target sequences aligned at once by Interseq_sw_batch (1 if no SIMD support)
+ */
+size_t get_interseq_batch_size(){
+	switch(get_simd_level()){
+	case SSE2_simd:
+		return 8;
+	case AVX2_simd:
+		return 16;
+	default:
+		return 1;
+	}
+}
+
+/*
+ * Builds the inter sequence profile of a batch of at most get_interseq_batch_size() target sequences
+ * The first nucleotide of the targets is not used since the first row of the SW matrix is null in Aligner::sw_align
+ */
+Interseq_sw_batch::Interseq_sw_batch(const std::vector<const Int_Str*>& int_data_sequences , const Matrix<double>& substitution_matrix , int gap_pen , bool local):
+		enabled(false) , simd_level(get_simd_level()) , local_align(local) , gap_penalty(0) , n_lanes(get_interseq_batch_size()) , n_rows(0) , n_residues(0) , n_seqs(int_data_sequences.size()) , lanes_status(int_data_sequences.size() , Invalid_lane) {
+
+	if( (simd_level == No_simd) or (n_seqs > n_lanes) ){
+		return;
+	}
+	if(not scores_fit_int16(substitution_matrix , gap_pen)){
+		return;
+	}
+	gap_penalty = gap_pen;
+	n_residues = substitution_matrix.get_n_cols();
+
+	for(size_t k = 0 ; k != n_seqs ; ++k){
+		const Int_Str& int_data_sequence = *int_data_sequences[k];
+		lanes_status[k] = (int_data_sequence.size()<2) ? Empty_lane : Valid_lane;
+		for(Int_Str::const_iterator iter = int_data_sequence.begin() ; iter != int_data_sequence.end() ; ++iter){
+			if( ((*iter)<0) or ((*iter)>=substitution_matrix.get_n_rows()) ){
+				//The bound cannot be computed for this sequence
+				lanes_status[k] = Invalid_lane;
+				break;
+			}
+		}
+		if( (lanes_status[k] == Valid_lane) and (int_data_sequence.size()-1 > n_rows) ){
+			n_rows = int_data_sequence.size()-1;
+		}
+	}
+
+	//Rows beyond the end of a sequence are padded
+	profile.assign(n_residues*n_rows*n_lanes , padding_score);
+	for(size_t k = 0 ; k != n_seqs ; ++k){
+		if(lanes_status[k] != Valid_lane){
+			continue;
+		}
+		const Int_Str& int_data_sequence = *int_data_sequences[k];
+		for(size_t residue = 0 ; residue != n_residues ; ++residue){
+			for(size_t row = 0 ; row+1 < int_data_sequence.size() ; ++row){
+				profile[(residue*n_rows + row)*n_lanes + k] = substitution_matrix(int_data_sequence[row+1],residue);
+			}
+		}
+	}
+	h_col.resize(n_rows*n_lanes);
+	enabled = (n_rows > 0);
+}
+
+Interseq_sw_batch::~Interseq_sw_batch() {
+	// TODO Auto-generated destructor stub
+}
+
+/*
+ * Computes for each sequence of the batch an upper bound of the maximum score of its SW matrix with the genomic template
+ * Bounds are set to INT16_MAX if they cannot be computed (the template should then be aligned)
+ */
+void Interseq_sw_batch::max_scores(const Int_Str& int_genomic_sequence , std::vector<int>& seqs_bounds) const{
+	seqs_bounds.assign(n_seqs , INT16_MAX);
+	for(size_t k = 0 ; k != n_seqs ; ++k){
+		if( (lanes_status[k] == Empty_lane) or (int_genomic_sequence.size()<2) ){
+			//Empty SW matrix, no alignment can be found
+			seqs_bounds[k] = numeric_limits<int>::min();
+		}
+	}
+	if( (not enabled) or (int_genomic_sequence.size()<2) ){
+		return;
+	}
+	for(Int_Str::const_iterator iter = int_genomic_sequence.begin() ; iter != int_genomic_sequence.end() ; ++iter){
+		if( ((*iter)<0) or ((size_t)(*iter)>=n_residues) ){
+			return;
+		}
+	}
+#ifdef IGOR_STRIPED_SW_X86
+	int16_t lanes_max[16];
+	switch(simd_level){
+	case SSE2_simd:
+		interseq_max_scores_sse2(profile.data() , n_rows , int_genomic_sequence , gap_penalty , local_align , h_col.data() , lanes_max);
+		break;
+	case AVX2_simd:
+		interseq_max_scores_avx2(profile.data() , n_rows , int_genomic_sequence , gap_penalty , local_align , h_col.data() , lanes_max);
+		break;
+	default:
+		return;
+	}
+	for(size_t k = 0 ; k != n_seqs ; ++k){
+		if(lanes_status[k] == Valid_lane){
+			seqs_bounds[k] = lanes_max[k];
+		}
+	}
+#endif
+}
@@ -0,0 +1,116 @@
+/*
+ * Stripedsw.h
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef IGOR_SRC_STRIPEDSW_H_
+#define IGOR_SRC_STRIPEDSW_H_
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include "Utils.h"
+#include "IntStr.h"
+
+/**
+ * Instruction sets the striped kernel can run on, detected at runtime
+ */
+enum Simd_level{No_simd , SSE2_simd , AVX2_simd};
+
+Simd_level get_simd_level();
+
+
+/**
+ * \class Striped_sw_profile Stripedsw.h
+ * \brief Striped (Farrar) query profile computing Smith-Waterman score upper bounds with 16 bits integer SIMD arithmetic.
+ * \version 1.0
+ *
+ * The profile is built once for a target sequence and can then be run against every genomic template.
+ * It computes the maximum over the score matrix filled by Aligner::sw_align (same linear gap penalty, same local/non local
+ * recursion and same null first row and column) without any traceback.
+ * Since every alignment score reported by Aligner::sw_align is one of the cells of this matrix, a template whose maximum is
+ * below the score threshold cannot yield any alignment and does not need to be aligned.
+ *
+ * Saturated arithmetic can only overestimate negative scores, the returned value is thus always an upper bound of the
+ * exact maximum as long as it is below INT16_MAX.
+ * The kernel is disabled (is_enabled() returns false) if the CPU has no SIMD support or if the substitution matrix/gap penalty
+ * cannot be represented exactly with 16 bits integers, in which case the caller should fall back to the scalar alignment.
+ */
+class Striped_sw_profile {
+public:
+	Striped_sw_profile(const Int_Str& , const Matrix<double>& , int , bool);
+	virtual ~Striped_sw_profile();
+
+	bool is_enabled() const {return enabled;}
+	int max_score(const Int_Str&) const;
+
+private:
+	bool enabled;
+	Simd_level simd_level;
+	bool local_align;
+	int16_t gap_penalty;
+	size_t n_lanes;
+	size_t seg_length;
+	size_t n_residues;
+	std::vector<int16_t> profile;
+	//DP work vectors, reused between templates
+	mutable std::vector<int16_t> h_store;
+	mutable std::vector<int16_t> h_load;
+	mutable std::vector<int16_t> e_vect;
+};
+
+
+size_t get_interseq_batch_size();
+
+/**
+ * \class Interseq_sw_batch Stripedsw.h
+ * \brief Inter sequence Smith-Waterman score upper bounds for a batch of target sequences, one sequence per SIMD lane.
+ * \version 1.0
+ *
+ * Computes the same bound as Striped_sw_profile for get_interseq_batch_size() target sequences at once (8 with SSE2, 16 with AVX2).
+ * The substitution profile of the batch is built once and shared by all genomic templates.
+ * Unlike the striped kernel there is no lazy F loop, this makes it faster for short targets (e.g CDR3 or J alignments) for which
+ * the striped segments are mostly padding.
+ * Sequences of different lengths are padded, the bound of each sequence is thus the same as the one obtained aligning it alone.
+ */
+class Interseq_sw_batch {
+public:
+	Interseq_sw_batch(const std::vector<const Int_Str*>& , const Matrix<double>& , int , bool);
+	virtual ~Interseq_sw_batch();
+
+	bool is_enabled() const {return enabled;}
+	void max_scores(const Int_Str& , std::vector<int>&) const;
+
+private:
+	enum Lane_status{Valid_lane , Empty_lane , Invalid_lane};
+	bool enabled;
+	Simd_level simd_level;
+	bool local_align;
+	int16_t gap_penalty;
+	size_t n_lanes;
+	size_t n_rows;
+	size_t n_residues;
+	size_t n_seqs;
+	std::vector<Lane_status> lanes_status;
+	std::vector<int16_t> profile;
+	//DP work vector, reused between templates
+	mutable std::vector<int16_t> h_col;
+};
+
+#endif /* IGOR_SRC_STRIPEDSW_H_ */
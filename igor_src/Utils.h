@@ -43,6 +43,9 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <unordered_map>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
 
 
 class Rec_Event;
@@ -72,12 +75,47 @@ std::string operator+(const std::string& , Event_type );
 //Type used to describe the array of doubles containing the marginals values
 typedef std::unique_ptr<long double []> Marginal_array_p;
 
+/**
+ * \class Touched_marginals_indices Utils.h
+ * \brief Records which entries of a marginal array have been written to.
+ *
+ * A single sequence only touches a tiny fraction of the marginal array. Recording the touched indices
+ * allows to normalize, merge and reset the single sequence marginals without walking the whole array.
+ * Each index is recorded only once until clear() is called.
+ */
+class Touched_marginals_indices{
+public:
+	Touched_marginals_indices(): touched_flags() , touched_indices(){}
+	Touched_marginals_indices(size_t array_size): touched_flags(array_size,0) , touched_indices(){}
+	void touch(size_t index){
+		if(not touched_flags[index]){
+			touched_flags[index] = 1;
+			touched_indices.push_back(index);
+		}
+	}
+	void touch_range(size_t first_index , size_t range_length){
+		for(size_t i = first_index ; i != first_index + range_length ; ++i){
+			touch(i);
+		}
+	}
+	void clear(){
+		for(std::vector<size_t>::const_iterator iter = touched_indices.begin() ; iter != touched_indices.end() ; ++iter){
+			touched_flags[*iter] = 0;
+		}
+		touched_indices.clear();
+	}
+	const std::vector<size_t>& get_indices() const{return touched_indices;}
+	size_t size() const{return touched_indices.size();}
+private:
+	std::vector<unsigned char> touched_flags;
+	std::vector<size_t> touched_indices;
+};
+
 //Type used as key for unordered map since Rec_event cannot be instantiated
 typedef std::string Rec_Event_name;
 
 //Type used for offset of alignmed sequences in sequence_offsets maps. Used to characterize the beginning and the end of a sequence on the data sequence
 typedef int Seq_Offset;
-typedef Int_Str* Int_Str_ptr;
 
 //Typedef used for getting the next event ptr
 //typedef std::shared_ptr<Rec_Event> Next_event_ptr; //Does not work for some reason
@@ -139,6 +177,7 @@ public:
 		for(int i = 0 ; i != rows*cols ; i++){
 			this->array_p[i] = other.array_p[i];
 		}
+		return *this;
 	}
 
 	T& operator()(const int& i ,const int& j ){
@@ -190,6 +229,89 @@ std::ostream& operator<<(std::ostream& stream ,const Matrix<T>& mat){
 }
 
 
+/*
+ * Move only matrix with unchecked accessors, reserved for internal hot loops (e.g the SW alignment workspace)
+ * The buffer is 64 bytes aligned and only grows: reshape() reuses it whenever it is large enough.
+ * Only meant for trivial types (contents are left uninitialized)
+ */
+template<typename T> struct Unchecked_matrix {
+	static_assert(std::is_trivial<T>::value , "Unchecked_matrix can only hold trivial types");
+public:
+	Unchecked_matrix(): rows(0) , cols(0) , capacity(0) , array_p(nullptr){}
+	Unchecked_matrix(int m , int n): rows(0) , cols(0) , capacity(0) , array_p(nullptr){
+		this->reshape(m,n);
+	}
+	Unchecked_matrix(const Unchecked_matrix<T>&) = delete;
+	Unchecked_matrix<T>& operator=(const Unchecked_matrix<T>&) = delete;
+	Unchecked_matrix(Unchecked_matrix<T>&& other): rows(other.rows) , cols(other.cols) , capacity(other.capacity) , array_p(other.array_p){
+		other.rows = 0;
+		other.cols = 0;
+		other.capacity = 0;
+		other.array_p = nullptr;
+	}
+	Unchecked_matrix<T>& operator=(Unchecked_matrix<T>&& other){
+		if(this != &other){
+			free(array_p);
+			rows = other.rows;
+			cols = other.cols;
+			capacity = other.capacity;
+			array_p = other.array_p;
+			other.rows = 0;
+			other.cols = 0;
+			other.capacity = 0;
+			other.array_p = nullptr;
+		}
+		return *this;
+	}
+	~Unchecked_matrix(){
+		free(array_p);
+	}
+
+	/*
+	 * Sets the dimensions of the matrix, the content is not preserved
+	 * Returns true if the buffer had to be reallocated
+	 */
+	bool reshape(int m , int n){
+		if( (m<0) or (n<0) ){
+			throw std::invalid_argument("Cannot reshape a matrix to negative dimensions ["+std::to_string(m)+","+std::to_string(n)+"]");
+		}
+		rows = m;
+		cols = n;
+		size_t size = (size_t) m*n;
+		if(size <= capacity){
+			return false;
+		}
+		free(array_p);
+		array_p = nullptr;
+		void* buffer_p;
+		if(posix_memalign(&buffer_p , 64 , size*sizeof(T)) != 0){
+			capacity = 0;
+			throw std::bad_alloc();
+		}
+		array_p = static_cast<T*>(buffer_p);
+		capacity = size;
+		return true;
+	}
+
+	T& operator()(const int& i ,const int& j ){
+		return array_p[i + rows*j];
+	}
+	const T& operator()(const int& i ,const int& j ) const{
+		return array_p[i + rows*j];
+	}
+
+	//Accessors
+	const int& get_n_rows() const {return rows;}
+	const int& get_n_cols() const {return cols;}
+	T* data() {return array_p;}
+private:
+	int rows;
+	int cols;
+	size_t capacity;
+	T* array_p;
+};
+
+
 /*
  * This class provides a fast alternative to unordered_map<Seq_type,string*> for the constructed_sequences objects
  * Change this and give some kind of matrix with memory levels
@@ -344,6 +466,15 @@ public:
 			}
 		}
 
+		/*
+		 * Overwrite the value of the first memory layer of a key without invalidating the upper layers
+		 * (used to set read specific values before exploring the scenarios, see init_read_proba_bounds())
+		 */
+		void set_first_layer_value(const K& key , const V& value){
+			if(key>range-1){throw std::out_of_range("Unknown seq type in Enum_fast_memory_map::set_first_layer_value()");}
+			value_ptr_arr[key] = value;
+		}
+
 		void init_first_layer(V value){
 			for(size_t i = 0 ; i!=range ; ++i){
 				if(memory_layer_ptr[i]>-1){
@@ -368,7 +499,7 @@ protected:
 
 
 
-typedef Enum_fast_memory_map<Seq_type,Int_Str_ptr> Seq_type_str_p_map;
+typedef Enum_fast_memory_map<Seq_type,Int_Str_view> Seq_type_str_p_map; //Views on the sequences constructed by the events (see Int_Str_view)
 
 typedef Enum_fast_memory_map<Event_safety,bool> Safety_bool_map;
 
@@ -651,7 +782,7 @@ typedef Enum_fast_memory_dual_key_map<Seq_type,Seq_side,Seq_Offset> Seq_offsets_
  }
 
  struct D_position_comparator{
- 	 bool operator()(std::tuple<std::string,int,int,double> position_1 , std::tuple<std::string,int,int,double> position_2 ){
+ 	 bool operator()(const std::tuple<int,int,int,double>& position_1 , const std::tuple<int,int,int,double>& position_2 ){
  		 return std::get<3>(position_1) > std::get<3>(position_2);
  	 }
  };
@@ -48,6 +48,9 @@
 #include <string>
 #include "CDR3SeqData.h"
 #include "ExtractFeatures.h"
+#include "Seqstreamreader.h"
+#include "Alignmentpipeline.h"
+#include <thread>
 
 using namespace std;
 
@@ -143,7 +146,13 @@ int main(int argc , char* argv[]){
 	//Input sequences variables
 	bool read_seqs = false;
 	Fileformat seqs_fileformat;
+	bool input_seqs_gzipped = false;
 	string input_seqs_file;
+	bool qual_trim_seqs = false;
+	int qual_trim_thresh = 20;
+	size_t qual_trim_min_length = 1;
+	int qual_phred_offset = 33;
+	size_t read_seqs_chunk_size = 100000;
 
 	//Genomic templates list and aligns parms
 	vector<pair<string,string>> v_genomic;
@@ -176,6 +185,16 @@ int main(int argc , char* argv[]){
 	bool no_infer = false;
 	set<string> infer_restrict_nicknames;
 	bool fix_err_rate = false;
+	bool junction_dp_inference = false;
+	size_t skeleton_cache_mb = 0;
+	int skeleton_reexplore_period = 5;
+	Scenario_ordering scenario_ordering_inference = Alignment_order;
+	bool greedy_seed_inference = false;
+	bool read_bounds_inference = true;
+	bool generic_engine_inference = false;
+	size_t split_chunk_alignments_inference = 0;
+	size_t seq_budget_branches_inference = 0;
+	double seq_budget_seconds_inference = 0;
 	bool subsample_seqs = false;
 	size_t n_subsample_seqs;
 
@@ -183,6 +202,23 @@ int main(int argc , char* argv[]){
 	bool viterbi_evaluate = false;
 	double likelihood_thresh_evaluate = 1e-60;;
 	double proba_threshold_ratio_evaluate = 1e-5;
+	bool junction_dp_evaluate = false;
+	Scenario_ordering scenario_ordering_evaluate = Alignment_order;
+	bool greedy_seed_evaluate = false;
+	bool read_bounds_evaluate = true;
+	bool generic_engine_evaluate = false;
+	size_t split_chunk_alignments_evaluate = 0;
+	size_t seq_budget_branches_evaluate = 0;
+	double seq_budget_seconds_evaluate = 0;
+
+	//Read the binary alignment files instead of the CSV ones (inference and evaluation)
+	bool read_bin_alignments = false;
+
+	//Fused align/evaluate pipeline parms
+	bool pipeline = false;
+	size_t pipeline_batch_size = 1000;
+	size_t pipeline_queue_size = 4;
+	int pipeline_align_threads = 0; //0: half of the threads
 
 	//Alignment parameters
 	double heavy_pen_nuc44_vect [] = { // A,C,G,T,R,Y,K,M,S,W,B,D,H,V,N
@@ -204,6 +240,11 @@ int main(int argc , char* argv[]){
 
 	Matrix<double> heavy_pen_nuc44_sub_matrix(15,15,heavy_pen_nuc44_vect);
 
+		//Alignment output format
+		Alignment_fileformat align_output_format = CSV_align_f;
+		Alignment_output_order align_output_order = Arrival_order;
+		string align_cache_dir;
+
 		//V alignment vars
 		bool align_v = false;
 		string v_align_filename = "V_alignments.csv";
@@ -216,6 +257,7 @@ int main(int argc , char* argv[]){
 		int v_right_offset_bound = INT16_MAX;
 		unordered_map<string,pair<int,int>> v_template_bounds_map;
 		bool v_reversed_offsets = false;
+		size_t v_seed_length = 0;
 
 		//D alignment vars
 		bool align_d = false;
@@ -229,6 +271,7 @@ int main(int argc , char* argv[]){
 		int d_right_offset_bound = INT16_MAX;
 		unordered_map<string,pair<int,int>> d_template_bounds_map;
 		bool d_reversed_offsets = false;
+		size_t d_seed_length = 0;
 
 		//J alignment vars
 		bool align_j = false;
@@ -242,6 +285,7 @@ int main(int argc , char* argv[]){
 		int j_right_offset_bound = INT16_MAX;
 		unordered_map<string,pair<int,int>> j_template_bounds_map;
 		bool j_reversed_offsets = false;
+		size_t j_seed_length = 0;
 
 		// Flag to extract CDR3 from aligned sequences.
 		bool b_feature		  = true;
@@ -413,6 +457,52 @@ int main(int argc , char* argv[]){
 			custom = true;
 		}
 
+		else if(string(argv[carg_i]) == "-pipeline"){
+			//Align and evaluate sequences batch by batch without writing alignments on disk
+			pipeline = true;
+			while(	(carg_i+1<argc)
+					and (string(argv[carg_i+1]).size()>2)
+					and (string(argv[carg_i+1]).substr(0,2) == "--")){
+				++carg_i;
+				if(string(argv[carg_i]) == "--batch_size"){
+					++carg_i;
+					try{
+						pipeline_batch_size = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the number of sequences per pipeline batch, received: \"" + string(argv[carg_i]) + "\"");
+					}
+				}
+				else if(string(argv[carg_i]) == "--queue_size"){
+					++carg_i;
+					try{
+						pipeline_queue_size = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the maximum number of aligned batches waiting for evaluation, received: \"" + string(argv[carg_i]) + "\"");
+					}
+				}
+				else if(string(argv[carg_i]) == "--align_threads"){
+					++carg_i;
+					try{
+						pipeline_align_threads = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the number of threads aligning sequences in the pipeline, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if(pipeline_align_threads < 1){
+						return terminate_IGoR_with_error_message("The number of threads aligning sequences in the pipeline must be strictly positive");
+					}
+				}
+				else{
+					return terminate_IGoR_with_error_message("Unknown argument \""+string(argv[carg_i])+"\" to specify pipeline parameters");
+				}
+			}
+			if( (pipeline_batch_size == 0) or (pipeline_queue_size == 0) ){
+				return terminate_IGoR_with_error_message("Pipeline batch size and queue size must be strictly positive");
+			}
+		}
+
 		else if(string(argv[carg_i]) == "-subsample"){
 			subsample_seqs = true;
 			++carg_i;
@@ -455,6 +545,8 @@ int main(int argc , char* argv[]){
 				int right_offset_bound;
 				bool reversed_offset_provided = false;
 				bool reversed_offsets;
+				bool seed_length_provided = false;
+				size_t seed_length;
 				unordered_map<string,pair<int,int>> template_bounds_map;
 
 				if( (gene_str_val == "--V")
@@ -585,10 +677,29 @@ int main(int argc , char* argv[]){
 							}
 							reversed_offset_provided = true;
 						}
+						else if(string(argv[carg_i]) == "---seed_filter"){
+							//Read the length of the k-mers used to prefilter genomic templates (0 for exact mode)
+							++carg_i;
+							try{
+								int kmer_length = stoi(string(argv[carg_i]));
+								if( (kmer_length<0) or (kmer_length>16) ){
+									throw out_of_range("Seed length out of range");
+								}
+								seed_length = kmer_length;
+							}
+							catch (exception& e) {
+								return terminate_IGoR_with_error_message("Expected an integer between 0 and 16 for the seed filter k-mer length, received: \"" + string(argv[carg_i]) + "\"");
+							}
+							seed_length_provided = true;
+						}
 						else{
 							return terminate_IGoR_with_error_message("Unknown parameter\"" + string(argv[carg_i]) +"\" for gene " + gene_str_val + " in -align " );
 						}
 					}
+					//D and J templates are too short for the k-mer prefilter to keep their alignments
+					if(seed_length_provided and (seed_length>0) and (gene_str_val != "--V")){
+						return terminate_IGoR_with_error_message("The seed filter can only be used for V genes (use \"-align --V ---seed_filter K\"), D and J templates are too short to be safely prefiltered");
+					}
 				}
 				else if(string(argv[carg_i]) == "--ntCDR3"){
 					align_data_is_CDR3 = true;
@@ -614,6 +725,42 @@ int main(int argc , char* argv[]){
 						}
 					}
 				}
+				else if(string(argv[carg_i]) == "--format"){
+					//Choose the alignments output file format
+					++carg_i;
+					string format_str = string(argv[carg_i]);
+					if(format_str == "csv"){
+						align_output_format = CSV_align_f;
+					}
+					else if(format_str == "bin"){
+						align_output_format = BIN_align_f;
+					}
+					else if(format_str == "both"){
+						align_output_format = CSV_BIN_align_f;
+					}
+					else{
+						return terminate_IGoR_with_error_message("Unknown alignment file format \"" + format_str + "\" for -align --format, expected csv, bin or both");
+					}
+				}
+				else if(string(argv[carg_i]) == "--order"){
+					//Choose the order of the sequences in the alignments files
+					++carg_i;
+					string order_str = string(argv[carg_i]);
+					if(order_str == "arrival"){
+						align_output_order = Arrival_order;
+					}
+					else if(order_str == "input"){
+						align_output_order = Input_order;
+					}
+					else{
+						return terminate_IGoR_with_error_message("Unknown alignment order \"" + order_str + "\" for -align --order, expected arrival or input");
+					}
+				}
+				else if(string(argv[carg_i]) == "--cache"){
+					//Directory of the persistent alignment cache
+					++carg_i;
+					align_cache_dir = string(argv[carg_i]);
+				}
 				else{
 					return terminate_IGoR_with_error_message("Unknown gene specification\"" + string(argv[carg_i]) + "\"for -align");
 				}
@@ -653,6 +800,10 @@ int main(int argc , char* argv[]){
 					if(reversed_offset_provided){
 						v_reversed_offsets = reversed_offsets;
 					}
+
+					if(seed_length_provided){
+						v_seed_length = seed_length;
+					}
 				}
 				if( (gene_str_val == "--D") or (gene_str_val == "--all")){
 					align_d = true;
@@ -688,6 +839,10 @@ int main(int argc , char* argv[]){
 					if(reversed_offset_provided){
 						d_reversed_offsets = reversed_offsets;
 					}
+
+					if(seed_length_provided){
+						d_seed_length = seed_length;
+					}
 				}
 				if( (gene_str_val == "--J") or (gene_str_val == "--all")){
 					align_j = true;
@@ -723,6 +878,10 @@ int main(int argc , char* argv[]){
 					if(reversed_offset_provided){
 						j_reversed_offsets = reversed_offsets;
 					}
+
+					if(seed_length_provided){
+						j_seed_length = seed_length;
+					}
 				}
 
 			}
@@ -820,6 +979,141 @@ int main(int argc , char* argv[]){
 				else if(string(argv[carg_i]) == "--fix_err"){
 					fix_err_rate = true;
 				}
+				else if(string(argv[carg_i]) == "--junction_dp"){
+					if(infer){
+						junction_dp_inference = true;
+					}
+					else{
+						junction_dp_evaluate = true;
+					}
+				}
+				else if(string(argv[carg_i]) == "--scenario_order"){
+					++carg_i;
+					Scenario_ordering ordering;
+					if(string(argv[carg_i]) == "alignment"){
+						ordering = Alignment_order;
+					}
+					else if(string(argv[carg_i]) == "best_first"){
+						ordering = Best_first_order;
+					}
+					else{
+						return terminate_IGoR_with_error_message("Unknown scenario ordering \"" + string(argv[carg_i]) + "\", expected \"alignment\" or \"best_first\"");
+					}
+					if(infer){
+						scenario_ordering_inference = ordering;
+					}
+					else{
+						scenario_ordering_evaluate = ordering;
+					}
+				}
+				else if(string(argv[carg_i]) == "--crude_bounds"){
+					if(infer){
+						read_bounds_inference = false;
+					}
+					else{
+						read_bounds_evaluate = false;
+					}
+				}
+				else if(string(argv[carg_i]) == "--generic_engine"){
+					if(infer){
+						generic_engine_inference = true;
+					}
+					else{
+						generic_engine_evaluate = true;
+					}
+				}
+				else if(string(argv[carg_i]) == "--split_seqs"){
+					++carg_i;
+					size_t max_chunk_alignments;
+					try{
+						max_chunk_alignments = stoul(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the maximum number of alignments per sequence chunk, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if(infer){
+						split_chunk_alignments_inference = max_chunk_alignments;
+					}
+					else{
+						split_chunk_alignments_evaluate = max_chunk_alignments;
+					}
+				}
+				else if(string(argv[carg_i]) == "--seq_budget_branches"){
+					++carg_i;
+					size_t max_explored_branches;
+					try{
+						max_explored_branches = stoul(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the maximum number of explored partial scenarios per sequence, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if(infer){
+						seq_budget_branches_inference = max_explored_branches;
+					}
+					else{
+						seq_budget_branches_evaluate = max_explored_branches;
+					}
+				}
+				else if(string(argv[carg_i]) == "--seq_budget_time"){
+					++carg_i;
+					double max_seconds;
+					try{
+						max_seconds = stod(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected a number of seconds for the exploration time budget per sequence, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if(max_seconds < 0){
+						return terminate_IGoR_with_error_message("The exploration time budget per sequence cannot be negative, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if(infer){
+						seq_budget_seconds_inference = max_seconds;
+					}
+					else{
+						seq_budget_seconds_evaluate = max_seconds;
+					}
+				}
+				else if(string(argv[carg_i]) == "--bin_aligns"){
+					read_bin_alignments = true;
+				}
+				else if(string(argv[carg_i]) == "--greedy_seed"){
+					if(infer){
+						greedy_seed_inference = true;
+					}
+					else{
+						greedy_seed_evaluate = true;
+					}
+				}
+				else if(string(argv[carg_i]) == "--skeleton_cache"){
+					if(not infer){
+						return terminate_IGoR_with_error_message("Invalid argument \"--skeleton_cache\" for -evaluate");
+					}
+					skeleton_cache_mb = 1024;
+					//Optional memory budget in MB
+					if( (carg_i+1<argc)
+							and string(argv[carg_i+1]).size()>=1
+							and string(argv[carg_i+1]).substr(0,1)!="-"){
+						++carg_i;
+						try{
+							skeleton_cache_mb = stoul(string(argv[carg_i]));
+						}
+						catch(exception& e){
+							return terminate_IGoR_with_error_message("Expected an integer for the scenario skeleton cache size (MB), received: \"" + string(argv[carg_i]) + "\"");
+						}
+					}
+				}
+				else if(string(argv[carg_i]) == "--skeleton_reexplore"){
+					if(not infer){
+						return terminate_IGoR_with_error_message("Invalid argument \"--skeleton_reexplore\" for -evaluate");
+					}
+					++carg_i;
+					try{
+						skeleton_reexplore_period = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the scenario skeleton re-exploration period, received: \"" + string(argv[carg_i]) + "\"");
+					}
+				}
 
 
 				else{
@@ -988,30 +1282,106 @@ int main(int argc , char* argv[]){
 			read_seqs = true;
 			++carg_i;
 			input_seqs_file = string(argv[carg_i]);
-			//Get the extension index
-			size_t extension_index = input_seqs_file.rfind(".");
-			if(extension_index!=string::npos){
-				string tmp_str = input_seqs_file.substr(extension_index , string::npos );
-				transform(tmp_str.begin(),tmp_str.end(),tmp_str.begin(),::tolower);
-				if( tmp_str == ".fasta" ){
-					seqs_fileformat = FASTA_f;
-					clog<<"FASTA extension detected for the input sequence file"<<endl;
-				}
-				else if(tmp_str == ".csv"){
-					seqs_fileformat = CSV_f;
-					clog<<"CSV extension detected for the input sequence file"<<endl;
-				}
-				else if(tmp_str == ".txt"){
-					seqs_fileformat = TXT_f;
-					clog<<"TXT extension detected for the input sequence file"<<endl;
+			//Detect the file format from the extension (possibly followed by .gz)
+			try{
+				seqs_fileformat = detect_seq_file_format(input_seqs_file,input_seqs_gzipped);
+			}
+			catch(exception& e){
+				return terminate_IGoR_with_error_message("Could not detect the input sequence file format:",e);
+			}
+			switch(seqs_fileformat){
+			case FASTA_f:
+				clog<<"FASTA extension detected for the input sequence file";
+				break;
+			case FASTQ_f:
+				clog<<"FASTQ extension detected for the input sequence file";
+				break;
+			case CSV_f:
+				clog<<"CSV extension detected for the input sequence file";
+				break;
+			case TXT_f:
+				if(input_seqs_file.rfind(".txt") == string::npos){
+					clog<<"No extension detected for the input sequence file assuming a text file without header";
 				}
 				else{
-					return terminate_IGoR_with_error_message("Unknown file extension \"" + tmp_str + "\" for input sequences file! ");
+					clog<<"TXT extension detected for the input sequence file";
 				}
+				break;
+			default:
+				break;
 			}
-			else{
-				clog<<"No extension detected for the input sequence file assuming a text file without header"<<endl;
-				seqs_fileformat = TXT_f;
+			if(input_seqs_gzipped){
+				clog<<" (gzipped)";
+			}
+			clog<<endl;
+
+			//Check for quality trimming options (FASTQ only)
+			bool qual_trim_option_set = false;
+			while(	(carg_i+1<argc)
+					and (string(argv[carg_i+1]).size()>2)
+					and (string(argv[carg_i+1]).substr(0,2) == "--")){
+				++carg_i;
+				if(string(argv[carg_i]) == "--qual_trim"){
+					qual_trim_seqs = true;
+					++carg_i;
+					try{
+						qual_trim_thresh = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the quality trimming Phred score threshold, received: \"" + string(argv[carg_i]) + "\"");
+					}
+				}
+				else if(string(argv[carg_i]) == "--min_length"){
+					qual_trim_option_set = true;
+					++carg_i;
+					int min_length;
+					try{
+						min_length = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the minimal read length after quality trimming, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if(min_length < 1){
+						return terminate_IGoR_with_error_message("The minimal read length after quality trimming (--min_length) must be at least 1, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					qual_trim_min_length = min_length;
+				}
+				else if(string(argv[carg_i]) == "--phred_offset"){
+					qual_trim_option_set = true;
+					++carg_i;
+					try{
+						qual_phred_offset = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the Phred score offset, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if( (qual_phred_offset != 33) and (qual_phred_offset != 64) ){
+						return terminate_IGoR_with_error_message("The Phred score offset (--phred_offset) must be 33 or 64, received: \"" + string(argv[carg_i]) + "\"");
+					}
+				}
+				else if(string(argv[carg_i]) == "--chunk_size"){
+					++carg_i;
+					int chunk_size;
+					try{
+						chunk_size = stoi(string(argv[carg_i]));
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Expected an integer for the number of sequences read per chunk, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					if(chunk_size < 1){
+						return terminate_IGoR_with_error_message("The number of sequences read per chunk (--chunk_size) must be at least 1, received: \"" + string(argv[carg_i]) + "\"");
+					}
+					read_seqs_chunk_size = chunk_size;
+				}
+				else{
+					return terminate_IGoR_with_error_message("Unknown argument \""+string(argv[carg_i])+"\" to specify input sequences reading");
+				}
+			}
+			if(qual_trim_seqs and (seqs_fileformat != FASTQ_f)){
+				return terminate_IGoR_with_error_message("Quality trimming (--qual_trim) can only be used with FASTQ input files");
+			}
+			if(qual_trim_option_set and (not qual_trim_seqs)){
+				return terminate_IGoR_with_error_message("--min_length and --phred_offset can only be used along with quality trimming (--qual_trim)");
 			}
 		}
 
@@ -1030,6 +1400,19 @@ int main(int argc , char* argv[]){
 	}
 	clog<<"Working directory set to: \""+cl_path+"\""<<endl;
 
+	//Check that the fused pipeline is used in a supported configuration
+	if(pipeline){
+		if( (not align) or (not evaluate) or infer){
+			return terminate_IGoR_with_error_message("The -pipeline command requires both -align and -evaluate (and cannot be used with -infer)");
+		}
+		if(subsample_seqs){
+			return terminate_IGoR_with_error_message("The -pipeline command cannot be used with -subsample");
+		}
+		if(align_data_is_CDR3){
+			return terminate_IGoR_with_error_message("The -pipeline command cannot be used to align CDR3 sequences (--ntCDR3)");
+		}
+	}
+
 	//Check that both species and chain have been provided
 	if(chain_provided xor species_provided){
 		forward_list<string> error_messages;
@@ -1730,39 +2113,186 @@ int main(int argc , char* argv[]){
 
 	else if (not custom){
 		//Execute code dictated by command line arguments
-		if(read_seqs){
+		if(pipeline){
+			/*
+			 * Fused read/align/evaluate pipeline:
+			 * a producer thread reads and aligns sequences by batches and pushes them in a bounded queue,
+			 * batches are evaluated as soon as they are available such that no indexed sequences or alignments file is written.
+			 */
+			clog<<"Running fused align/evaluate pipeline with batches of "<<pipeline_batch_size<<" sequences (at most "<<pipeline_queue_size<<" batches waiting for evaluation)"<<endl;
+
+			//Both stages run at the same time, split the threads between them instead of running twice as many threads as requested
+			int n_threads = omp_get_max_threads();
+			int n_align_threads;
+			if(pipeline_align_threads > 0){
+				n_align_threads = min(pipeline_align_threads , max(n_threads-1 , 1));
+			}
+			else{
+				n_align_threads = max(n_threads/2 , 1);
+			}
+			int n_evaluate_threads = max(n_threads - n_align_threads , 1);
+			clog<<"Pipeline threads: "<<n_align_threads<<" aligning, "<<n_evaluate_threads<<" evaluating"<<endl;
+
+			list<Pipeline_align_parms> align_parms_list;
+			Pipeline_align_parms v_align_parms = {V_gene , make_shared<Aligner>(v_subst_matrix , v_gap_penalty , V_gene) , v_align_thresh_value , v_best_align_only , v_best_gene_only ,
+					complete_offset_bounds(v_template_bounds_map , v_genomic , v_left_offset_bound , v_right_offset_bound) , v_reversed_offsets , 55};
+			v_align_parms.aligner_p->set_genomic_sequences(v_genomic);
+			v_align_parms.aligner_p->set_seed_filter(v_seed_length);
+			align_parms_list.push_back(v_align_parms);
+			if(has_D){
+				Pipeline_align_parms d_align_parms = {D_gene , make_shared<Aligner>(d_subst_matrix , d_gap_penalty , D_gene) , d_align_thresh_value , d_best_align_only , d_best_gene_only ,
+						complete_offset_bounds(d_template_bounds_map , d_genomic , d_left_offset_bound , d_right_offset_bound) , d_reversed_offsets , 35};
+				d_align_parms.aligner_p->set_genomic_sequences(d_genomic);
+				d_align_parms.aligner_p->set_seed_filter(d_seed_length);
+				align_parms_list.push_back(d_align_parms);
+			}
+			Pipeline_align_parms j_align_parms = {J_gene , make_shared<Aligner>(j_subst_matrix , j_gap_penalty , J_gene) , j_align_thresh_value , j_best_align_only , j_best_gene_only ,
+					complete_offset_bounds(j_template_bounds_map , j_genomic , j_left_offset_bound , j_right_offset_bound) , j_reversed_offsets , 10};
+			j_align_parms.aligner_p->set_genomic_sequences(j_genomic);
+			j_align_parms.aligner_p->set_seed_filter(j_seed_length);
+			align_parms_list.push_back(j_align_parms);
+
+			//Get the sequences source: stream the input file if provided, otherwise read the indexed sequences file
+			shared_ptr<Seq_stream_reader> seq_reader_p;
 			vector<pair<const int, const string>> indexed_seqlist;
-			switch(seqs_fileformat){
-			case FASTA_f:
-				indexed_seqlist = read_fasta(input_seqs_file);
-				break;
-			case CSV_f:
-				indexed_seqlist = read_indexed_csv(input_seqs_file);
-				break;
-			case TXT_f:
-				indexed_seqlist = read_txt(input_seqs_file);
-				break;
-			default:
-				return terminate_IGoR_with_error_message("Unknown file format for input seqs file!");
+			size_t indexed_seqlist_position = 0;
+			try{
+				if(read_seqs and (seqs_fileformat != CSV_f)){
+					seq_reader_p = make_shared<Seq_stream_reader>(input_seqs_file,seqs_fileformat);
+					if(qual_trim_seqs){
+						seq_reader_p->set_quality_trimming(qual_trim_thresh,qual_trim_min_length,qual_phred_offset);
+					}
+				}
+				else if(read_seqs){
+					indexed_seqlist = read_indexed_csv(input_seqs_file);
+				}
+				else{
+					indexed_seqlist = read_indexed_csv(cl_path + "aligns/" + batchname + "indexed_sequences.csv");
+				}
+			}
+			catch(exception& e){
+				return terminate_IGoR_with_error_message("Exception caught while opening the input sequences for the pipeline:",e);
 			}
 
+			Seq_chunk_reader read_chunk;
+			if(seq_reader_p){
+				read_chunk = [seq_reader_p](vector<pair<const int,const string>>& seq_chunk , size_t max_chunk_size){
+					return seq_reader_p->read_chunk(seq_chunk,max_chunk_size);
+				};
+			}
+			else{
+				read_chunk = [&indexed_seqlist,&indexed_seqlist_position](vector<pair<const int,const string>>& seq_chunk , size_t max_chunk_size){
+					size_t n_appended = 0;
+					while( (n_appended<max_chunk_size) and (indexed_seqlist_position<indexed_seqlist.size()) ){
+						seq_chunk.push_back(indexed_seqlist[indexed_seqlist_position]);
+						++indexed_seqlist_position;
+						++n_appended;
+					}
+					return n_appended;
+				};
+			}
+
+			//create the output and evaluate directories
+			system(&("mkdir " + cl_path +  batchname + "output")[0]);
+			system(&("mkdir " + cl_path +  batchname + "evaluate")[0]);
+
+			GenModel genmodel(cl_model_parms,cl_model_marginals,cl_counters_list);
+			genmodel.set_junction_dp(junction_dp_evaluate);
+			genmodel.set_scenario_ordering(scenario_ordering_evaluate , greedy_seed_evaluate);
+			genmodel.set_read_proba_bounds(read_bounds_evaluate);
+			genmodel.set_generic_scenario_engine(generic_engine_evaluate);
+			genmodel.set_sequence_splitting(split_chunk_alignments_evaluate);
+			genmodel.set_sequence_budget(seq_budget_branches_evaluate , seq_budget_seconds_evaluate);
+			Aligned_seq_queue seq_queue(pipeline_queue_size);
+
+			//Alignments of the next batches are performed while the current ones are evaluated
+			omp_set_num_threads(n_evaluate_threads);
+			thread producer_thread(produce_aligned_seq_batches , read_chunk , cref(align_parms_list) , pipeline_batch_size , n_align_threads , ref(seq_queue));
+			try{
+				genmodel.evaluate_seq_stream(seq_queue , cl_path +  batchname + "evaluate/" , likelihood_thresh_evaluate , viterbi_evaluate , proba_threshold_ratio_evaluate);
+			}
+			catch(exception& e){
+				//Unblock and wait for the producer before exiting
+				seq_queue.close();
+				producer_thread.join();
+				return terminate_IGoR_with_error_message("Exception caught while evaluating sequences in the pipeline:",e);
+			}
+			producer_thread.join();
+			omp_set_num_threads(n_threads);
+			try{
+				seq_queue.rethrow_producer_exception();
+			}
+			catch(exception& e){
+				return terminate_IGoR_with_error_message("Exception caught while reading or aligning sequences in the pipeline:",e);
+			}
+			if(seq_reader_p){
+				clog<<seq_reader_p->get_n_records_read()<<" sequences read from "<<input_seqs_file<<endl;
+				if(qual_trim_seqs){
+					clog<<seq_reader_p->get_n_trimmed_nt()<<" nucleotides trimmed, "<<seq_reader_p->get_n_records_discarded()<<" sequences shorter than "<<qual_trim_min_length<<" nucleotides after quality trimming discarded"<<endl;
+				}
+			}
+			clog<<seq_queue.get_n_pushed_seqs()<<" sequences aligned and evaluated"<<endl;
+		}
+
+		if(read_seqs and (not pipeline)){
 			//create the directory
 			system(&("mkdir " + cl_path + "aligns")[0]);
 
-			if(subsample_seqs){
+			if(seqs_fileformat == CSV_f){
+				vector<pair<const int, const string>> indexed_seqlist;
 				try{
-					indexed_seqlist = sample_indexed_seq(indexed_seqlist,n_subsample_seqs);
+					indexed_seqlist = read_indexed_csv(input_seqs_file);
 				}
 				catch(exception& e){
-					forward_list<string> error_messages;
-					return terminate_IGoR_with_error_message("Exception caught trying to subsample input files sequences to indexed sequences:",e);
+					return terminate_IGoR_with_error_message("Exception caught while reading input sequences file:",e);
+				}
+				if(subsample_seqs){
+					try{
+						indexed_seqlist = sample_indexed_seq(indexed_seqlist,n_subsample_seqs);
+					}
+					catch(exception& e){
+						return terminate_IGoR_with_error_message("Exception caught trying to subsample input files sequences to indexed sequences:",e);
+					}
 				}
+				write_indexed_seq_csv(cl_path + "aligns/" + batchname + "indexed_sequences.csv",indexed_seqlist);
 			}
+			else{
+				//Stream FASTA/FASTQ/TXT files (possibly gzipped) by chunks to keep memory usage bounded
+				try{
+					Seq_stream_reader seq_reader(input_seqs_file,seqs_fileformat);
+					if(qual_trim_seqs){
+						seq_reader.set_quality_trimming(qual_trim_thresh,qual_trim_min_length,qual_phred_offset);
+					}
+
+					if(subsample_seqs){
+						//Subsampling requires the whole set of sequences
+						vector<pair<const int, const string>> indexed_seqlist = seq_reader.read_all();
+						indexed_seqlist = sample_indexed_seq(indexed_seqlist,n_subsample_seqs);
+						write_indexed_seq_csv(cl_path + "aligns/" + batchname + "indexed_sequences.csv",indexed_seqlist);
+					}
+					else{
+						ofstream indexed_seq_file(cl_path + "aligns/" + batchname + "indexed_sequences.csv");
+						indexed_seq_file<<"seq_index"<<";"<<"sequence"<<endl;
+						vector<pair<const int, const string>> seq_chunk;
+						seq_chunk.reserve(read_seqs_chunk_size);
+						while(seq_reader.read_chunk(seq_chunk,read_seqs_chunk_size)>0){
+							append_indexed_seq_csv(indexed_seq_file,seq_chunk);
+							seq_chunk.clear();
+						}
+					}
 
-			write_indexed_seq_csv(cl_path + "aligns/" + batchname + "indexed_sequences.csv",indexed_seqlist);
+					clog<<seq_reader.get_n_records_read()<<" sequences read from "<<input_seqs_file<<endl;
+					if(qual_trim_seqs){
+						clog<<seq_reader.get_n_trimmed_nt()<<" nucleotides trimmed, "<<seq_reader.get_n_records_discarded()<<" sequences shorter than "<<qual_trim_min_length<<" nucleotides after quality trimming discarded"<<endl;
+					}
+				}
+				catch(exception& e){
+					return terminate_IGoR_with_error_message("Exception caught while reading input sequences file:",e);
+				}
+			}
 		}
 
-		if(align){
+		if(align and (not pipeline)){
 			vector<pair<const int, const string>> indexed_seqlist;
 			try{
 				indexed_seqlist = read_indexed_csv(cl_path + "aligns/" + batchname + "indexed_sequences.csv");
@@ -1784,6 +2314,10 @@ int main(int argc , char* argv[]){
 				//Performs V alignments
 				Aligner v_aligner = Aligner(v_subst_matrix , v_gap_penalty , V_gene);
 				v_aligner.set_genomic_sequences(v_genomic);
+				v_aligner.set_output_format(align_output_format);
+				v_aligner.set_output_order(align_output_order);
+				v_aligner.set_alignment_cache_dir(align_cache_dir);
+				v_aligner.set_seed_filter(v_seed_length);
 				try{
 					if (not align_data_is_CDR3){
 						clog<<"Performing V alignments...."<<endl;
@@ -1862,6 +2396,10 @@ int main(int argc , char* argv[]){
 				clog<<"Performing D alignments...."<<endl;
 				Aligner d_aligner = Aligner(d_subst_matrix , d_gap_penalty , D_gene);
 				d_aligner.set_genomic_sequences(d_genomic);
+				d_aligner.set_output_format(align_output_format);
+				d_aligner.set_output_order(align_output_order);
+				d_aligner.set_alignment_cache_dir(align_cache_dir);
+				d_aligner.set_seed_filter(d_seed_length);
 				try{
 					if(d_template_bounds_map.empty()){
 						d_aligner.align_seqs(cl_path + "aligns/" +  batchname + d_align_filename ,indexed_seqlist, d_align_thresh_value , d_best_align_only , d_best_gene_only , d_left_offset_bound , d_right_offset_bound, d_reversed_offsets);
@@ -1892,6 +2430,10 @@ int main(int argc , char* argv[]){
 			if(align_j){
 				Aligner j_aligner (j_subst_matrix , j_gap_penalty , J_gene);
 				j_aligner.set_genomic_sequences(j_genomic);
+				j_aligner.set_output_format(align_output_format);
+				j_aligner.set_output_order(align_output_order);
+				j_aligner.set_alignment_cache_dir(align_cache_dir);
+				j_aligner.set_seed_filter(j_seed_length);
 				try{
 					if (not align_data_is_CDR3){
 						clog<<"Performing J alignments...."<<endl;
@@ -1967,14 +2509,14 @@ int main(int argc , char* argv[]){
 				unordered_map<int,pair<string,unordered_map<Gene_class,vector<Alignment_data>>>> sorted_alignments;
 				// If alignments files are not found CDR3 will not be extracted.
 				try{
-					sorted_alignments = read_alignments_seq_csv_score_range(cl_path + "aligns/" +  batchname + v_align_filename, V_gene , 55 , false , indexed_seqlist  );
+					sorted_alignments = read_alignments_seq_csv_score_range(resolve_alignment_filename(cl_path + "aligns/" +  batchname + v_align_filename , false), V_gene , 55 , false , indexed_seqlist  );
 				}
 				catch(exception& e){
 					return terminate_IGoR_with_error_message("Exception caught while reading V alignments before feature extraction. Make sure alignments were carried previously using \"-align --V\" or \"-align --all\" with similar path parameters (working directory, batchname, ...)",e);
 				}
 
 				try{
-					sorted_alignments = read_alignments_seq_csv_score_range(cl_path + "aligns/" +  batchname + j_align_filename, J_gene , 10 , false , indexed_seqlist , sorted_alignments);
+					sorted_alignments = read_alignments_seq_csv_score_range(resolve_alignment_filename(cl_path + "aligns/" +  batchname + j_align_filename , false), J_gene , 10 , false , indexed_seqlist , sorted_alignments);
 				}
 				catch(exception& e){
 					return terminate_IGoR_with_error_message("Exception caught while reading J alignments before feature extraction. Make sure alignments were carried previously using \"-align --J\" or \"-align --all\" with similar path parameters (working directory, batchname, ...)",e);
@@ -2008,7 +2550,7 @@ int main(int argc , char* argv[]){
 			} // end extractCDR3
 		}//end align
 
-		if(infer xor evaluate){
+		if((infer xor evaluate) and (not pipeline)){
 
 			GenModel genmodel(cl_model_parms,cl_model_marginals,cl_counters_list);
 
@@ -2031,7 +2573,7 @@ int main(int argc , char* argv[]){
 			}
 			unordered_map<int,pair<string,unordered_map<Gene_class,vector<Alignment_data>>>> sorted_alignments;
 			try{
-				sorted_alignments = read_alignments_seq_csv_score_range(cl_path + "aligns/" +  batchname + v_align_filename, V_gene , 55 , false , indexed_seqlist  );
+				sorted_alignments = read_alignments_seq_csv_score_range(resolve_alignment_filename(cl_path + "aligns/" +  batchname + v_align_filename , read_bin_alignments), V_gene , 55 , false , indexed_seqlist  );
 			}
 			catch(exception& e){
 				return terminate_IGoR_with_error_message("Exception caught while reading V alignments before inference/evaluation. Make sure alignments were carried previously using \"-align --V\" or \"-align --all\" with similar path parameters (working directory, batchname, ...)",e);
@@ -2039,14 +2581,14 @@ int main(int argc , char* argv[]){
 
 			if(has_D){
 				try{
-					sorted_alignments = read_alignments_seq_csv_score_range(cl_path + "aligns/" +  batchname + d_align_filename, D_gene , 35 , false , indexed_seqlist , sorted_alignments);
+					sorted_alignments = read_alignments_seq_csv_score_range(resolve_alignment_filename(cl_path + "aligns/" +  batchname + d_align_filename , read_bin_alignments), D_gene , 35 , false , indexed_seqlist , sorted_alignments);
 				}
 				catch(exception& e){
 					return terminate_IGoR_with_error_message("Exception caught while reading D alignments before inference/evaluation. Make sure alignments were carried previously using \"-align --D\" or \"-align --all\" with similar path parameters (working directory, batchname, ...)",e);
 				}
 			}
 			try{
-				sorted_alignments = read_alignments_seq_csv_score_range(cl_path + "aligns/" +  batchname + j_align_filename, J_gene , 10 , false , indexed_seqlist , sorted_alignments);
+				sorted_alignments = read_alignments_seq_csv_score_range(resolve_alignment_filename(cl_path + "aligns/" +  batchname + j_align_filename , read_bin_alignments), J_gene , 10 , false , indexed_seqlist , sorted_alignments);
 			}
 			catch(exception& e){
 				return terminate_IGoR_with_error_message("Exception caught while reading J alignments before inference/evaluation. Make sure alignments were carried previously using \"-align --J\" or \"-align --all\" with similar path parameters (working directory, batchname, ...)",e);
@@ -2060,12 +2602,25 @@ int main(int argc , char* argv[]){
 			if(infer){
 				//create inference directory directory
 				system(&("mkdir " + cl_path +  batchname + "inference")[0]);
+				genmodel.set_junction_dp(junction_dp_inference);
+				genmodel.set_skeleton_cache(skeleton_cache_mb , skeleton_reexplore_period);
+				genmodel.set_scenario_ordering(scenario_ordering_inference , greedy_seed_inference);
+				genmodel.set_read_proba_bounds(read_bounds_inference);
+				genmodel.set_generic_scenario_engine(generic_engine_inference);
+				genmodel.set_sequence_splitting(split_chunk_alignments_inference);
+				genmodel.set_sequence_budget(seq_budget_branches_inference , seq_budget_seconds_inference);
 				genmodel.infer_model(sorted_alignments_vec , n_iter_inference , cl_path +  batchname + "inference/" , true , likelihood_thresh_inference , viterbi_inference , proba_threshold_ratio_inference);
 			}
 
 			if(evaluate){
 				//create evaluate directory
 				system(&("mkdir " + cl_path +  batchname + "evaluate")[0]);
+				genmodel.set_junction_dp(junction_dp_evaluate);
+				genmodel.set_scenario_ordering(scenario_ordering_evaluate , greedy_seed_evaluate);
+				genmodel.set_read_proba_bounds(read_bounds_evaluate);
+				genmodel.set_generic_scenario_engine(generic_engine_evaluate);
+				genmodel.set_sequence_splitting(split_chunk_alignments_evaluate);
+				genmodel.set_sequence_budget(seq_budget_branches_evaluate , seq_budget_seconds_evaluate);
 				genmodel.infer_model(sorted_alignments_vec , 1 , cl_path +  batchname + "evaluate/" , false , likelihood_thresh_evaluate , viterbi_evaluate , proba_threshold_ratio_evaluate);
 			}
 		}
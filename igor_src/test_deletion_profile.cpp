@@ -0,0 +1,87 @@
+/*
+ * test_deletion_profile.cpp
+ *
+ *  This source code is distributed as part of the IGoR software.
+ *  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+ *  generation, selection, mutation and all other processes.
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that a Deletion_profile_key does not match the upstream sequence of a different template.
+ * Run through 'make check'.
+ */
+
+#include "Deletion.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int n_failed = 0;
+
+static void check(bool condition , const string& description){
+	if(not condition){
+		cerr<<"FAIL: "<<description<<endl;
+		++n_failed;
+	}
+}
+
+static Int_Str to_int_str(const string& nt_seq){
+	Int_Str int_seq;
+	for(string::const_iterator iter = nt_seq.begin() ; iter != nt_seq.end() ; ++iter){
+		switch(*iter){
+			case 'A': int_seq.push_back(0); break;
+			case 'C': int_seq.push_back(1); break;
+			case 'G': int_seq.push_back(2); break;
+			case 'T': int_seq.push_back(3); break;
+			default: int_seq.push_back(4); break;
+		}
+	}
+	return int_seq;
+}
+
+int main(){
+	//Two D templates of equal length
+	const Int_Str d_1 = to_int_str("GGGACAGGGGGC");
+	const Int_Str d_2 = to_int_str("GGGACTAGCGGG");
+	const int offset = 17;
+
+	//Without D alignment every D template is explored with the same mismatch list, Gene_choice views each template in place
+	vector<int> no_d_mismatches;
+
+	Deletion_profile_key key;
+	check(not key.matches(Int_Str_view(d_1) , no_d_mismatches , offset) , "a new key matches an upstream sequence");
+
+	key.assign(Int_Str_view(d_1) , no_d_mismatches , offset);
+	check(key.matches(Int_Str_view(d_1) , no_d_mismatches , offset) , "the key does not match the template it was assigned");
+
+	check(not key.matches(Int_Str_view(d_2) , no_d_mismatches , offset) , "two D templates of equal length at the same offset share a deletion profile");
+	check(not key.matches(Int_Str_view(d_1).substr(0 , d_1.size()-1) , no_d_mismatches , offset) , "the key matches a truncated template");
+
+	check(not key.matches(Int_Str_view(d_1) , no_d_mismatches , offset+1) , "the key matches the same template at another offset");
+	vector<int> other_mismatches;
+	check(not key.matches(Int_Str_view(d_1) , other_mismatches , offset) , "the key matches the same template with another mismatch list");
+
+	key.invalidate();
+	check(not key.matches(Int_Str_view(d_1) , no_d_mismatches , offset) , "an invalidated key matches");
+
+	if(n_failed != 0){
+		cerr<<n_failed<<" deletion profile key check(s) failed"<<endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# test_greedy_seed.sh
+#
+#  This source code is distributed as part of the IGoR software.
+#  IGoR (Inference and Generation of Repertoires) is a versatile software to analyze and model immune receptors
+#  generation, selection, mutation and all other processes.
+#
+#   This program is free software: you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License as published by
+#   the Free Software Foundation, either version 3 of the License, or
+#   (at your option) any later version.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public License
+#   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+# Evaluates the first 100 TRB demo sequences with the default exploration and with --greedy_seed.
+# The seed must not prune the best scenario of any sequence nor zero its likelihood.
+# Run through 'make check'.
+
+srcdir=${srcdir:-.}
+model_dir=$srcdir/../models/human/tcr_beta
+work_dir=$(mktemp -d) || exit 99
+trap 'rm -rf "$work_dir"' EXIT
+
+head -n 100 $srcdir/../demo/murugan_naive1_noncoding_demo_seqs.txt > $work_dir/seqs.txt
+
+run_igor(){
+	./igor -set_wd $work_dir -threads 1 -batch test \
+		-set_genomic --V $model_dir/ref_genome/genomicVs.fasta --D $model_dir/ref_genome/genomicDs.fasta --J $model_dir/ref_genome/genomicJs.fasta \
+		-set_CDR3_anchors --V $model_dir/ref_genome/V_gene_CDR3_anchors.csv --J $model_dir/ref_genome/J_gene_CDR3_anchors.csv \
+		-set_custom_model $model_dir/models/model_parms.txt $model_dir/models/model_marginals.txt "$@" > $work_dir/igor.out 2>&1 \
+		|| { cat $work_dir/igor.out ; exit 99 ; }
+}
+
+run_igor -read_seqs $work_dir/seqs.txt -align --all -evaluate
+mv $work_dir/test_evaluate $work_dir/default_evaluate
+run_igor -evaluate --greedy_seed
+
+#Join both inference logs on the sequence index, the best scenario must be identical and the likelihood close
+awk -F';' '
+	FNR==1{
+		for(i=1 ; i<=NF ; ++i){ col[$i] = i }
+		next
+	}
+	NR==FNR{
+		likelihood[$col["seq_index"]] = $col["seq_likelihood"]
+		best[$col["seq_index"]] = $col["seq_best_scenario"]
+		next
+	}
+	{
+		++n_seqs
+		ref_likelihood = likelihood[$col["seq_index"]]
+		ref_best = best[$col["seq_index"]]
+		if( ($col["seq_best_scenario"] - ref_best) > 1e-9*ref_best || (ref_best - $col["seq_best_scenario"]) > 1e-9*ref_best ){
+			print "FAIL: sequence " $col["seq_index"] " best scenario " $col["seq_best_scenario"] " instead of " ref_best
+			++n_failed
+		}
+		if( (ref_likelihood - $col["seq_likelihood"]) > 1e-2*ref_likelihood || ($col["seq_likelihood"] - ref_likelihood) > 1e-6*ref_likelihood ){
+			print "FAIL: sequence " $col["seq_index"] " likelihood " $col["seq_likelihood"] " instead of " ref_likelihood
+			++n_failed
+		}
+	}
+	END{
+		if(n_seqs != 100){
+			print "FAIL: " n_seqs " sequences evaluated with --greedy_seed"
+			exit 1
+		}
+		exit (n_failed > 0)
+	}' $work_dir/default_evaluate/inference_logs.txt $work_dir/test_evaluate/inference_logs.txt
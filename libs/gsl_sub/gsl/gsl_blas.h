@@ -0,0 +1 @@
+../blas/gsl_blas.h
\ No newline at end of file
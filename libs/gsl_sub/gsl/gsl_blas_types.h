@@ -0,0 +1 @@
+../blas/gsl_blas_types.h
\ No newline at end of file
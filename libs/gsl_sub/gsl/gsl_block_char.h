@@ -0,0 +1 @@
+../block/gsl_block_char.h
\ No newline at end of file
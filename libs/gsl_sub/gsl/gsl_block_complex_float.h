@@ -0,0 +1 @@
+../block/gsl_block_complex_float.h
\ No newline at end of file
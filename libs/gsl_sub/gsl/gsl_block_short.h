@@ -0,0 +1 @@
+../block/gsl_block_short.h
\ No newline at end of file
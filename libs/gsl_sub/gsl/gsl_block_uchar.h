@@ -0,0 +1 @@
+../block/gsl_block_uchar.h
\ No newline at end of file
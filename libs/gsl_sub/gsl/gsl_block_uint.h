@@ -0,0 +1 @@
+../block/gsl_block_uint.h
\ No newline at end of file
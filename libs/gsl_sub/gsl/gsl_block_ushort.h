@@ -0,0 +1 @@
+../block/gsl_block_ushort.h
\ No newline at end of file
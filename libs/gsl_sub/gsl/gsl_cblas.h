@@ -0,0 +1 @@
+../cblas/gsl_cblas.h
\ No newline at end of file
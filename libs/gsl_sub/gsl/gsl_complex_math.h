@@ -0,0 +1 @@
+../complex/gsl_complex_math.h
\ No newline at end of file
@@ -0,0 +1 @@
+../eigen/gsl_eigen.h
\ No newline at end of file
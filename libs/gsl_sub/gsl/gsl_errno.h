@@ -0,0 +1 @@
+../err/gsl_errno.h
\ No newline at end of file
@@ -0,0 +1 @@
+../sort/gsl_heapsort.h
\ No newline at end of file
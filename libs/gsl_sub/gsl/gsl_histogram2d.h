@@ -0,0 +1 @@
+../histogram/gsl_histogram2d.h
\ No newline at end of file
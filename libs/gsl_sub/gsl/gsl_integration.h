@@ -0,0 +1 @@
+../integration/gsl_integration.h
\ No newline at end of file
@@ -0,0 +1 @@
+../gsl_math.h
\ No newline at end of file
@@ -0,0 +1 @@
+../matrix/gsl_matrix.h
\ No newline at end of file
@@ -0,0 +1 @@
+../matrix/gsl_matrix_complex_float.h
\ No newline at end of file
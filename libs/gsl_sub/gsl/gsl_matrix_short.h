@@ -0,0 +1 @@
+../matrix/gsl_matrix_short.h
\ No newline at end of file
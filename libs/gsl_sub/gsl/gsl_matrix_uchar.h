@@ -0,0 +1 @@
+../matrix/gsl_matrix_uchar.h
\ No newline at end of file
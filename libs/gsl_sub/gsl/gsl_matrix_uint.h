@@ -0,0 +1 @@
+../matrix/gsl_matrix_uint.h
\ No newline at end of file
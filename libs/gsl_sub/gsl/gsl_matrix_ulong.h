@@ -0,0 +1 @@
+../matrix/gsl_matrix_ulong.h
\ No newline at end of file
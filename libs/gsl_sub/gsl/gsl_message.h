@@ -0,0 +1 @@
+../err/gsl_message.h
\ No newline at end of file
@@ -0,0 +1 @@
+../gsl_mode.h
\ No newline at end of file
@@ -0,0 +1 @@
+../gsl_nan.h
\ No newline at end of file
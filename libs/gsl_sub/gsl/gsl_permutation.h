@@ -0,0 +1 @@
+../permutation/gsl_permutation.h
\ No newline at end of file
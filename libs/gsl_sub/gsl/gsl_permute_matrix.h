@@ -0,0 +1 @@
+../permutation/gsl_permute_matrix.h
\ No newline at end of file
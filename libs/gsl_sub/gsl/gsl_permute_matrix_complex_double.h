@@ -0,0 +1 @@
+../permutation/gsl_permute_matrix_complex_double.h
\ No newline at end of file
@@ -0,0 +1 @@
+../permutation/gsl_permute_matrix_ushort.h
\ No newline at end of file
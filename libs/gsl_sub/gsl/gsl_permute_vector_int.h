@@ -0,0 +1 @@
+../permutation/gsl_permute_vector_int.h
\ No newline at end of file
@@ -0,0 +1 @@
+../permutation/gsl_permute_vector_uint.h
\ No newline at end of file
@@ -0,0 +1 @@
+../poly/gsl_poly.h
\ No newline at end of file
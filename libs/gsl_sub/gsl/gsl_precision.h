@@ -0,0 +1 @@
+../gsl_precision.h
\ No newline at end of file
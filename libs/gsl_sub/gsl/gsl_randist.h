@@ -0,0 +1 @@
+../randist/gsl_randist.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_airy.h
\ No newline at end of file
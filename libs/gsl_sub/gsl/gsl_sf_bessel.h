@@ -0,0 +1 @@
+../specfunc/gsl_sf_bessel.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_clausen.h
\ No newline at end of file
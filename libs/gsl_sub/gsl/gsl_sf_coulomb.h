@@ -0,0 +1 @@
+../specfunc/gsl_sf_coulomb.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_coupling.h
\ No newline at end of file
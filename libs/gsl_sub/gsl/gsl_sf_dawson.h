@@ -0,0 +1 @@
+../specfunc/gsl_sf_dawson.h
\ No newline at end of file
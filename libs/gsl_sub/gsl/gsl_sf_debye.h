@@ -0,0 +1 @@
+../specfunc/gsl_sf_debye.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_ellint.h
\ No newline at end of file
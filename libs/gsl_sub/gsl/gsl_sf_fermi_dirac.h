@@ -0,0 +1 @@
+../specfunc/gsl_sf_fermi_dirac.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_gamma.h
\ No newline at end of file
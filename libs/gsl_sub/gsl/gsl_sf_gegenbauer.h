@@ -0,0 +1 @@
+../specfunc/gsl_sf_gegenbauer.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_hyperg.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_laguerre.h
\ No newline at end of file
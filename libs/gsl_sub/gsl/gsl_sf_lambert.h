@@ -0,0 +1 @@
+../specfunc/gsl_sf_lambert.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_log.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_mathieu.h
\ No newline at end of file
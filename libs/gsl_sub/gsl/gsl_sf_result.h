@@ -0,0 +1 @@
+../specfunc/gsl_sf_result.h
\ No newline at end of file
@@ -0,0 +1 @@
+../specfunc/gsl_sf_synchrotron.h
\ No newline at end of file
@@ -0,0 +1 @@
+../sort/gsl_sort.h
\ No newline at end of file
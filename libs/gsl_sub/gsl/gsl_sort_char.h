@@ -0,0 +1 @@
+../sort/gsl_sort_char.h
\ No newline at end of file
@@ -0,0 +1 @@
+../sort/gsl_sort_uchar.h
\ No newline at end of file
@@ -0,0 +1 @@
+../sort/gsl_sort_ulong.h
\ No newline at end of file
@@ -0,0 +1 @@
+../sort/gsl_sort_vector_ulong.h
\ No newline at end of file
@@ -0,0 +1 @@
+../statistics/gsl_statistics_double.h
\ No newline at end of file
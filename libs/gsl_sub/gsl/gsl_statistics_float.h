@@ -0,0 +1 @@
+../statistics/gsl_statistics_float.h
\ No newline at end of file
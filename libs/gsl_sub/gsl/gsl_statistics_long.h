@@ -0,0 +1 @@
+../statistics/gsl_statistics_long.h
\ No newline at end of file
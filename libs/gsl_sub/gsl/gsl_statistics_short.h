@@ -0,0 +1 @@
+../statistics/gsl_statistics_short.h
\ No newline at end of file
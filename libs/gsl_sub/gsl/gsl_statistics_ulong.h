@@ -0,0 +1 @@
+../statistics/gsl_statistics_ulong.h
\ No newline at end of file
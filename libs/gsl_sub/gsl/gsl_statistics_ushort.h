@@ -0,0 +1 @@
+../statistics/gsl_statistics_ushort.h
\ No newline at end of file
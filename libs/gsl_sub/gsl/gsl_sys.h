@@ -0,0 +1 @@
+../sys/gsl_sys.h
\ No newline at end of file
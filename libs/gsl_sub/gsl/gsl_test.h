@@ -0,0 +1 @@
+../test/gsl_test.h
\ No newline at end of file
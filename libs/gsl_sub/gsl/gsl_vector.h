@@ -0,0 +1 @@
+../vector/gsl_vector.h
\ No newline at end of file
@@ -0,0 +1 @@
+../vector/gsl_vector_char.h
\ No newline at end of file
@@ -0,0 +1 @@
+../vector/gsl_vector_complex_double.h
\ No newline at end of file
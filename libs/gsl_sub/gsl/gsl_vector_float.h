@@ -0,0 +1 @@
+../vector/gsl_vector_float.h
\ No newline at end of file
@@ -0,0 +1 @@
+../vector/gsl_vector_short.h
\ No newline at end of file
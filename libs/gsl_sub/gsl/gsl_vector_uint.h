@@ -0,0 +1 @@
+../vector/gsl_vector_uint.h
\ No newline at end of file
@@ -0,0 +1 @@
+../vector/gsl_vector_ushort.h
\ No newline at end of file